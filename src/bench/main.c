@@ -0,0 +1,467 @@
+/**
+ * @file bench/main.c
+ * @brief Load generator
+ *
+ * Reads its configuration from bench_input.txt (or the file given as the
+ * first argument), opens `connections` clients, one thread each, and
+ * sends messages as fast as the server acknowledges them or at a target
+ * rate. Results are printed to stdout as one JSON object; client logs go
+ * to bench_output.txt.
+ *
+ * Latency is measured from the moment a message was due to be sent until
+ * its ACK arrives. With a target rate the due time comes from the
+ * schedule, not from the actual send, so a stalled server shows up in
+ * the latency instead of silently lowering the offered load.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include "../client/client.h"
+#include "../common/logger.h"
+#include "../common/types.h"
+#include "../common/utils.h"
+#include "../common/histogram.h"
+#include "../common/buffer_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+
+#define MAX_LINE_LEN 256
+#define INPUT_FILE "bench_input.txt"
+#define OUTPUT_FILE "bench_output.txt"
+#define MAX_CONNECTIONS 1024
+#define MAX_MESSAGE_SIZE (64 * 1024 * 1024)
+#define CONNECT_TIMEOUT_SEC 5
+
+/**
+ * @brief Message size distribution
+ */
+typedef enum {
+    SIZE_DIST_FIXED,        ///< Every message is `size` bytes
+    SIZE_DIST_UNIFORM,      ///< Uniform in [size_min, size_max]
+    SIZE_DIST_EXPONENTIAL   ///< Exponential with mean `size`, clamped to [size_min, size_max]
+} SizeDistribution;
+
+typedef struct {
+    SocketMode mode;
+    char* address;
+    int enable_tls;
+    size_t connections;
+    size_t messages;        ///< Per connection (ignored when duration_sec > 0)
+    double duration_sec;
+    double rate;            ///< Messages per second over all connections (0 = as fast as possible)
+    size_t window;
+    uint32_t features;
+    size_t compression_threshold;
+    SizeDistribution size_dist;
+    size_t size;
+    size_t size_min;
+    size_t size_max;
+} BenchConfig;
+
+/**
+ * @brief Per-connection state, owned by its thread
+ */
+typedef struct {
+    const BenchConfig* config;
+    const char* payload;    ///< size_max bytes of message text, shared read-only
+    size_t id;
+    uint64_t rng;
+    uint64_t* due_ns;       ///< Due time of each in-flight sequence, indexed by sequence & due_mask
+    size_t due_mask;
+    Histogram latency;
+    uint64_t sent;
+    uint64_t acked;
+    uint64_t bytes;
+    uint64_t errors;
+    int connect_failed;
+    pthread_t thread;
+} BenchWorker;
+
+static const char* size_dist_name(SizeDistribution dist) {
+    switch (dist) {
+        case SIZE_DIST_UNIFORM: return "uniform";
+        case SIZE_DIST_EXPONENTIAL: return "exponential";
+        default: return "fixed";
+    }
+}
+
+static int parse_config(const char* filename, BenchConfig* config) {
+    FILE* f = fopen(filename, "r");
+    if (!f) {
+        fprintf(stderr, "Failed to open %s\n", filename);
+        return -1;
+    }
+    
+    memset(config, 0, sizeof(BenchConfig));
+    config->mode = SOCKET_MODE_INET;
+    config->connections = 4;
+    config->messages = 10000;
+    config->window = 1;
+    config->size_dist = SIZE_DIST_FIXED;
+    config->size = 64;
+    
+    char line[MAX_LINE_LEN];
+    while (fgets(line, sizeof(line), f)) {
+        // Remove newline
+        line[strcspn(line, "\n")] = '\0';
+        
+        // Skip empty lines and comments
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+        
+        char* eq = strchr(line, '=');
+        if (!eq) {
+            continue;
+        }
+        
+        *eq = '\0';
+        char* key = line;
+        char* value = eq + 1;
+        
+        if (strcmp(key, "mode") == 0) {
+            if (strcmp(value, "unix") == 0) {
+                config->mode = SOCKET_MODE_UNIX;
+            } else if (strcmp(value, "inet") == 0) {
+                config->mode = SOCKET_MODE_INET;
+            } else if (strcmp(value, "shm") == 0) {
+                config->mode = SOCKET_MODE_SHM;
+            }
+        } else if (strcmp(key, "address") == 0) {
+            free(config->address);
+            config->address = strdup(value);
+        } else if (strcmp(key, "tls") == 0) {
+            config->enable_tls = (atoi(value) != 0);
+        } else if (strcmp(key, "connections") == 0) {
+            long n = atol(value);
+            config->connections = n > 0 ? (size_t)n : 1;
+        } else if (strcmp(key, "messages") == 0) {
+            long n = atol(value);
+            config->messages = n > 0 ? (size_t)n : 1;
+        } else if (strcmp(key, "duration") == 0) {
+            double d = atof(value);
+            config->duration_sec = d > 0.0 ? d : 0.0;
+        } else if (strcmp(key, "rate") == 0) {
+            double r = atof(value);
+            config->rate = r > 0.0 ? r : 0.0;
+        } else if (strcmp(key, "window") == 0) {
+            int w = atoi(value);
+            config->window = w > 0 ? (size_t)w : 1;
+        } else if (strcmp(key, "ack_batch") == 0) {
+            if (atoi(value) != 0) {
+                config->features |= MSG_FEATURE_ACK_BATCH;
+            } else {
+                config->features &= ~(uint32_t)MSG_FEATURE_ACK_BATCH;
+            }
+        } else if (strcmp(key, "compression_threshold") == 0) {
+            long threshold = atol(value);
+            config->compression_threshold = threshold > 0 ? (size_t)threshold : 0;
+        } else if (strcmp(key, "size_dist") == 0) {
+            if (strcmp(value, "fixed") == 0) {
+                config->size_dist = SIZE_DIST_FIXED;
+            } else if (strcmp(value, "uniform") == 0) {
+                config->size_dist = SIZE_DIST_UNIFORM;
+            } else if (strcmp(value, "exponential") == 0) {
+                config->size_dist = SIZE_DIST_EXPONENTIAL;
+            }
+        } else if (strcmp(key, "size") == 0) {
+            long n = atol(value);
+            config->size = n > 0 ? (size_t)n : 1;
+        } else if (strcmp(key, "size_min") == 0) {
+            long n = atol(value);
+            config->size_min = n > 0 ? (size_t)n : 1;
+        } else if (strcmp(key, "size_max") == 0) {
+            long n = atol(value);
+            config->size_max = n > 0 ? (size_t)n : 1;
+        }
+    }
+    
+    fclose(f);
+    
+    // Set default address if not provided
+    if (!config->address) {
+        if (config->mode != SOCKET_MODE_INET) {
+            config->address = strdup("/tmp/server.sock");
+        } else {
+            config->address = strdup("localhost:8080");
+        }
+    }
+    if (config->mode != SOCKET_MODE_INET) {
+        config->enable_tls = 0;
+    }
+    if (config->connections > MAX_CONNECTIONS) {
+        config->connections = MAX_CONNECTIONS;
+    }
+    
+    // Size bounds default around `size`
+    if (config->size > MAX_MESSAGE_SIZE) {
+        config->size = MAX_MESSAGE_SIZE;
+    }
+    if (config->size_min == 0) {
+        config->size_min = config->size_dist == SIZE_DIST_FIXED ? config->size : 1;
+    }
+    if (config->size_max == 0) {
+        config->size_max = config->size_dist == SIZE_DIST_EXPONENTIAL ? config->size * 8 : config->size;
+    }
+    if (config->size_max > MAX_MESSAGE_SIZE) {
+        config->size_max = MAX_MESSAGE_SIZE;
+    }
+    if (config->size_min > config->size_max) {
+        config->size_min = config->size_max;
+    }
+    return 0;
+}
+
+static uint64_t next_random(uint64_t* state) {
+    // xorshift64*
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 2685821657736338717ull;
+}
+
+static size_t next_size(BenchWorker* worker) {
+    const BenchConfig* config = worker->config;
+    size_t size = config->size;
+    if (config->size_dist == SIZE_DIST_UNIFORM) {
+        size = config->size_min + (size_t)(next_random(&worker->rng) % (config->size_max - config->size_min + 1));
+    } else if (config->size_dist == SIZE_DIST_EXPONENTIAL) {
+        double u = (double)(next_random(&worker->rng) >> 11) / (double)(1ull << 53);
+        size = (size_t)(-log(1.0 - u) * (double)config->size);
+    }
+    if (size < config->size_min) {
+        size = config->size_min;
+    }
+    if (size > config->size_max) {
+        size = config->size_max;
+    }
+    return size;
+}
+
+static void sleep_ns(uint64_t ns) {
+    struct timespec ts = { (time_t)(ns / 1000000000u), (long)(ns % 1000000000u) };
+    nanosleep(&ts, NULL);
+}
+
+static void on_acked(uint64_t sequence, void* user_data) {
+    BenchWorker* worker = (BenchWorker*)user_data;
+    uint64_t now = get_monotonic_ns();
+    uint64_t due = worker->due_ns[sequence & worker->due_mask];
+    histogram_record(&worker->latency, now > due ? now - due : 0);
+    worker->acked++;
+}
+
+/**
+ * @brief Wait for the next due time, collecting ACKs meanwhile
+ */
+static int wait_until(Client* client, uint64_t due_ns) {
+    for (;;) {
+        uint64_t now = get_monotonic_ns();
+        if (now >= due_ns) {
+            return 0;
+        }
+        uint64_t remaining = due_ns - now;
+        if (client_in_flight(client) == 0) {
+            sleep_ns(remaining);
+        } else if (client_poll_acks(client, (int)(remaining / 1000000u)) < 0) {
+            // Below a millisecond this polls without blocking, so ACKs are still timed precisely
+            return -1;
+        }
+    }
+}
+
+static void* bench_thread(void* arg) {
+    BenchWorker* worker = (BenchWorker*)arg;
+    const BenchConfig* config = worker->config;
+    
+    Client client;
+    if (client_init(&client, config->mode, config->address, config->enable_tls) < 0) {
+        worker->connect_failed = 1;
+        return NULL;
+    }
+    client_set_features(&client, config->features);
+    client_set_compression(&client, config->compression_threshold);
+    client_set_window(&client, config->window);
+    client_set_ack_callback(&client, on_acked, worker);
+    if (client_connect(&client, CONNECT_TIMEOUT_SEC) < 0) {
+        worker->connect_failed = 1;
+        client_cleanup(&client);
+        return NULL;
+    }
+    
+    // Each connection offers an equal share of the rate, staggered so they do not send in lockstep
+    uint64_t interval_ns = 0;
+    uint64_t start = get_monotonic_ns();
+    if (config->rate > 0.0) {
+        interval_ns = (uint64_t)(1e9 * (double)config->connections / config->rate);
+        start += interval_ns * worker->id / config->connections;
+    }
+    uint64_t end = config->duration_sec > 0.0 ? start + (uint64_t)(config->duration_sec * 1e9) : UINT64_MAX;
+    
+    for (uint64_t i = 0; config->duration_sec > 0.0 || i < config->messages; i++) {
+        uint64_t due = interval_ns > 0 ? start + i * interval_ns : get_monotonic_ns();
+        if (due >= end) {
+            break;
+        }
+        if (interval_ns > 0 && wait_until(&client, due) < 0) {
+            worker->errors++;
+            break;
+        }
+        
+        size_t size = next_size(worker);
+        if (config->window > 1) {
+            // The callback looks the due time up by sequence number
+            worker->due_ns[(client.last_sent_sequence + 1) & worker->due_mask] = due;
+            if (client_send_text_async(&client, worker->payload, size, NULL) < 0) {
+                worker->errors++;
+                break;
+            }
+        } else {
+            if (client_send_text(&client, worker->payload, size) < 0) {
+                worker->errors++;
+                break;
+            }
+            uint64_t now = get_monotonic_ns();
+            histogram_record(&worker->latency, now > due ? now - due : 0);
+            worker->acked++;
+        }
+        worker->sent++;
+        worker->bytes += size;
+    }
+    
+    if (config->window > 1 && client_flush(&client, CONNECT_TIMEOUT_SEC * 1000) < 0) {
+        worker->errors += client_in_flight(&client);
+    }
+    
+    client_disconnect(&client);
+    client_cleanup(&client);
+    buffer_pool_thread_exit();
+    return NULL;
+}
+
+static void print_json(FILE* f, const BenchConfig* config, const BenchWorker* workers, double elapsed_sec) {
+    Histogram latency;
+    histogram_init(&latency);
+    uint64_t sent = 0, acked = 0, bytes = 0, errors = 0;
+    size_t failed = 0;
+    for (size_t i = 0; i < config->connections; i++) {
+        histogram_merge(&latency, &workers[i].latency);
+        sent += workers[i].sent;
+        acked += workers[i].acked;
+        bytes += workers[i].bytes;
+        errors += workers[i].errors;
+        failed += workers[i].connect_failed ? 1 : 0;
+    }
+    
+    double msgs_per_sec = elapsed_sec > 0.0 ? (double)acked / elapsed_sec : 0.0;
+    double mb_per_sec = elapsed_sec > 0.0 ? (double)bytes / (1024.0 * 1024.0) / elapsed_sec : 0.0;
+    
+    fprintf(f, "{\n");
+    fprintf(f, "  \"mode\": \"%s\",\n", socket_mode_name(config->mode));
+    fprintf(f, "  \"tls\": %s,\n", config->enable_tls ? "true" : "false");
+    fprintf(f, "  \"connections\": %zu,\n", config->connections);
+    fprintf(f, "  \"failed_connections\": %zu,\n", failed);
+    fprintf(f, "  \"window\": %zu,\n", config->window);
+    fprintf(f, "  \"target_rate\": %.1f,\n", config->rate);
+    fprintf(f, "  \"size_dist\": \"%s\",\n", size_dist_name(config->size_dist));
+    fprintf(f, "  \"size\": %zu,\n", config->size);
+    fprintf(f, "  \"size_min\": %zu,\n", config->size_min);
+    fprintf(f, "  \"size_max\": %zu,\n", config->size_max);
+    fprintf(f, "  \"messages_sent\": %llu,\n", (unsigned long long)sent);
+    fprintf(f, "  \"messages_acked\": %llu,\n", (unsigned long long)acked);
+    fprintf(f, "  \"errors\": %llu,\n", (unsigned long long)errors);
+    fprintf(f, "  \"bytes\": %llu,\n", (unsigned long long)bytes);
+    fprintf(f, "  \"elapsed_sec\": %.3f,\n", elapsed_sec);
+    fprintf(f, "  \"msgs_per_sec\": %.1f,\n", msgs_per_sec);
+    fprintf(f, "  \"mb_per_sec\": %.3f,\n", mb_per_sec);
+    fprintf(f, "  \"latency_us\": {\n");
+    fprintf(f, "    \"min\": %.1f,\n", (double)latency.min / 1e3);
+    fprintf(f, "    \"mean\": %.1f,\n", histogram_mean(&latency) / 1e3);
+    fprintf(f, "    \"p50\": %.1f,\n", (double)histogram_percentile(&latency, 50.0) / 1e3);
+    fprintf(f, "    \"p90\": %.1f,\n", (double)histogram_percentile(&latency, 90.0) / 1e3);
+    fprintf(f, "    \"p99\": %.1f,\n", (double)histogram_percentile(&latency, 99.0) / 1e3);
+    fprintf(f, "    \"p99_9\": %.1f,\n", (double)histogram_percentile(&latency, 99.9) / 1e3);
+    fprintf(f, "    \"max\": %.1f\n", (double)latency.max / 1e3);
+    fprintf(f, "  }\n");
+    fprintf(f, "}\n");
+}
+
+int main(int argc, char* argv[]) {
+    // TLS writes to a connection the server dropped must fail, not kill the run
+    signal(SIGPIPE, SIG_IGN);
+    
+    BenchConfig config;
+    if (parse_config(argc > 1 ? argv[1] : INPUT_FILE, &config) < 0) {
+        return 1;
+    }
+    
+    if (logger_init(OUTPUT_FILE) < 0) {
+        fprintf(stderr, "Failed to initialize logger\n");
+        free(config.address);
+        return 1;
+    }
+    
+    // One message body for everyone; each send uses a prefix of it
+    char* payload = malloc(config.size_max);
+    BenchWorker* workers = calloc(config.connections, sizeof(BenchWorker));
+    size_t due_slots = 1;
+    while (due_slots < config.window + 1) {
+        due_slots <<= 1;
+    }
+    if (!payload || !workers) {
+        fprintf(stderr, "Failed to allocate benchmark state\n");
+        free(payload);
+        free(workers);
+        free(config.address);
+        logger_cleanup();
+        return 1;
+    }
+    for (size_t i = 0; i < config.size_max; i++) {
+        payload[i] = (char)('a' + (i * 7 + i / 26) % 26);
+    }
+    
+    logger_info("Benchmark: mode=%s, address=%s, tls=%s, connections=%zu, window=%zu, rate=%.1f",
+                socket_mode_name(config.mode), config.address, config.enable_tls ? "enabled" : "disabled",
+                config.connections, config.window, config.rate);
+    
+    uint64_t start = get_monotonic_ns();
+    size_t started = 0;
+    for (size_t i = 0; i < config.connections; i++) {
+        BenchWorker* worker = &workers[i];
+        worker->config = &config;
+        worker->payload = payload;
+        worker->id = i;
+        worker->rng = 0x9e3779b97f4a7c15ull * (i + 1);
+        histogram_init(&worker->latency);
+        worker->due_ns = calloc(due_slots, sizeof(uint64_t));
+        worker->due_mask = due_slots - 1;
+        if (!worker->due_ns || pthread_create(&worker->thread, NULL, bench_thread, worker) != 0) {
+            logger_error("Failed to start connection %zu", i);
+            worker->connect_failed = 1;
+            break;
+        }
+        started++;
+    }
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    double elapsed_sec = (double)(get_monotonic_ns() - start) / 1e9;
+    
+    print_json(stdout, &config, workers, elapsed_sec);
+    
+    for (size_t i = 0; i < config.connections; i++) {
+        free(workers[i].due_ns);
+    }
+    free(workers);
+    free(payload);
+    free(config.address);
+    buffer_pool_cleanup();
+    logger_cleanup();
+    return 0;
+}
@@ -0,0 +1,647 @@
+/**
+ * @file bench/micro.c
+ * @brief Microbenchmarks for the framing, transport and logging layers
+ *
+ * Each benchmark runs an operation in a loop and reports the median time
+ * per operation over several repetitions, together with heap allocations
+ * per operation. The process is pinned to one CPU and every benchmark is
+ * warmed up before it is measured, so runs on the same machine can be
+ * compared when judging a change to protocol.c, net_common.c or logger.c.
+ *
+ * Allocations are counted by wrapping malloc and friends at link time
+ * (see the bench-micro target in the Makefile) and by routing OpenSSL's
+ * allocator through the same counters. Allocations made inside libc
+ * itself, such as by strdup or stdio, are not seen.
+ *
+ * Usage: run_bench_micro [cpu=N] [reps=N] [time_ms=N] [filter=substring]
+ */
+
+#define _GNU_SOURCE
+#include "../common/protocol.h"
+#include "../common/net_common.h"
+#include "../common/logger.h"
+#include "../common/utils.h"
+#include "../common/buffer_pool.h"
+#include "../common/integrity.h"
+#include "../server/server_net.h"
+#include "../client/client_net.h"
+#include <openssl/ssl.h>
+#include <openssl/crypto.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#define DEFAULT_REPS 7
+#define DEFAULT_TIME_MS 200         ///< Target duration of one repetition
+#define WARMUP_MS 100
+#define MAX_REPS 64
+#define TLS_BIO_BUFFER (1024 * 1024)
+#define TLS_HANDSHAKE_ROUNDS 64
+
+// ---------------------------------------------------------------------------
+// Allocation counting
+// ---------------------------------------------------------------------------
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void* __real_aligned_alloc(size_t alignment, size_t size);
+void __real_free(void* ptr);
+
+static _Atomic uint64_t alloc_count;
+static _Atomic uint64_t alloc_bytes;
+
+static void count_alloc(size_t size) {
+    atomic_fetch_add_explicit(&alloc_count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&alloc_bytes, size, memory_order_relaxed);
+}
+
+void* __wrap_malloc(size_t size) {
+    count_alloc(size);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    count_alloc(count * size);
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    count_alloc(size);
+    return __real_realloc(ptr, size);
+}
+
+void* __wrap_aligned_alloc(size_t alignment, size_t size) {
+    count_alloc(size);
+    return __real_aligned_alloc(alignment, size);
+}
+
+void __wrap_free(void* ptr) {
+    __real_free(ptr);
+}
+
+static void* crypto_malloc(size_t size, const char* file, int line) {
+    (void)file;
+    (void)line;
+    count_alloc(size);
+    return __real_malloc(size);
+}
+
+static void* crypto_realloc(void* ptr, size_t size, const char* file, int line) {
+    (void)file;
+    (void)line;
+    count_alloc(size);
+    return __real_realloc(ptr, size);
+}
+
+static void crypto_free(void* ptr, const char* file, int line) {
+    (void)file;
+    (void)line;
+    __real_free(ptr);
+}
+
+// ---------------------------------------------------------------------------
+// Harness
+// ---------------------------------------------------------------------------
+
+/**
+ * @brief Keep the compiler from optimizing away work on *p
+ */
+static inline void clobber(void* p) {
+    __asm__ volatile("" : : "g"(p) : "memory");
+}
+
+typedef struct MicroBench MicroBench;
+
+struct MicroBench {
+    const char* name;
+    size_t size;                                    ///< Payload size, if the benchmark has one
+    int (*setup)(MicroBench* bench);                ///< Optional; -1 skips the benchmark
+    int (*run)(MicroBench* bench, uint64_t iterations);
+    void (*teardown)(MicroBench* bench);            ///< Optional
+    void* state;
+};
+
+typedef struct {
+    int cpu;
+    int reps;
+    int time_ms;
+    const char* filter;
+} MicroOptions;
+
+typedef struct {
+    uint64_t iterations;
+    double ns_per_op;       ///< Median over repetitions
+    double ns_min;
+    double ns_max;
+    double allocs_per_op;
+    double bytes_per_op;
+} MicroResult;
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Time one batch of iterations
+ * @return Elapsed nanoseconds, 0 if the benchmark failed
+ */
+static uint64_t time_batch(MicroBench* bench, uint64_t iterations) {
+    uint64_t start = get_monotonic_ns();
+    if (bench->run(bench, iterations) < 0) {
+        return 0;
+    }
+    uint64_t elapsed = get_monotonic_ns() - start;
+    return elapsed > 0 ? elapsed : 1;
+}
+
+static int measure(MicroBench* bench, const MicroOptions* options, MicroResult* result) {
+    // Warm up caches, branch predictors, the buffer pool and CPU frequency,
+    // growing the batch until it runs long enough to time reliably
+    uint64_t iterations = 1;
+    uint64_t elapsed = 0;
+    uint64_t warm_until = get_monotonic_ns() + (uint64_t)WARMUP_MS * 1000000u;
+    for (;;) {
+        elapsed = time_batch(bench, iterations);
+        if (elapsed == 0) {
+            return -1;
+        }
+        if (elapsed >= 10000000u && get_monotonic_ns() >= warm_until) {
+            break;
+        }
+        if (elapsed < 10000000u) {
+            iterations *= 2;
+        }
+    }
+    double target_ns = (double)options->time_ms * 1e6;
+    iterations = (uint64_t)((double)iterations * target_ns / (double)elapsed);
+    if (iterations == 0) {
+        iterations = 1;
+    }
+    
+    double samples[MAX_REPS];
+    uint64_t count_before = atomic_load(&alloc_count);
+    uint64_t bytes_before = atomic_load(&alloc_bytes);
+    for (int i = 0; i < options->reps; i++) {
+        elapsed = time_batch(bench, iterations);
+        if (elapsed == 0) {
+            return -1;
+        }
+        samples[i] = (double)elapsed / (double)iterations;
+    }
+    uint64_t total = iterations * (uint64_t)options->reps;
+    result->allocs_per_op = (double)(atomic_load(&alloc_count) - count_before) / (double)total;
+    result->bytes_per_op = (double)(atomic_load(&alloc_bytes) - bytes_before) / (double)total;
+    
+    qsort(samples, (size_t)options->reps, sizeof(double), compare_double);
+    result->iterations = iterations;
+    result->ns_per_op = samples[options->reps / 2];
+    result->ns_min = samples[0];
+    result->ns_max = samples[options->reps - 1];
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Framing
+// ---------------------------------------------------------------------------
+
+static int run_header_serialize(MicroBench* bench, uint64_t iterations) {
+    (void)bench;
+    MessageHeader header = { MSG_TYPE_TEXT, 4096, MSG_FLAGS_NONE };
+    for (uint64_t i = 0; i < iterations; i++) {
+        message_header_serialize(&header);
+        clobber(&header);
+    }
+    return 0;
+}
+
+static int run_header_deserialize(MicroBench* bench, uint64_t iterations) {
+    (void)bench;
+    MessageHeader header = { MSG_TYPE_TEXT, 4096, MSG_FLAGS_NONE };
+    message_header_serialize(&header);
+    for (uint64_t i = 0; i < iterations; i++) {
+        message_header_deserialize(&header);
+        clobber(&header);
+    }
+    return 0;
+}
+
+static int run_encode_head(MicroBench* bench, uint64_t iterations) {
+    (void)bench;
+    uint8_t head[MESSAGE_HEAD_MAX_SIZE];
+    Message msg = message_create_text_borrowed("x", 1);
+    message_set_sequence(&msg, 42);
+    message_set_timestamp(&msg, 1234567890);
+    for (uint64_t i = 0; i < iterations; i++) {
+        size_t size = message_encode_head(&msg, head);
+        clobber(head);
+        clobber(&size);
+    }
+    return 0;
+}
+
+static int setup_payload(MicroBench* bench) {
+    bench->state = malloc(bench->size);
+    if (!bench->state) {
+        return -1;
+    }
+    memset(bench->state, 'a', bench->size);
+    return 0;
+}
+
+static void teardown_payload(MicroBench* bench) {
+    free(bench->state);
+    bench->state = NULL;
+}
+
+static int run_create_text(MicroBench* bench, uint64_t iterations) {
+    const char* text = (const char*)bench->state;
+    for (uint64_t i = 0; i < iterations; i++) {
+        Message msg = message_create_text(text, bench->size);
+        if (!msg.payload) {
+            return -1;
+        }
+        clobber(msg.payload);
+        message_free(&msg);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Payload checks: checksum and UTF-8 validation, alone and fused with the copy
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    uint8_t* src;
+    uint8_t* dst;
+} ScanState;
+
+static void teardown_scan(MicroBench* bench) {
+    ScanState* state = (ScanState*)bench->state;
+    if (state) {
+        free(state->src);
+        free(state->dst);
+        free(state);
+    }
+    bench->state = NULL;
+}
+
+/**
+ * @param mixed Mostly ASCII with a two- or three-byte sequence every 16 bytes, as in accented prose
+ */
+static int setup_scan(MicroBench* bench, int mixed) {
+    ScanState* state = (ScanState*)calloc(1, sizeof(ScanState));
+    if (!state) {
+        return -1;
+    }
+    bench->state = state;
+    state->src = (uint8_t*)malloc(bench->size);
+    state->dst = (uint8_t*)malloc(bench->size);
+    if (!state->src || !state->dst) {
+        teardown_scan(bench);
+        return -1;
+    }
+    static const char ascii[] = "The quick brown ";
+    static const char accented[] = "caf\xc3\xa9 na\xc3\xafve \xe2\x82\xac";  // 16 bytes
+    const char* pattern = mixed ? accented : ascii;
+    for (size_t i = 0; i < bench->size; i += 16) {
+        size_t n = bench->size - i < 16 ? bench->size - i : 16;
+        memcpy(state->src + i, pattern, n);
+    }
+    return utf8_validate(state->src, bench->size) ? 0 : -1;
+}
+
+static int setup_scan_ascii(MicroBench* bench) {
+    return setup_scan(bench, 0);
+}
+
+static int setup_scan_mixed(MicroBench* bench) {
+    return setup_scan(bench, 1);
+}
+
+static int run_memcpy(MicroBench* bench, uint64_t iterations) {
+    ScanState* state = (ScanState*)bench->state;
+    for (uint64_t i = 0; i < iterations; i++) {
+        memcpy(state->dst, state->src, bench->size);
+        clobber(state->dst);
+    }
+    return 0;
+}
+
+static int run_crc32c(MicroBench* bench, uint64_t iterations) {
+    ScanState* state = (ScanState*)bench->state;
+    for (uint64_t i = 0; i < iterations; i++) {
+        uint32_t crc = crc32c(0, state->src, bench->size);
+        clobber(&crc);
+    }
+    return 0;
+}
+
+static int run_utf8_validate(MicroBench* bench, uint64_t iterations) {
+    ScanState* state = (ScanState*)bench->state;
+    for (uint64_t i = 0; i < iterations; i++) {
+        if (!utf8_validate(state->src, bench->size)) {
+            return -1;
+        }
+        clobber(state->src);
+    }
+    return 0;
+}
+
+static int run_copy_crc_utf8(MicroBench* bench, uint64_t iterations) {
+    ScanState* state = (ScanState*)bench->state;
+    for (uint64_t i = 0; i < iterations; i++) {
+        uint32_t crc = 0;
+        if (integrity_scan(state->dst, state->src, bench->size, INTEGRITY_CRC32C | INTEGRITY_UTF8, &crc) < 0) {
+            return -1;
+        }
+        clobber(state->dst);
+        clobber(&crc);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Transport: socketpair and in-memory TLS
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    char* payload;
+    int fds[2];
+    void* server_ctx;
+    void* client_ctx;
+    SSL* server;
+    SSL* client;
+} TransportState;
+
+static void teardown_transport(MicroBench* bench) {
+    TransportState* state = (TransportState*)bench->state;
+    if (!state) {
+        return;
+    }
+    if (state->client) {
+        SSL_free(state->client);
+    }
+    if (state->server) {
+        SSL_free(state->server);
+    }
+    if (state->client_ctx) {
+        cleanup_tls(state->client_ctx);
+    }
+    if (state->server_ctx) {
+        cleanup_tls(state->server_ctx);
+    }
+    if (state->fds[0] >= 0) {
+        close(state->fds[0]);
+        close(state->fds[1]);
+    }
+    free(state->payload);
+    free(state);
+    bench->state = NULL;
+}
+
+static int setup_transport(MicroBench* bench, int tls) {
+    TransportState* state = calloc(1, sizeof(TransportState));
+    if (!state) {
+        return -1;
+    }
+    bench->state = state;
+    state->fds[0] = -1;
+    state->fds[1] = -1;
+    state->payload = malloc(bench->size);
+    if (!state->payload) {
+        return -1;
+    }
+    memset(state->payload, 'a', bench->size);
+    
+    if (!tls) {
+        // Both directions must hold a whole message: send and receive run on one thread
+        int buffer = (int)(bench->size * 4 + 65536);
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, state->fds) < 0) {
+            return -1;
+        }
+        setsockopt(state->fds[0], SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+        setsockopt(state->fds[1], SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+        return 0;
+    }
+    
+    // Records travel through a BIO pair: TLS cost without any socket I/O
+    state->server_ctx = init_tls_server(NULL, NULL, NULL, NULL, 0);
+    state->client_ctx = init_tls_client();
+    if (!state->server_ctx || !state->client_ctx) {
+        return -1;
+    }
+    state->server = SSL_new((SSL_CTX*)state->server_ctx);
+    state->client = SSL_new((SSL_CTX*)state->client_ctx);
+    BIO* server_bio = NULL;
+    BIO* client_bio = NULL;
+    if (!state->server || !state->client ||
+        !BIO_new_bio_pair(&server_bio, TLS_BIO_BUFFER, &client_bio, TLS_BIO_BUFFER)) {
+        return -1;
+    }
+    SSL_set_bio(state->server, server_bio, server_bio);
+    SSL_set_bio(state->client, client_bio, client_bio);
+    SSL_set_accept_state(state->server);
+    SSL_set_connect_state(state->client);
+    
+    int server_done = 0;
+    int client_done = 0;
+    for (int round = 0; round < TLS_HANDSHAKE_ROUNDS && !(server_done && client_done); round++) {
+        if (!client_done) {
+            client_done = SSL_do_handshake(state->client) == 1;
+        }
+        if (!server_done) {
+            server_done = SSL_do_handshake(state->server) == 1;
+        }
+    }
+    if (!server_done || !client_done) {
+        fprintf(stderr, "In-memory TLS handshake failed\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int setup_socketpair(MicroBench* bench) {
+    return setup_transport(bench, 0);
+}
+
+static int setup_tls(MicroBench* bench) {
+    return setup_transport(bench, 1);
+}
+
+/**
+ * @brief One message from the sending to the receiving end and back into the pool
+ */
+static int run_round_trip(MicroBench* bench, uint64_t iterations) {
+    TransportState* state = (TransportState*)bench->state;
+    int tls = state->client != NULL;
+    int tx_fd = tls ? -1 : state->fds[0];
+    int rx_fd = tls ? -1 : state->fds[1];
+    Message msg = message_create_text_borrowed(state->payload, bench->size);
+    for (uint64_t i = 0; i < iterations; i++) {
+        if (send_message(tx_fd, state->client, tls, &msg) < 0) {
+            return -1;
+        }
+        Message received;
+        if (receive_message(rx_fd, state->server, tls, &received) < 0) {
+            return -1;
+        }
+        clobber(received.payload);
+        message_free(&received);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Logging
+// ---------------------------------------------------------------------------
+
+static int run_logger(MicroBench* bench, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        logger_log(LOG_LEVEL_INFO, "Received message from client (fd=%d): %zu bytes", 7, bench->size);
+    }
+    return 0;
+}
+
+static int setup_logger_async(MicroBench* bench) {
+    (void)bench;
+    LoggerAsyncOptions options;
+    logger_async_options_init(&options);
+    return logger_start_async(&options);
+}
+
+static void teardown_logger_async(MicroBench* bench) {
+    (void)bench;
+    size_t dropped = logger_dropped_lines();
+    // Back to synchronous logging for whatever runs next
+    logger_cleanup();
+    logger_init("/dev/null");
+    if (dropped > 0) {
+        printf("  (logger_async dropped %zu lines: the writer could not keep up)\n", dropped);
+    }
+}
+
+static MicroBench benches[] = {
+    { "header_serialize", 0, NULL, run_header_serialize, NULL, NULL },
+    { "header_deserialize", 0, NULL, run_header_deserialize, NULL, NULL },
+    { "encode_head/seq+ts", 0, NULL, run_encode_head, NULL, NULL },
+    { "create_text/64", 64, setup_payload, run_create_text, teardown_payload, NULL },
+    { "create_text/4096", 4096, setup_payload, run_create_text, teardown_payload, NULL },
+    { "create_text/65536", 65536, setup_payload, run_create_text, teardown_payload, NULL },
+    { "memcpy/65536", 65536, setup_scan_ascii, run_memcpy, teardown_scan, NULL },
+    { "crc32c/65536", 65536, setup_scan_ascii, run_crc32c, teardown_scan, NULL },
+    { "utf8_validate/ascii/65536", 65536, setup_scan_ascii, run_utf8_validate, teardown_scan, NULL },
+    { "utf8_validate/mixed/65536", 65536, setup_scan_mixed, run_utf8_validate, teardown_scan, NULL },
+    { "copy+crc32c+utf8/mixed/65536", 65536, setup_scan_mixed, run_copy_crc_utf8, teardown_scan, NULL },
+    { "socketpair_send_recv/64", 64, setup_socketpair, run_round_trip, teardown_transport, NULL },
+    { "socketpair_send_recv/4096", 4096, setup_socketpair, run_round_trip, teardown_transport, NULL },
+    { "socketpair_send_recv/65536", 65536, setup_socketpair, run_round_trip, teardown_transport, NULL },
+    { "tls_send_recv/64", 64, setup_tls, run_round_trip, teardown_transport, NULL },
+    { "tls_send_recv/4096", 4096, setup_tls, run_round_trip, teardown_transport, NULL },
+    { "tls_send_recv/65536", 65536, setup_tls, run_round_trip, teardown_transport, NULL },
+    { "logger_sync", 64, NULL, run_logger, NULL, NULL },
+    { "logger_async", 64, setup_logger_async, run_logger, teardown_logger_async, NULL },
+};
+
+static void parse_options(int argc, char* argv[], MicroOptions* options) {
+    options->cpu = -1;
+    options->reps = DEFAULT_REPS;
+    options->time_ms = DEFAULT_TIME_MS;
+    options->filter = NULL;
+    
+    for (int i = 1; i < argc; i++) {
+        char* eq = strchr(argv[i], '=');
+        if (!eq) {
+            options->filter = argv[i];
+            continue;
+        }
+        const char* value = eq + 1;
+        if (strncmp(argv[i], "cpu=", 4) == 0) {
+            options->cpu = atoi(value);
+        } else if (strncmp(argv[i], "reps=", 5) == 0) {
+            int reps = atoi(value);
+            options->reps = reps < 1 ? 1 : (reps > MAX_REPS ? MAX_REPS : reps);
+        } else if (strncmp(argv[i], "time_ms=", 8) == 0) {
+            int time_ms = atoi(value);
+            options->time_ms = time_ms < 1 ? 1 : time_ms;
+        } else if (strncmp(argv[i], "filter=", 7) == 0) {
+            options->filter = value;
+        }
+    }
+}
+
+/**
+ * @brief Pin the process to one CPU (by default the one it is running on)
+ */
+static int pin_cpu(int cpu) {
+    if (cpu < 0) {
+        cpu = sched_getcpu();
+        if (cpu < 0) {
+            return -1;
+        }
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+        return -1;
+    }
+    return cpu;
+}
+
+int main(int argc, char* argv[]) {
+    MicroOptions options;
+    parse_options(argc, argv, &options);
+    
+    // Must precede the first OpenSSL allocation
+    CRYPTO_set_mem_functions(crypto_malloc, crypto_realloc, crypto_free);
+    
+    // Log lines go nowhere: the benchmark measures formatting and locking, not the disk
+    if (logger_init("/dev/null") < 0) {
+        fprintf(stderr, "Failed to initialize logger\n");
+        return 1;
+    }
+    
+    int cpu = pin_cpu(options.cpu);
+    if (cpu < 0) {
+        fprintf(stderr, "Warning: could not pin to a CPU, results will be noisier\n");
+    }
+    printf("cpu=%d reps=%d time_ms=%d\n", cpu, options.reps, options.time_ms);
+    printf("%-28s %12s %12s %12s %10s %10s\n", "benchmark", "ns/op", "min", "max", "allocs/op", "bytes/op");
+    
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        MicroBench* bench = &benches[i];
+        if (options.filter && !strstr(bench->name, options.filter)) {
+            continue;
+        }
+        
+        MicroResult result;
+        memset(&result, 0, sizeof(result));
+        int status = bench->setup ? bench->setup(bench) : 0;
+        if (status == 0) {
+            status = measure(bench, &options, &result);
+        }
+        if (bench->teardown) {
+            bench->teardown(bench);
+        }
+        if (status < 0) {
+            printf("%-28s %12s\n", bench->name, "failed");
+            failed = 1;
+            continue;
+        }
+        printf("%-28s %12.1f %12.1f %12.1f %10.2f %10.1f\n", bench->name, result.ns_per_op,
+               result.ns_min, result.ns_max, result.allocs_per_op, result.bytes_per_op);
+        fflush(stdout);
+    }
+    
+    buffer_pool_cleanup();
+    logger_cleanup();
+    return failed ? 1 : 0;
+}
@@ -9,11 +9,197 @@
 #include "../common/logger.h"
 #include "../common/utils.h"
 #include "../common/net_common.h"
+#include "../common/buffer_pool.h"
 #include <unistd.h>
 #include <string.h>
 #include <stdlib.h>
-#include <math.h>
 #include <errno.h>
+#include <poll.h>
+
+#define DEFAULT_WINDOW 32
+
+/**
+ * @brief Wait for the next complete frame of any type
+ * @return 1 if a frame was read, 0 on timeout, -1 on error
+ */
+static int read_any_frame(Client* client, Message* msg, int timeout_ms) {
+    if (client->shm) {
+        for (;;) {
+            int result = shm_channel_next(client->shm, msg);
+            if (result != 0) {
+                return result;
+            }
+            result = shm_channel_wait(client->shm, timeout_ms);
+            if (result <= 0) {
+                return result;
+            }
+        }
+    }
+    
+    for (;;) {
+        int result = frame_reader_next(&client->reader, msg);
+        if (result != 0) {
+            return result;
+        }
+        
+        struct pollfd pfd;
+        pfd.fd = client->fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        int ready = poll(&pfd, 1, timeout_ms);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (ready == 0) {
+            return 0;
+        }
+        
+        if (frame_reader_read(&client->reader, client->fd, client->ssl, client->enable_tls) < 0) {
+            return -1;
+        }
+    }
+}
+
+/**
+ * @brief Hand a publication to the application
+ */
+static void deliver_publication(Client* client, const Message* msg) {
+    const char* topic;
+    size_t topic_len;
+    const uint8_t* data;
+    size_t len;
+    if (message_parse_publish(msg, &topic, &topic_len, &data, &len) < 0) {
+        logger_warn("Ignoring malformed publication");
+        return;
+    }
+    client->publications++;
+    if (client->publication_callback) {
+        client->publication_callback(topic, topic_len, data, len, client->publication_user_data);
+    }
+}
+
+/**
+ * @brief Wait for the next frame that is not a publication
+ *
+ * Publications read on the way are delivered; the timeout covers the
+ * whole wait.
+ * @return 1 if a frame was read, 0 on timeout, -1 on error
+ */
+static int read_frame(Client* client, Message* msg, int timeout_ms) {
+    uint64_t deadline_ns = get_monotonic_ns() + (uint64_t)(timeout_ms > 0 ? timeout_ms : 0) * 1000000ull;
+    int wait_ms = timeout_ms;
+    for (;;) {
+        int result = read_any_frame(client, msg, wait_ms);
+        if (result <= 0 || msg->header.type != MSG_TYPE_PUBLISH) {
+            return result;
+        }
+        deliver_publication(client, msg);
+        message_free(msg);
+        
+        if (timeout_ms >= 0) {
+            uint64_t now_ns = get_monotonic_ns();
+            wait_ms = now_ns < deadline_ns ? (int)((deadline_ns - now_ns + 999999) / 1000000) : 0;
+        }
+    }
+}
+
+/**
+ * @brief Record the round trip of the message whose send time an ACK echoes
+ *
+ * A cumulative ACK echoes the newest message it covers, so one sample is
+ * taken per ACK frame.
+ */
+static void record_rtt(Client* client, const Message* msg) {
+    if ((msg->header.type == MSG_TYPE_ACK || msg->header.type == MSG_TYPE_ACK_BATCH) &&
+        (msg->header.flags & MSG_FLAGS_TIMESTAMPED)) {
+        uint64_t now_ns = get_monotonic_ns();
+        histogram_record(&client->rtt, now_ns > msg->timestamp_ns ? now_ns - msg->timestamp_ns : 0);
+    }
+}
+
+/**
+ * @brief Apply an incoming frame to the in-flight window
+ * @return Number of messages acknowledged, -1 on error message
+ */
+static int process_ack(Client* client, const Message* msg) {
+    if (msg->header.type == MSG_TYPE_ERROR) {
+        logger_error("Server reported error: %.*s", (int)msg->payload_size,
+                     msg->payload ? (const char*)msg->payload : "");
+        return -1;
+    }
+    record_rtt(client, msg);
+    if (msg->header.type != MSG_TYPE_ACK && msg->header.type != MSG_TYPE_ACK_BATCH) {
+        return 0;
+    }
+    
+    uint64_t sequence;
+    if (msg->header.flags & MSG_FLAGS_SEQUENCED) {
+        sequence = msg->sequence;
+    } else if (!(client->features & MSG_FEATURE_SEQUENCE) && client_in_flight(client) > 0) {
+        // Without negotiated sequencing the server ACKs in order: this one is for the oldest
+        sequence = client->last_acked_sequence + 1;
+    } else {
+        return 0;
+    }
+    if (sequence <= client->last_acked_sequence || sequence > client->last_sent_sequence) {
+        logger_warn("Ignoring ACK for unexpected sequence %llu", (unsigned long long)sequence);
+        return 0;
+    }
+    
+    // ACKs are cumulative: everything up to `sequence` is complete
+    int acked = 0;
+    while (client->last_acked_sequence < sequence) {
+        client->last_acked_sequence++;
+        client->acked_messages++;
+        acked++;
+        if (client->ack_callback) {
+            client->ack_callback(client->last_acked_sequence, client->ack_user_data);
+        }
+    }
+    return acked;
+}
+
+/**
+ * @brief Write a frame on the connection's transport
+ */
+static int transmit(Client* client, const Message* msg) {
+    if (client->shm) {
+        return shm_channel_send(client->shm, msg, client->timeout_sec * 1000);
+    }
+    return send_message(client->fd, client->ssl, client->enable_tls, msg);
+}
+
+/**
+ * @brief Ask the server for optional features right after connecting
+ */
+static void negotiate_features(Client* client) {
+    client->features = MSG_FEATURE_NONE;
+    
+    // Sequencing is always requested; a server that refuses it gets unsequenced frames
+    uint32_t requested = client->requested_features | MSG_FEATURE_SEQUENCE;
+    Message hello = message_create_hello(requested);
+    int sent = transmit(client, &hello);
+    message_free(&hello);
+    if (sent < 0) {
+        logger_warn("Failed to send feature negotiation");
+        return;
+    }
+    
+    Message reply;
+    if (read_frame(client, &reply, client->timeout_sec * 1000) <= 0) {
+        logger_warn("No reply to feature negotiation");
+        return;
+    }
+    
+    // Servers without negotiation answer with a plain ACK
+    uint32_t features = 0;
+    if (message_parse_hello(&reply, &features) == 0) {
+        client->features = features & requested;
+    }
+    message_free(&reply);
+    logger_info("Negotiated features=0x%x (requested 0x%x)", client->features, requested);
+}
 
 int client_init(Client* client, SocketMode mode, const char* address, int enable_tls) {
     memset(client, 0, sizeof(Client));
@@ -28,6 +214,15 @@ int client_init(Client* client, SocketMode mode, const char* address, int enable
     client->connected = 0;
     client->timeout_sec = 5;
     client->ssl_ctx = NULL;
+    client->window = DEFAULT_WINDOW;
+    client_connect_policy_init(&client->connect_policy);
+    // Distinct per process and per client, so reconnects spread out
+    client->jitter_state = get_monotonic_ns() ^ ((uint64_t)getpid() << 32) ^ (uint64_t)(uintptr_t)client;
+    if (client->jitter_state == 0) {
+        client->jitter_state = 1;
+    }
+    frame_reader_init(&client->reader);
+    client->reader.max_payload = MSG_DEFAULT_MAX_FRAME_SIZE;
     
     // Initialize TLS if enabled
     if (enable_tls) {
@@ -45,6 +240,7 @@ void client_cleanup(Client* client) {
     if (!client) return;
     
     client_disconnect(client);
+    free_tls_session(client->tls_session);
     
     if (client->ssl_ctx) {
         cleanup_tls(client->ssl_ctx);
@@ -54,78 +250,132 @@ void client_cleanup(Client* client) {
     memset(client, 0, sizeof(Client));
 }
 
-int client_connect(Client* client, int timeout_sec) {
-    if (!client) return -1;
-    
-    client->timeout_sec = timeout_sec;
-    int retry_count = 0;
-    const int max_retries = 5;
+void client_connect_policy_init(ConnectPolicy* policy) {
+    policy->connect_timeout_ms = 3000;
+    policy->attempts = 5;
+    policy->backoff_base_ms = 100;
+    policy->backoff_max_ms = 5000;
+    tuning_init(&policy->tuning);
+}
+
+void client_set_connect_policy(Client* client, const ConnectPolicy* policy) {
+    if (client && policy) {
+        client->connect_policy = *policy;
+    }
+}
+
+/**
+ * @brief Delay before retry number retry: uniform in [0, min(max, base * 2^retry)]
+ */
+static unsigned backoff_delay_ms(Client* client, int retry) {
+    const ConnectPolicy* policy = &client->connect_policy;
+    uint64_t base = policy->backoff_base_ms > 0 ? (uint64_t)policy->backoff_base_ms : 0;
+    uint64_t cap = policy->backoff_max_ms > 0 ? (uint64_t)policy->backoff_max_ms : 0;
+    uint64_t ceiling = base << (retry < 20 ? retry : 20);
+    if (ceiling > cap) {
+        ceiling = cap;
+    }
     
-    while (retry_count < max_retries) {
-        if (client->mode == SOCKET_MODE_UNIX) {
-            client->fd = connect_unix_socket(client->address);
-        } else {
-            uint16_t port = 8080;
-            char* host = parse_address(client->address, &port);
-            if (!host) {
-                if (retry_count < max_retries - 1) {
-                    int backoff = (int)pow(2, retry_count);
-                    logger_warn("Connection failed, retrying in %d seconds...", backoff);
-                    sleep(backoff);
-                    retry_count++;
-                    continue;
-                }
-                return -1;
-            }
-            client->fd = connect_inet_socket(host, port);
-            free(host);
+    // xorshift64*: enough to decorrelate clients, not for cryptography
+    uint64_t x = client->jitter_state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    client->jitter_state = x;
+    return (unsigned)(((x * 2685821657736338717ull) >> 32) % (ceiling + 1));
+}
+
+/**
+ * @brief One connection attempt: socket, timeouts, TLS handshake, shared-memory rings
+ * @return 0 on success, -1 on error (nothing is left open)
+ */
+static int open_transport(Client* client) {
+    if (client->mode != SOCKET_MODE_INET) {
+        client->fd = connect_unix_socket(client->address);
+    } else {
+        uint16_t port = 8080;
+        char* host = parse_address(client->address, &port);
+        if (!host) {
+            return -1;
         }
-        
-        if (client->fd < 0) {
-            if (retry_count < max_retries - 1) {
-                int backoff = (int)pow(2, retry_count);
-                logger_warn("Connection failed, retrying in %d seconds...", backoff);
-                sleep(backoff);
-                retry_count++;
-                continue;
-            }
+        client->fd = connect_inet_socket(host, port, client->connect_policy.connect_timeout_ms,
+                                         &client->connect_policy.tuning);
+        free(host);
+        if (client->fd >= 0) {
+            char tuning[256];
+            tuning_describe(client->fd, &client->connect_policy.tuning, tuning, sizeof(tuning));
+            logger_info("Socket tuning: %s", tuning);
+        }
+    }
+    if (client->fd < 0) {
+        return -1;
+    }
+    
+    if (set_socket_timeout(client->fd, client->timeout_sec) < 0) {
+        logger_error("Failed to set socket timeouts: %s", get_error_string(errno));
+        close(client->fd);
+        client->fd = -1;
+        return -1;
+    }
+    
+    if (client->enable_tls) {
+        client->ssl = connect_tls(client->fd, client->ssl_ctx, &client->tls_session);
+        if (!client->ssl) {
+            close(client->fd);
+            client->fd = -1;
             return -1;
         }
-        
-        if (set_socket_timeout(client->fd, client->timeout_sec) < 0) {
+    }
+    
+    if (client->mode == SOCKET_MODE_SHM) {
+        // The server hands over the rings right after accepting
+        client->shm = shm_channel_attach(client->fd);
+        if (!client->shm) {
             close(client->fd);
             client->fd = -1;
-            if (retry_count < max_retries - 1) {
-                int backoff = (int)pow(2, retry_count);
-                logger_warn("Connection failed, retrying in %d seconds...", backoff);
-                sleep(backoff);
-                retry_count++;
-                continue;
-            }
             return -1;
         }
-        
-        if (client->enable_tls) {
-            client->ssl = connect_tls(client->fd, client->ssl_ctx);
-            if (!client->ssl) {
-                close(client->fd);
-                client->fd = -1;
-                if (retry_count < max_retries - 1) {
-                    int backoff = (int)pow(2, retry_count);
-                    logger_warn("TLS connection failed, retrying in %d seconds...", backoff);
-                    sleep(backoff);
-                    retry_count++;
-                    continue;
-                }
-                return -1;
-            }
+        shm_channel_set_max_payload(client->shm, client->reader.max_payload);
+    }
+    return 0;
+}
+
+int client_connect(Client* client, int timeout_sec) {
+    if (!client) return -1;
+    
+    client->timeout_sec = timeout_sec;
+    int attempts = client->connect_policy.attempts > 0 ? client->connect_policy.attempts : 1;
+    
+    for (int attempt = 0; attempt < attempts; attempt++) {
+        if (attempt > 0) {
+            unsigned delay = backoff_delay_ms(client, attempt - 1);
+            logger_warn("Connection failed, retrying in %u ms...", delay);
+            sleep_ms(delay);
+        }
+        if (open_transport(client) < 0) {
+            continue;
         }
         
+        frame_reader_free(&client->reader);
+        client->last_sent_sequence = 0;
+        client->last_acked_sequence = 0;
         client->connected = 1;
-        logger_info("Connected to server at %s", client->address);
+        if (client->shm) {
+            logger_info("Connected to server at %s (shared memory, %zu KiB per direction)", client->address,
+                        shm_channel_ring_size(client->shm) / 1024);
+        } else if (client->ssl) {
+            logger_info("Connected to server at %s (TLS %s, ktls tx=%s rx=%s)", client->address,
+                        tls_session_reused(client->ssl) ? "resumed" : "full",
+                        tls_ktls_send(client->ssl) ? "on" : "off",
+                        tls_ktls_recv(client->ssl) ? "on" : "off");
+        } else {
+            logger_info("Connected to server at %s", client->address);
+        }
+        negotiate_features(client);
         return 0;
     }
     
+    logger_error("Could not connect to %s after %d attempts", client->address, attempts);
     return -1;
 }
 
@@ -134,16 +384,26 @@ void client_disconnect(Client* client) {
         return;
     }
     
+    if (client_in_flight(client) > 0) {
+        logger_warn("Disconnecting with %zu unacknowledged messages", client_in_flight(client));
+    }
+    
     if (client->enable_tls && client->ssl) {
         close_tls_connection(client->ssl);
         client->ssl = NULL;
     }
     
+    if (client->shm) {
+        shm_channel_destroy(client->shm);
+        client->shm = NULL;
+    }
+    
     if (client->fd >= 0) {
         close(client->fd);
         client->fd = -1;
     }
     
+    frame_reader_free(&client->reader);
     client->connected = 0;
     logger_info("Disconnected from server");
 }
@@ -152,44 +412,417 @@ int client_is_connected(const Client* client) {
     return client && client->connected && client->fd >= 0;
 }
 
+/**
+ * @brief Write one frame, compressing and checksumming the payload if the server accepts it
+ * @note A compressed payload is owned by msg and released here
+ */
+static int send_frame(Client* client, Message* msg) {
+    if ((client->features & MSG_FEATURE_COMPRESSION) &&
+        message_compress(msg, client->compression_threshold, &client->compression) < 0) {
+        return -1;
+    }
+    if (client->features & MSG_FEATURE_TIMESTAMPS) {
+        message_set_timestamp(msg, get_monotonic_ns());
+    }
+    if (client->features & MSG_FEATURE_CHECKSUM) {
+        message_set_checksum(msg);
+    }
+    int result = transmit(client, msg);
+    message_free(msg);
+    return result;
+}
+
+/**
+ * @brief Wait for the ACK of the only unsequenced message in flight
+ */
+static int wait_ack(Client* client) {
+    Message ack;
+    if (read_frame(client, &ack, client->timeout_sec * 1000) <= 0) {
+        return -1;
+    }
+    
+    if (ack.header.type != MSG_TYPE_ACK) {
+        if (ack.header.type == MSG_TYPE_ERROR) {
+            process_ack(client, &ack);
+        } else {
+            logger_error("Expected ACK, got different message type");
+        }
+        message_free(&ack);
+        return -1;
+    }
+    record_rtt(client, &ack);
+    
+    message_free(&ack);
+    return 0;
+}
+
+/**
+ * @brief Send a message and wait for its ACK
+ */
+static int send_and_wait_ack(Client* client, Message* msg) {
+    if (!client_is_connected(client)) {
+        logger_error("Not connected to server");
+        return -1;
+    }
+    
+    // Keep ordering with pipelined messages sent earlier
+    if (client_flush(client, client->timeout_sec * 1000) < 0) {
+        return -1;
+    }
+    
+    if (send_frame(client, msg) < 0) {
+        return -1;
+    }
+    return wait_ack(client);
+}
+
+/**
+ * @brief Send a message with the next sequence number, waiting only while the window is full
+ */
+static int send_sequenced(Client* client, Message* msg, uint64_t* sequence) {
+    if (!client_is_connected(client)) {
+        logger_error("Not connected to server");
+        return -1;
+    }
+    
+    // Window full: wait for the oldest message to be acknowledged
+    while (client_in_flight(client) >= client->window) {
+        int acked = client_poll_acks(client, client->timeout_sec * 1000);
+        if (acked < 0) {
+            return -1;
+        }
+        if (acked == 0) {
+            logger_error("Timed out waiting for ACK (%zu in flight)", client_in_flight(client));
+            return -1;
+        }
+    }
+    
+    // The number is tracked locally either way; it only goes on the wire once negotiated
+    if (client->features & MSG_FEATURE_SEQUENCE) {
+        message_set_sequence(msg, client->last_sent_sequence + 1);
+    }
+    if (send_frame(client, msg) < 0) {
+        return -1;
+    }
+    client->last_sent_sequence++;
+    
+    if (sequence) {
+        *sequence = client->last_sent_sequence;
+    }
+    return 0;
+}
+
 int client_send_text(Client* client, const char* text, size_t text_len) {
+    // send_message writes the caller's buffer directly, no copy needed
+    Message msg = message_create_text_borrowed(text, text_len);
+    return send_and_wait_ack(client, &msg);
+}
+
+int client_send_textv(Client* client, const struct iovec* iov, size_t iovcnt) {
+    Message msg = message_create_text_iov(iov, iovcnt);
+    return send_and_wait_ack(client, &msg);
+}
+
+int client_send_text_async(Client* client, const char* text, size_t text_len, uint64_t* sequence) {
+    Message msg = message_create_text_borrowed(text, text_len);
+    return send_sequenced(client, &msg, sequence);
+}
+
+int client_send_textv_async(Client* client, const struct iovec* iov, size_t iovcnt, uint64_t* sequence) {
+    Message msg = message_create_text_iov(iov, iovcnt);
+    return send_sequenced(client, &msg, sequence);
+}
+
+/**
+ * @brief Read exactly len bytes of a file at offset
+ */
+static int read_file_at(int file_fd, uint8_t* buf, size_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pread(file_fd, buf, len, (off_t)offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            logger_error("Failed to read file: %s", get_error_string(errno));
+            return -1;
+        }
+        if (n == 0) {
+            logger_error("File ended %zu bytes early", len);
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return 0;
+}
+
+int client_send_file(Client* client, int file_fd, uint64_t offset, uint64_t length) {
     if (!client_is_connected(client)) {
         logger_error("Not connected to server");
         return -1;
     }
     
-    Message msg = message_create_text(text, text_len);
-    if (send_message(client->fd, client->ssl, client->enable_tls, &msg) < 0) {
-        message_free(&msg);
+    // Chunks carry no sequence number, so nothing pipelined may still await its ACK
+    if (client_flush(client, client->timeout_sec * 1000) < 0) {
         return -1;
     }
     
-    // Wait for ACK
-    Message ack;
-    if (receive_message(client->fd, client->ssl, client->enable_tls, &ack) < 0) {
-        message_free(&msg);
+    // The page cache goes straight to the socket when the kernel writes the bytes as they are
+    int zero_copy = !client->shm && (!client->enable_tls || tls_ktls_send(client->ssl));
+    uint8_t* buffer = NULL;
+    if (!zero_copy) {
+        buffer = (uint8_t*)buffer_pool_alloc(MSG_STREAM_CHUNK_SIZE);
+        if (!buffer) {
+            logger_error("Failed to allocate stream buffer");
+            return -1;
+        }
+    }
+    
+    // An empty stream is a single empty final chunk
+    uint64_t sent = 0;
+    int result = 0;
+    do {
+        uint64_t remaining = length - sent;
+        size_t chunk_len = remaining > MSG_STREAM_CHUNK_SIZE ? MSG_STREAM_CHUNK_SIZE : (size_t)remaining;
+        int final = (sent + chunk_len == length);
+        if (zero_copy) {
+            Message head = message_create_chunk(NULL, chunk_len, final);
+            if (client->features & MSG_FEATURE_TIMESTAMPS) {
+                message_set_timestamp(&head, get_monotonic_ns());
+            }
+            result = send_message_file(client->fd, &head, file_fd, (off_t)(offset + sent));
+        } else {
+            result = read_file_at(file_fd, buffer, chunk_len, offset + sent);
+            if (result == 0) {
+                Message chunk = message_create_chunk(buffer, chunk_len, final);
+                result = send_frame(client, &chunk);
+            }
+        }
+        sent += chunk_len;
+    } while (result == 0 && sent < length);
+    buffer_pool_free(buffer);
+    
+    if (result < 0) {
+        logger_error("Stream failed after %llu of %llu bytes", (unsigned long long)sent,
+                     (unsigned long long)length);
+        return -1;
+    }
+    return wait_ack(client);
+}
+
+int client_poll_acks(Client* client, int timeout_ms) {
+    if (!client_is_connected(client)) {
         return -1;
     }
     
-    if (ack.header.type != MSG_TYPE_ACK) {
+    int acked = 0;
+    int wait_ms = timeout_ms;
+    while (client_in_flight(client) > 0) {
+        Message msg;
+        int result = read_frame(client, &msg, wait_ms);
+        if (result < 0) {
+            return -1;
+        }
+        if (result == 0) {
+            break;
+        }
+        
+        int count = process_ack(client, &msg);
         message_free(&msg);
-        message_free(&ack);
-        logger_error("Expected ACK, got different message type");
+        if (count < 0) {
+            return -1;
+        }
+        acked += count;
+        
+        // Drain what has already arrived without waiting again
+        wait_ms = 0;
+    }
+    return acked;
+}
+
+int client_flush(Client* client, int timeout_ms) {
+    while (client_in_flight(client) > 0) {
+        int acked = client_poll_acks(client, timeout_ms);
+        if (acked < 0) {
+            return -1;
+        }
+        if (acked == 0) {
+            logger_error("Timed out waiting for ACK (%zu in flight)", client_in_flight(client));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+size_t client_in_flight(const Client* client) {
+    return client ? (size_t)(client->last_sent_sequence - client->last_acked_sequence) : 0;
+}
+
+void client_set_window(Client* client, size_t window) {
+    if (client) {
+        client->window = window > 0 ? window : 1;
+    }
+}
+
+void client_set_ack_callback(Client* client, AckCallback callback, void* user_data) {
+    if (client) {
+        client->ack_callback = callback;
+        client->ack_user_data = user_data;
+    }
+}
+
+void client_set_publication_handler(Client* client, PublicationCallback callback, void* user_data) {
+    if (client) {
+        client->publication_callback = callback;
+        client->publication_user_data = user_data;
+    }
+}
+
+static int valid_topic(const char* topic, size_t topic_len) {
+    if (!topic || topic_len == 0 || topic_len > MSG_TOPIC_MAX) {
+        logger_error("Topic names are 1 to %d bytes", MSG_TOPIC_MAX);
+        return 0;
+    }
+    return 1;
+}
+
+int client_subscribe(Client* client, const char* topic, size_t topic_len) {
+    if (!valid_topic(topic, topic_len)) {
+        return -1;
+    }
+    Message msg = message_create_subscription(MSG_TYPE_SUBSCRIBE, topic, topic_len);
+    return send_and_wait_ack(client, &msg);
+}
+
+int client_unsubscribe(Client* client, const char* topic, size_t topic_len) {
+    if (!valid_topic(topic, topic_len)) {
+        return -1;
+    }
+    Message msg = message_create_subscription(MSG_TYPE_UNSUBSCRIBE, topic, topic_len);
+    return send_and_wait_ack(client, &msg);
+}
+
+int client_publish(Client* client, const char* topic, size_t topic_len, const void* data, size_t len) {
+    if (!valid_topic(topic, topic_len)) {
+        return -1;
+    }
+    Message msg = message_create_publish(topic, topic_len, data, len);
+    if (!msg.payload) {
+        logger_error("Failed to allocate publication");
+        return -1;
+    }
+    return send_and_wait_ack(client, &msg);
+}
+
+int client_poll_publications(Client* client, int timeout_ms) {
+    if (!client_is_connected(client)) {
         return -1;
     }
     
-    message_free(&msg);
-    message_free(&ack);
+    int delivered = 0;
+    int wait_ms = timeout_ms;
+    for (;;) {
+        Message msg;
+        int result = read_any_frame(client, &msg, wait_ms);
+        if (result < 0) {
+            return -1;
+        }
+        if (result == 0) {
+            break;
+        }
+        
+        if (msg.header.type == MSG_TYPE_PUBLISH) {
+            deliver_publication(client, &msg);
+            delivered++;
+        } else if (process_ack(client, &msg) < 0) {
+            message_free(&msg);
+            return -1;
+        }
+        message_free(&msg);
+        
+        // Drain what has already arrived without waiting again
+        wait_ms = 0;
+    }
+    return delivered;
+}
+
+void client_set_features(Client* client, uint32_t features) {
+    if (client) {
+        client->requested_features = features;
+    }
+}
+
+void client_set_compression(Client* client, size_t threshold) {
+    if (!client) {
+        return;
+    }
+    client->compression_threshold = threshold;
+    if (threshold > 0) {
+        client->requested_features |= MSG_FEATURE_COMPRESSION;
+    } else {
+        client->requested_features &= ~(uint32_t)MSG_FEATURE_COMPRESSION;
+    }
+}
+
+int client_set_ktls(Client* client, int enable) {
+    if (!client || !client->ssl_ctx) {
+        return -1;
+    }
+    if (enable) {
+        tls_enable_ktls(client->ssl_ctx);
+    }
     return 0;
 }
 
+char* client_request_stats(Client* client, size_t* len) {
+    if (!client_is_connected(client)) {
+        logger_error("Not connected to server");
+        return NULL;
+    }
+    if (client_flush(client, client->timeout_sec * 1000) < 0) {
+        return NULL;
+    }
+    
+    Message request = message_create_stats(NULL, 0);
+    if (send_frame(client, &request) < 0) {
+        return NULL;
+    }
+    
+    Message reply;
+    if (read_frame(client, &reply, client->timeout_sec * 1000) <= 0) {
+        return NULL;
+    }
+    if (reply.header.type != MSG_TYPE_STATS) {
+        if (reply.header.type == MSG_TYPE_ERROR) {
+            logger_error("Server refused stats: %.*s", (int)reply.payload_size,
+                         reply.payload ? (const char*)reply.payload : "");
+        } else {
+            logger_error("Expected STATS reply, got message type %u", reply.header.type);
+        }
+        message_free(&reply);
+        return NULL;
+    }
+    
+    char* text = malloc(reply.payload_size + 1);
+    if (text) {
+        if (reply.payload_size > 0) {
+            memcpy(text, reply.payload, reply.payload_size);
+        }
+        text[reply.payload_size] = '\0';
+        if (len) {
+            *len = reply.payload_size;
+        }
+    }
+    message_free(&reply);
+    return text;
+}
+
 int client_receive_message(Client* client, Message* msg) {
     if (!client_is_connected(client)) {
         logger_error("Not connected to server");
         return -1;
     }
     
-    return receive_message(client->fd, client->ssl, client->enable_tls, msg);
+    return read_frame(client, msg, client->timeout_sec * 1000) > 0 ? 0 : -1;
 }
 
 void client_set_timeout(Client* client, int timeout_sec) {
@@ -200,4 +833,3 @@ void client_set_timeout(Client* client, int timeout_sec) {
         set_socket_timeout(client->fd, client->timeout_sec);
     }
 }
-
@@ -2,7 +2,10 @@
  * @file client.h
  * @brief Client implementation
  * 
- * Client with reconnect logic and timeout handling.
+ * Client with reconnect logic and timeout handling. Besides the
+ * synchronous client_send_text, messages can be pipelined with
+ * client_send_text_async: up to `window` sequenced messages are in
+ * flight and their ACKs are collected by client_poll_acks.
  */
 
 #ifndef CLIENT_H
@@ -10,8 +13,43 @@
 
 #include "../common/protocol.h"
 #include "../common/types.h"
+#include "../common/frame_reader.h"
+#include "../common/shm_channel.h"
+#include "../common/histogram.h"
+#include "../common/tuning.h"
 #include <stdint.h>
 
+/**
+ * @brief Completion callback for pipelined sends
+ * @param sequence Sequence number that was acknowledged
+ * @param user_data Pointer given to client_set_ack_callback
+ */
+typedef void (*AckCallback)(uint64_t sequence, void* user_data);
+
+/**
+ * @brief Delivery callback for topics the client subscribed to
+ * @param topic Topic name (not NUL-terminated)
+ * @param data Published bytes, valid only during the call
+ * @param user_data Pointer given to client_set_publication_handler
+ */
+typedef void (*PublicationCallback)(const char* topic, size_t topic_len, const uint8_t* data, size_t len,
+                                    void* user_data);
+
+/**
+ * @brief How client_connect establishes a connection (see client_connect_policy_init)
+ *
+ * Retry n waits a random time between 0 and min(backoff_max_ms,
+ * backoff_base_ms * 2^n) ("full jitter"), so clients that lost the same
+ * server do not all come back at the same moment.
+ */
+typedef struct {
+    int connect_timeout_ms;     ///< Longest wait for the TCP connect of one attempt
+    int attempts;               ///< Attempts before client_connect gives up
+    int backoff_base_ms;        ///< Upper bound of the first retry delay
+    int backoff_max_ms;         ///< Cap on the upper bound
+    TuningOptions tuning;       ///< TCP socket options set on every attempt
+} ConnectPolicy;
+
 /**
  * @brief Client structure
  */
@@ -24,12 +62,36 @@ typedef struct {
     int connected;
     int timeout_sec;
     void* ssl_ctx;  // SSL_CTX* pointer
+    void* tls_session;  // SSL_SESSION* offered for resumption on reconnect
+    ConnectPolicy connect_policy;
+    uint64_t jitter_state;  // Backoff jitter generator
+    FrameReader reader;  // Buffered incoming frames
+    ShmChannel* shm;     // Shared-memory transport (SOCKET_MODE_SHM)
+    
+    // Pipelining
+    size_t window;                  ///< Maximum unacknowledged messages
+    uint64_t last_sent_sequence;    ///< Highest sequence number sent
+    uint64_t last_acked_sequence;   ///< Highest sequence number acknowledged
+    uint64_t acked_messages;        ///< Total messages acknowledged
+    AckCallback ack_callback;
+    void* ack_user_data;
+    
+    PublicationCallback publication_callback;
+    void* publication_user_data;
+    uint64_t publications;          ///< Publications received, handled or not
+    
+    uint32_t requested_features;    ///< MSG_FEATURE_* to ask for on connect
+    uint32_t features;              ///< MSG_FEATURE_* the server enabled
+    
+    size_t compression_threshold;   ///< Compress payloads of at least this size (0 = off)
+    CompressionStats compression;   ///< Payloads compressed on send
+    Histogram rtt;                  ///< Send to ACK, in ns (with MSG_FEATURE_TIMESTAMPS)
 } Client;
 
 /**
  * @brief Initialize client
  * @param client Client structure to initialize
- * @param mode Socket mode (UNIX or INET)
+ * @param mode Socket mode (UNIX, SHM or INET)
  * @param address Server address (socket path for UNIX, host:port for INET)
  * @param enable_tls Enable TLS/SSL encryption
  * @return 0 on success, -1 on error
@@ -42,9 +104,20 @@ int client_init(Client* client, SocketMode mode, const char* address, int enable
 void client_cleanup(Client* client);
 
 /**
- * @brief Connect to server
+ * @brief Fill policy with defaults (3 s connect timeout, 5 attempts, 100 ms to 5 s backoff)
+ */
+void client_connect_policy_init(ConnectPolicy* policy);
+
+/**
+ * @brief Change how later client_connect calls connect and retry
+ */
+void client_set_connect_policy(Client* client, const ConnectPolicy* policy);
+
+/**
+ * @brief Connect to server, retrying with jittered exponential backoff
  * @param client Client instance
- * @param timeout_sec Connection timeout in seconds
+ * @param timeout_sec Send, receive and TLS handshake timeout in seconds (the
+ *                    TCP connect is bounded by the ConnectPolicy instead)
  * @return 0 on success, -1 on error
  */
 int client_connect(Client* client, int timeout_sec);
@@ -68,6 +141,155 @@ int client_is_connected(const Client* client);
  */
 int client_send_text(Client* client, const char* text, size_t text_len);
 
+/**
+ * @brief Send one text message gathered from several buffers
+ *
+ * Segments are written straight from caller memory and are not copied.
+ * @param client Client instance
+ * @param iov Payload segments
+ * @param iovcnt Number of segments (at most MESSAGE_MAX_IOV)
+ * @return 0 on success, -1 on error
+ */
+int client_send_textv(Client* client, const struct iovec* iov, size_t iovcnt);
+
+/**
+ * @brief Send text message without waiting for its ACK
+ *
+ * Blocks only while `window` messages are already unacknowledged.
+ * @param client Client instance
+ * @param text Text to send
+ * @param text_len Length of text
+ * @param sequence Assigned sequence number (output, may be NULL)
+ * @return 0 on success, -1 on error
+ */
+int client_send_text_async(Client* client, const char* text, size_t text_len, uint64_t* sequence);
+
+/**
+ * @brief Pipelined variant of client_send_textv
+ * @note The buffers may be reused as soon as the call returns
+ */
+int client_send_textv_async(Client* client, const struct iovec* iov, size_t iovcnt, uint64_t* sequence);
+
+/**
+ * @brief Stream part of a file as MSG_TYPE_CHUNK frames and wait for the final ACK
+ *
+ * The payload is cut into MSG_STREAM_CHUNK_SIZE chunks, so neither side
+ * holds more than one chunk however large the file. On plaintext sockets
+ * (and with kTLS send offload) the kernel copies the file to the socket
+ * with sendfile; otherwise each chunk is read into a buffer first.
+ * Pipelined messages are acknowledged before the stream starts.
+ * @note sendfile raises SIGPIPE if the server has closed the connection
+ * @param client Client instance
+ * @param file_fd Open file (its file position is not used or changed)
+ * @param offset File offset of the first byte to send
+ * @param length Bytes to send
+ * @return 0 on success, -1 on error
+ */
+int client_send_file(Client* client, int file_fd, uint64_t offset, uint64_t length);
+
+/**
+ * @brief Collect ACKs for pipelined messages
+ * @param client Client instance
+ * @param timeout_ms Time to wait for the first ACK (0 = only what has arrived)
+ * @return Number of messages acknowledged, -1 on error
+ */
+int client_poll_acks(Client* client, int timeout_ms);
+
+/**
+ * @brief Wait until every pipelined message is acknowledged
+ * @param client Client instance
+ * @param timeout_ms Maximum wait for each ACK
+ * @return 0 on success, -1 on error or timeout
+ */
+int client_flush(Client* client, int timeout_ms);
+
+/**
+ * @brief Number of sent but unacknowledged messages
+ */
+size_t client_in_flight(const Client* client);
+
+/**
+ * @brief Set maximum number of unacknowledged messages (minimum 1)
+ */
+void client_set_window(Client* client, size_t window);
+
+/**
+ * @brief Set completion callback invoked once per acknowledged message
+ */
+void client_set_ack_callback(Client* client, AckCallback callback, void* user_data);
+
+/**
+ * @brief Set the callback for publications on subscribed topics
+ *
+ * Publications can arrive between any two replies; they are handed to the
+ * callback (or discarded without one) by whichever call reads them, so they
+ * never stand in for an ACK.
+ */
+void client_set_publication_handler(Client* client, PublicationCallback callback, void* user_data);
+
+/**
+ * @brief Subscribe to a topic (1 to MSG_TOPIC_MAX bytes) and wait for the server's ACK
+ * @return 0 on success, -1 on error
+ */
+int client_subscribe(Client* client, const char* topic, size_t topic_len);
+
+/**
+ * @brief Stop receiving a topic
+ * @return 0 on success (also if not subscribed), -1 on error
+ */
+int client_unsubscribe(Client* client, const char* topic, size_t topic_len);
+
+/**
+ * @brief Publish data to every subscriber of a topic and wait for the server's ACK
+ *
+ * The publisher does not receive its own publication unless it subscribed
+ * to the topic.
+ * @return 0 on success, -1 on error
+ */
+int client_publish(Client* client, const char* topic, size_t topic_len, const void* data, size_t len);
+
+/**
+ * @brief Wait for publications and hand them to the publication handler
+ *
+ * ACKs of pipelined messages that arrive meanwhile are processed too.
+ * @param timeout_ms Time to wait for the first publication (0 = only what has arrived)
+ * @return Number of publications delivered, -1 on error
+ */
+int client_poll_publications(Client* client, int timeout_ms);
+
+/**
+ * @brief Request optional protocol features (negotiated on next connect)
+ * @param client Client instance
+ * @param features MSG_FEATURE_* mask
+ */
+void client_set_features(Client* client, uint32_t features);
+
+/**
+ * @brief Fetch a live metrics snapshot from the server (MSG_TYPE_STATS)
+ *
+ * Pipelined messages are acknowledged first so the reply is not mixed up
+ * with their ACKs.
+ * @param client Client instance
+ * @param len Output text length (may be NULL)
+ * @return NUL-terminated snapshot text (release with free), NULL on error
+ */
+char* client_request_stats(Client* client, size_t* len);
+
+/**
+ * @brief Compress payloads of at least threshold bytes (negotiated on next connect)
+ * @param client Client instance
+ * @param threshold Minimum payload size; 0 turns compression off
+ */
+void client_set_compression(Client* client, size_t threshold);
+
+/**
+ * @brief Offload the TLS record layer to the kernel (kTLS) on later connects
+ * @param client Client instance (TLS enabled)
+ * @param enable Non-zero to enable
+ * @return 0 on success, -1 if TLS is not enabled
+ */
+int client_set_ktls(Client* client, int enable);
+
 /**
  * @brief Receive message
  * @param client Client instance
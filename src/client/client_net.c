@@ -13,12 +13,21 @@
 #include <sys/un.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
 #include <unistd.h>
 #include <string.h>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 #include <openssl/x509.h>
 #include <openssl/evp.h>
+#include <pthread.h>
+
+#define CONNECT_ATTEMPT_DELAY_MS 250    // Head start of each address over the next (RFC 8305)
+#define CONNECT_MAX_ADDRESSES 8
 
 int connect_unix_socket(const char* socket_path) {
     int fd = socket(AF_UNIX, SOCK_STREAM, 0);
@@ -41,43 +50,173 @@ int connect_unix_socket(const char* socket_path) {
     return fd;
 }
 
-int connect_inet_socket(const char* host, uint16_t port) {
-    int fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (fd < 0) {
-        logger_error("Failed to create INET socket: %s", get_error_string(errno));
-        return -1;
+/**
+ * @brief Order resolved addresses by alternating families (RFC 8305), keeping
+ * the resolver's preference within each family
+ * @return Number of addresses stored
+ */
+static size_t interleave_families(struct addrinfo* list, struct addrinfo** out, size_t max) {
+    struct addrinfo* first[CONNECT_MAX_ADDRESSES];
+    struct addrinfo* other[CONNECT_MAX_ADDRESSES];
+    size_t first_count = 0, other_count = 0;
+    for (struct addrinfo* ai = list; ai; ai = ai->ai_next) {
+        if (ai->ai_family == list->ai_family && first_count < max) {
+            first[first_count++] = ai;
+        } else if (ai->ai_family != list->ai_family && other_count < max) {
+            other[other_count++] = ai;
+        }
     }
     
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(port);
-    
-    // Handle localhost
-    const char* host_ip = host;
-    if (strcmp(host, "localhost") == 0) {
-        host_ip = "127.0.0.1";
+    size_t count = 0;
+    for (size_t i = 0; i < first_count || i < other_count; i++) {
+        if (i < first_count && count < max) {
+            out[count++] = first[i];
+        }
+        if (i < other_count && count < max) {
+            out[count++] = other[i];
+        }
     }
+    return count;
+}
+
+int connect_inet_socket(const char* host, uint16_t port, int timeout_ms, const TuningOptions* tuning) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV;
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
     
-    if (inet_aton(host_ip, &addr.sin_addr) == 0) {
-        close(fd);
-        logger_error("Invalid IP address: %s", host);
+    struct addrinfo* list = NULL;
+    int gai = getaddrinfo(host, service, &hints, &list);
+    if (gai != 0) {
+        logger_error("Failed to resolve %s: %s", host, gai_strerror(gai));
         return -1;
     }
+    struct addrinfo* addresses[CONNECT_MAX_ADDRESSES];
+    size_t count = interleave_families(list, addresses, CONNECT_MAX_ADDRESSES);
     
-    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-        close(fd);
-        logger_error("Failed to connect to INET socket: %s", get_error_string(errno));
-        return -1;
+    // Happy Eyeballs: start the next address whenever the previous one fails
+    // or has not answered within the attempt delay; the first to connect wins
+    struct pollfd attempts[CONNECT_MAX_ADDRESSES];
+    size_t active = 0, started = 0;
+    int fd = -1;
+    int last_error = ETIMEDOUT;
+    uint64_t now = get_monotonic_ms();
+    uint64_t deadline = now + (uint64_t)(timeout_ms > 0 ? timeout_ms : 0);
+    uint64_t next_start = now;
+    
+    while (fd < 0) {
+        now = get_monotonic_ms();
+        if (started < count && (now >= next_start || active == 0)) {
+            const struct addrinfo* ai = addresses[started++];
+            next_start = now + CONNECT_ATTEMPT_DELAY_MS;
+            int candidate = socket(ai->ai_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            if (candidate < 0) {
+                last_error = errno;
+                continue;
+            }
+            if (tuning) {
+                tuning_apply_socket(candidate, tuning);
+            }
+            if (connect(candidate, ai->ai_addr, ai->ai_addrlen) == 0) {
+                fd = candidate;
+                break;
+            }
+            if (errno != EINPROGRESS) {
+                last_error = errno;
+                close(candidate);
+                next_start = now;
+                continue;
+            }
+            attempts[active].fd = candidate;
+            attempts[active].events = POLLOUT;
+            attempts[active].revents = 0;
+            active++;
+            continue;
+        }
+        if (active == 0 || now >= deadline) {
+            break;
+        }
+        
+        uint64_t wake = deadline;
+        if (started < count && next_start < wake) {
+            wake = next_start;
+        }
+        int ready = poll(attempts, active, (int)(wake - now));
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            last_error = errno;
+            break;
+        }
+        for (size_t i = active; i-- > 0 && fd < 0;) {
+            if (attempts[i].revents == 0) {
+                continue;
+            }
+            int error = 0;
+            socklen_t length = sizeof(error);
+            if (getsockopt(attempts[i].fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0) {
+                error = errno;
+            }
+            if (error == 0) {
+                fd = attempts[i].fd;
+            } else {
+                last_error = error;
+                close(attempts[i].fd);
+                next_start = now;
+            }
+            attempts[i] = attempts[--active];
+        }
     }
+    for (size_t i = 0; i < active; i++) {
+        close(attempts[i].fd);
+    }
+    freeaddrinfo(list);
     
+    if (fd < 0) {
+        logger_error("Failed to connect to %s:%u: %s", host, port, get_error_string(last_error));
+        return -1;
+    }
+    if (tuning) {
+        tuning_apply_connected(fd, tuning);
+    }
+    // The connection is used with blocking I/O and socket timeouts
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
     return fd;
 }
 
+static int session_slot_index = -1;
+static pthread_once_t session_slot_once = PTHREAD_ONCE_INIT;
+
+static void create_session_slot_index(void) {
+    session_slot_index = SSL_get_ex_new_index(0, NULL, NULL, NULL, NULL);
+}
+
+/**
+ * @brief Keep the newest resumable session in the slot given to connect_tls
+ * 
+ * TLS 1.3 tickets arrive after the handshake, so sessions are captured
+ * here rather than right after SSL_connect.
+ */
+static int on_new_session(SSL* ssl, SSL_SESSION* session) {
+    void** slot = (void**)SSL_get_ex_data(ssl, session_slot_index);
+    if (!slot) {
+        return 0;
+    }
+    if (*slot) {
+        SSL_SESSION_free((SSL_SESSION*)*slot);
+    }
+    *slot = session;
+    return 1;   // Reference kept
+}
+
 void* init_tls_client(void) {
     SSL_library_init();
     SSL_load_error_strings();
     OpenSSL_add_all_algorithms();
+    pthread_once(&session_slot_once, create_session_slot_index);
     
     const SSL_METHOD* method = TLS_client_method();
     SSL_CTX* ctx = SSL_CTX_new(method);
@@ -90,10 +229,14 @@ void* init_tls_client(void) {
     // For demo, don't verify certificate
     SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, NULL);
     
+    // Sessions are stored per client by on_new_session and offered on reconnect
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx, on_new_session);
+    
     return ctx;
 }
 
-void* connect_tls(int fd, void* ssl_ctx) {
+void* connect_tls(int fd, void* ssl_ctx, void** session) {
     SSL_CTX* ctx = (SSL_CTX*)ssl_ctx;
     SSL* ssl = SSL_new(ctx);
     if (!ssl) {
@@ -101,13 +244,29 @@ void* connect_tls(int fd, void* ssl_ctx) {
     }
     
     SSL_set_fd(ssl, fd);
+    if (session) {
+        SSL_set_ex_data(ssl, session_slot_index, session);
+        if (*session) {
+            SSL_set_session(ssl, (SSL_SESSION*)*session);
+        }
+    }
     
     if (SSL_connect(ssl) <= 0) {
         ERR_print_errors_fp(stderr);
         SSL_free(ssl);
+        // Do not offer a session the server just rejected
+        if (session && *session) {
+            SSL_SESSION_free((SSL_SESSION*)*session);
+            *session = NULL;
+        }
         return NULL;
     }
     
     return ssl;
 }
 
+void free_tls_session(void* session) {
+    if (session) {
+        SSL_SESSION_free((SSL_SESSION*)session);
+    }
+}
@@ -8,6 +8,7 @@
 #ifndef CLIENT_NET_H
 #define CLIENT_NET_H
 
+#include "../common/tuning.h"
 #include <stdint.h>
 
 /**
@@ -19,14 +20,21 @@ int connect_unix_socket(const char* socket_path);
 
 /**
  * @brief Connect to Internet socket
- * @param host Host address
+ *
+ * Resolves host with getaddrinfo (IPv4 and IPv6) and races the addresses:
+ * each one gets a short head start before the next is tried in parallel,
+ * and the first connection established wins. The connects are
+ * non-blocking, so an unreachable host costs at most timeout_ms.
+ * @param host Host name or address literal
  * @param port Port number
- * @return Socket file descriptor on success, -1 on error
+ * @param timeout_ms Longest wait for a connection
+ * @param tuning Socket options set on every attempt (NULL = none)
+ * @return Socket file descriptor (blocking) on success, -1 on error
  */
-int connect_inet_socket(const char* host, uint16_t port);
+int connect_inet_socket(const char* host, uint16_t port, int timeout_ms, const TuningOptions* tuning);
 
 /**
- * @brief Initialize TLS client context
+ * @brief Initialize TLS client context (session resumption enabled)
  * @return SSL_CTX pointer on success, NULL on error
  */
 void* init_tls_client(void);
@@ -35,9 +43,17 @@ void* init_tls_client(void);
  * @brief Connect with TLS
  * @param fd Socket file descriptor
  * @param ssl_ctx SSL context
+ * @param session Session slot (may be NULL): a stored session is offered for
+ *                resumption, and new sessions from the server replace it. The
+ *                slot must stay valid for the lifetime of the connection.
  * @return SSL pointer on success, NULL on error
  */
-void* connect_tls(int fd, void* ssl_ctx);
+void* connect_tls(int fd, void* ssl_ctx, void** session);
+
+/**
+ * @brief Release a session stored by connect_tls
+ */
+void free_tls_session(void* session);
 
 #endif // CLIENT_NET_H
 
@@ -0,0 +1,336 @@
+/**
+ * @file client_pool.c
+ * @brief Pool of client connections to one server
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include "client_pool.h"
+#include "../common/logger.h"
+#include "../common/buffer_pool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define RECONNECT_PAUSE_MS 1000    // Between rounds when a connection could not be replaced
+
+static void on_connection_acked(uint64_t sequence, void* user_data) {
+    PoolConnection* connection = (PoolConnection*)user_data;
+    ClientPool* pool = connection->pool;
+    connection->messages_acked++;
+    if (pool->ack_callback) {
+        pool->ack_callback(connection->index, sequence, pool->ack_user_data);
+    }
+}
+
+/**
+ * @brief Take a connection out of rotation and wake the reconnect thread
+ * @note Called with connection->lock held
+ */
+static void mark_failed(PoolConnection* connection) {
+    ClientPool* pool = connection->pool;
+    connection->send_failures++;
+    if (!atomic_exchange(&connection->healthy, 0)) {
+        return;
+    }
+    logger_warn("Pool connection %zu failed, replacing it", connection->index);
+    pthread_mutex_lock(&pool->reconnect_lock);
+    pthread_cond_signal(&pool->reconnect_cond);
+    pthread_mutex_unlock(&pool->reconnect_lock);
+}
+
+/**
+ * @brief Open (or reopen) one connection
+ * @note Called with connection->lock held
+ */
+static int open_connection(PoolConnection* connection, int timeout_sec) {
+    client_disconnect(&connection->client);
+    if (client_connect(&connection->client, timeout_sec) < 0) {
+        return -1;
+    }
+    atomic_store(&connection->healthy, 1);
+    return 0;
+}
+
+static int has_failed_connection(const ClientPool* pool) {
+    for (size_t i = 0; i < pool->count; i++) {
+        if (!atomic_load(&pool->connections[i].healthy)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void* reconnect_thread(void* arg) {
+    ClientPool* pool = (ClientPool*)arg;
+    
+    pthread_mutex_lock(&pool->reconnect_lock);
+    while (pool->running) {
+        if (!has_failed_connection(pool)) {
+            pthread_cond_wait(&pool->reconnect_cond, &pool->reconnect_lock);
+            continue;
+        }
+        pthread_mutex_unlock(&pool->reconnect_lock);
+        
+        int pending = 0;
+        for (size_t i = 0; i < pool->count; i++) {
+            PoolConnection* connection = &pool->connections[i];
+            if (atomic_load(&connection->healthy)) {
+                continue;
+            }
+            // client_connect retries with exponential backoff before giving up
+            pthread_mutex_lock(&connection->lock);
+            if (open_connection(connection, pool->timeout_sec) == 0) {
+                connection->reconnects++;
+                logger_info("Pool connection %zu replaced", connection->index);
+            } else {
+                pending = 1;
+            }
+            pthread_mutex_unlock(&connection->lock);
+        }
+        
+        pthread_mutex_lock(&pool->reconnect_lock);
+        if (pending && pool->running) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += RECONNECT_PAUSE_MS / 1000;
+            deadline.tv_nsec += (long)(RECONNECT_PAUSE_MS % 1000) * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&pool->reconnect_cond, &pool->reconnect_lock, &deadline);
+        }
+    }
+    pthread_mutex_unlock(&pool->reconnect_lock);
+    
+    // Feature negotiation and ACKs of the reopened connections used this thread's pool;
+    // other threads may still be using theirs
+    buffer_pool_thread_exit();
+    return NULL;
+}
+
+int client_pool_init(ClientPool* pool, size_t count, SocketMode mode, const char* address, int enable_tls) {
+    memset(pool, 0, sizeof(ClientPool));
+    if (count == 0 || count > CLIENT_POOL_MAX_CONNECTIONS) {
+        logger_error("Invalid pool size %zu (1 to %d)", count, CLIENT_POOL_MAX_CONNECTIONS);
+        return -1;
+    }
+    
+    pool->connections = calloc(count, sizeof(PoolConnection));
+    if (!pool->connections) {
+        return -1;
+    }
+    pool->timeout_sec = 5;
+    pthread_mutex_init(&pool->reconnect_lock, NULL);
+    pthread_cond_init(&pool->reconnect_cond, NULL);
+    
+    for (size_t i = 0; i < count; i++) {
+        PoolConnection* connection = &pool->connections[i];
+        if (client_init(&connection->client, mode, address, enable_tls) < 0) {
+            client_pool_cleanup(pool);
+            return -1;
+        }
+        connection->pool = pool;
+        connection->index = i;
+        pthread_mutex_init(&connection->lock, NULL);
+        client_set_ack_callback(&connection->client, on_connection_acked, connection);
+        pool->count++;
+    }
+    return 0;
+}
+
+void client_pool_cleanup(ClientPool* pool) {
+    if (!pool) return;
+    
+    if (pool->reconnect_started) {
+        pthread_mutex_lock(&pool->reconnect_lock);
+        pool->running = 0;
+        pthread_cond_signal(&pool->reconnect_cond);
+        pthread_mutex_unlock(&pool->reconnect_lock);
+        pthread_join(pool->reconnect_thread, NULL);
+    }
+    
+    for (size_t i = 0; i < pool->count; i++) {
+        client_cleanup(&pool->connections[i].client);
+        pthread_mutex_destroy(&pool->connections[i].lock);
+    }
+    free(pool->connections);
+    pthread_mutex_destroy(&pool->reconnect_lock);
+    pthread_cond_destroy(&pool->reconnect_cond);
+    memset(pool, 0, sizeof(ClientPool));
+}
+
+Client* client_pool_client(ClientPool* pool, size_t index) {
+    return index < pool->count ? &pool->connections[index].client : NULL;
+}
+
+int client_pool_connect(ClientPool* pool, int timeout_sec) {
+    pool->timeout_sec = timeout_sec;
+    
+    int opened = 0;
+    for (size_t i = 0; i < pool->count; i++) {
+        PoolConnection* connection = &pool->connections[i];
+        pthread_mutex_lock(&connection->lock);
+        if (open_connection(connection, timeout_sec) == 0) {
+            opened++;
+        }
+        pthread_mutex_unlock(&connection->lock);
+    }
+    if (opened == 0) {
+        logger_error("No pool connection could be opened");
+        return -1;
+    }
+    
+    if (!pool->reconnect_started) {
+        pool->running = 1;
+        if (pthread_create(&pool->reconnect_thread, NULL, reconnect_thread, pool) != 0) {
+            logger_error("Failed to start pool reconnect thread");
+            pool->running = 0;
+            return -1;
+        }
+        pool->reconnect_started = 1;
+    }
+    logger_info("Connection pool ready: %d of %zu connections open", opened, pool->count);
+    return opened;
+}
+
+/**
+ * @brief Send on one connection, taking it out of rotation if the send fails
+ * @return 0 on success, -1 on error
+ */
+static int send_on(PoolConnection* connection, const char* text, size_t text_len, uint64_t* sequence) {
+    pthread_mutex_lock(&connection->lock);
+    // Re-check under the lock: another thread may have seen it fail
+    if (!atomic_load(&connection->healthy)) {
+        pthread_mutex_unlock(&connection->lock);
+        return -1;
+    }
+    int result = client_send_text_async(&connection->client, text, text_len, sequence);
+    if (result == 0) {
+        connection->messages_sent++;
+    } else {
+        mark_failed(connection);
+    }
+    pthread_mutex_unlock(&connection->lock);
+    return result;
+}
+
+int client_pool_send_text(ClientPool* pool, const char* text, size_t text_len, size_t* connection,
+                          uint64_t* sequence) {
+    if (!pool || pool->count == 0) return -1;
+    
+    int attempts = 0;
+    for (size_t tried = 0; tried < pool->count && attempts < 2; tried++) {
+        size_t index = atomic_fetch_add(&pool->next, 1) % pool->count;
+        PoolConnection* candidate = &pool->connections[index];
+        if (!atomic_load(&candidate->healthy)) {
+            continue;
+        }
+        attempts++;
+        if (send_on(candidate, text, text_len, sequence) == 0) {
+            if (connection) {
+                *connection = index;
+            }
+            return 0;
+        }
+    }
+    logger_error("No pool connection could take the message");
+    return -1;
+}
+
+int client_pool_send_text_keyed(ClientPool* pool, uint64_t key, const char* text, size_t text_len,
+                                uint64_t* sequence) {
+    if (!pool || pool->count == 0) return -1;
+    
+    // Fibonacci hashing spreads sequential keys over the connections
+    size_t index = (size_t)((key * 11400714819323198485ull) >> 32) % pool->count;
+    PoolConnection* connection = &pool->connections[index];
+    if (!atomic_load(&connection->healthy)) {
+        logger_error("Pool connection %zu for key %llu is being replaced", index, (unsigned long long)key);
+        return -1;
+    }
+    return send_on(connection, text, text_len, sequence);
+}
+
+int client_pool_flush(ClientPool* pool, int timeout_ms) {
+    int result = 0;
+    for (size_t i = 0; i < pool->count; i++) {
+        PoolConnection* connection = &pool->connections[i];
+        if (!atomic_load(&connection->healthy)) {
+            // Its in-flight messages went down with it
+            result = -1;
+            continue;
+        }
+        pthread_mutex_lock(&connection->lock);
+        if (atomic_load(&connection->healthy) && client_flush(&connection->client, timeout_ms) < 0) {
+            mark_failed(connection);
+            result = -1;
+        }
+        pthread_mutex_unlock(&connection->lock);
+    }
+    return result;
+}
+
+char* client_pool_request_stats(ClientPool* pool, size_t* len) {
+    if (!pool) return NULL;
+    
+    for (size_t i = 0; i < pool->count; i++) {
+        PoolConnection* connection = &pool->connections[i];
+        if (!atomic_load(&connection->healthy)) {
+            continue;
+        }
+        // The reconnect thread must not reopen the client under the request
+        pthread_mutex_lock(&connection->lock);
+        char* stats = NULL;
+        if (atomic_load(&connection->healthy)) {
+            stats = client_request_stats(&connection->client, len);
+            if (!stats) {
+                mark_failed(connection);
+            }
+        }
+        pthread_mutex_unlock(&connection->lock);
+        if (stats) {
+            return stats;
+        }
+    }
+    return NULL;
+}
+
+void client_pool_set_window(ClientPool* pool, size_t window) {
+    for (size_t i = 0; i < pool->count; i++) {
+        client_set_window(&pool->connections[i].client, window);
+    }
+}
+
+void client_pool_set_features(ClientPool* pool, uint32_t features) {
+    for (size_t i = 0; i < pool->count; i++) {
+        client_set_features(&pool->connections[i].client, features);
+    }
+}
+
+void client_pool_set_compression(ClientPool* pool, size_t threshold) {
+    for (size_t i = 0; i < pool->count; i++) {
+        client_set_compression(&pool->connections[i].client, threshold);
+    }
+}
+
+void client_pool_set_connect_policy(ClientPool* pool, const ConnectPolicy* policy) {
+    for (size_t i = 0; i < pool->count; i++) {
+        client_set_connect_policy(&pool->connections[i].client, policy);
+    }
+}
+
+void client_pool_set_ack_callback(ClientPool* pool, PoolAckCallback callback, void* user_data) {
+    pool->ack_callback = callback;
+    pool->ack_user_data = user_data;
+}
+
+size_t client_pool_healthy(const ClientPool* pool) {
+    size_t healthy = 0;
+    for (size_t i = 0; i < pool->count; i++) {
+        if (atomic_load(&pool->connections[i].healthy)) {
+            healthy++;
+        }
+    }
+    return healthy;
+}
@@ -0,0 +1,178 @@
+/**
+ * @file client_pool.h
+ * @brief Pool of client connections to one server
+ *
+ * A single Client is one socket, so one producer can never use more than
+ * one server worker or one TCP flow. A ClientPool opens several Clients to
+ * the same server and spreads pipelined sends over them round-robin.
+ * Sends that must stay in order can be pinned to a connection by key.
+ *
+ * The pool may be shared by several producer threads: each connection is
+ * used by one thread at a time. A connection whose send or ACK wait fails
+ * is taken out of rotation and replaced by a background thread with
+ * client_connect, which retries with jittered exponential backoff. Messages that
+ * were in flight on it are lost; sequence numbers restart at 1 on the new
+ * connection.
+ */
+
+#ifndef CLIENT_POOL_H
+#define CLIENT_POOL_H
+
+#include "client.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define CLIENT_POOL_MAX_CONNECTIONS 256
+
+/**
+ * @brief Completion callback for pooled sends
+ * @param connection Index of the connection that carried the message
+ * @param sequence Sequence number on that connection
+ * @param user_data Pointer given to client_pool_set_ack_callback
+ */
+typedef void (*PoolAckCallback)(size_t connection, uint64_t sequence, void* user_data);
+
+struct ClientPool;
+
+/**
+ * @brief One pooled connection
+ */
+typedef struct {
+    Client client;
+    struct ClientPool* pool;
+    size_t index;
+    pthread_mutex_t lock;           ///< Held while a thread uses the client
+    _Atomic int healthy;            ///< In rotation; cleared when the connection fails
+    uint64_t messages_sent;
+    uint64_t messages_acked;
+    uint64_t send_failures;
+    uint64_t reconnects;
+} PoolConnection;
+
+/**
+ * @brief Client connection pool
+ */
+typedef struct ClientPool {
+    PoolConnection* connections;
+    size_t count;
+    int timeout_sec;
+    _Atomic size_t next;            ///< Round-robin cursor
+    PoolAckCallback ack_callback;
+    void* ack_user_data;
+    
+    // Background replacement of failed connections
+    pthread_t reconnect_thread;
+    int reconnect_started;
+    pthread_mutex_t reconnect_lock;
+    pthread_cond_t reconnect_cond;
+    int running;
+} ClientPool;
+
+/**
+ * @brief Initialize a pool (no connection is opened yet)
+ * @param pool Pool structure to initialize
+ * @param count Number of connections (1 to CLIENT_POOL_MAX_CONNECTIONS)
+ * @param mode Socket mode, as for client_init
+ * @param address Server address, as for client_init
+ * @param enable_tls Enable TLS on every connection
+ * @return 0 on success, -1 on error
+ */
+int client_pool_init(ClientPool* pool, size_t count, SocketMode mode, const char* address, int enable_tls);
+
+/**
+ * @brief Close every connection and release the pool
+ */
+void client_pool_cleanup(ClientPool* pool);
+
+/**
+ * @brief Client of one connection, for per-connection settings before client_pool_connect
+ */
+Client* client_pool_client(ClientPool* pool, size_t index);
+
+/**
+ * @brief Open all connections and start replacing failed ones
+ *
+ * Connections that cannot be opened now are left to the background thread.
+ * @param pool Pool instance
+ * @param timeout_sec Connection and ACK timeout in seconds
+ * @return Number of connections opened, -1 if none could be opened
+ */
+int client_pool_connect(ClientPool* pool, int timeout_sec);
+
+/**
+ * @brief Send a pipelined text message on the next healthy connection
+ *
+ * A message whose send fails is retried once on another connection.
+ * @param pool Pool instance
+ * @param text Text to send
+ * @param text_len Length of text
+ * @param connection Connection that carried the message (output, may be NULL)
+ * @param sequence Sequence number on that connection (output, may be NULL)
+ * @return 0 on success, -1 if no connection could take the message
+ */
+int client_pool_send_text(ClientPool* pool, const char* text, size_t text_len, size_t* connection,
+                          uint64_t* sequence);
+
+/**
+ * @brief Send a pipelined text message on the connection owning key
+ *
+ * Messages with the same key always use the same connection and therefore
+ * arrive in order. While that connection is being replaced the call fails
+ * instead of moving the key elsewhere.
+ * @return 0 on success, -1 on error
+ */
+int client_pool_send_text_keyed(ClientPool* pool, uint64_t key, const char* text, size_t text_len,
+                                uint64_t* sequence);
+
+/**
+ * @brief Wait until every connection has no unacknowledged messages
+ * @param pool Pool instance
+ * @param timeout_ms Maximum wait for each ACK
+ * @return 0 on success, -1 if some connection failed or timed out
+ */
+int client_pool_flush(ClientPool* pool, int timeout_ms);
+
+/**
+ * @brief Fetch a server metrics snapshot over the first healthy connection
+ *
+ * A connection whose request fails is taken out of rotation and the next
+ * one is tried.
+ * @param len Output text length (may be NULL)
+ * @return NUL-terminated snapshot text (release with free), NULL on error
+ */
+char* client_pool_request_stats(ClientPool* pool, size_t* len);
+
+/**
+ * @brief Set maximum unacknowledged messages per connection
+ */
+void client_pool_set_window(ClientPool* pool, size_t window);
+
+/**
+ * @brief Request optional protocol features on every connection
+ */
+void client_pool_set_features(ClientPool* pool, uint32_t features);
+
+/**
+ * @brief Compress payloads of at least threshold bytes on every connection
+ */
+void client_pool_set_compression(ClientPool* pool, size_t threshold);
+
+/**
+ * @brief Connect timeout and retry backoff of every connection
+ *
+ * Each connection draws its own backoff jitter, so replacements of
+ * connections lost together are spread out.
+ */
+void client_pool_set_connect_policy(ClientPool* pool, const ConnectPolicy* policy);
+
+/**
+ * @brief Set completion callback invoked once per acknowledged message
+ */
+void client_pool_set_ack_callback(ClientPool* pool, PoolAckCallback callback, void* user_data);
+
+/**
+ * @brief Number of connections currently in rotation
+ */
+size_t client_pool_healthy(const ClientPool* pool);
+
+#endif // CLIENT_POOL_H
@@ -6,18 +6,30 @@
  */
 
 #include "client.h"
+#include "client_pool.h"
 #include "../common/logger.h"
 #include "../common/types.h"
+#include "../common/buffer_pool.h"
+#include "../common/utils.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #define MAX_LINE_LEN 1024
 #define INPUT_FILE "client_input.txt"
 #define OUTPUT_FILE "client_output.txt"
 
 static int parse_config(const char* filename, SocketMode* mode, char** address, 
-                       int* enable_tls, int* free_input, char*** messages, size_t* message_count) {
+                       int* enable_tls, int* ktls, int* free_input, size_t* window,
+                       uint32_t* features, size_t* compression_threshold, int* request_stats,
+                       size_t* connections, ConnectPolicy* connect_policy, char** stream_file,
+                       char** subscribe_topic, char** publish_topic, int* listen_ms,
+                       char*** messages, size_t* message_count) {
     FILE* f = fopen(filename, "r");
     if (!f) {
         fprintf(stderr, "Failed to open %s\n", filename);
@@ -28,7 +40,18 @@ static int parse_config(const char* filename, SocketMode* mode, char** address,
     *mode = SOCKET_MODE_INET;
     *address = NULL;
     *enable_tls = 0;
+    *ktls = 0;
     *free_input = 0;
+    *window = 1;
+    *features = MSG_FEATURE_NONE;
+    *compression_threshold = 0;
+    *request_stats = 0;
+    *connections = 1;
+    client_connect_policy_init(connect_policy);
+    *stream_file = NULL;
+    *subscribe_topic = NULL;
+    *publish_topic = NULL;
+    *listen_ms = 0;
     *messages = NULL;
     *message_count = 0;
     size_t message_capacity = 0;
@@ -56,13 +79,70 @@ static int parse_config(const char* filename, SocketMode* mode, char** address,
                 *mode = SOCKET_MODE_UNIX;
             } else if (strcmp(value, "inet") == 0) {
                 *mode = SOCKET_MODE_INET;
+            } else if (strcmp(value, "shm") == 0) {
+                *mode = SOCKET_MODE_SHM;
             }
         } else if (strcmp(key, "address") == 0) {
             *address = strdup(value);
         } else if (strcmp(key, "tls") == 0) {
             *enable_tls = (atoi(value) != 0);
+        } else if (strcmp(key, "ktls") == 0) {
+            *ktls = (atoi(value) != 0);
         } else if (strcmp(key, "free_input") == 0) {
             *free_input = (atoi(value) != 0);
+        } else if (strcmp(key, "window") == 0) {
+            int w = atoi(value);
+            *window = w > 0 ? (size_t)w : 1;
+        } else if (strcmp(key, "ack_batch") == 0) {
+            if (atoi(value) != 0) {
+                *features |= MSG_FEATURE_ACK_BATCH;
+            } else {
+                *features &= ~(uint32_t)MSG_FEATURE_ACK_BATCH;
+            }
+        } else if (strcmp(key, "timestamps") == 0) {
+            if (atoi(value) != 0) {
+                *features |= MSG_FEATURE_TIMESTAMPS;
+            } else {
+                *features &= ~(uint32_t)MSG_FEATURE_TIMESTAMPS;
+            }
+        } else if (strcmp(key, "checksum") == 0) {
+            if (atoi(value) != 0) {
+                *features |= MSG_FEATURE_CHECKSUM;
+            } else {
+                *features &= ~(uint32_t)MSG_FEATURE_CHECKSUM;
+            }
+        } else if (strcmp(key, "stats") == 0) {
+            *request_stats = (atoi(value) != 0);
+        } else if (strcmp(key, "compression_threshold") == 0) {
+            long threshold = atol(value);
+            *compression_threshold = threshold > 0 ? (size_t)threshold : 0;
+        } else if (strcmp(key, "connect_timeout_ms") == 0) {
+            int timeout = atoi(value);
+            connect_policy->connect_timeout_ms = timeout > 0 ? timeout : 1;
+        } else if (strcmp(key, "connect_attempts") == 0) {
+            int attempts = atoi(value);
+            connect_policy->attempts = attempts > 0 ? attempts : 1;
+        } else if (strcmp(key, "backoff_base_ms") == 0) {
+            int base = atoi(value);
+            connect_policy->backoff_base_ms = base > 0 ? base : 0;
+        } else if (strcmp(key, "backoff_max_ms") == 0) {
+            int max = atoi(value);
+            connect_policy->backoff_max_ms = max > 0 ? max : 0;
+        } else if (strcmp(key, "connections") == 0) {
+            long n = atol(value);
+            *connections = n > 0 ? (size_t)n : 1;
+        } else if (strcmp(key, "file") == 0) {
+            free(*stream_file);
+            *stream_file = strdup(value);
+        } else if (strcmp(key, "subscribe") == 0) {
+            free(*subscribe_topic);
+            *subscribe_topic = strdup(value);
+        } else if (strcmp(key, "publish_topic") == 0) {
+            free(*publish_topic);
+            *publish_topic = strdup(value);
+        } else if (strcmp(key, "listen_ms") == 0) {
+            int ms = atoi(value);
+            *listen_ms = ms > 0 ? ms : 0;
         } else if (strcmp(key, "message") == 0) {
             // Add message to list
             if (*message_count >= message_capacity) {
@@ -75,6 +155,9 @@ static int parse_config(const char* filename, SocketMode* mode, char** address,
                     }
                     free(*messages);
                     free(*address);
+                    free(*stream_file);
+                    free(*subscribe_topic);
+                    free(*publish_topic);
                     fclose(f);
                     return -1;
                 }
@@ -83,6 +166,8 @@ static int parse_config(const char* filename, SocketMode* mode, char** address,
             }
             (*messages)[*message_count] = strdup(value);
             (*message_count)++;
+        } else {
+            tuning_parse_option(&connect_policy->tuning, key, value);
         }
     }
     
@@ -90,7 +175,7 @@ static int parse_config(const char* filename, SocketMode* mode, char** address,
     
     // Set default address if not provided
     if (!*address) {
-        if (*mode == SOCKET_MODE_UNIX) {
+        if (*mode != SOCKET_MODE_INET) {
             *address = strdup("/tmp/server.sock");
         } else {
             *address = strdup("localhost:8080");
@@ -100,6 +185,157 @@ static int parse_config(const char* filename, SocketMode* mode, char** address,
     return 0;
 }
 
+static void on_message_acked(uint64_t sequence, void* user_data) {
+    // Sequence numbers start at 1 on every connection, in send order
+    char** messages = (char**)user_data;
+    logger_info("Message acknowledged (seq=%llu): %s", (unsigned long long)sequence,
+                messages[sequence - 1]);
+}
+
+static void on_publication(const char* topic, size_t topic_len, const uint8_t* data, size_t len,
+                           void* user_data) {
+    (void)user_data;
+    logger_info("Publication on %.*s: %.*s", (int)topic_len, topic, (int)len, (const char*)data);
+}
+
+/**
+ * @brief Send one configured message, as a publication when a topic is set
+ */
+static int send_one(Client* client, const char* publish_topic, const char* text) {
+    if (publish_topic) {
+        return client_publish(client, publish_topic, strlen(publish_topic), text, strlen(text));
+    }
+    return client_send_text(client, text, strlen(text));
+}
+
+/**
+ * @brief Deliver publications for listen_ms milliseconds
+ */
+static void listen_for_publications(Client* client, int listen_ms) {
+    uint64_t deadline_ns = get_monotonic_ns() + (uint64_t)listen_ms * 1000000ull;
+    for (;;) {
+        uint64_t now_ns = get_monotonic_ns();
+        if (now_ns >= deadline_ns) {
+            break;
+        }
+        if (client_poll_publications(client, (int)((deadline_ns - now_ns + 999999) / 1000000)) < 0) {
+            logger_error("Connection lost while listening for publications");
+            break;
+        }
+    }
+    logger_info("Received %llu publications", (unsigned long long)client->publications);
+}
+
+static void on_pooled_message_acked(size_t connection, uint64_t sequence, void* user_data) {
+    (void)user_data;
+    logger_info("Message acknowledged (connection=%zu, seq=%llu)", connection, (unsigned long long)sequence);
+}
+
+static void log_rtt(const Histogram* rtt) {
+    if (rtt->total > 0) {
+        logger_info("Round-trip latency: %llu samples, p50 %.1f us, p90 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us",
+                    (unsigned long long)rtt->total, (double)histogram_percentile(rtt, 50.0) / 1e3,
+                    (double)histogram_percentile(rtt, 90.0) / 1e3, (double)histogram_percentile(rtt, 99.0) / 1e3,
+                    (double)histogram_percentile(rtt, 99.9) / 1e3, (double)rtt->max / 1e3);
+    }
+}
+
+/**
+ * @brief Send the configured messages round-robin over a connection pool
+ * @return 0 on success, -1 if the pool could not connect
+ */
+static int send_with_pool(SocketMode mode, const char* address, int enable_tls, size_t connections,
+                          const ConnectPolicy* connect_policy, size_t window, uint32_t features,
+                          size_t compression_threshold, int request_stats, char** messages,
+                          size_t message_count) {
+    ClientPool pool;
+    if (client_pool_init(&pool, connections, mode, address, enable_tls) < 0) {
+        logger_error("Failed to initialize connection pool");
+        return -1;
+    }
+    client_pool_set_features(&pool, features);
+    client_pool_set_compression(&pool, compression_threshold);
+    client_pool_set_window(&pool, window);
+    client_pool_set_connect_policy(&pool, connect_policy);
+    client_pool_set_ack_callback(&pool, on_pooled_message_acked, NULL);
+    
+    logger_info("Connecting %zu connections to server...", connections);
+    if (client_pool_connect(&pool, 5) < 0) {
+        logger_error("Failed to connect to server");
+        client_pool_cleanup(&pool);
+        return -1;
+    }
+    
+    for (size_t i = 0; i < message_count; i++) {
+        size_t connection = 0;
+        uint64_t sequence = 0;
+        if (client_pool_send_text(&pool, messages[i], strlen(messages[i]), &connection, &sequence) < 0) {
+            logger_error("Failed to send message: %s", messages[i]);
+        } else {
+            logger_info("Message sent (connection=%zu, seq=%llu): %s", connection,
+                        (unsigned long long)sequence, messages[i]);
+        }
+    }
+    if (client_pool_flush(&pool, 5000) < 0) {
+        logger_error("Failed to receive all ACKs");
+    }
+    
+    Histogram rtt;
+    histogram_init(&rtt);
+    for (size_t i = 0; i < pool.count; i++) {
+        const PoolConnection* connection = &pool.connections[i];
+        logger_info("Connection %zu: %llu sent, %llu acknowledged, %llu failures, %llu reconnects", i,
+                    (unsigned long long)connection->messages_sent, (unsigned long long)connection->messages_acked,
+                    (unsigned long long)connection->send_failures, (unsigned long long)connection->reconnects);
+        histogram_merge(&rtt, &connection->client.rtt);
+    }
+    
+    if (request_stats) {
+        char* stats = client_pool_request_stats(&pool, NULL);
+        if (stats) {
+            logger_info("Server stats:\n%s", stats);
+            free(stats);
+        } else {
+            logger_error("Failed to fetch server stats");
+        }
+    }
+    log_rtt(&rtt);
+    
+    client_pool_cleanup(&pool);
+    return 0;
+}
+
+/**
+ * @brief Send a whole file as one chunked stream
+ */
+static int stream_file_to_server(Client* client, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        logger_error("Failed to open %s: %s", path, get_error_string(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        logger_error("Failed to stat %s: %s", path, get_error_string(errno));
+        close(fd);
+        return -1;
+    }
+    
+    uint64_t length = (uint64_t)st.st_size;
+    logger_info("Streaming %s (%llu bytes)", path, (unsigned long long)length);
+    uint64_t start_ns = get_monotonic_ns();
+    int result = client_send_file(client, fd, 0, length);
+    double elapsed_sec = (double)(get_monotonic_ns() - start_ns) / 1e9;
+    close(fd);
+    if (result < 0) {
+        logger_error("Failed to stream %s", path);
+        return -1;
+    }
+    logger_info("Streamed %s: %llu bytes in %.3f s (%.1f MB/s)", path, (unsigned long long)length,
+                elapsed_sec, elapsed_sec > 0.0 ? (double)length / elapsed_sec / 1e6 : 0.0);
+    return 0;
+}
+
 static void free_messages(char** messages, size_t count) {
     if (messages) {
         for (size_t i = 0; i < count; i++) {
@@ -117,40 +353,93 @@ int main(int argc, char* argv[]) {
     SocketMode mode;
     char* address = NULL;
     int enable_tls = 0;
+    int ktls = 0;
     int free_input = 0;
+    size_t window = 1;
+    uint32_t features = MSG_FEATURE_NONE;
+    size_t compression_threshold = 0;
+    int request_stats = 0;
+    size_t connections = 1;
+    ConnectPolicy connect_policy;
+    char* stream_file = NULL;
+    char* subscribe_topic = NULL;
+    char* publish_topic = NULL;
+    int listen_ms = 0;
     char** messages = NULL;
     size_t message_count = 0;
     
-    if (parse_config(INPUT_FILE, &mode, &address, &enable_tls, &free_input, &messages, &message_count) < 0) {
+    if (parse_config(INPUT_FILE, &mode, &address, &enable_tls, &ktls, &free_input, &window, &features,
+                     &compression_threshold, &request_stats, &connections, &connect_policy, &stream_file,
+                     &subscribe_topic, &publish_topic, &listen_ms, &messages, &message_count) < 0) {
         return 1;
     }
     
+    // A server that goes away mid-sendfile must surface as an error, not kill the process
+    signal(SIGPIPE, SIG_IGN);
+    
     // Initialize logger: use stdout for interactive mode, file for batch mode
     const char* log_output = free_input ? NULL : OUTPUT_FILE;
     if (logger_init(log_output) < 0) {
         fprintf(stderr, "Failed to initialize logger\n");
         free(address);
         free_messages(messages, message_count);
+        free(stream_file);
+        free(subscribe_topic);
+        free(publish_topic);
         return 1;
     }
     
+    int cpu = tuning_pin_thread(&connect_policy.tuning, 0);
+    if (cpu >= 0) {
+        logger_info("Client pinned to CPU %d", cpu);
+    }
+    
     // Initialize client
     Client client;
     
-    if (mode == SOCKET_MODE_UNIX && enable_tls) {
-        logger_warn("TLS requested for UNIX mode; disabling TLS because it is not required.");
+    if (mode != SOCKET_MODE_INET && enable_tls) {
+        logger_warn("TLS requested for %s mode; disabling TLS because it is not required.", socket_mode_name(mode));
         enable_tls = 0;
     }
     
+    if (connections > 1 && !free_input) {
+        // Several connections: messages are striped round-robin across them
+        if (stream_file) {
+            logger_warn("file= is only streamed with connections=1; ignoring %s", stream_file);
+        }
+        if (subscribe_topic || publish_topic) {
+            logger_warn("subscribe= and publish_topic= need connections=1; sending plain messages");
+        }
+        int result = send_with_pool(mode, address, enable_tls, connections, &connect_policy, window, features,
+                                    compression_threshold, request_stats, messages, message_count);
+        free(address);
+        free_messages(messages, message_count);
+        free(stream_file);
+        free(subscribe_topic);
+        free(publish_topic);
+        buffer_pool_cleanup();
+        logger_cleanup();
+        return result < 0 ? 1 : 0;
+    }
+    
     if (client_init(&client, mode, address, enable_tls) < 0) {
         logger_error("Failed to initialize client");
         free(address);
         free_messages(messages, message_count);
+        free(stream_file);
+        free(subscribe_topic);
+        free(publish_topic);
         logger_cleanup();
         return 1;
     }
     
     free(address);
+    client_set_features(&client, features);
+    client_set_compression(&client, compression_threshold);
+    client_set_connect_policy(&client, &connect_policy);
+    if (enable_tls) {
+        client_set_ktls(&client, ktls);
+    }
     
     // Connect to server
     logger_info("Connecting to server...");
@@ -158,12 +447,24 @@ int main(int argc, char* argv[]) {
         logger_error("Failed to connect to server");
         client_cleanup(&client);
         free_messages(messages, message_count);
+        free(stream_file);
+        free(subscribe_topic);
+        free(publish_topic);
         logger_cleanup();
         return 1;
     }
     
     logger_info("Connected successfully");
     
+    if (subscribe_topic) {
+        client_set_publication_handler(&client, on_publication, NULL);
+        if (client_subscribe(&client, subscribe_topic, strlen(subscribe_topic)) < 0) {
+            logger_error("Failed to subscribe to %s", subscribe_topic);
+        } else {
+            logger_info("Subscribed to %s", subscribe_topic);
+        }
+    }
+    
     if (free_input) {
         // Interactive mode: keep connection open and read from stdin
         printf("Connected. Type messages to send (type 'quit' or 'exit' to close):\n");
@@ -178,18 +479,32 @@ int main(int argc, char* argv[]) {
                 continue;
             }
             logger_info("Sending message: %s", line);
-            if (client_send_text(&client, line, strlen(line)) < 0) {
+            if (send_one(&client, publish_topic, line) < 0) {
                 logger_error("Failed to send message: %s", line);
                 // Continue allowing user to try again
             } else {
                 logger_info("Message sent successfully: %s", line);
             }
         }
+    } else if (window > 1 && !publish_topic) {
+        // Pipelined: keep up to `window` messages in flight
+        client_set_window(&client, window);
+        client_set_ack_callback(&client, on_message_acked, messages);
+        for (size_t i = 0; i < message_count; i++) {
+            logger_info("Sending message: %s", messages[i]);
+            if (client_send_text_async(&client, messages[i], strlen(messages[i]), NULL) < 0) {
+                logger_error("Failed to send message: %s", messages[i]);
+                break;
+            }
+        }
+        if (client_flush(&client, 5000) < 0) {
+            logger_error("Failed to receive all ACKs (%zu unacknowledged)", client_in_flight(&client));
+        }
     } else {
         // Send messages from config
         for (size_t i = 0; i < message_count; i++) {
             logger_info("Sending message: %s", messages[i]);
-            if (client_send_text(&client, messages[i], strlen(messages[i])) < 0) {
+            if (send_one(&client, publish_topic, messages[i]) < 0) {
                 logger_error("Failed to send message: %s", messages[i]);
             } else {
                 logger_info("Message sent successfully: %s", messages[i]);
@@ -197,13 +512,44 @@ int main(int argc, char* argv[]) {
         }
     }
     
+    if (stream_file && !free_input) {
+        stream_file_to_server(&client, stream_file);
+    }
+    
+    if (listen_ms > 0 && !free_input) {
+        listen_for_publications(&client, listen_ms);
+    }
+    
+    if (client.compression.frames > 0) {
+        logger_info("Compressed %zu payloads: %llu -> %llu bytes (%.1f%%), %.3f ms CPU",
+                    client.compression.frames, (unsigned long long)client.compression.raw_bytes,
+                    (unsigned long long)client.compression.wire_bytes,
+                    compression_stats_ratio(&client.compression), (double)client.compression.cpu_ns / 1e6);
+    }
+    
+    if (request_stats) {
+        char* stats = client_request_stats(&client, NULL);
+        if (stats) {
+            logger_info("Server stats:\n%s", stats);
+            free(stats);
+        } else {
+            logger_error("Failed to fetch server stats");
+        }
+    }
+    
+    log_rtt(&client.rtt);
+    
     // Disconnect
     client_disconnect(&client);
     client_cleanup(&client);
     
     // Free messages
     free_messages(messages, message_count);
+    free(stream_file);
+    free(subscribe_topic);
+    free(publish_topic);
     
+    buffer_pool_cleanup();
     logger_cleanup();
     
     return 0;
@@ -0,0 +1,215 @@
+/**
+ * @file buffer_pool.c
+ * @brief Per-thread size-class buffer pool implementation
+ */
+
+#include "buffer_pool.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SMALLEST_CLASS_SIZE 64
+#define CLASS_OVERSIZE BUFFER_POOL_CLASS_COUNT
+#define MAX_CACHED_BYTES_PER_CLASS (1024 * 1024)
+#define MIN_CACHED_PER_CLASS 8
+
+/**
+ * @brief Hidden header in front of every buffer (32 bytes keeps payloads 16-byte aligned)
+ */
+typedef struct BufferHeader {
+    size_t capacity;
+    struct BufferHeader* next;  // Free-list link while cached
+    uint32_t size_class;
+    uint32_t reserved;
+    uint64_t padding;
+} BufferHeader;
+
+typedef struct ThreadPool {
+    BufferHeader* free_list[BUFFER_POOL_CLASS_COUNT];
+    size_t cached[BUFFER_POOL_CLASS_COUNT];
+    size_t allocs[BUFFER_POOL_CLASS_COUNT];
+    size_t hits[BUFFER_POOL_CLASS_COUNT];
+    size_t releases;
+    size_t oversize_allocs;
+    struct ThreadPool* next_pool;
+} ThreadPool;
+
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ThreadPool* registry = NULL;
+static atomic_uint registry_generation = 1;
+
+static _Thread_local ThreadPool* local_pool = NULL;
+static _Thread_local unsigned local_generation = 0;
+
+static size_t class_size(size_t size_class) {
+    return (size_t)SMALLEST_CLASS_SIZE << (2 * size_class);
+}
+
+static size_t class_limit(size_t size_class) {
+    size_t limit = MAX_CACHED_BYTES_PER_CLASS / class_size(size_class);
+    return limit < MIN_CACHED_PER_CLASS ? MIN_CACHED_PER_CLASS : limit;
+}
+
+static uint32_t class_for_size(size_t size) {
+    for (uint32_t c = 0; c < BUFFER_POOL_CLASS_COUNT; c++) {
+        if (size <= class_size(c)) {
+            return c;
+        }
+    }
+    return CLASS_OVERSIZE;
+}
+
+static ThreadPool* get_local_pool(void) {
+    unsigned generation = atomic_load_explicit(&registry_generation, memory_order_acquire);
+    if (local_pool && local_generation == generation) {
+        return local_pool;
+    }
+    
+    ThreadPool* pool = calloc(1, sizeof(ThreadPool));
+    if (!pool) {
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&registry_mutex);
+    pool->next_pool = registry;
+    registry = pool;
+    local_generation = atomic_load_explicit(&registry_generation, memory_order_relaxed);
+    pthread_mutex_unlock(&registry_mutex);
+    
+    local_pool = pool;
+    return pool;
+}
+
+static inline BufferHeader* header_of(const void* ptr) {
+    return (BufferHeader*)((uint8_t*)ptr - sizeof(BufferHeader));
+}
+
+void* buffer_pool_alloc(size_t size) {
+    if (size > SIZE_MAX - sizeof(BufferHeader)) {
+        return NULL;
+    }
+    
+    uint32_t size_class = class_for_size(size);
+    ThreadPool* pool = get_local_pool();
+    
+    if (size_class == CLASS_OVERSIZE || !pool) {
+        BufferHeader* header = malloc(sizeof(BufferHeader) + size);
+        if (!header) {
+            return NULL;
+        }
+        header->capacity = size;
+        header->size_class = CLASS_OVERSIZE;
+        if (pool) {
+            pool->oversize_allocs++;
+        }
+        return header + 1;
+    }
+    
+    pool->allocs[size_class]++;
+    BufferHeader* header = pool->free_list[size_class];
+    if (header) {
+        pool->free_list[size_class] = header->next;
+        pool->cached[size_class]--;
+        pool->hits[size_class]++;
+        return header + 1;
+    }
+    
+    header = malloc(sizeof(BufferHeader) + class_size(size_class));
+    if (!header) {
+        return NULL;
+    }
+    header->capacity = class_size(size_class);
+    header->size_class = size_class;
+    return header + 1;
+}
+
+void buffer_pool_free(void* ptr) {
+    if (!ptr) return;
+    
+    BufferHeader* header = header_of(ptr);
+    uint32_t size_class = header->size_class;
+    if (size_class == CLASS_OVERSIZE) {
+        free(header);
+        return;
+    }
+    
+    ThreadPool* pool = get_local_pool();
+    if (!pool || pool->cached[size_class] >= class_limit(size_class)) {
+        if (pool) {
+            pool->releases++;
+        }
+        free(header);
+        return;
+    }
+    
+    header->next = pool->free_list[size_class];
+    pool->free_list[size_class] = header;
+    pool->cached[size_class]++;
+}
+
+size_t buffer_pool_capacity(const void* ptr) {
+    return ptr ? header_of(ptr)->capacity : 0;
+}
+
+void buffer_pool_get_stats(BufferPoolStats* stats) {
+    memset(stats, 0, sizeof(BufferPoolStats));
+    for (size_t c = 0; c < BUFFER_POOL_CLASS_COUNT; c++) {
+        stats->class_size[c] = class_size(c);
+    }
+    
+    pthread_mutex_lock(&registry_mutex);
+    for (ThreadPool* pool = registry; pool; pool = pool->next_pool) {
+        for (size_t c = 0; c < BUFFER_POOL_CLASS_COUNT; c++) {
+            stats->allocs[c] += pool->allocs[c];
+            stats->hits[c] += pool->hits[c];
+            stats->cached[c] += pool->cached[c];
+            stats->cached_bytes += pool->cached[c] * class_size(c);
+        }
+        stats->releases += pool->releases;
+        stats->oversize_allocs += pool->oversize_allocs;
+        stats->thread_pools++;
+    }
+    pthread_mutex_unlock(&registry_mutex);
+}
+
+static void free_cached(ThreadPool* pool) {
+    for (size_t c = 0; c < BUFFER_POOL_CLASS_COUNT; c++) {
+        BufferHeader* header = pool->free_list[c];
+        while (header) {
+            BufferHeader* next_header = header->next;
+            free(header);
+            header = next_header;
+        }
+        pool->free_list[c] = NULL;
+        pool->cached[c] = 0;
+    }
+}
+
+void buffer_pool_thread_exit(void) {
+    // The registry lock keeps buffer_pool_cleanup and the stats away from the pool
+    pthread_mutex_lock(&registry_mutex);
+    if (local_pool && local_generation == atomic_load_explicit(&registry_generation, memory_order_relaxed)) {
+        free_cached(local_pool);
+    }
+    pthread_mutex_unlock(&registry_mutex);
+    local_pool = NULL;
+}
+
+void buffer_pool_cleanup(void) {
+    pthread_mutex_lock(&registry_mutex);
+    ThreadPool* pool = registry;
+    registry = NULL;
+    // Stale thread-local pointers are detected by the generation change
+    atomic_fetch_add_explicit(&registry_generation, 1, memory_order_release);
+    pthread_mutex_unlock(&registry_mutex);
+    
+    while (pool) {
+        ThreadPool* next = pool->next_pool;
+        free_cached(pool);
+        free(pool);
+        pool = next;
+    }
+    local_pool = NULL;
+}
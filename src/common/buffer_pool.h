@@ -0,0 +1,70 @@
+/**
+ * @file buffer_pool.h
+ * @brief Size-class buffer pool for message payloads
+ *
+ * Every thread gets its own pool, so allocation and release never take
+ * a lock. Buffers are grouped in power-of-four size classes and cached
+ * on free lists when released; requests above the largest class go
+ * straight to malloc. A buffer may be released on any thread and is
+ * then cached by that thread's pool.
+ */
+
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stddef.h>
+
+#define BUFFER_POOL_CLASS_COUNT 6   ///< 64 B, 256 B, 1 KiB, 4 KiB, 16 KiB, 64 KiB
+
+/**
+ * @brief Pool statistics (summed over all thread pools)
+ */
+typedef struct {
+    size_t class_size[BUFFER_POOL_CLASS_COUNT];     ///< Buffer size of each class
+    size_t allocs[BUFFER_POOL_CLASS_COUNT];         ///< Allocations served by each class
+    size_t hits[BUFFER_POOL_CLASS_COUNT];           ///< Allocations served from the free list
+    size_t cached[BUFFER_POOL_CLASS_COUNT];         ///< Buffers currently on free lists
+    size_t releases;        ///< Buffers returned to malloc because a free list was full
+    size_t oversize_allocs; ///< Allocations larger than the biggest class
+    size_t cached_bytes;    ///< Memory held on free lists
+    size_t thread_pools;    ///< Number of thread pools created
+} BufferPoolStats;
+
+/**
+ * @brief Allocate a buffer of at least size bytes
+ * @return Buffer (release with buffer_pool_free), NULL on error
+ */
+void* buffer_pool_alloc(size_t size);
+
+/**
+ * @brief Release a buffer obtained from buffer_pool_alloc (NULL is ignored)
+ */
+void buffer_pool_free(void* ptr);
+
+/**
+ * @brief Usable size of a pooled buffer
+ */
+size_t buffer_pool_capacity(const void* ptr);
+
+/**
+ * @brief Collect statistics from every thread pool
+ */
+void buffer_pool_get_stats(BufferPoolStats* stats);
+
+/**
+ * @brief Release the calling thread's cached buffers before it exits
+ *
+ * Only touches the caller's own pool, so other threads may keep using
+ * theirs. Its statistics are kept until buffer_pool_cleanup.
+ */
+void buffer_pool_thread_exit(void);
+
+/**
+ * @brief Release all cached buffers and thread pools
+ *
+ * Call once at shutdown after worker threads have exited. Buffers still
+ * in use remain valid and are returned to a fresh pool when freed.
+ */
+void buffer_pool_cleanup(void);
+
+#endif // BUFFER_POOL_H
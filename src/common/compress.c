@@ -0,0 +1,238 @@
+/**
+ * @file compress.c
+ * @brief LZ4 block format encoder and decoder
+ */
+
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+#include "compress.h"
+#include <endian.h>
+#include <string.h>
+
+#define LZ4_MIN_MATCH 4
+#define LZ4_MFLIMIT 12          // A match may not start within the last 12 bytes
+#define LZ4_LAST_LITERALS 5     // The last 5 bytes are always literals
+#define LZ4_MAX_OFFSET 65535
+#define LZ4_HASH_BITS 12
+#define LZ4_SKIP_TRIGGER 6      // Search step grows every 2^6 bytes without a match
+
+static inline uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t read64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t hash4(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+/**
+ * @brief Length of the common prefix of a and b, scanning at most up to limit
+ */
+static size_t match_length(const uint8_t* a, const uint8_t* b, const uint8_t* limit) {
+    const uint8_t* start = a;
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+    while (a + sizeof(uint64_t) <= limit) {
+        uint64_t diff = read64(a) ^ read64(b);
+        if (diff) {
+            return (size_t)(a - start) + ((size_t)__builtin_ctzll(diff) >> 3);
+        }
+        a += sizeof(uint64_t);
+        b += sizeof(uint64_t);
+    }
+#endif
+    while (a < limit && *a == *b) {
+        a++;
+        b++;
+    }
+    return (size_t)(a - start);
+}
+
+/**
+ * @brief Write the 255-continued remainder of a literal or match length
+ */
+static uint8_t* write_length(uint8_t* op, size_t len) {
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+/**
+ * @brief Emit one sequence: literals, then (if match_len > 0) the match
+ */
+static uint8_t* write_sequence(uint8_t* op, const uint8_t* literals, size_t literal_len,
+                               size_t offset, size_t match_len) {
+    uint8_t* token = op++;
+    *token = (uint8_t)((literal_len >= 15 ? 15 : literal_len) << 4);
+    if (literal_len >= 15) {
+        op = write_length(op, literal_len - 15);
+    }
+    memcpy(op, literals, literal_len);
+    op += literal_len;
+    
+    if (match_len > 0) {
+        *op++ = (uint8_t)(offset & 0xff);
+        *op++ = (uint8_t)(offset >> 8);
+        size_t code = match_len - LZ4_MIN_MATCH;
+        *token |= (uint8_t)(code >= 15 ? 15 : code);
+        if (code >= 15) {
+            op = write_length(op, code - 15);
+        }
+    }
+    return op;
+}
+
+size_t lz4_compress(const uint8_t* src, size_t src_len, uint8_t* dst, size_t dst_cap) {
+    if (dst_cap < lz4_compress_bound(src_len)) {
+        return 0;
+    }
+    
+    const uint8_t* end = src + src_len;
+    const uint8_t* anchor = src;
+    uint8_t* op = dst;
+    
+    if (src_len > LZ4_MFLIMIT) {
+        uint32_t table[1 << LZ4_HASH_BITS];
+        memset(table, 0, sizeof(table));
+        
+        const uint8_t* match_start_limit = end - LZ4_MFLIMIT;
+        const uint8_t* match_end_limit = end - LZ4_LAST_LITERALS;
+        const uint8_t* ip = src + 1;
+        table[hash4(read32(src))] = 0;
+        
+        while (ip < match_start_limit) {
+            uint32_t sequence = read32(ip);
+            uint32_t h = hash4(sequence);
+            const uint8_t* ref = src + table[h];
+            table[h] = (uint32_t)(ip - src);
+            
+            if (ref >= ip || (size_t)(ip - ref) > LZ4_MAX_OFFSET || read32(ref) != sequence) {
+                // Incompressible input is skipped over faster and faster
+                ip += 1 + ((size_t)(ip - anchor) >> LZ4_SKIP_TRIGGER);
+                continue;
+            }
+            
+            // Extend backwards into pending literals, then forwards
+            while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            size_t len = LZ4_MIN_MATCH + match_length(ip + LZ4_MIN_MATCH, ref + LZ4_MIN_MATCH, match_end_limit);
+            
+            op = write_sequence(op, anchor, (size_t)(ip - anchor), (size_t)(ip - ref), len);
+            ip += len;
+            anchor = ip;
+            
+            // Seed the table inside the match so the next search has a candidate
+            if (ip < match_start_limit) {
+                table[hash4(read32(ip - 2))] = (uint32_t)(ip - 2 - src);
+            }
+        }
+    }
+    
+    op = write_sequence(op, anchor, (size_t)(end - anchor), 0, 0);
+    return (size_t)(op - dst);
+}
+
+/**
+ * @brief Read the 255-continued remainder of a length
+ * @return 0 on success, -1 on truncated input
+ */
+static int read_length(const uint8_t** ip, const uint8_t* end, size_t* len) {
+    uint8_t b;
+    do {
+        if (*ip >= end) {
+            return -1;
+        }
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return 0;
+}
+
+int lz4_decompress(const uint8_t* src, size_t src_len, uint8_t* dst, size_t dst_len) {
+    const uint8_t* ip = src;
+    const uint8_t* iend = src + src_len;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + dst_len;
+    
+    for (;;) {
+        if (ip >= iend) {
+            return -1;
+        }
+        uint8_t token = *ip++;
+        
+        size_t literal_len = token >> 4;
+        if (literal_len == 15 && read_length(&ip, iend, &literal_len) < 0) {
+            return -1;
+        }
+        if (literal_len > (size_t)(iend - ip) || literal_len > (size_t)(oend - op)) {
+            return -1;
+        }
+        memcpy(op, ip, literal_len);
+        op += literal_len;
+        ip += literal_len;
+        
+        // The last sequence has literals only
+        if (ip == iend) {
+            break;
+        }
+        
+        if (iend - ip < 2) {
+            return -1;
+        }
+        size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst)) {
+            return -1;
+        }
+        
+        size_t match_len = token & 15;
+        if (match_len == 15 && read_length(&ip, iend, &match_len) < 0) {
+            return -1;
+        }
+        match_len += LZ4_MIN_MATCH;
+        if (match_len > (size_t)(oend - op)) {
+            return -1;
+        }
+        
+        // Overlapping matches repeat the last `offset` bytes; copy in growing chunks
+        const uint8_t* match = op - offset;
+        while (match_len > 0) {
+            size_t n = (size_t)(op - match);
+            if (n > match_len) {
+                n = match_len;
+            }
+            memcpy(op, match, n);
+            op += n;
+            match_len -= n;
+        }
+    }
+    
+    return op == oend ? 0 : -1;
+}
+
+void compression_stats_add(CompressionStats* dst, const CompressionStats* src) {
+    dst->frames += src->frames;
+    dst->skipped += src->skipped;
+    dst->raw_bytes += src->raw_bytes;
+    dst->wire_bytes += src->wire_bytes;
+    dst->cpu_ns += src->cpu_ns;
+}
+
+double compression_stats_ratio(const CompressionStats* stats) {
+    if (stats->raw_bytes == 0) {
+        return 100.0;
+    }
+    return 100.0 * (double)stats->wire_bytes / (double)stats->raw_bytes;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file compress.h
+ * @brief LZ4 block compression for message payloads
+ *
+ * Self-contained implementation of the LZ4 block format (greedy,
+ * single-probe hash matcher), so no external library is needed and any
+ * LZ4 decoder can read the output. Payloads carry no LZ4 frame header;
+ * the uncompressed size travels in the MSG_FLAGS_COMPRESSED extension.
+ */
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Codec counters (one direction, owned by one thread)
+ */
+typedef struct {
+    size_t frames;          ///< Payloads compressed or decompressed
+    size_t skipped;         ///< Payloads sent as-is because compression did not shrink them
+    uint64_t raw_bytes;     ///< Uncompressed bytes of those payloads
+    uint64_t wire_bytes;    ///< Compressed bytes of those payloads
+    uint64_t cpu_ns;        ///< Thread CPU time spent in the codec
+} CompressionStats;
+
+/**
+ * @brief Worst-case compressed size of src_len bytes
+ */
+static inline size_t lz4_compress_bound(size_t src_len) {
+    return src_len + src_len / 255 + 16;
+}
+
+/**
+ * @brief Compress a block
+ * @param dst Output buffer of at least lz4_compress_bound(src_len) bytes
+ * @return Compressed size, 0 if dst_cap is too small
+ */
+size_t lz4_compress(const uint8_t* src, size_t src_len, uint8_t* dst, size_t dst_cap);
+
+/**
+ * @brief Decompress a block produced by an LZ4 block compressor
+ * @param dst Output buffer of exactly the uncompressed size
+ * @return 0 on success, -1 if the input is malformed or does not decode to dst_len bytes
+ */
+int lz4_decompress(const uint8_t* src, size_t src_len, uint8_t* dst, size_t dst_len);
+
+/**
+ * @brief Add the counters of src to dst
+ */
+void compression_stats_add(CompressionStats* dst, const CompressionStats* src);
+
+/**
+ * @brief Compressed size as a percentage of the uncompressed size (100 if nothing was compressed)
+ */
+double compression_stats_ratio(const CompressionStats* stats);
+
+#endif // COMPRESS_H
@@ -0,0 +1,226 @@
+/**
+ * @file frame_reader.c
+ * @brief Incremental framing implementation
+ */
+
+#include "frame_reader.h"
+#include "buffer_pool.h"
+#include <openssl/ssl.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_READER_INITIAL_CAPACITY 16384
+#define FRAME_READER_MIN_READ 4096
+
+void frame_reader_init(FrameReader* reader) {
+    memset(reader, 0, sizeof(FrameReader));
+    reader->state = FRAME_STATE_HEADER;
+}
+
+void frame_reader_free(FrameReader* reader) {
+    if (!reader) return;
+    CompressionStats* stats = reader->stats;
+    uint64_t max_payload = reader->max_payload;
+    unsigned validate = reader->validate;
+    free(reader->buffer);
+    frame_reader_init(reader);
+    reader->stats = stats;
+    reader->max_payload = max_payload;
+    reader->validate = validate;
+}
+
+static int ensure_space(FrameReader* reader) {
+    if (reader->start == reader->end) {
+        reader->start = reader->end = 0;
+        // Drop oversized buffers left behind by a large frame
+        if (reader->capacity > 4 * FRAME_READER_INITIAL_CAPACITY) {
+            free(reader->buffer);
+            reader->buffer = NULL;
+            reader->capacity = 0;
+        }
+    }
+    
+    if (reader->capacity - reader->end >= FRAME_READER_MIN_READ) {
+        return 0;
+    }
+    
+    // Compact unconsumed bytes to the front
+    if (reader->start > 0) {
+        size_t pending = reader->end - reader->start;
+        memmove(reader->buffer, reader->buffer + reader->start, pending);
+        reader->start = 0;
+        reader->end = pending;
+        if (reader->capacity - reader->end >= FRAME_READER_MIN_READ) {
+            return 0;
+        }
+    }
+    
+    size_t new_capacity = reader->capacity == 0 ? FRAME_READER_INITIAL_CAPACITY : reader->capacity * 2;
+    uint8_t* new_buffer = realloc(reader->buffer, new_capacity);
+    if (!new_buffer) {
+        return -1;
+    }
+    reader->buffer = new_buffer;
+    reader->capacity = new_capacity;
+    return 0;
+}
+
+ssize_t frame_reader_read(FrameReader* reader, int fd, void* ssl, int is_ssl) {
+    ssize_t total = 0;
+    
+    for (;;) {
+        if (ensure_space(reader) < 0) {
+            return -1;
+        }
+        
+        uint8_t* dst = reader->buffer + reader->end;
+        size_t space = reader->capacity - reader->end;
+        ssize_t received;
+        
+        if (is_ssl && ssl) {
+            int n = SSL_read((SSL*)ssl, dst, (int)(space > 0x7fffffff ? 0x7fffffff : space));
+            if (n <= 0) {
+                int err = SSL_get_error((SSL*)ssl, n);
+                if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+                    return total;
+                }
+                // Report bytes already buffered; the error repeats on the next call
+                return total > 0 ? total : -1;
+            }
+            received = n;
+        } else {
+            received = recv(fd, dst, space, MSG_DONTWAIT);
+            if (received < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return total;
+                }
+                return -1;
+            }
+            if (received == 0) {
+                return -1; // Connection closed
+            }
+        }
+        
+        reader->end += (size_t)received;
+        total += received;
+        
+        // Decrypted bytes kept inside OpenSSL are invisible to the event loop
+        if (!(is_ssl && ssl && SSL_pending((SSL*)ssl) > 0)) {
+            return total;
+        }
+    }
+}
+
+int frame_reader_feed(FrameReader* reader, const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    while (len > 0) {
+        if (ensure_space(reader) < 0) {
+            return -1;
+        }
+        size_t n = reader->capacity - reader->end;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(reader->buffer + reader->end, p, n);
+        reader->end += n;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Cut the next frame out of the buffer
+ * @param borrow Point uncompressed payloads into the read buffer instead of copying them
+ */
+static int next_frame(FrameReader* reader, Message* msg, int borrow) {
+    Message* current = &reader->current;
+    
+    if (reader->state == FRAME_STATE_HEADER) {
+        size_t buffered = frame_reader_buffered(reader);
+        if (buffered < sizeof(MessageHeader)) {
+            return 0;
+        }
+        const uint8_t* head = reader->buffer + reader->start;
+        MessageHeader header;
+        memcpy(&header, head, sizeof(header));
+        message_header_deserialize(&header);
+        
+        size_t ext_size = message_extension_size(header.flags);
+        if (buffered < sizeof(MessageHeader) + ext_size) {
+            return 0;
+        }
+        if (header.length > SIZE_MAX - sizeof(MessageHeader) - ext_size) {
+            return -1;
+        }
+        
+        memset(current, 0, sizeof(Message));
+        current->header = header;
+        message_decode_extensions(current, head + sizeof(MessageHeader));
+        if (reader->max_payload > 0 &&
+            (header.length > reader->max_payload ||
+             ((header.flags & MSG_FLAGS_COMPRESSED) && current->raw_length > reader->max_payload))) {
+            reader->oversized = header.length > reader->max_payload ? header.length : current->raw_length;
+            return -1;
+        }
+        reader->start += sizeof(MessageHeader) + ext_size;
+        reader->state = FRAME_STATE_PAYLOAD;
+    }
+    
+    if (reader->state == FRAME_STATE_PAYLOAD) {
+        if (frame_reader_buffered(reader) < current->header.length) {
+            return 0;
+        }
+        reader->state = FRAME_STATE_COMPLETE;
+    }
+    
+    // FRAME_STATE_COMPLETE: hand the frame out
+    size_t length = (size_t)current->header.length;
+    const uint8_t* wire = reader->buffer + reader->start;
+    *msg = *current;
+    if (msg->header.flags & MSG_FLAGS_COMPRESSED) {
+        if ((reader->rejected = message_verify(msg, NULL, wire, 0)) != 0 ||
+            message_decompress(msg, wire, reader->stats) < 0) {
+            return -1;
+        }
+        if ((reader->rejected = message_verify(msg, NULL, msg->payload, reader->validate)) != 0) {
+            message_free(msg);
+            return -1;
+        }
+    } else if (length > 0 && borrow) {
+        if ((reader->rejected = message_verify(msg, NULL, wire, reader->validate)) != 0) {
+            return -1;
+        }
+        msg->payload = (uint8_t*)wire;
+        msg->payload_size = length;
+        msg->borrowed = 1;
+    } else {
+        if (length > 0) {
+            msg->payload = (uint8_t*)buffer_pool_alloc(length);
+            if (!msg->payload) {
+                return -1;
+            }
+            msg->payload_size = length;
+        }
+        // One pass copies the payload and runs the checks
+        if ((reader->rejected = message_verify(msg, msg->payload, wire, reader->validate)) != 0) {
+            message_free(msg);
+            return -1;
+        }
+    }
+    
+    reader->start += length;
+    reader->state = FRAME_STATE_HEADER;
+    return 1;
+}
+
+int frame_reader_next(FrameReader* reader, Message* msg) {
+    return next_frame(reader, msg, 0);
+}
+
+int frame_reader_next_view(FrameReader* reader, Message* msg) {
+    return next_frame(reader, msg, 1);
+}
@@ -0,0 +1,102 @@
+/**
+ * @file frame_reader.h
+ * @brief Incremental, non-blocking message framing
+ *
+ * Each connection owns a FrameReader. Bytes are read as they become
+ * available and frames are cut out of the buffer once complete, so a
+ * peer that sends a partial frame never blocks the caller.
+ */
+
+#ifndef FRAME_READER_H
+#define FRAME_READER_H
+
+#include "protocol.h"
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * @brief Framing state
+ */
+typedef enum {
+    FRAME_STATE_HEADER,     ///< Waiting for a complete MessageHeader and extensions
+    FRAME_STATE_PAYLOAD,    ///< Header parsed, waiting for payload bytes
+    FRAME_STATE_COMPLETE    ///< Full frame buffered, ready to dispatch
+} FrameState;
+
+/**
+ * @brief Per-connection read buffer and framing state
+ */
+typedef struct {
+    uint8_t* buffer;
+    size_t capacity;
+    size_t start;           ///< Offset of first unconsumed byte
+    size_t end;             ///< Offset one past last buffered byte
+    FrameState state;
+    Message current;        ///< Header and extensions of the frame being read
+    CompressionStats* stats; ///< Decompression counters (NULL = not collected)
+    uint64_t max_payload;   ///< Largest payload accepted, before or after decompression (0 = unlimited)
+    uint64_t oversized;     ///< Announced length of the frame refused for exceeding max_payload
+    unsigned validate;      ///< INTEGRITY_UTF8: refuse text payloads that are not UTF-8
+    unsigned rejected;      ///< INTEGRITY_* check the refused frame failed
+} FrameReader;
+
+/**
+ * @brief Initialize reader (buffer is allocated on first read)
+ */
+void frame_reader_init(FrameReader* reader);
+
+/**
+ * @brief Release reader buffer
+ */
+void frame_reader_free(FrameReader* reader);
+
+/**
+ * @brief Read whatever is available without blocking
+ * @param reader Frame reader
+ * @param fd Non-blocking socket file descriptor
+ * @param ssl SSL context (NULL if not using TLS)
+ * @param is_ssl Whether TLS is enabled
+ * @return Bytes read (>0), 0 if nothing is available, -1 on error or peer close
+ */
+ssize_t frame_reader_read(FrameReader* reader, int fd, void* ssl, int is_ssl);
+
+/**
+ * @brief Append bytes received by other means (e.g. a completion-based backend)
+ * @return 0 on success, -1 on allocation failure
+ */
+int frame_reader_feed(FrameReader* reader, const void* data, size_t len);
+
+/**
+ * @brief Extract next complete frame
+ * 
+ * Compressed payloads are decoded straight out of the read buffer, so the
+ * caller always sees the original payload. A frame larger than max_payload
+ * is refused as soon as its header arrives, before any of it is buffered.
+ * Checksums and text are verified while the payload is copied out.
+ * @param reader Frame reader
+ * @param msg Output message (must be freed with message_free)
+ * @return 1 if a frame was produced, 0 if more data is needed, -1 on protocol
+ *         error (reader->oversized is set if the frame was too large,
+ *         reader->rejected if its payload failed a check)
+ */
+int frame_reader_next(FrameReader* reader, Message* msg);
+
+/**
+ * @brief Extract next complete frame without copying its payload
+ * 
+ * Like frame_reader_next, but an uncompressed payload is borrowed from the
+ * read buffer: it stays valid until the next frame_reader_read or
+ * frame_reader_feed, so every view taken from one read can be used
+ * together. Compressed payloads are still decoded into a buffer of their
+ * own; message_free releases either kind.
+ */
+int frame_reader_next_view(FrameReader* reader, Message* msg);
+
+/**
+ * @brief Number of buffered bytes not yet consumed
+ */
+static inline size_t frame_reader_buffered(const FrameReader* reader) {
+    return reader->end - reader->start;
+}
+
+#endif // FRAME_READER_H
@@ -0,0 +1,108 @@
+/**
+ * @file histogram.c
+ * @brief Log-linear histogram implementation
+ */
+
+#include "histogram.h"
+#include <string.h>
+
+#define SUB_BUCKET_BITS 6   // log2(HISTOGRAM_SUB_BUCKETS)
+
+/**
+ * @brief Bucket of a value
+ *
+ * Values below 2 * HISTOGRAM_SUB_BUCKETS map one-to-one. Above that, a
+ * value whose highest set bit is b keeps its top SUB_BUCKET_BITS + 1 bits:
+ * shift = b - SUB_BUCKET_BITS, index = shift * 64 + (value >> shift).
+ */
+static size_t bucket_index(uint64_t value) {
+    if (value >= HISTOGRAM_MAX_VALUE) {
+        return HISTOGRAM_BUCKETS - 1;
+    }
+    if (value < 2 * HISTOGRAM_SUB_BUCKETS) {
+        return (size_t)value;
+    }
+    unsigned msb = 63u - (unsigned)__builtin_clzll(value);
+    unsigned shift = msb - SUB_BUCKET_BITS;
+    return (size_t)shift * HISTOGRAM_SUB_BUCKETS + (size_t)(value >> shift);
+}
+
+/**
+ * @brief Largest value that maps to a bucket
+ */
+static uint64_t bucket_upper_bound(size_t index) {
+    if (index < 2 * HISTOGRAM_SUB_BUCKETS) {
+        return index;
+    }
+    unsigned shift = (unsigned)(index / HISTOGRAM_SUB_BUCKETS) - 1;
+    uint64_t sub = index - (size_t)shift * HISTOGRAM_SUB_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+void histogram_init(Histogram* histogram) {
+    memset(histogram, 0, sizeof(Histogram));
+}
+
+void histogram_record(Histogram* histogram, uint64_t value) {
+    histogram->counts[bucket_index(value)]++;
+    if (histogram->total == 0 || value < histogram->min) {
+        histogram->min = value;
+    }
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+    histogram->total++;
+    histogram->sum += value;
+}
+
+void histogram_merge(Histogram* dst, const Histogram* src) {
+    if (src->total == 0) {
+        return;
+    }
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+    if (dst->total == 0 || src->min < dst->min) {
+        dst->min = src->min;
+    }
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+    dst->total += src->total;
+    dst->sum += src->sum;
+}
+
+uint64_t histogram_percentile(const Histogram* histogram, double percentile) {
+    if (histogram->total == 0) {
+        return 0;
+    }
+    if (percentile < 0.0) {
+        percentile = 0.0;
+    } else if (percentile > 100.0) {
+        percentile = 100.0;
+    }
+    
+    // Rank of the wanted value, rounded up: p99 of 1000 values is the 990th
+    double exact = percentile / 100.0 * (double)histogram->total;
+    uint64_t rank = (uint64_t)exact;
+    if ((double)rank < exact || rank == 0) {
+        rank++;
+    }
+    
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            uint64_t value = bucket_upper_bound(i);
+            if (value > histogram->max) {
+                value = histogram->max;
+            }
+            return value < histogram->min ? histogram->min : value;
+        }
+    }
+    return histogram->max;
+}
+
+double histogram_mean(const Histogram* histogram) {
+    return histogram->total > 0 ? (double)histogram->sum / (double)histogram->total : 0.0;
+}
@@ -0,0 +1,61 @@
+/**
+ * @file histogram.h
+ * @brief Log-linear (HDR-style) histogram for latency percentiles
+ *
+ * Values are grouped into power-of-two ranges, each split into 64 linear
+ * sub-buckets, so every recorded value is kept with a relative error
+ * below 1/64 (about 1.6%) from 1 ns up to HISTOGRAM_MAX_VALUE in a
+ * fixed array. Recording is a few instructions and never allocates;
+ * histograms of different threads are combined with histogram_merge.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HISTOGRAM_SUB_BUCKETS 64            ///< Linear steps per power of two
+#define HISTOGRAM_MAX_SHIFT 34
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_SHIFT + 2) * HISTOGRAM_SUB_BUCKETS)
+#define HISTOGRAM_MAX_VALUE ((uint64_t)(2 * HISTOGRAM_SUB_BUCKETS) << HISTOGRAM_MAX_SHIFT)   ///< About 37 minutes in ns; larger values are clamped
+
+/**
+ * @brief Histogram (one owner thread; merge to combine)
+ */
+typedef struct {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t total;     ///< Recorded values
+    uint64_t sum;       ///< Sum of recorded values (for the mean)
+    uint64_t min;
+    uint64_t max;
+} Histogram;
+
+/**
+ * @brief Reset a histogram
+ */
+void histogram_init(Histogram* histogram);
+
+/**
+ * @brief Record one value
+ */
+void histogram_record(Histogram* histogram, uint64_t value);
+
+/**
+ * @brief Add every value recorded in src to dst
+ */
+void histogram_merge(Histogram* dst, const Histogram* src);
+
+/**
+ * @brief Smallest value that at least `percentile` percent of the values do not exceed
+ * @param percentile 0 to 100 (e.g. 99.9)
+ * @return The value (bucket upper bound, at most the recorded maximum), 0 if empty
+ */
+uint64_t histogram_percentile(const Histogram* histogram, double percentile);
+
+/**
+ * @brief Mean of the recorded values, 0 if empty
+ */
+double histogram_mean(const Histogram* histogram);
+
+#endif // HISTOGRAM_H
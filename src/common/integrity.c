@@ -0,0 +1,546 @@
+/**
+ * @file integrity.c
+ * @brief Payload checksums (CRC32C) and UTF-8 validation
+ */
+
+#define _DEFAULT_SOURCE
+#include "integrity.h"
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+
+#define CRC32C_POLY 0x82F63B78u     // Castagnoli polynomial, bit-reflected
+#define SCAN_CHUNK 4096             // Bytes copied and checksummed before they are validated (portable scan)
+#define CRC_LONG 8192               // Bytes per stream of a long three-stream CRC block
+#define CRC_SHORT 256               // Bytes per stream of a short one
+
+/**
+ * @brief Advance a raw (not inverted) CRC32C state over len bytes
+ */
+typedef uint32_t (*CrcFn)(uint32_t state, const uint8_t* p, size_t len);
+
+typedef int (*ScanFn)(uint8_t* dst, const uint8_t* src, size_t len, unsigned checks, uint32_t* state);
+
+static uint32_t crc_table[8][256];
+static uint32_t crc_shift_long[4][256];     // Advance a CRC state over CRC_LONG zero bytes
+static uint32_t crc_shift_short[4][256];    // ... over CRC_SHORT zero bytes
+static CrcFn crc_update;
+static ScanFn scan;
+static const char* backend = "portable";
+static pthread_once_t select_once = PTHREAD_ONCE_INIT;
+
+// ---------------------------------------------------------------------------
+// Portable code
+// ---------------------------------------------------------------------------
+
+static void build_crc_table(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (CRC32C_POLY & (0u - (crc & 1)));
+        }
+        crc_table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            uint32_t prev = crc_table[k - 1][i];
+            crc_table[k][i] = (prev >> 8) ^ crc_table[0][prev & 0xFF];
+        }
+    }
+}
+
+/**
+ * @brief Apply a linear map of CRC states, given as the images of its 32 bits
+ */
+static uint32_t gf2_apply(const uint32_t* map, uint32_t vec) {
+    uint32_t sum = 0;
+    for (int i = 0; vec != 0; vec >>= 1, i++) {
+        if (vec & 1) {
+            sum ^= map[i];
+        }
+    }
+    return sum;
+}
+
+/**
+ * @brief Fill table with the effect of len zero bytes on a CRC state (len a power of two)
+ *
+ * The map for one zero bit is squared until it covers len bytes
+ * (zlib's crc32_combine), then tabulated one state byte at a time.
+ */
+static void build_shift_table(uint32_t table[4][256], size_t len) {
+    uint32_t map[32];
+    uint32_t square[32];
+    map[0] = CRC32C_POLY;
+    for (int i = 1; i < 32; i++) {
+        map[i] = 1u << (i - 1);
+    }
+    for (size_t bits = 1; bits < len * 8; bits <<= 1) {
+        for (int i = 0; i < 32; i++) {
+            square[i] = gf2_apply(map, map[i]);
+        }
+        memcpy(map, square, sizeof(map));
+    }
+    for (int k = 0; k < 4; k++) {
+        for (uint32_t b = 0; b < 256; b++) {
+            table[k][b] = gf2_apply(map, b << (8 * k));
+        }
+    }
+}
+
+/**
+ * @brief Advance a CRC state over the zero bytes a build_shift_table table stands for
+ */
+static inline uint32_t crc_shift(const uint32_t table[4][256], uint32_t crc) {
+    return table[0][crc & 0xFF] ^ table[1][(crc >> 8) & 0xFF] ^
+           table[2][(crc >> 16) & 0xFF] ^ table[3][crc >> 24];
+}
+
+/**
+ * @brief Slicing-by-8: eight table lookups per 8 bytes
+ */
+static uint32_t crc_portable(uint32_t crc, const uint8_t* p, size_t len) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        uint32_t lo = (uint32_t)word ^ crc;
+        uint32_t hi = (uint32_t)(word >> 32);
+        crc = crc_table[7][lo & 0xFF] ^ crc_table[6][(lo >> 8) & 0xFF] ^
+              crc_table[5][(lo >> 16) & 0xFF] ^ crc_table[4][lo >> 24] ^
+              crc_table[3][hi & 0xFF] ^ crc_table[2][(hi >> 8) & 0xFF] ^
+              crc_table[1][(hi >> 16) & 0xFF] ^ crc_table[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+#endif
+    while (len-- > 0) {
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *p++) & 0xFF];
+    }
+    return crc;
+}
+
+/**
+ * @brief Validate the complete sequences at the start of p
+ * @param error Set to 1 on a malformed sequence
+ * @return Bytes validated; fewer than len if p ends inside a sequence
+ */
+static size_t utf8_prefix(const uint8_t* p, size_t len, int* error) {
+    size_t i = 0;
+    while (i < len) {
+        if (len - i >= 8) {
+            uint64_t word;
+            memcpy(&word, p + i, sizeof(word));
+            if ((word & 0x8080808080808080ull) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+        uint8_t c = p[i];
+        if (c < 0x80) {
+            i++;
+            continue;
+        }
+        
+        size_t n;
+        if (c >= 0xC2 && c <= 0xDF) {
+            n = 2;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            n = 3;
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            n = 4;
+        } else {
+            *error = 1;         // Continuation byte, overlong 2-byte lead or beyond U+10FFFF
+            return i;
+        }
+        if (len - i < n) {
+            // The continuation bytes seen so far must still fit
+            for (size_t k = i + 1; k < len; k++) {
+                if ((p[k] & 0xC0) != 0x80) {
+                    *error = 1;
+                }
+            }
+            return i;
+        }
+        
+        uint8_t c1 = p[i + 1];
+        if ((c1 & 0xC0) != 0x80 ||
+            (c == 0xE0 && c1 < 0xA0) ||     // Overlong 3-byte form
+            (c == 0xED && c1 > 0x9F) ||     // UTF-16 surrogate
+            (c == 0xF0 && c1 < 0x90) ||     // Overlong 4-byte form
+            (c == 0xF4 && c1 > 0x8F)) {     // Above U+10FFFF
+            *error = 1;
+            return i;
+        }
+        for (size_t k = 2; k < n; k++) {
+            if ((p[i + k] & 0xC0) != 0x80) {
+                *error = 1;
+                return i;
+            }
+        }
+        i += n;
+    }
+    return i;
+}
+
+/**
+ * @brief Copy, checksum and validate in cache-sized chunks
+ */
+static int scan_chunked(uint8_t* dst, const uint8_t* src, size_t len, unsigned checks, uint32_t* state) {
+    size_t validated = 0;
+    int error = 0;
+    for (size_t offset = 0; offset < len; offset += SCAN_CHUNK) {
+        size_t n = len - offset < SCAN_CHUNK ? len - offset : SCAN_CHUNK;
+        if (dst) {
+            memcpy(dst + offset, src + offset, n);
+        }
+        if (checks & INTEGRITY_CRC32C) {
+            *state = crc_update(*state, src + offset, n);
+        }
+        if ((checks & INTEGRITY_UTF8) && !error) {
+            // A sequence cut by the chunk boundary is validated with the next chunk
+            validated += utf8_prefix(src + validated, offset + n - validated, &error);
+        }
+    }
+    if ((checks & INTEGRITY_UTF8) && (error || validated != len)) {
+        return -1;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// x86-64: SSE4.2 crc32 and 16-byte UTF-8 validation
+// ---------------------------------------------------------------------------
+
+#if defined(__x86_64__)
+
+/**
+ * @brief CRC of three adjacent streams of lane bytes each, computed side by side
+ *
+ * crc32 has a latency of three cycles but issues every cycle, so three
+ * independent streams keep it busy. The CRC of A then B is that of A
+ * advanced over |B| zero bytes, XOR that of B alone.
+ */
+__attribute__((target("sse4.2")))
+static inline uint64_t crc_sse42_3way(uint64_t crc, const uint8_t* p, size_t lane, const uint32_t table[4][256]) {
+    uint64_t crc1 = 0;
+    uint64_t crc2 = 0;
+    for (size_t i = 0; i < lane; i += 8) {
+        uint64_t w0, w1, w2;
+        memcpy(&w0, p + i, sizeof(w0));
+        memcpy(&w1, p + lane + i, sizeof(w1));
+        memcpy(&w2, p + 2 * lane + i, sizeof(w2));
+        crc = _mm_crc32_u64(crc, w0);
+        crc1 = _mm_crc32_u64(crc1, w1);
+        crc2 = _mm_crc32_u64(crc2, w2);
+    }
+    crc = crc_shift(table, (uint32_t)crc) ^ crc1;
+    return crc_shift(table, (uint32_t)crc) ^ crc2;
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t crc_sse42(uint32_t crc, const uint8_t* p, size_t len) {
+    uint64_t state = crc;
+    while (len >= 3 * CRC_LONG) {
+        state = crc_sse42_3way(state, p, CRC_LONG, crc_shift_long);
+        p += 3 * CRC_LONG;
+        len -= 3 * CRC_LONG;
+    }
+    while (len >= 3 * CRC_SHORT) {
+        state = crc_sse42_3way(state, p, CRC_SHORT, crc_shift_short);
+        p += 3 * CRC_SHORT;
+        len -= 3 * CRC_SHORT;
+    }
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        state = _mm_crc32_u64(state, word);
+        p += 8;
+        len -= 8;
+    }
+    crc = (uint32_t)state;
+    while (len-- > 0) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+
+// Error classes of a byte pair (Keiser and Lemire, "Validating UTF-8 In Less
+// Than One Instruction Per Byte"); a pair is valid when the lookups on its
+// first byte's nibbles and its second byte's high nibble share no bit
+#define TOO_SHORT (1 << 0)      // Lead byte followed by a lead or ASCII byte
+#define TOO_LONG (1 << 1)       // ASCII followed by a continuation byte
+#define OVERLONG_3 (1 << 2)     // E0 80..9F
+#define TOO_LARGE (1 << 3)      // F4 90..BF, or F5..FF
+#define SURROGATE (1 << 4)      // ED A0..BF
+#define OVERLONG_2 (1 << 5)     // C0..C1 followed by a continuation byte
+#define TOO_LARGE_1000 (1 << 6) // F5..FF 80..8F
+#define OVERLONG_4 (1 << 6)     // F0 80..8F
+#define TWO_CONTS (1 << 7)      // Two continuation bytes (valid only inside a 3- or 4-byte sequence)
+#define CARRY (TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+/**
+ * @brief Error bits of one 16-byte block, given the block before it
+ */
+__attribute__((target("sse4.2")))
+static inline __m128i utf8_block_errors(__m128i input, __m128i prev) {
+    const __m128i byte_1_high_table = _mm_setr_epi8(
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        TOO_SHORT | OVERLONG_2,
+        TOO_SHORT,
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+    const __m128i byte_1_low_table = _mm_setr_epi8(
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+        CARRY | OVERLONG_2,
+        CARRY,
+        CARRY,
+        CARRY | TOO_LARGE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000);
+    const __m128i byte_2_high_table = _mm_setr_epi8(
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        (char)(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4),
+        (char)(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE),
+        (char)(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+        (char)(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+    const __m128i low_nibble = _mm_set1_epi8(0x0F);
+    
+    __m128i prev1 = _mm_alignr_epi8(input, prev, 15);
+    __m128i byte_1_high = _mm_shuffle_epi8(byte_1_high_table,
+                                           _mm_and_si128(_mm_srli_epi16(prev1, 4), low_nibble));
+    __m128i byte_1_low = _mm_shuffle_epi8(byte_1_low_table, _mm_and_si128(prev1, low_nibble));
+    __m128i byte_2_high = _mm_shuffle_epi8(byte_2_high_table,
+                                           _mm_and_si128(_mm_srli_epi16(input, 4), low_nibble));
+    __m128i special = _mm_and_si128(_mm_and_si128(byte_1_high, byte_1_low), byte_2_high);
+    
+    // Bytes 2 and 3 after a 3-byte lead (E0..EF) or 4-byte lead (F0..FF) must be continuations
+    __m128i third = _mm_subs_epu8(_mm_alignr_epi8(input, prev, 14), _mm_set1_epi8((char)(0xE0 - 0x80)));
+    __m128i fourth = _mm_subs_epu8(_mm_alignr_epi8(input, prev, 13), _mm_set1_epi8((char)(0xF0 - 0x80)));
+    __m128i must_continue = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8((char)0x80));
+    return _mm_xor_si128(must_continue, special);
+}
+
+/**
+ * @brief Non-zero where a block ends inside a multi-byte sequence
+ */
+__attribute__((target("sse4.2")))
+static inline __m128i utf8_incomplete(__m128i block) {
+    const __m128i max = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                      (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+    return _mm_subs_epu8(block, max);
+}
+
+/**
+ * @brief Copy and validate 64 bytes
+ * @param prev The 16 bytes before src (zeros at the start of the payload); set to the last 16 of src
+ * @return Error bits
+ */
+__attribute__((target("sse4.2")))
+static inline __m128i scan_64(uint8_t* dst, const uint8_t* src, __m128i* prev, int utf8) {
+    __m128i b0 = _mm_loadu_si128((const __m128i*)src);
+    __m128i b1 = _mm_loadu_si128((const __m128i*)(src + 16));
+    __m128i b2 = _mm_loadu_si128((const __m128i*)(src + 32));
+    __m128i b3 = _mm_loadu_si128((const __m128i*)(src + 48));
+    if (dst) {
+        _mm_storeu_si128((__m128i*)dst, b0);
+        _mm_storeu_si128((__m128i*)(dst + 16), b1);
+        _mm_storeu_si128((__m128i*)(dst + 32), b2);
+        _mm_storeu_si128((__m128i*)(dst + 48), b3);
+    }
+    __m128i error = _mm_setzero_si128();
+    if (utf8) {
+        if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(b0, b1), _mm_or_si128(b2, b3))) == 0) {
+            // ASCII: only a sequence left open before it can be wrong
+            error = utf8_incomplete(*prev);
+        } else {
+            error = _mm_or_si128(_mm_or_si128(utf8_block_errors(b0, *prev), utf8_block_errors(b1, b0)),
+                                 _mm_or_si128(utf8_block_errors(b2, b1), utf8_block_errors(b3, b2)));
+        }
+    }
+    *prev = b3;
+    return error;
+}
+
+/**
+ * @brief The 16 bytes before offset i, zeros at the start
+ */
+__attribute__((target("sse4.2")))
+static inline __m128i scan_prev(const uint8_t* src, size_t i) {
+    return i >= 16 ? _mm_loadu_si128((const __m128i*)(src + i - 16)) : _mm_setzero_si128();
+}
+
+/**
+ * @brief Copy, checksum and validate 64 bytes at a time
+ *
+ * Blocks of 3 * CRC_SHORT bytes are taken as three lanes side by side,
+ * as in crc_sse42. A 16-byte block is validated against the 16 bytes
+ * before it only, so the lanes need no state from each other, and the
+ * crc32 instructions run alongside the shuffles of the validation. The
+ * final partial block is padded with zeros, which also exposes a
+ * sequence cut off by the end of the payload.
+ */
+__attribute__((target("sse4.2")))
+static int scan_sse42(uint8_t* dst, const uint8_t* src, size_t len, unsigned checks, uint32_t* state) {
+    int crc = (checks & INTEGRITY_CRC32C) != 0;
+    int utf8 = (checks & INTEGRITY_UTF8) != 0;
+    uint64_t crc_state = *state;
+    __m128i error = _mm_setzero_si128();
+    
+    size_t i = 0;
+    for (; len - i >= 3 * CRC_SHORT; i += 3 * CRC_SHORT) {
+        const uint8_t* p = src + i;
+        __m128i prev0 = scan_prev(src, i);
+        __m128i prev1 = scan_prev(src, i + CRC_SHORT);
+        __m128i prev2 = scan_prev(src, i + 2 * CRC_SHORT);
+        uint64_t crc1 = 0;
+        uint64_t crc2 = 0;
+        for (size_t j = 0; j < CRC_SHORT; j += 64) {
+            error = _mm_or_si128(error, scan_64(dst ? dst + i + j : NULL, p + j, &prev0, utf8));
+            error = _mm_or_si128(error, scan_64(dst ? dst + i + CRC_SHORT + j : NULL, p + CRC_SHORT + j,
+                                                &prev1, utf8));
+            error = _mm_or_si128(error, scan_64(dst ? dst + i + 2 * CRC_SHORT + j : NULL,
+                                                p + 2 * CRC_SHORT + j, &prev2, utf8));
+            if (crc) {
+                for (size_t k = j; k < j + 64; k += 8) {
+                    uint64_t w0, w1, w2;
+                    memcpy(&w0, p + k, sizeof(w0));
+                    memcpy(&w1, p + CRC_SHORT + k, sizeof(w1));
+                    memcpy(&w2, p + 2 * CRC_SHORT + k, sizeof(w2));
+                    crc_state = _mm_crc32_u64(crc_state, w0);
+                    crc1 = _mm_crc32_u64(crc1, w1);
+                    crc2 = _mm_crc32_u64(crc2, w2);
+                }
+            }
+        }
+        if (crc) {
+            crc_state = crc_shift(crc_shift_short, (uint32_t)crc_state) ^ crc1;
+            crc_state = crc_shift(crc_shift_short, (uint32_t)crc_state) ^ crc2;
+        }
+    }
+    
+    // Less than one three-lane block left
+    if (crc) {
+        crc_state = crc_sse42((uint32_t)crc_state, src + i, len - i);
+    }
+    __m128i prev = scan_prev(src, i);
+    for (; len - i >= 64; i += 64) {
+        error = _mm_or_si128(error, scan_64(dst ? dst + i : NULL, src + i, &prev, utf8));
+    }
+    for (; len - i >= 16; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(src + i));
+        if (dst) {
+            _mm_storeu_si128((__m128i*)(dst + i), block);
+        }
+        if (utf8) {
+            error = _mm_or_si128(error, _mm_movemask_epi8(block) == 0 ? utf8_incomplete(prev)
+                                                                       : utf8_block_errors(block, prev));
+        }
+        prev = block;
+    }
+    
+    size_t rest = len - i;
+    if (rest > 0 && dst) {
+        memcpy(dst + i, src + i, rest);
+    }
+    if (utf8) {
+        uint8_t last[16] = {0};
+        memcpy(last, src + i, rest);
+        __m128i block = _mm_loadu_si128((const __m128i*)last);
+        error = _mm_or_si128(error, _mm_movemask_epi8(block) == 0 ? utf8_incomplete(prev)
+                                                                   : utf8_block_errors(block, prev));
+    }
+    *state = (uint32_t)crc_state;
+    return utf8 && !_mm_testz_si128(error, error) ? -1 : 0;
+}
+
+#endif
+
+// ---------------------------------------------------------------------------
+// AArch64: ARMv8 CRC extension
+// ---------------------------------------------------------------------------
+
+#if defined(__aarch64__)
+
+__attribute__((target("+crc")))
+static uint32_t crc_armv8(uint32_t crc, const uint8_t* p, size_t len) {
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        crc = __crc32cd(crc, word);
+        p += 8;
+        len -= 8;
+    }
+    while (len-- > 0) {
+        crc = __crc32cb(crc, *p++);
+    }
+    return crc;
+}
+
+#endif
+
+static void select_backend(void) {
+    build_crc_table();
+    crc_update = crc_portable;
+    scan = scan_chunked;
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("sse4.2")) {
+        build_shift_table(crc_shift_long, CRC_LONG);
+        build_shift_table(crc_shift_short, CRC_SHORT);
+        crc_update = crc_sse42;
+        scan = scan_sse42;
+        backend = "sse4.2";
+    }
+#elif defined(__aarch64__)
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+        crc_update = crc_armv8;
+        backend = "armv8-crc";
+    }
+#endif
+}
+
+uint32_t crc32c(uint32_t crc, const void* data, size_t len) {
+    pthread_once(&select_once, select_backend);
+    return ~crc_update(~crc, (const uint8_t*)data, len);
+}
+
+int utf8_validate(const void* data, size_t len) {
+    pthread_once(&select_once, select_backend);
+    uint32_t unused = 0;
+    return scan(NULL, (const uint8_t*)data, len, INTEGRITY_UTF8, &unused) == 0;
+}
+
+int integrity_scan(void* dst, const void* src, size_t len, unsigned checks, uint32_t* crc) {
+    pthread_once(&select_once, select_backend);
+    uint32_t state = crc ? ~*crc : 0;
+    int result = scan((uint8_t*)dst, (const uint8_t*)src, len, checks, &state);
+    if (crc && (checks & INTEGRITY_CRC32C)) {
+        *crc = ~state;
+    }
+    return result;
+}
+
+const char* integrity_backend(void) {
+    pthread_once(&select_once, select_backend);
+    return backend;
+}
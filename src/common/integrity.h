@@ -0,0 +1,50 @@
+/**
+ * @file integrity.h
+ * @brief Payload checksums (CRC32C) and UTF-8 validation
+ *
+ * Both checks run over a payload in one pass, optionally while copying it
+ * out of a receive buffer. On x86-64 CPUs with SSE4.2 the checksum uses the
+ * crc32 instruction and text is validated 16 bytes at a time with Keiser
+ * and Lemire's lookup algorithm; ARMv8 CPUs with the CRC extension use its
+ * crc32c instructions. Other CPUs fall back to a slicing-by-8 table and a
+ * validator that skips ASCII a word at a time. The implementation is picked
+ * at run time, on first use.
+ */
+
+#ifndef INTEGRITY_H
+#define INTEGRITY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define INTEGRITY_CRC32C 0x01   ///< Compute the CRC32C of the bytes
+#define INTEGRITY_UTF8 0x02     ///< Require well-formed UTF-8 (RFC 3629)
+
+/**
+ * @brief Extend a CRC32C (Castagnoli) checksum
+ * @param crc Checksum of the preceding bytes (0 to start)
+ * @return Checksum including data
+ */
+uint32_t crc32c(uint32_t crc, const void* data, size_t len);
+
+/**
+ * @brief Whether data is well-formed UTF-8 (no overlongs, surrogates or code points above U+10FFFF)
+ */
+int utf8_validate(const void* data, size_t len);
+
+/**
+ * @brief Run the checks over src in one pass, copying it to dst on the way
+ * @param dst Destination of len bytes, or NULL to only check
+ * @param checks INTEGRITY_* bits
+ * @param crc With INTEGRITY_CRC32C: checksum of the preceding bytes on
+ *            input, including src on output
+ * @return 0 on success, -1 if INTEGRITY_UTF8 was asked for and src is not UTF-8
+ */
+int integrity_scan(void* dst, const void* src, size_t len, unsigned checks, uint32_t* crc);
+
+/**
+ * @brief Name of the implementation in use ("sse4.2", "armv8-crc" or "portable")
+ */
+const char* integrity_backend(void);
+
+#endif // INTEGRITY_H
@@ -3,23 +3,85 @@
  * @brief Logger implementation
  */
 
+#define _POSIX_C_SOURCE 200809L
 #include "logger.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include <pthread.h>
 
+#define LOG_SLOT_SIZE 512
+#define LOG_TIMESTAMP_LEN 19    // "YYYY-mm-dd HH:MM:SS"
+#define LOG_WRITE_BUFFER (64 * 1024)
+
 static FILE* log_file = NULL;
 static LogLevel log_level = LOG_LEVEL_INFO;
 static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-int logger_init(const char* output_file) {
+/**
+ * @brief One formatted line waiting for the writer
+ *
+ * sequence == position: free for the producer claiming that position;
+ * sequence == position + 1: holds a line for the writer.
+ */
+typedef struct {
+    _Atomic size_t sequence;
+    uint16_t length;
+    uint8_t level;
+    char text[LOGGER_ASYNC_LINE_MAX + 1];  // + the terminator vsnprintf writes
+} LogSlot;
+
+_Static_assert(sizeof(LogSlot) <= LOG_SLOT_SIZE, "LOGGER_ASYNC_LINE_MAX does not fit a log slot");
+
+/**
+ * @brief Bounded multi-producer/single-consumer ring and its writer thread
+ */
+typedef struct {
+    LogSlot* slots;
+    size_t mask;
+    _Alignas(64) _Atomic size_t enqueue_pos;
+    _Alignas(64) size_t dequeue_pos;            // Writer thread only
+    _Atomic size_t dropped;
+    _Atomic int writer_sleeping;
+    _Atomic size_t flush_target;                // Position logger_flush() waits for
+    size_t flushed_pos;                         // Guarded by mutex
+    int stopping;                               // Guarded by mutex
+    LoggerAsyncOptions options;
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+    pthread_cond_t flushed;
+    pthread_t thread;
+} AsyncLogger;
+
+static AsyncLogger async_logger;
+static atomic_int async_active = 0;
+
+/**
+ * @brief Per-thread copy of the formatted wall-clock second
+ */
+static _Thread_local time_t cached_second = (time_t)-1;
+static _Thread_local char cached_timestamp[LOG_TIMESTAMP_LEN + 1];
+
+static const char* timestamp_now(void) {
+    time_t now = time(NULL);
+    if (now != cached_second) {
+        struct tm tm_info;
+        localtime_r(&now, &tm_info);
+        strftime(cached_timestamp, sizeof(cached_timestamp), "%Y-%m-%d %H:%M:%S", &tm_info);
+        cached_second = now;
+    }
+    return cached_timestamp;
+}
+
+static int open_log(const char* output_file, const char* mode) {
     pthread_mutex_lock(&log_mutex);
     
     if (output_file) {
-        log_file = fopen(output_file, "w");
+        log_file = fopen(output_file, mode);
         if (!log_file) {
             pthread_mutex_unlock(&log_mutex);
             return -1;
@@ -32,7 +94,309 @@ int logger_init(const char* output_file) {
     return 0;
 }
 
+int logger_init(const char* output_file) {
+    return open_log(output_file, "w");
+}
+
+int logger_init_append(const char* output_file) {
+    return open_log(output_file, "a");
+}
+
+void logger_async_options_init(LoggerAsyncOptions* options) {
+    options->ring_lines = LOGGER_ASYNC_DEFAULT_LINES;
+    options->flush_interval_ms = LOGGER_ASYNC_DEFAULT_FLUSH_MS;
+    options->flush_level = LOG_LEVEL_WARN;
+}
+
+static const char* level_to_string(LogLevel level) {
+    switch (level) {
+        case LOG_LEVEL_INFO: return "INFO";
+        case LOG_LEVEL_WARN: return "WARN";
+        case LOG_LEVEL_ERROR: return "ERROR";
+        default: return "UNKNOWN";
+    }
+}
+
+static uint64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Write every published line to the stdio buffer
+ * @return Number of lines written; *urgent is set if one reached flush_level
+ */
+static size_t drain_ring(AsyncLogger* logger, int* urgent) {
+    size_t count = 0;
+    for (;;) {
+        LogSlot* slot = &logger->slots[logger->dequeue_pos & logger->mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (sequence != logger->dequeue_pos + 1) {
+            return count;
+        }
+        
+        fwrite(slot->text, 1, slot->length, log_file);
+        if (slot->level >= logger->options.flush_level) {
+            *urgent = 1;
+        }
+        
+        atomic_store_explicit(&slot->sequence, logger->dequeue_pos + logger->mask + 1, memory_order_release);
+        logger->dequeue_pos++;
+        count++;
+    }
+}
+
+static void* writer_thread(void* arg) {
+    AsyncLogger* logger = (AsyncLogger*)arg;
+    uint64_t last_flush = monotonic_ms();
+    size_t unflushed = 0;
+    size_t reported_drops = 0;
+    
+    for (;;) {
+        int urgent = 0;
+        size_t written = drain_ring(logger, &urgent);
+        unflushed += written;
+        
+        size_t dropped = atomic_load_explicit(&logger->dropped, memory_order_relaxed);
+        if (dropped != reported_drops) {
+            fprintf(log_file, "[%s] [WARN] Log ring full: dropped %zu lines\n", timestamp_now(),
+                    dropped - reported_drops);
+            reported_drops = dropped;
+            unflushed++;
+        }
+        
+        size_t flush_target = atomic_load_explicit(&logger->flush_target, memory_order_acquire);
+        uint64_t now = monotonic_ms();
+        int flush_wanted = flush_target > logger->flushed_pos && logger->dequeue_pos >= flush_target;
+        if (unflushed > 0 &&
+            (urgent || flush_wanted || now - last_flush >= (uint64_t)logger->options.flush_interval_ms)) {
+            fflush(log_file);
+            unflushed = 0;
+            last_flush = now;
+        }
+        if (flush_wanted || logger->dequeue_pos > logger->flushed_pos) {
+            if (unflushed == 0) {
+                pthread_mutex_lock(&logger->mutex);
+                logger->flushed_pos = logger->dequeue_pos;
+                pthread_cond_broadcast(&logger->flushed);
+                pthread_mutex_unlock(&logger->mutex);
+            }
+        }
+        
+        if (written > 0) {
+            continue;
+        }
+        
+        pthread_mutex_lock(&logger->mutex);
+        if (logger->stopping) {
+            pthread_mutex_unlock(&logger->mutex);
+            LogSlot* next = &logger->slots[logger->dequeue_pos & logger->mask];
+            if (atomic_load_explicit(&next->sequence, memory_order_acquire) == logger->dequeue_pos + 1) {
+                continue;
+            }
+            break;
+        }
+        
+        // Producers check writer_sleeping after publishing, so either they see it or we see their line
+        atomic_store(&logger->writer_sleeping, 1);
+        LogSlot* next = &logger->slots[logger->dequeue_pos & logger->mask];
+        if (atomic_load(&next->sequence) != logger->dequeue_pos + 1 &&
+            atomic_load(&logger->flush_target) <= logger->flushed_pos) {
+            uint64_t wait_ms = (uint64_t)logger->options.flush_interval_ms;
+            if (unflushed > 0) {
+                uint64_t elapsed = monotonic_ms() - last_flush;
+                wait_ms = elapsed < wait_ms ? wait_ms - elapsed : 0;
+            }
+            struct timespec deadline;
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_sec += (time_t)(wait_ms / 1000);
+            deadline.tv_nsec += (long)(wait_ms % 1000) * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&logger->wake, &logger->mutex, &deadline);
+        }
+        atomic_store(&logger->writer_sleeping, 0);
+        pthread_mutex_unlock(&logger->mutex);
+    }
+    
+    fflush(log_file);
+    pthread_mutex_lock(&logger->mutex);
+    logger->flushed_pos = logger->dequeue_pos;
+    pthread_cond_broadcast(&logger->flushed);
+    pthread_mutex_unlock(&logger->mutex);
+    return NULL;
+}
+
+static void wake_writer(AsyncLogger* logger) {
+    pthread_mutex_lock(&logger->mutex);
+    pthread_cond_signal(&logger->wake);
+    pthread_mutex_unlock(&logger->mutex);
+}
+
+int logger_start_async(const LoggerAsyncOptions* options) {
+    AsyncLogger* logger = &async_logger;
+    if (atomic_load(&async_active)) {
+        return 0;
+    }
+    
+    pthread_mutex_lock(&log_mutex);
+    if (!log_file) {
+        log_file = stdout;
+    }
+    pthread_mutex_unlock(&log_mutex);
+    
+    size_t lines = 64;
+    while (lines < options->ring_lines) {
+        lines <<= 1;
+    }
+    
+    memset(logger, 0, sizeof(*logger));
+    logger->slots = aligned_alloc(64, lines * sizeof(LogSlot));
+    if (!logger->slots) {
+        return -1;
+    }
+    for (size_t i = 0; i < lines; i++) {
+        atomic_init(&logger->slots[i].sequence, i);
+    }
+    logger->mask = lines - 1;
+    logger->options = *options;
+    if (logger->options.flush_interval_ms <= 0) {
+        logger->options.flush_interval_ms = 1;
+    }
+    
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&logger->mutex, NULL);
+    pthread_cond_init(&logger->wake, &attr);
+    pthread_cond_init(&logger->flushed, NULL);
+    pthread_condattr_destroy(&attr);
+    
+    // Only the writer touches log_file from now on; let stdio batch the writes
+    if (log_file != stdout) {
+        setvbuf(log_file, NULL, _IOFBF, LOG_WRITE_BUFFER);
+    }
+    
+    if (pthread_create(&logger->thread, NULL, writer_thread, logger) != 0) {
+        pthread_cond_destroy(&logger->wake);
+        pthread_cond_destroy(&logger->flushed);
+        pthread_mutex_destroy(&logger->mutex);
+        free(logger->slots);
+        logger->slots = NULL;
+        return -1;
+    }
+    
+    atomic_store_explicit(&async_active, 1, memory_order_release);
+    return 0;
+}
+
+/**
+ * @brief Format a line into the ring without blocking
+ */
+static void async_log(AsyncLogger* logger, LogLevel level, const char* format, va_list args) {
+    size_t pos = atomic_load_explicit(&logger->enqueue_pos, memory_order_relaxed);
+    LogSlot* slot;
+    for (;;) {
+        slot = &logger->slots[pos & logger->mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&logger->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&logger->dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&logger->enqueue_pos, memory_order_relaxed);
+        }
+    }
+    
+    size_t cap = sizeof(slot->text);
+    int prefix = snprintf(slot->text, cap, "[%s] [%s] ", timestamp_now(), level_to_string(level));
+    size_t length = (size_t)prefix;
+    int body = vsnprintf(slot->text + length, cap - length, format, args);
+    if (body > 0) {
+        length += (size_t)body;
+    }
+    if (length > LOGGER_ASYNC_LINE_MAX - 1) {
+        // Truncated: keep the line terminated and marked
+        length = LOGGER_ASYNC_LINE_MAX - 1;
+        memcpy(slot->text + length - 3, "...", 3);
+    }
+    slot->text[length++] = '\n';
+    slot->length = (uint16_t)length;
+    slot->level = (uint8_t)level;
+    
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+    
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&logger->writer_sleeping, memory_order_relaxed)) {
+        // The ring was empty when the writer went to sleep: wake it for urgent
+        // lines and at every half-ring boundary so a burst never fills the ring
+        if (level >= logger->options.flush_level || (pos & (logger->mask >> 1)) == 0) {
+            wake_writer(logger);
+        }
+    }
+}
+
+void logger_flush(void) {
+    if (!atomic_load_explicit(&async_active, memory_order_acquire)) {
+        pthread_mutex_lock(&log_mutex);
+        if (log_file) {
+            fflush(log_file);
+        }
+        pthread_mutex_unlock(&log_mutex);
+        return;
+    }
+    
+    AsyncLogger* logger = &async_logger;
+    size_t target = atomic_load(&logger->enqueue_pos);
+    pthread_mutex_lock(&logger->mutex);
+    if (atomic_load(&logger->flush_target) < target) {
+        atomic_store(&logger->flush_target, target);
+    }
+    pthread_cond_signal(&logger->wake);
+    while (logger->flushed_pos < target && !logger->stopping) {
+        pthread_cond_wait(&logger->flushed, &logger->mutex);
+    }
+    pthread_mutex_unlock(&logger->mutex);
+}
+
+size_t logger_dropped_lines(void) {
+    return atomic_load_explicit(&async_logger.dropped, memory_order_relaxed);
+}
+
+/**
+ * @brief Drain and join the background writer; logging is synchronous afterwards
+ */
+static void stop_async(void) {
+    AsyncLogger* logger = &async_logger;
+    if (!atomic_load(&async_active)) {
+        return;
+    }
+    
+    pthread_mutex_lock(&logger->mutex);
+    logger->stopping = 1;
+    pthread_cond_signal(&logger->wake);
+    pthread_mutex_unlock(&logger->mutex);
+    pthread_join(logger->thread, NULL);
+    
+    atomic_store(&async_active, 0);
+    pthread_cond_destroy(&logger->wake);
+    pthread_cond_destroy(&logger->flushed);
+    pthread_mutex_destroy(&logger->mutex);
+    free(logger->slots);
+    logger->slots = NULL;
+}
+
 void logger_cleanup(void) {
+    stop_async();
+    
     pthread_mutex_lock(&log_mutex);
     
     if (log_file && log_file != stdout) {
@@ -49,30 +413,21 @@ void logger_set_level(LogLevel level) {
     pthread_mutex_unlock(&log_mutex);
 }
 
-static const char* level_to_string(LogLevel level) {
-    switch (level) {
-        case LOG_LEVEL_INFO: return "INFO";
-        case LOG_LEVEL_WARN: return "WARN";
-        case LOG_LEVEL_ERROR: return "ERROR";
-        default: return "UNKNOWN";
-    }
-}
-
 void vlogger_log(LogLevel level, const char* format, va_list args) {
     if (level < log_level) return;
     
+    if (atomic_load_explicit(&async_active, memory_order_acquire)) {
+        async_log(&async_logger, level, format, args);
+        return;
+    }
+    
     pthread_mutex_lock(&log_mutex);
     
     if (!log_file) {
         log_file = stdout;
     }
     
-    time_t now = time(NULL);
-    struct tm* tm_info = localtime(&now);
-    char time_str[64];
-    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
-    
-    fprintf(log_file, "[%s] [%s] ", time_str, level_to_string(level));
+    fprintf(log_file, "[%s] [%s] ", timestamp_now(), level_to_string(level));
     vfprintf(log_file, format, args);
     fprintf(log_file, "\n");
     fflush(log_file);
@@ -107,4 +462,3 @@ void logger_error(const char* format, ...) {
     vlogger_log(LOG_LEVEL_ERROR, format, args);
     va_end(args);
 }
-
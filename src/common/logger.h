@@ -4,6 +4,12 @@
  * 
  * Provides logging functionality with different log levels
  * and thread-safe output to files.
+ *
+ * By default each line is written and flushed under a mutex by the calling
+ * thread. After logger_start_async() callers only format the line into a
+ * slot of a lock-free ring and a background thread writes the lines in
+ * batches; when the ring is full, lines are dropped and counted instead of
+ * blocking the caller.
  */
 
 #ifndef LOGGER_H
@@ -11,6 +17,7 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <stddef.h>
 
 /**
  * @brief Log level enumeration
@@ -21,6 +28,19 @@ typedef enum {
     LOG_LEVEL_ERROR
 } LogLevel;
 
+#define LOGGER_ASYNC_DEFAULT_LINES 8192
+#define LOGGER_ASYNC_DEFAULT_FLUSH_MS 100
+#define LOGGER_ASYNC_LINE_MAX 496   ///< Longest line in async mode, timestamp and newline included
+
+/**
+ * @brief Background writer settings
+ */
+typedef struct {
+    size_t ring_lines;          ///< Lines buffered between callers and the writer (rounded up to a power of two)
+    int flush_interval_ms;      ///< Longest time a written line stays in the stdio buffer
+    LogLevel flush_level;       ///< Lines at or above this level are written and flushed immediately
+} LoggerAsyncOptions;
+
 /**
  * @brief Initialize logger with output file
  * @param output_file File to write logs to (NULL for stdout)
@@ -28,8 +48,41 @@ typedef enum {
  */
 int logger_init(const char* output_file);
 
+/**
+ * @brief Initialize logger, appending to output_file instead of truncating it
+ *
+ * For processes that share one log, like a server and the successor it
+ * hands its sockets to.
+ * @return 0 on success, -1 on error
+ */
+int logger_init_append(const char* output_file);
+
+/**
+ * @brief Fill in the default async settings
+ */
+void logger_async_options_init(LoggerAsyncOptions* options);
+
+/**
+ * @brief Move writing to a background thread (call after logger_init)
+ * @return 0 on success, -1 on error (logging stays synchronous)
+ */
+int logger_start_async(const LoggerAsyncOptions* options);
+
+/**
+ * @brief Wait until every line logged so far has reached the output file
+ */
+void logger_flush(void);
+
+/**
+ * @brief Lines dropped because the async ring was full
+ */
+size_t logger_dropped_lines(void);
+
 /**
  * @brief Cleanup logger
+ *
+ * Stops the background writer after draining it, so no other thread may
+ * still be logging.
  */
 void logger_cleanup(void);
 
@@ -6,103 +6,402 @@
 #include "net_common.h"
 #include "error.h"
 #include "logger.h"
+#include "buffer_pool.h"
+#include "utils.h"
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <poll.h>
+#include <errno.h>
 #include <unistd.h>
 #include <string.h>
 #include <stdlib.h>
 
-int send_message(int fd, void* ssl, int is_ssl, const Message* msg) {
-    // Serialize header
-    MessageHeader header = msg->header;
-    message_header_serialize(&header);
+#define IO_WAIT_TIMEOUT_MS 5000
+#define TLS_MAX_RECORD_SIZE 16384   // Maximum TLS plaintext record
+#define SENDFILE_MAX_CHUNK (1u << 30)  // Bytes per sendfile call
+
+/**
+ * @brief Wait until fd is ready (used when a non-blocking socket returns EAGAIN)
+ */
+static int wait_fd(int fd, short events) {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+    int result;
+    do {
+        result = poll(&pfd, 1, IO_WAIT_TIMEOUT_MS);
+    } while (result < 0 && errno == EINTR);
+    return result > 0 ? 0 : -1;
+}
+
+/**
+ * @brief Write the whole buffer over TLS, retrying would-block writes
+ */
+static int ssl_write_all(int fd, SSL* ssl, const void* buf, size_t len) {
+    const uint8_t* p = (const uint8_t*)buf;
+    while (len > 0) {
+        int n = SSL_write(ssl, p, (int)(len > 0x7fffffff ? 0x7fffffff : len));
+        if (n <= 0) {
+            // SSL_write must be retried with the same arguments
+            int err = SSL_get_error(ssl, n);
+            if (err == SSL_ERROR_WANT_WRITE && wait_fd(fd, POLLOUT) == 0) continue;
+            if (err == SSL_ERROR_WANT_READ && wait_fd(fd, POLLIN) == 0) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Write an iovec list with sendmsg, continuing after partial writes
+ * @note The iovec array is modified in place
+ */
+static int sendmsg_all(int fd, struct iovec* iov, int iovcnt) {
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
     
-    // Send header
-    ssize_t sent = 0;
-    if (is_ssl && ssl) {
-        sent = SSL_write((SSL*)ssl, &header, sizeof(header));
-    } else {
-        sent = send(fd, &header, sizeof(header), 0);
+    while (iovcnt > 0) {
+        mh.msg_iov = iov;
+        mh.msg_iovlen = (size_t)iovcnt;
+        ssize_t sent = sendmsg(fd, &mh, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && wait_fd(fd, POLLOUT) == 0) continue;
+            return -1;
+        }
+        
+        // Skip fully written entries, trim the partially written one
+        while (iovcnt > 0 && (size_t)sent >= iov->iov_len) {
+            sent -= (ssize_t)iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (uint8_t*)iov->iov_base + sent;
+            iov->iov_len -= (size_t)sent;
+        }
     }
+    return 0;
+}
+
+/**
+ * @brief Read exactly len bytes; short reads (e.g. one TLS record) are continued
+ * @return 0 on success, -1 on error, timeout or peer close
+ */
+static int read_full(int fd, SSL* ssl, void* buf, size_t len) {
+    uint8_t* p = (uint8_t*)buf;
+    while (len > 0) {
+        ssize_t received;
+        if (ssl) {
+            int n = SSL_read(ssl, p, (int)(len > 0x7fffffff ? 0x7fffffff : len));
+            if (n <= 0) {
+                int err = SSL_get_error(ssl, n);
+                if (err == SSL_ERROR_WANT_READ && wait_fd(fd, POLLIN) == 0) continue;
+                if (err == SSL_ERROR_WANT_WRITE && wait_fd(fd, POLLOUT) == 0) continue;
+                return -1;
+            }
+            received = n;
+        } else {
+            received = recv(fd, p, len, MSG_WAITALL);
+            if (received < 0 && errno == EINTR) continue;
+            if (received <= 0) {
+                return -1; // Error, timeout or connection closed
+            }
+        }
+        p += received;
+        len -= (size_t)received;
+    }
+    return 0;
+}
+
+/**
+ * @brief Write header and payload segments over TLS
+ * 
+ * Small pieces are coalesced into full records; a segment that starts on
+ * a record boundary and spans at least one record is written in place.
+ */
+static int ssl_write_segments(int fd, SSL* tls, const uint8_t* head, size_t head_size,
+                              const struct iovec* parts, size_t count) {
+    uint8_t record[TLS_MAX_RECORD_SIZE];
+    size_t used = head_size;
+    memcpy(record, head, head_size);
     
-    if (sent != sizeof(header)) {
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* p = (const uint8_t*)parts[i].iov_base;
+        size_t len = parts[i].iov_len;
+        while (len > 0) {
+            if (used == 0 && len >= sizeof(record)) {
+                // Large remainder: written straight from the caller's memory
+                if (ssl_write_all(fd, tls, p, len) < 0) {
+                    return -1;
+                }
+                break;
+            }
+            size_t n = sizeof(record) - used;
+            if (n > len) {
+                n = len;
+            }
+            memcpy(record + used, p, n);
+            used += n;
+            p += n;
+            len -= n;
+            if (used == sizeof(record)) {
+                if (ssl_write_all(fd, tls, record, used) < 0) {
+                    return -1;
+                }
+                used = 0;
+            }
+        }
+    }
+    
+    if (used > 0 && ssl_write_all(fd, tls, record, used) < 0) {
         return -1;
     }
+    return 0;
+}
+
+int send_message(int fd, void* ssl, int is_ssl, const Message* msg) {
+    SSL* tls = (is_ssl && ssl) ? (SSL*)ssl : NULL;
+    
+    // Serialize header and extensions
+    uint8_t head[MESSAGE_HEAD_MAX_SIZE];
+    size_t head_size = message_encode_head(msg, head);
+    
+    // Payload as a list of segments: either the scatter list or the single buffer
+    struct iovec single;
+    const struct iovec* parts = &single;
+    size_t count = 0;
+    if (msg->iov) {
+        if (msg->iovcnt > MESSAGE_MAX_IOV) {
+            logger_error("Too many payload segments (%zu, max %d)", msg->iovcnt, MESSAGE_MAX_IOV);
+            return -1;
+        }
+        parts = msg->iov;
+        count = msg->iovcnt;
+    } else if (msg->header.length > 0 && msg->payload) {
+        single.iov_base = msg->payload;
+        single.iov_len = msg->payload_size;
+        count = 1;
+    }
     
-    // Send payload
-    if (msg->header.length > 0 && msg->payload) {
-        if (is_ssl && ssl) {
-            sent = SSL_write((SSL*)ssl, msg->payload, msg->payload_size);
-        } else {
-            sent = send(fd, msg->payload, msg->payload_size, 0);
+    // With kTLS the kernel frames records itself, so plain sendmsg is used
+    if (tls && !tls_ktls_send(tls)) {
+        return ssl_write_segments(fd, tls, head, head_size, parts, count);
+    }
+    
+    // Header and payload leave in a single syscall
+    struct iovec iov[1 + MESSAGE_MAX_IOV];
+    iov[0].iov_base = head;
+    iov[0].iov_len = head_size;
+    int iovcnt = 1;
+    for (size_t i = 0; i < count; i++) {
+        if (parts[i].iov_len > 0) {
+            iov[iovcnt++] = parts[i];
         }
-        
-        if (sent != (ssize_t)msg->payload_size) {
+    }
+    return sendmsg_all(fd, iov, iovcnt);
+}
+
+ssize_t send_nonblocking(int fd, void* ssl, int is_ssl, const struct iovec* iov, int iovcnt) {
+    SSL* tls = (is_ssl && ssl) ? (SSL*)ssl : NULL;
+    while (iovcnt > 0 && iov->iov_len == 0) {
+        iov++;
+        iovcnt--;
+    }
+    if (iovcnt == 0) {
+        return 0;
+    }
+    
+    if (tls && !tls_ktls_send(tls)) {
+        // A short first segment (a frame header) shares its record with what follows
+        uint8_t record[TLS_MAX_RECORD_SIZE];
+        const void* data = iov->iov_base;
+        size_t len = iov->iov_len;
+        if (iovcnt > 1 && len < sizeof(record)) {
+            len = 0;
+            for (int i = 0; i < iovcnt && len < sizeof(record); i++) {
+                size_t n = iov[i].iov_len < sizeof(record) - len ? iov[i].iov_len : sizeof(record) - len;
+                memcpy(record + len, iov[i].iov_base, n);
+                len += n;
+            }
+            data = record;
+        }
+        if (len > 0x7fffffff) {
+            len = 0x7fffffff;
+        }
+        int n = SSL_write(tls, data, (int)len);
+        if (n <= 0) {
+            int err = SSL_get_error(tls, n);
+            return (err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ) ? 0 : -1;
+        }
+        return n;
+    }
+    
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = (struct iovec*)iov;
+    mh.msg_iovlen = (size_t)iovcnt;
+    for (;;) {
+        ssize_t sent = sendmsg(fd, &mh, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent >= 0) {
+            return sent;
+        }
+        if (errno == EINTR) continue;
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    }
+}
+
+int send_message_file(int fd, const Message* msg, int file_fd, off_t offset) {
+    uint8_t head[MESSAGE_HEAD_MAX_SIZE];
+    size_t head_size = message_encode_head(msg, head);
+    
+    // MSG_MORE holds the header back so it leaves in the same segment as the payload
+    size_t head_sent = 0;
+    while (head_sent < head_size) {
+        ssize_t sent = send(fd, head + head_sent, head_size - head_sent,
+                            MSG_NOSIGNAL | (msg->header.length > 0 ? MSG_MORE : 0));
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && wait_fd(fd, POLLOUT) == 0) continue;
             return -1;
         }
+        head_sent += (size_t)sent;
     }
     
+    uint64_t remaining = msg->header.length;
+    while (remaining > 0) {
+        size_t count = remaining > SENDFILE_MAX_CHUNK ? SENDFILE_MAX_CHUNK : (size_t)remaining;
+        ssize_t sent = sendfile(fd, file_fd, &offset, count);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && wait_fd(fd, POLLOUT) == 0) continue;
+            logger_error("sendfile failed: %s", get_error_string(errno));
+            return -1;
+        }
+        if (sent == 0) {
+            // The peer already counts on the announced length; the stream cannot continue
+            logger_error("File ended %llu bytes before the frame did", (unsigned long long)remaining);
+            return -1;
+        }
+        remaining -= (uint64_t)sent;
+    }
     return 0;
 }
 
 int receive_message(int fd, void* ssl, int is_ssl, Message* msg) {
+    SSL* tls = (is_ssl && ssl) ? (SSL*)ssl : NULL;
     MessageHeader header;
     
     // Receive header
-    ssize_t received = 0;
-    if (is_ssl && ssl) {
-        received = SSL_read((SSL*)ssl, &header, sizeof(header));
-    } else {
-        received = recv(fd, &header, sizeof(header), MSG_WAITALL);
-    }
-    
-    if (received != sizeof(header)) {
-        if (received == 0) {
-            return -1; // Connection closed
-        }
+    if (read_full(fd, tls, &header, sizeof(header)) < 0) {
         return -1;
     }
     
     message_header_deserialize(&header);
     
     // Initialize message
+    memset(msg, 0, sizeof(Message));
     msg->header = header;
-    msg->payload = NULL;
-    msg->payload_size = 0;
+    
+    // Receive header extensions
+    size_t ext_size = message_extension_size(header.flags);
+    if (ext_size > 0) {
+        uint8_t ext[MSG_EXT_MAX_SIZE];
+        if (read_full(fd, tls, ext, ext_size) < 0) {
+            return -1;
+        }
+        message_decode_extensions(msg, ext);
+    }
+    
+    // Never trust the announced length with an allocation of that size
+    if (header.length > MSG_DEFAULT_MAX_FRAME_SIZE ||
+        ((header.flags & MSG_FLAGS_COMPRESSED) && msg->raw_length > MSG_DEFAULT_MAX_FRAME_SIZE)) {
+        logger_error("Refusing frame of %llu bytes (limit %llu)", (unsigned long long)header.length,
+                     (unsigned long long)MSG_DEFAULT_MAX_FRAME_SIZE);
+        return -1;
+    }
+    
+    // Compressed payload: read into scratch memory, decode into the message
+    if (header.flags & MSG_FLAGS_COMPRESSED) {
+        if (header.length == 0 || header.length > SIZE_MAX / MSG_MAX_COMPRESSION_RATIO) {
+            return -1;
+        }
+        uint8_t* wire = (uint8_t*)buffer_pool_alloc(header.length);
+        if (!wire) {
+            return -1;
+        }
+        int result = read_full(fd, tls, wire, header.length);
+        if (result == 0 && message_verify(msg, NULL, wire, 0) != 0) {
+            logger_error("Payload checksum mismatch (type %u, %llu bytes)", header.type,
+                         (unsigned long long)header.length);
+            result = -1;
+        }
+        if (result == 0) {
+            result = message_decompress(msg, wire, NULL);
+        }
+        buffer_pool_free(wire);
+        return result;
+    }
     
     // Receive payload
     if (header.length > 0) {
-        msg->payload = (uint8_t*)malloc(header.length);
+        msg->payload = (uint8_t*)buffer_pool_alloc(header.length);
         if (!msg->payload) {
             return -1;
         }
         msg->payload_size = header.length;
         
-        if (is_ssl && ssl) {
-            received = SSL_read((SSL*)ssl, msg->payload, header.length);
-        } else {
-            received = recv(fd, msg->payload, header.length, MSG_WAITALL);
-        }
-        
-        if (received != (ssize_t)header.length) {
-            free(msg->payload);
+        if (read_full(fd, tls, msg->payload, header.length) < 0) {
+            buffer_pool_free(msg->payload);
             msg->payload = NULL;
             msg->payload_size = 0;
             return -1;
         }
     }
     
+    if (message_verify(msg, NULL, msg->payload, 0) != 0) {
+        logger_error("Payload checksum mismatch (type %u, %llu bytes)", header.type,
+                     (unsigned long long)header.length);
+        message_free(msg);
+        return -1;
+    }
     return 0;
 }
 
 void close_tls_connection(void* ssl) {
     if (ssl) {
-        SSL_shutdown((SSL*)ssl);
+        // close_notify only makes sense on an established session
+        if (SSL_is_init_finished((SSL*)ssl)) {
+            SSL_shutdown((SSL*)ssl);
+        }
         SSL_free((SSL*)ssl);
     }
 }
 
+int tls_session_reused(void* ssl) {
+    return ssl ? SSL_session_reused((SSL*)ssl) : 0;
+}
+
+void tls_enable_ktls(void* ssl_ctx) {
+    if (ssl_ctx) {
+        SSL_CTX_set_options((SSL_CTX*)ssl_ctx, SSL_OP_ENABLE_KTLS);
+    }
+}
+
+int tls_ktls_send(void* ssl) {
+    return ssl ? BIO_get_ktls_send(SSL_get_wbio((SSL*)ssl)) : 0;
+}
+
+int tls_ktls_recv(void* ssl) {
+    return ssl ? BIO_get_ktls_recv(SSL_get_rbio((SSL*)ssl)) : 0;
+}
+
 void cleanup_tls(void* ssl_ctx) {
     if (ssl_ctx) {
         SSL_CTX_free((SSL_CTX*)ssl_ctx);
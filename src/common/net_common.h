@@ -7,6 +7,7 @@
 #define NET_COMMON_H
 
 #include "protocol.h"
+#include <sys/types.h>
 
 /**
  * @brief Send message (with TLS support)
@@ -18,8 +19,43 @@
  */
 int send_message(int fd, void* ssl, int is_ssl, const Message* msg);
 
+/**
+ * @brief Write as much of the segments as the socket takes without blocking
+ *
+ * Over userspace TLS this is one SSL_write: a first segment shorter than a
+ * record is gathered with the following ones into a single record, a
+ * longer one is written on its own. After a would-block result the same
+ * segments must be passed again; the connection needs
+ * SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER, as the gathered copy may move.
+ * @param fd Non-blocking socket file descriptor
+ * @param ssl SSL context (NULL if not using TLS)
+ * @param is_ssl Whether TLS is enabled
+ * @param iov Segments to write
+ * @param iovcnt Number of segments
+ * @return Bytes written, 0 if the socket would block, -1 on error
+ */
+ssize_t send_nonblocking(int fd, void* ssl, int is_ssl, const struct iovec* iov, int iovcnt);
+
+/**
+ * @brief Send a frame whose payload the kernel copies from a file (sendfile)
+ *
+ * Only for sockets whose bytes the kernel writes as they are: plaintext,
+ * or TLS with kTLS send offload. The payload is the next
+ * msg->header.length bytes of file_fd from offset; msg->payload is ignored.
+ * @param fd Socket file descriptor
+ * @param msg Header and extensions of the frame
+ * @param file_fd File to read the payload from (its file position is not used)
+ * @param offset File offset of the first payload byte
+ * @return 0 on success, -1 on error or if the file is shorter than the frame
+ */
+int send_message_file(int fd, const Message* msg, int file_fd, off_t offset);
+
 /**
  * @brief Receive message (with TLS support)
+ *
+ * Frames larger than MSG_DEFAULT_MAX_FRAME_SIZE are refused before their
+ * payload is read, and frames whose MSG_FLAGS_CHECKSUM does not match
+ * after it was read.
  * @param fd Socket file descriptor
  * @param ssl SSL context (NULL if not using TLS)
  * @param is_ssl Whether TLS is enabled
@@ -33,6 +69,30 @@ int receive_message(int fd, void* ssl, int is_ssl, Message* msg);
  */
 void close_tls_connection(void* ssl);
 
+/**
+ * @brief Whether the handshake resumed an earlier session (abbreviated handshake)
+ */
+int tls_session_reused(void* ssl);
+
+/**
+ * @brief Let OpenSSL hand the record layer to the kernel (kTLS) after handshakes
+ * 
+ * Must be called before connections are created. Whether kTLS actually
+ * engages depends on the kernel (tls module), the OpenSSL build and the
+ * negotiated cipher; check each connection with tls_ktls_send/tls_ktls_recv.
+ */
+void tls_enable_ktls(void* ssl_ctx);
+
+/**
+ * @brief Whether the kernel encrypts outgoing records for this connection
+ */
+int tls_ktls_send(void* ssl);
+
+/**
+ * @brief Whether the kernel decrypts incoming records for this connection
+ */
+int tls_ktls_recv(void* ssl);
+
 /**
  * @brief Cleanup TLS context
  */
@@ -4,68 +4,399 @@
  */
 
 #include "protocol.h"
+#include "buffer_pool.h"
+#include "utils.h"
 #include <stdlib.h>
 #include <string.h>
 
-Message message_create_text(const char* text, size_t text_len) {
+/**
+ * @brief Empty message of the given type
+ */
+static Message message_init(uint32_t type) {
     Message msg;
-    msg.header.type = MSG_TYPE_TEXT;
-    msg.header.length = text_len;
+    memset(&msg, 0, sizeof(msg));
+    msg.header.type = type;
     msg.header.flags = MSG_FLAGS_NONE;
+    return msg;
+}
+
+/**
+ * @brief Message with a pooled copy of data
+ */
+static Message message_create_copy(uint32_t type, const void* data, size_t len) {
+    Message msg = message_init(type);
+    msg.header.length = len;
     
-    if (text_len > 0) {
-        msg.payload = (uint8_t*)malloc(text_len);
+    if (len > 0) {
+        msg.payload = (uint8_t*)buffer_pool_alloc(len);
         if (!msg.payload) {
-            msg.payload_size = 0;
             return msg;
         }
-        memcpy(msg.payload, text, text_len);
-        msg.payload_size = text_len;
-    } else {
-        msg.payload = NULL;
-        msg.payload_size = 0;
+        memcpy(msg.payload, data, len);
+        msg.payload_size = len;
     }
     
     return msg;
 }
 
-Message message_create_ack(void) {
-    Message msg;
-    msg.header.type = MSG_TYPE_ACK;
-    msg.header.length = 0;
-    msg.header.flags = MSG_FLAGS_NONE;
-    msg.payload = NULL;
-    msg.payload_size = 0;
+Message message_create_text(const char* text, size_t text_len) {
+    return message_create_copy(MSG_TYPE_TEXT, text, text_len);
+}
+
+Message message_create_text_borrowed(const void* text, size_t text_len) {
+    Message msg = message_init(MSG_TYPE_TEXT);
+    msg.header.length = text_len;
+    msg.payload = text_len > 0 ? (uint8_t*)text : NULL;
+    msg.payload_size = text_len;
+    msg.borrowed = 1;
+    return msg;
+}
+
+Message message_create_chunk(const void* data, size_t len, int final) {
+    Message msg = message_create_text_borrowed(data, len);
+    msg.header.type = MSG_TYPE_CHUNK;
+    if (final) {
+        msg.header.flags |= MSG_FLAGS_FINAL;
+    }
     return msg;
 }
 
+Message message_create_text_iov(const struct iovec* iov, size_t iovcnt) {
+    Message msg = message_init(MSG_TYPE_TEXT);
+    size_t total = 0;
+    for (size_t i = 0; i < iovcnt; i++) {
+        total += iov[i].iov_len;
+    }
+    msg.header.length = total;
+    msg.payload_size = total;
+    msg.iov = iov;
+    msg.iovcnt = iovcnt;
+    msg.borrowed = 1;
+    return msg;
+}
+
+Message message_create_ack(void) {
+    return message_init(MSG_TYPE_ACK);
+}
+
 Message message_create_error(const char* error, size_t error_len) {
-    Message msg;
-    msg.header.type = MSG_TYPE_ERROR;
-    msg.header.length = error_len;
-    msg.header.flags = MSG_FLAGS_NONE;
+    return message_create_copy(MSG_TYPE_ERROR, error, error_len);
+}
+
+Message message_create_ack_batch(uint64_t sequence) {
+    Message msg = message_create_ack();
+    msg.header.type = MSG_TYPE_ACK_BATCH;
+    message_set_sequence(&msg, sequence);
+    return msg;
+}
+
+Message message_create_hello(uint32_t features) {
+    uint32_t wire = htonl(features);
+    return message_create_copy(MSG_TYPE_HELLO, &wire, sizeof(wire));
+}
+
+Message message_create_stats(const char* text, size_t text_len) {
+    return message_create_copy(MSG_TYPE_STATS, text, text_len);
+}
+
+int message_parse_hello(const Message* msg, uint32_t* features) {
+    if (msg->header.type != MSG_TYPE_HELLO || !msg->payload || msg->payload_size < sizeof(uint32_t)) {
+        return -1;
+    }
+    uint32_t wire;
+    memcpy(&wire, msg->payload, sizeof(wire));
+    *features = ntohl(wire);
+    return 0;
+}
+
+Message message_create_subscription(uint32_t type, const char* topic, size_t topic_len) {
+    return message_create_copy(type, topic, topic_len);
+}
+
+Message message_create_publish(const char* topic, size_t topic_len, const void* data, size_t len) {
+    Message msg = message_init(MSG_TYPE_PUBLISH);
+    msg.header.length = 1 + topic_len + len;
+    msg.payload = (uint8_t*)buffer_pool_alloc((size_t)msg.header.length);
+    if (!msg.payload) {
+        return msg;
+    }
+    msg.payload[0] = (uint8_t)topic_len;
+    memcpy(msg.payload + 1, topic, topic_len);
+    if (len > 0) {
+        memcpy(msg.payload + 1 + topic_len, data, len);
+    }
+    msg.payload_size = (size_t)msg.header.length;
+    return msg;
+}
+
+int message_parse_publish(const Message* msg, const char** topic, size_t* topic_len,
+                          const uint8_t** data, size_t* len) {
+    if (msg->header.type != MSG_TYPE_PUBLISH || !msg->payload || msg->payload_size < 1) {
+        return -1;
+    }
+    size_t name_len = msg->payload[0];
+    if (name_len == 0 || 1 + name_len > msg->payload_size) {
+        return -1;
+    }
+    *topic = (const char*)msg->payload + 1;
+    *topic_len = name_len;
+    *data = msg->payload + 1 + name_len;
+    *len = msg->payload_size - 1 - name_len;
+    return 0;
+}
+
+size_t message_encode_head(const Message* msg, uint8_t* out) {
+    MessageHeader header = msg->header;
+    message_header_serialize(&header);
+    memcpy(out, &header, sizeof(header));
+    size_t offset = sizeof(header);
     
-    if (error_len > 0) {
-        msg.payload = (uint8_t*)malloc(error_len);
-        if (!msg.payload) {
-            msg.payload_size = 0;
-            return msg;
+    if (msg->header.flags & MSG_FLAGS_COMPRESSED) {
+        uint64_t raw_length = htobe64(msg->raw_length);
+        memcpy(out + offset, &raw_length, sizeof(raw_length));
+        offset += sizeof(raw_length);
+    }
+    
+    if (msg->header.flags & MSG_FLAGS_SEQUENCED) {
+        uint64_t sequence = htobe64(msg->sequence);
+        memcpy(out + offset, &sequence, sizeof(sequence));
+        offset += sizeof(sequence);
+    }
+    
+    if (msg->header.flags & MSG_FLAGS_TIMESTAMPED) {
+        uint64_t timestamp = htobe64(msg->timestamp_ns);
+        memcpy(out + offset, &timestamp, sizeof(timestamp));
+        offset += sizeof(timestamp);
+    }
+    
+    if (msg->header.flags & MSG_FLAGS_CHECKSUM) {
+        uint32_t checksum = htonl(msg->checksum);
+        memcpy(out + offset, &checksum, sizeof(checksum));
+        offset += sizeof(checksum);
+    }
+    
+    return offset;
+}
+
+void message_decode_extensions(Message* msg, const uint8_t* ext) {
+    size_t offset = 0;
+    msg->sequence = 0;
+    msg->raw_length = 0;
+    msg->timestamp_ns = 0;
+    msg->checksum = 0;
+    
+    if (msg->header.flags & MSG_FLAGS_COMPRESSED) {
+        uint64_t raw_length;
+        memcpy(&raw_length, ext + offset, sizeof(raw_length));
+        msg->raw_length = be64toh(raw_length);
+        offset += sizeof(raw_length);
+    }
+    
+    if (msg->header.flags & MSG_FLAGS_SEQUENCED) {
+        uint64_t sequence;
+        memcpy(&sequence, ext + offset, sizeof(sequence));
+        msg->sequence = be64toh(sequence);
+        offset += sizeof(sequence);
+    }
+    
+    if (msg->header.flags & MSG_FLAGS_TIMESTAMPED) {
+        uint64_t timestamp;
+        memcpy(&timestamp, ext + offset, sizeof(timestamp));
+        msg->timestamp_ns = be64toh(timestamp);
+        offset += sizeof(timestamp);
+    }
+    
+    if (msg->header.flags & MSG_FLAGS_CHECKSUM) {
+        uint32_t checksum;
+        memcpy(&checksum, ext + offset, sizeof(checksum));
+        msg->checksum = ntohl(checksum);
+        offset += sizeof(checksum);
+    }
+}
+
+void message_set_checksum(Message* msg) {
+    uint32_t crc = 0;
+    if (msg->iov) {
+        for (size_t i = 0; i < msg->iovcnt; i++) {
+            crc = crc32c(crc, msg->iov[i].iov_base, msg->iov[i].iov_len);
+        }
+    } else if (msg->payload) {
+        crc = crc32c(crc, msg->payload, msg->payload_size);
+    }
+    msg->checksum = crc;
+    msg->header.flags |= MSG_FLAGS_CHECKSUM;
+}
+
+unsigned message_verify(const Message* msg, void* dst, const uint8_t* wire, unsigned validate) {
+    unsigned checks = 0;
+    if (msg->header.flags & MSG_FLAGS_CHECKSUM) {
+        checks |= INTEGRITY_CRC32C;
+    }
+    if ((validate & INTEGRITY_UTF8) && msg->header.type == MSG_TYPE_TEXT &&
+        !(msg->header.flags & MSG_FLAGS_COMPRESSED)) {
+        checks |= INTEGRITY_UTF8;
+    }
+    
+    size_t length = (size_t)msg->header.length;
+    uint32_t crc = 0;
+    if (checks == 0) {
+        if (dst && length > 0) {
+            memcpy(dst, wire, length);
         }
-        memcpy(msg.payload, error, error_len);
-        msg.payload_size = error_len;
-    } else {
-        msg.payload = NULL;
-        msg.payload_size = 0;
+        return 0;
+    }
+    if (integrity_scan(dst, wire, length, checks, &crc) < 0) {
+        return INTEGRITY_UTF8;
+    }
+    if ((checks & INTEGRITY_CRC32C) && crc != msg->checksum) {
+        return INTEGRITY_CRC32C;
+    }
+    return 0;
+}
+
+int message_compress(Message* msg, size_t threshold, CompressionStats* stats) {
+    size_t raw_size = msg->payload_size;
+    if (threshold == 0 || raw_size < threshold || (msg->header.flags & MSG_FLAGS_COMPRESSED)) {
+        return 0;
     }
     
-    return msg;
+    // Scatter payloads are gathered first; the matcher needs one contiguous block
+    const uint8_t* src = msg->payload;
+    uint8_t* gathered = NULL;
+    if (msg->iov) {
+        gathered = (uint8_t*)buffer_pool_alloc(raw_size);
+        if (!gathered) {
+            return -1;
+        }
+        size_t offset = 0;
+        for (size_t i = 0; i < msg->iovcnt; i++) {
+            memcpy(gathered + offset, msg->iov[i].iov_base, msg->iov[i].iov_len);
+            offset += msg->iov[i].iov_len;
+        }
+        src = gathered;
+    }
+    
+    size_t bound = lz4_compress_bound(raw_size);
+    uint8_t* out = (uint8_t*)buffer_pool_alloc(bound);
+    if (!out) {
+        buffer_pool_free(gathered);
+        return -1;
+    }
+    
+    uint64_t start_ns = stats ? get_thread_cpu_ns() : 0;
+    size_t compressed = lz4_compress(src, raw_size, out, bound);
+    if (stats) {
+        stats->cpu_ns += get_thread_cpu_ns() - start_ns;
+    }
+    buffer_pool_free(gathered);
+    
+    if (compressed == 0 || compressed >= raw_size) {
+        buffer_pool_free(out);
+        if (stats) {
+            stats->skipped++;
+        }
+        return 0;
+    }
+    
+    message_free(msg);
+    msg->payload = out;
+    msg->payload_size = compressed;
+    msg->header.length = compressed;
+    msg->header.flags |= MSG_FLAGS_COMPRESSED;
+    msg->raw_length = raw_size;
+    if (stats) {
+        stats->frames++;
+        stats->raw_bytes += raw_size;
+        stats->wire_bytes += compressed;
+    }
+    return 1;
+}
+
+int message_decompress(Message* msg, const uint8_t* wire, CompressionStats* stats) {
+    uint64_t wire_size = msg->header.length;
+    uint64_t raw_size = msg->raw_length;
+    if (raw_size == 0 || wire_size == 0 || wire_size > SIZE_MAX / MSG_MAX_COMPRESSION_RATIO ||
+        raw_size > wire_size * MSG_MAX_COMPRESSION_RATIO) {
+        return -1;
+    }
+    
+    uint8_t* payload = (uint8_t*)buffer_pool_alloc((size_t)raw_size);
+    if (!payload) {
+        return -1;
+    }
+    
+    uint64_t start_ns = stats ? get_thread_cpu_ns() : 0;
+    int result = lz4_decompress(wire, (size_t)wire_size, payload, (size_t)raw_size);
+    if (stats) {
+        stats->cpu_ns += get_thread_cpu_ns() - start_ns;
+    }
+    if (result < 0) {
+        buffer_pool_free(payload);
+        return -1;
+    }
+    
+    msg->payload = payload;
+    msg->payload_size = (size_t)raw_size;
+    msg->header.length = raw_size;
+    msg->header.flags &= ~(uint32_t)(MSG_FLAGS_COMPRESSED | MSG_FLAGS_CHECKSUM);
+    msg->raw_length = 0;
+    msg->checksum = 0;
+    msg->borrowed = 0;
+    if (stats) {
+        stats->frames++;
+        stats->raw_bytes += raw_size;
+        stats->wire_bytes += wire_size;
+    }
+    return 0;
+}
+
+uint8_t* message_take_payload(Message* msg, size_t* size) {
+    size_t payload_size = msg->payload_size;
+    uint8_t* payload = NULL;
+    
+    if (payload_size > 0 && !msg->borrowed) {
+        payload = msg->payload;
+    } else if (payload_size > 0) {
+        // Borrowed memory stays with its owner: hand out a pooled copy
+        payload = (uint8_t*)buffer_pool_alloc(payload_size);
+        if (!payload) {
+            return NULL;
+        }
+        if (msg->iov) {
+            size_t offset = 0;
+            for (size_t i = 0; i < msg->iovcnt; i++) {
+                memcpy(payload + offset, msg->iov[i].iov_base, msg->iov[i].iov_len);
+                offset += msg->iov[i].iov_len;
+            }
+        } else {
+            memcpy(payload, msg->payload, payload_size);
+        }
+    }
+    
+    msg->payload = NULL;
+    msg->payload_size = 0;
+    msg->iov = NULL;
+    msg->iovcnt = 0;
+    msg->borrowed = 0;
+    if (size) {
+        *size = payload ? payload_size : 0;
+    }
+    return payload;
+}
+
+void message_payload_free(uint8_t* payload) {
+    buffer_pool_free(payload);
 }
 
 void message_free(Message* msg) {
-    if (msg && msg->payload) {
-        free(msg->payload);
-        msg->payload = NULL;
-        msg->payload_size = 0;
+    if (!msg) return;
+    if (msg->payload && !msg->borrowed) {
+        buffer_pool_free(msg->payload);
     }
+    msg->payload = NULL;
+    msg->payload_size = 0;
+    msg->iov = NULL;
+    msg->iovcnt = 0;
+    msg->borrowed = 0;
 }
 
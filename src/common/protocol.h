@@ -16,6 +16,9 @@
 #include <string.h>
 #include <arpa/inet.h>
 #include <endian.h>
+#include <sys/uio.h>
+#include "compress.h"
+#include "integrity.h"
 
 /**
  * @brief Message type enumeration
@@ -23,9 +26,34 @@
 typedef enum {
     MSG_TYPE_TEXT = 0x01,    ///< Text message
     MSG_TYPE_ACK = 0x03,     ///< Acknowledgment
-    MSG_TYPE_ERROR = 0x04    ///< Error message
+    MSG_TYPE_ERROR = 0x04,   ///< Error message
+    MSG_TYPE_ACK_BATCH = 0x05, ///< Cumulative ACK of every sequence number up to the one carried
+    MSG_TYPE_HELLO = 0x06,   ///< Feature negotiation (payload: uint32_t feature mask)
+    MSG_TYPE_STATS = 0x07,   ///< Metrics snapshot: empty request, text reply
+    MSG_TYPE_CHUNK = 0x08,   ///< Piece of a streamed payload; the chunk with MSG_FLAGS_FINAL ends the stream
+    MSG_TYPE_SUBSCRIBE = 0x09,   ///< Receive the publications of a topic (payload: topic name)
+    MSG_TYPE_UNSUBSCRIBE = 0x0A, ///< Stop receiving a topic (payload: topic name)
+    MSG_TYPE_PUBLISH = 0x0B  ///< Publication: uint8_t topic length, topic name, then the data
 } MessageType;
 
+#define MSG_TOPIC_MAX 255          ///< Longest topic name, in bytes
+
+/**
+ * @brief Optional features negotiated with MSG_TYPE_HELLO
+ *
+ * The client sends the features it wants right after connecting; the
+ * server answers with a HELLO carrying the subset it enabled. A server
+ * that predates negotiation answers with a plain ACK (no features).
+ */
+typedef enum {
+    MSG_FEATURE_NONE = 0x00,
+    MSG_FEATURE_ACK_BATCH = 0x01,   ///< Server may acknowledge sequenced messages with ACK_BATCH
+    MSG_FEATURE_COMPRESSION = 0x02, ///< Peer accepts MSG_FLAGS_COMPRESSED (LZ4 block) payloads
+    MSG_FEATURE_TIMESTAMPS = 0x04,  ///< Peer accepts MSG_FLAGS_TIMESTAMPED; the server echoes send times in its ACKs
+    MSG_FEATURE_CHECKSUM = 0x08,    ///< Peer accepts (and verifies) MSG_FLAGS_CHECKSUM
+    MSG_FEATURE_SEQUENCE = 0x10     ///< Peer accepts MSG_FLAGS_SEQUENCED; its ACKs carry the sequence number
+} MessageFeature;
+
 /**
  * @brief Message flags
  */
@@ -33,9 +61,44 @@ typedef enum {
     MSG_FLAGS_NONE = 0x00,
     MSG_FLAGS_COMPRESSED = 0x01,  ///< Payload is compressed
     MSG_FLAGS_ENCRYPTED = 0x02,   ///< Payload is encrypted
-    MSG_FLAGS_FINAL = 0x04        ///< Final message in sequence
+    MSG_FLAGS_FINAL = 0x04,       ///< Last chunk of a stream (MSG_TYPE_CHUNK)
+    MSG_FLAGS_SEQUENCED = 0x08,   ///< Sequence number extension follows header
+    MSG_FLAGS_TIMESTAMPED = 0x10, ///< Send timestamp extension follows header
+    MSG_FLAGS_CHECKSUM = 0x20     ///< CRC32C extension follows header
 } MessageFlags;
 
+/**
+ * @brief Header extensions
+ *
+ * Some flags announce a fixed-size, big-endian field that directly
+ * follows the 16-byte header, in increasing flag-bit order. Extensions
+ * are not counted in `length`, so frames without these flags keep the
+ * original wire format and stay readable by older peers.
+ */
+#define MSG_EXT_RAW_LENGTH_SIZE 8   ///< MSG_FLAGS_COMPRESSED: uint64_t uncompressed payload length
+#define MSG_EXT_SEQUENCE_SIZE 8     ///< MSG_FLAGS_SEQUENCED: uint64_t sequence number
+#define MSG_EXT_TIMESTAMP_SIZE 8    ///< MSG_FLAGS_TIMESTAMPED: uint64_t sender CLOCK_MONOTONIC time in ns
+#define MSG_EXT_CHECKSUM_SIZE 4     ///< MSG_FLAGS_CHECKSUM: uint32_t CRC32C of the payload as sent
+#define MSG_EXT_MAX_SIZE (MSG_EXT_RAW_LENGTH_SIZE + MSG_EXT_SEQUENCE_SIZE + MSG_EXT_TIMESTAMP_SIZE + \
+                          MSG_EXT_CHECKSUM_SIZE)
+
+/**
+ * @brief Streaming
+ *
+ * A payload too large for one frame is sent as consecutive MSG_TYPE_CHUNK
+ * frames of MSG_STREAM_CHUNK_SIZE bytes (the last one may be shorter) on
+ * one connection. Only the final chunk is acknowledged, so the receiver
+ * never holds more than one chunk. Receivers refuse frames larger than
+ * their limit (MSG_DEFAULT_MAX_FRAME_SIZE unless configured otherwise).
+ */
+#define MSG_STREAM_CHUNK_SIZE (64 * 1024)
+#define MSG_DEFAULT_MAX_FRAME_SIZE (64ull * 1024 * 1024)
+
+/**
+ * @brief Largest expansion an LZ4 block can encode, used to reject decompression bombs
+ */
+#define MSG_MAX_COMPRESSION_RATIO 255
+
 /**
  * @brief Message header structure (16 bytes)
  * 
@@ -50,15 +113,34 @@ typedef struct {
     uint32_t flags;     ///< Message flags
 } __attribute__((packed)) MessageHeader;
 
+#define MESSAGE_MAX_IOV 64         ///< Maximum number of payload segments in a scatter message
+
 /**
  * @brief Complete message structure
+ * 
+ * A message either owns its payload (a buffer pool allocation released by
+ * message_free) or borrows caller memory, which must stay valid until the
+ * message has been sent. Borrowed payloads are a single buffer or a list
+ * of segments in `iov`.
  */
 typedef struct {
     MessageHeader header;
-    uint8_t* payload;   ///< Payload data (allocated dynamically)
+    uint8_t* payload;   ///< Payload data (buffer pool allocation, or caller memory if borrowed)
     size_t payload_size; ///< Actual payload size
+    uint64_t sequence;  ///< Sequence number (valid if MSG_FLAGS_SEQUENCED)
+    uint64_t raw_length; ///< Uncompressed payload length (valid if MSG_FLAGS_COMPRESSED)
+    uint64_t timestamp_ns; ///< Client send time (valid if MSG_FLAGS_TIMESTAMPED; ACKs echo it)
+    uint32_t checksum;  ///< CRC32C of the payload as sent, compressed or not (valid if MSG_FLAGS_CHECKSUM)
+    const struct iovec* iov; ///< Borrowed payload segments (used instead of payload if set)
+    size_t iovcnt;      ///< Number of segments in iov
+    int borrowed;       ///< Payload belongs to the caller; message_free leaves it alone
 } Message;
 
+/**
+ * @brief Maximum encoded size of header plus extensions
+ */
+#define MESSAGE_HEAD_MAX_SIZE (sizeof(MessageHeader) + MSG_EXT_MAX_SIZE)
+
 /**
  * @brief Serialize header to network byte order
  */
@@ -78,17 +160,121 @@ static inline void message_header_deserialize(MessageHeader* header) {
 }
 
 /**
- * @brief Get total message size (header + payload)
+ * @brief Get size of the header extensions announced by flags
+ */
+static inline size_t message_extension_size(uint32_t flags) {
+    size_t size = 0;
+    if (flags & MSG_FLAGS_COMPRESSED) size += MSG_EXT_RAW_LENGTH_SIZE;
+    if (flags & MSG_FLAGS_SEQUENCED) size += MSG_EXT_SEQUENCE_SIZE;
+    if (flags & MSG_FLAGS_TIMESTAMPED) size += MSG_EXT_TIMESTAMP_SIZE;
+    if (flags & MSG_FLAGS_CHECKSUM) size += MSG_EXT_CHECKSUM_SIZE;
+    return size;
+}
+
+/**
+ * @brief Get total message size (header + extensions + payload)
  */
 static inline size_t message_total_size(const Message* msg) {
-    return sizeof(MessageHeader) + msg->payload_size;
+    return sizeof(MessageHeader) + message_extension_size(msg->header.flags) + msg->payload_size;
+}
+
+/**
+ * @brief Attach a sequence number to a message
+ */
+static inline void message_set_sequence(Message* msg, uint64_t sequence) {
+    msg->header.flags |= MSG_FLAGS_SEQUENCED;
+    msg->sequence = sequence;
+}
+
+/**
+ * @brief Attach a send timestamp (CLOCK_MONOTONIC ns) to a message
+ *
+ * Only meaningful as a one-way latency when both ends share the clock,
+ * i.e. run on the same host; the echo in the ACK always gives the RTT.
+ */
+static inline void message_set_timestamp(Message* msg, uint64_t timestamp_ns) {
+    msg->header.flags |= MSG_FLAGS_TIMESTAMPED;
+    msg->timestamp_ns = timestamp_ns;
 }
 
+/**
+ * @brief Attach the CRC32C of the payload (call after message_compress)
+ */
+void message_set_checksum(Message* msg);
+
+/**
+ * @brief Check a received payload, copying it out in the same pass
+ *
+ * Verifies the checksum of frames that carry one and, if validate has
+ * INTEGRITY_UTF8, that an uncompressed MSG_TYPE_TEXT payload is UTF-8.
+ * A compressed text payload is validated by a second call once
+ * message_decompress has decoded it.
+ * @param msg Message whose header and extensions are decoded
+ * @param dst Destination of header.length bytes, or NULL to only check
+ * @param wire Payload as received
+ * @param validate INTEGRITY_UTF8 or 0
+ * @return 0 if the payload passed, else the INTEGRITY_* check it failed
+ */
+unsigned message_verify(const Message* msg, void* dst, const uint8_t* wire, unsigned validate);
+
+/**
+ * @brief Encode header and extensions in network byte order
+ * @param msg Message
+ * @param out Output buffer of at least MESSAGE_HEAD_MAX_SIZE bytes
+ * @return Number of bytes written
+ */
+size_t message_encode_head(const Message* msg, uint8_t* out);
+
+/**
+ * @brief Decode extension fields that follow the header
+ * @param msg Message whose header (host byte order) is already set
+ * @param ext message_extension_size(msg->header.flags) bytes
+ */
+void message_decode_extensions(Message* msg, const uint8_t* ext);
+
+/**
+ * @brief Compress the payload in place if it is at least threshold bytes
+ * 
+ * Borrowed and scatter payloads are left to their owner; the message then
+ * owns the compressed buffer. Payloads that do not shrink are sent as-is.
+ * @param msg Message to send
+ * @param threshold Minimum payload size worth compressing (0 disables)
+ * @param stats Counters to update (may be NULL; CPU time is only measured with stats)
+ * @return 1 if compressed, 0 if left unchanged, -1 on allocation failure
+ */
+int message_compress(Message* msg, size_t threshold, CompressionStats* stats);
+
+/**
+ * @brief Decompress a received MSG_FLAGS_COMPRESSED payload
+ * 
+ * On success the message looks as if it had been sent uncompressed: it owns
+ * the decoded payload, header.length is the raw length, and the flag is
+ * cleared along with MSG_FLAGS_CHECKSUM, which only covered the wire bytes.
+ * @param msg Message whose header and extensions are decoded
+ * @param wire Compressed payload (header.length bytes)
+ * @param stats Counters to update (may be NULL)
+ * @return 0 on success, -1 on malformed input or allocation failure
+ */
+int message_decompress(Message* msg, const uint8_t* wire, CompressionStats* stats);
+
 /**
  * @brief Create a text message
  */
 Message message_create_text(const char* text, size_t text_len);
 
+/**
+ * @brief Create a text message that borrows the caller's buffer (no copy)
+ * @note text must stay valid until the message has been sent
+ */
+Message message_create_text_borrowed(const void* text, size_t text_len);
+
+/**
+ * @brief Create a text message from borrowed segments (no copy)
+ * @param iov Payload segments, sent back to back (array and buffers must outlive the send)
+ * @param iovcnt Number of segments (at most MESSAGE_MAX_IOV)
+ */
+Message message_create_text_iov(const struct iovec* iov, size_t iovcnt);
+
 /**
  * @brief Create an ACK message
  */
@@ -100,7 +286,89 @@ Message message_create_ack(void);
 Message message_create_error(const char* error, size_t error_len);
 
 /**
- * @brief Free message payload
+ * @brief Create a stream chunk that borrows the caller's buffer (no copy)
+ * @param data Chunk payload (must stay valid until the message has been sent)
+ * @param len Chunk length
+ * @param final Non-zero for the last chunk of the stream
+ */
+Message message_create_chunk(const void* data, size_t len, int final);
+
+/**
+ * @brief Create a cumulative ACK for every sequence number up to `sequence`
+ */
+Message message_create_ack_batch(uint64_t sequence);
+
+/**
+ * @brief Create a feature negotiation message
+ */
+Message message_create_hello(uint32_t features);
+
+/**
+ * @brief Create a stats message (empty for a request, snapshot text for the reply)
+ */
+Message message_create_stats(const char* text, size_t text_len);
+
+/**
+ * @brief Parse feature mask from a HELLO message
+ * @return 0 on success, -1 if the message is not a valid HELLO
+ */
+int message_parse_hello(const Message* msg, uint32_t* features);
+
+/**
+ * @brief Create a SUBSCRIBE or UNSUBSCRIBE message
+ * @param type MSG_TYPE_SUBSCRIBE or MSG_TYPE_UNSUBSCRIBE
+ */
+Message message_create_subscription(uint32_t type, const char* topic, size_t topic_len);
+
+/**
+ * @brief Create a publication, topic and data copied into one pooled payload
+ * @param topic_len At most MSG_TOPIC_MAX
+ */
+Message message_create_publish(const char* topic, size_t topic_len, const void* data, size_t len);
+
+/**
+ * @brief Split a PUBLISH payload into topic and data (both point into msg)
+ * @return 0 on success, -1 if the message is not a well-formed PUBLISH
+ */
+int message_parse_publish(const Message* msg, const char** topic, size_t* topic_len,
+                          const uint8_t** data, size_t* len);
+
+/**
+ * @brief Whether the receiver of this message type replies with an ACK
+ */
+static inline int message_type_needs_ack(uint32_t type) {
+    return type != MSG_TYPE_ACK && type != MSG_TYPE_ACK_BATCH && type != MSG_TYPE_HELLO &&
+           type != MSG_TYPE_STATS;
+}
+
+/**
+ * @brief Whether the receiver of this frame replies with an ACK (chunks only when final)
+ */
+static inline int message_needs_ack(const MessageHeader* header) {
+    if (header->type == MSG_TYPE_CHUNK) {
+        return (header->flags & MSG_FLAGS_FINAL) != 0;
+    }
+    return message_type_needs_ack(header->type);
+}
+
+/**
+ * @brief Take ownership of a received payload
+ * 
+ * The message no longer references the payload afterwards, so message_free
+ * leaves it alone. Borrowed payloads are copied first.
+ * @param msg Message
+ * @param size Output payload size (may be NULL)
+ * @return Payload (release with message_payload_free), NULL if there is none
+ */
+uint8_t* message_take_payload(Message* msg, size_t* size);
+
+/**
+ * @brief Release a payload obtained from message_take_payload
+ */
+void message_payload_free(uint8_t* payload);
+
+/**
+ * @brief Free message payload (borrowed payloads are left untouched)
  */
 void message_free(Message* msg);
 
@@ -0,0 +1,666 @@
+/**
+ * @file shm_channel.c
+ * @brief Shared-memory frame transport implementation
+ */
+
+#define _GNU_SOURCE
+#include "shm_channel.h"
+#include "buffer_pool.h"
+#include "logger.h"
+#include "utils.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+
+#define SHM_MAGIC 0x53484d31u  // "SHM1"
+#define SHM_CACHE_LINE 64
+#define SHM_FD_COUNT 3          // memfd, client doorbell, server doorbell
+#define RING_CLIENT_TO_SERVER 0
+#define RING_SERVER_TO_CLIENT 1
+
+/**
+ * @brief Ring positions; producer and consumer fields live on separate cache lines
+ */
+typedef struct {
+    _Alignas(SHM_CACHE_LINE) _Atomic uint64_t head;    ///< Written by the producer
+    _Atomic uint32_t writer_waiting;                   ///< Producer sleeps until space is released
+    _Alignas(SHM_CACHE_LINE) _Atomic uint64_t tail;    ///< Written by the consumer
+    _Atomic uint32_t reader_waiting;                   ///< Consumer sleeps until data is published
+} ShmRingControl;
+
+/**
+ * @brief Start of the mapping; ring data follows, client-to-server first
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t ring_size;
+    ShmRingControl rings[2];
+} ShmRegion;
+
+struct ShmChannel {
+    ShmRegion* region;
+    size_t map_size;
+    size_t ring_size;           // Power of two
+    ShmRingControl* tx;
+    uint8_t* tx_data;
+    uint64_t tx_head;           // Producer position, published with publish()
+    int tx_broken;              // A frame larger than the ring was cut short: the stream is lost
+    ShmRingControl* rx;
+    uint8_t* rx_data;
+    uint64_t rx_tail;           // Consumer position, published with release()
+    int doorbell_fd;            // Rung by the peer
+    int peer_doorbell_fd;       // Rung by us
+    int sock;                   // Not owned; readable only once the peer hangs up
+    
+    // Frame being received
+    int have_header;
+    Message current;
+    uint8_t* wire;              // Payload bytes as sent (compressed or not)
+    size_t received;
+    CompressionStats* stats;
+    uint64_t max_payload;       // Largest payload accepted, before or after decompression (0 = unlimited)
+    uint64_t oversized;         // Announced length of the frame refused for exceeding max_payload
+    unsigned validate;          // INTEGRITY_UTF8 or 0
+    unsigned rejected;          // Check the last refused frame failed
+};
+
+static size_t round_ring_size(size_t size) {
+    size_t ring = SHM_RING_MIN_SIZE;
+    while (ring < size && ring < SHM_RING_MAX_SIZE) {
+        ring <<= 1;
+    }
+    return ring;
+}
+
+static void ring_doorbell(int fd) {
+    uint64_t one = 1;
+    ssize_t written;
+    do {
+        written = write(fd, &one, sizeof(one));
+    } while (written < 0 && errno == EINTR);
+    // EAGAIN: the counter is saturated, the peer is being woken anyway
+}
+
+static void clear_doorbell(int fd) {
+    uint64_t count;
+    ssize_t result;
+    do {
+        result = read(fd, &count, sizeof(count));
+    } while (result < 0 && errno == EINTR);
+}
+
+/**
+ * @brief Point tx/rx at the rings for one side of the channel
+ */
+static void bind_rings(ShmChannel* channel, int is_server) {
+    uint8_t* data = (uint8_t*)channel->region + sizeof(ShmRegion);
+    int tx = is_server ? RING_SERVER_TO_CLIENT : RING_CLIENT_TO_SERVER;
+    int rx = is_server ? RING_CLIENT_TO_SERVER : RING_SERVER_TO_CLIENT;
+    channel->tx = &channel->region->rings[tx];
+    channel->tx_data = data + (size_t)tx * channel->ring_size;
+    channel->rx = &channel->region->rings[rx];
+    channel->rx_data = data + (size_t)rx * channel->ring_size;
+    channel->tx_head = atomic_load_explicit(&channel->tx->head, memory_order_relaxed);
+    channel->rx_tail = atomic_load_explicit(&channel->rx->tail, memory_order_relaxed);
+}
+
+static ShmChannel* channel_alloc(void) {
+    ShmChannel* channel = calloc(1, sizeof(ShmChannel));
+    if (channel) {
+        channel->doorbell_fd = -1;
+        channel->peer_doorbell_fd = -1;
+        channel->sock = -1;
+        channel->max_payload = MSG_DEFAULT_MAX_FRAME_SIZE;
+    }
+    return channel;
+}
+
+ShmChannel* shm_channel_create(int sock, size_t ring_size) {
+    ShmChannel* channel = channel_alloc();
+    if (!channel) {
+        return NULL;
+    }
+    channel->sock = sock;
+    channel->ring_size = round_ring_size(ring_size);
+    channel->map_size = sizeof(ShmRegion) + 2 * channel->ring_size;
+    
+    int memfd = memfd_create("ipc-shm-channel", MFD_CLOEXEC);
+    int client_doorbell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    channel->doorbell_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (memfd < 0 || client_doorbell < 0 || channel->doorbell_fd < 0) {
+        logger_error("Failed to create shared-memory channel: %s", get_error_string(errno));
+        goto fail;
+    }
+    if (ftruncate(memfd, (off_t)channel->map_size) < 0) {
+        logger_error("Failed to size shared-memory channel: %s", get_error_string(errno));
+        goto fail;
+    }
+    void* map = mmap(NULL, channel->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (map == MAP_FAILED) {
+        logger_error("Failed to map shared-memory channel: %s", get_error_string(errno));
+        goto fail;
+    }
+    channel->region = (ShmRegion*)map;
+    channel->region->magic = SHM_MAGIC;
+    channel->region->ring_size = channel->ring_size;
+    bind_rings(channel, 1);
+    
+    // Hand memfd and both doorbells over; the client keeps the mapping alive
+    int fds[SHM_FD_COUNT] = { memfd, client_doorbell, channel->doorbell_fd };
+    uint32_t magic = SHM_MAGIC;
+    struct iovec iov = { &magic, sizeof(magic) };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(fds))];
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = control.buf;
+    mh.msg_controllen = sizeof(control.buf);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&mh);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    
+    ssize_t sent;
+    do {
+        sent = sendmsg(sock, &mh, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    if (sent != (ssize_t)sizeof(magic)) {
+        logger_error("Failed to pass shared-memory channel: %s", get_error_string(errno));
+        goto fail;
+    }
+    
+    close(memfd);
+    channel->peer_doorbell_fd = client_doorbell;
+    return channel;
+
+fail:
+    if (memfd >= 0) close(memfd);
+    if (client_doorbell >= 0) close(client_doorbell);
+    shm_channel_destroy(channel);
+    return NULL;
+}
+
+ShmChannel* shm_channel_attach(int sock) {
+    int fds[SHM_FD_COUNT] = { -1, -1, -1 };
+    uint32_t magic = 0;
+    struct iovec iov = { &magic, sizeof(magic) };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(fds))];
+    } control;
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = control.buf;
+    mh.msg_controllen = sizeof(control.buf);
+    
+    ssize_t received;
+    do {
+        received = recvmsg(sock, &mh, MSG_CMSG_CLOEXEC);
+    } while (received < 0 && errno == EINTR);
+    
+    struct cmsghdr* cmsg = received > 0 ? CMSG_FIRSTHDR(&mh) : NULL;
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+        cmsg->cmsg_len == CMSG_LEN(sizeof(fds))) {
+        memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    }
+    if (received != (ssize_t)sizeof(magic) || magic != SHM_MAGIC || fds[0] < 0 || (mh.msg_flags & MSG_CTRUNC)) {
+        logger_error("Server did not offer a shared-memory channel");
+        goto fail;
+    }
+    
+    struct stat st;
+    if (fstat(fds[0], &st) < 0 || (size_t)st.st_size < sizeof(ShmRegion)) {
+        logger_error("Invalid shared-memory channel");
+        goto fail;
+    }
+    
+    ShmChannel* channel = channel_alloc();
+    if (!channel) {
+        goto fail;
+    }
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+    close(fds[0]);
+    fds[0] = -1;
+    if (map == MAP_FAILED) {
+        logger_error("Failed to map shared-memory channel: %s", get_error_string(errno));
+        free(channel);
+        goto fail;
+    }
+    channel->region = (ShmRegion*)map;
+    channel->map_size = (size_t)st.st_size;
+    channel->ring_size = (size_t)channel->region->ring_size;
+    channel->doorbell_fd = fds[1];
+    channel->peer_doorbell_fd = fds[2];
+    channel->sock = sock;
+    
+    size_t ring = channel->ring_size;
+    if (channel->region->magic != SHM_MAGIC || ring < SHM_RING_MIN_SIZE || ring > SHM_RING_MAX_SIZE ||
+        (ring & (ring - 1)) != 0 || channel->map_size < sizeof(ShmRegion) + 2 * ring) {
+        logger_error("Invalid shared-memory channel layout");
+        shm_channel_destroy(channel);
+        return NULL;
+    }
+    bind_rings(channel, 0);
+    return channel;
+
+fail:
+    for (int i = 0; i < SHM_FD_COUNT; i++) {
+        if (fds[i] >= 0) close(fds[i]);
+    }
+    return NULL;
+}
+
+void shm_channel_destroy(ShmChannel* channel) {
+    if (!channel) return;
+    buffer_pool_free(channel->wire);
+    if (channel->region) {
+        munmap(channel->region, channel->map_size);
+    }
+    if (channel->doorbell_fd >= 0) close(channel->doorbell_fd);
+    if (channel->peer_doorbell_fd >= 0) close(channel->peer_doorbell_fd);
+    free(channel);
+}
+
+int shm_channel_fd(const ShmChannel* channel) {
+    return channel->doorbell_fd;
+}
+
+size_t shm_channel_ring_size(const ShmChannel* channel) {
+    return channel->ring_size;
+}
+
+void shm_channel_set_stats(ShmChannel* channel, CompressionStats* stats) {
+    channel->stats = stats;
+}
+
+void shm_channel_set_validation(ShmChannel* channel, unsigned validate) {
+    channel->validate = validate;
+}
+
+void shm_channel_set_max_payload(ShmChannel* channel, uint64_t max_payload) {
+    channel->max_payload = max_payload;
+}
+
+uint64_t shm_channel_oversized(const ShmChannel* channel) {
+    return channel->oversized;
+}
+
+unsigned shm_channel_rejected(const ShmChannel* channel) {
+    return channel->rejected;
+}
+
+/**
+ * @brief Make written bytes visible; wake the reader if it went to sleep
+ */
+static void publish(ShmChannel* channel) {
+    atomic_store_explicit(&channel->tx->head, channel->tx_head, memory_order_release);
+    // Pairs with the fence in end_read(): either we see the flag or the reader sees the data
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&channel->tx->reader_waiting, memory_order_relaxed) &&
+        atomic_exchange_explicit(&channel->tx->reader_waiting, 0, memory_order_relaxed)) {
+        ring_doorbell(channel->peer_doorbell_fd);
+    }
+}
+
+/**
+ * @brief Hand consumed bytes back; wake the writer if it waits for space
+ */
+static void release(ShmChannel* channel) {
+    atomic_store_explicit(&channel->rx->tail, channel->rx_tail, memory_order_release);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&channel->rx->writer_waiting, memory_order_relaxed) &&
+        atomic_exchange_explicit(&channel->rx->writer_waiting, 0, memory_order_relaxed)) {
+        ring_doorbell(channel->peer_doorbell_fd);
+    }
+}
+
+/**
+ * @brief Sleep on the doorbell; the socket turns readable when the peer hangs up
+ * @return 1 when woken, 0 on timeout, -1 on error or peer close
+ */
+static int wait_doorbell(ShmChannel* channel, int timeout_ms) {
+    struct pollfd pfds[2];
+    pfds[0].fd = channel->doorbell_fd;
+    pfds[0].events = POLLIN;
+    pfds[0].revents = 0;
+    pfds[1].fd = channel->sock;
+    pfds[1].events = POLLIN;
+    pfds[1].revents = 0;
+    
+    int ready;
+    do {
+        ready = poll(pfds, 2, timeout_ms);
+    } while (ready < 0 && errno == EINTR);
+    if (ready < 0 || (pfds[1].revents & (POLLIN | POLLHUP | POLLERR))) {
+        return -1;
+    }
+    if (ready == 0) {
+        return 0;
+    }
+    clear_doorbell(channel->doorbell_fd);
+    return 1;
+}
+
+/**
+ * @brief Free bytes in the transmit ring
+ * @return Free bytes, (size_t)-1 if the peer corrupted the positions
+ */
+static size_t tx_space(const ShmChannel* channel) {
+    uint64_t tail = atomic_load_explicit(&channel->tx->tail, memory_order_acquire);
+    uint64_t used = channel->tx_head - tail;
+    if (used > channel->ring_size) {
+        return (size_t)-1;
+    }
+    return channel->ring_size - (size_t)used;
+}
+
+size_t shm_channel_unread(const ShmChannel* channel) {
+    size_t space = tx_space(channel);
+    return space == (size_t)-1 ? channel->ring_size : channel->ring_size - space;
+}
+
+/**
+ * @brief Wait until the transmit ring has room for needed bytes
+ * @param deadline_ms Monotonic time to give up at
+ * @param waited Set when the doorbell was consumed while waiting
+ */
+static int wait_space(ShmChannel* channel, size_t needed, uint64_t deadline_ms, int* waited) {
+    for (;;) {
+        size_t space = tx_space(channel);
+        if (space == (size_t)-1) {
+            return -1;
+        }
+        if (space >= needed) {
+            return 0;
+        }
+        
+        // Let the reader drain what is there, then sleep until it releases space
+        publish(channel);
+        atomic_store_explicit(&channel->tx->writer_waiting, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (tx_space(channel) >= needed) {
+            continue;
+        }
+        uint64_t now = get_monotonic_ms();
+        int remaining = now < deadline_ms ? (int)(deadline_ms - now) : 0;
+        *waited = 1;
+        if (wait_doorbell(channel, remaining) <= 0) {
+            return -1;
+        }
+    }
+}
+
+/**
+ * @brief Copy bytes into the transmit ring; the caller made sure they fit
+ */
+static void ring_copy(ShmChannel* channel, const uint8_t* data, size_t len) {
+    size_t offset = (size_t)(channel->tx_head & (channel->ring_size - 1));
+    size_t first = channel->ring_size - offset;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(channel->tx_data + offset, data, first);
+    memcpy(channel->tx_data, data + first, len - first);
+    channel->tx_head += len;
+}
+
+/**
+ * @brief Copy bytes into the transmit ring as the reader makes room (frames larger than the ring)
+ */
+static int ring_stream(ShmChannel* channel, const uint8_t* data, size_t len, uint64_t deadline_ms, int* waited) {
+    while (len > 0) {
+        if (wait_space(channel, 1, deadline_ms, waited) < 0) {
+            return -1;
+        }
+        size_t n = tx_space(channel);
+        if (n > len) {
+            n = len;
+        }
+        ring_copy(channel, data, n);
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int shm_channel_send(ShmChannel* channel, const Message* msg, int timeout_ms) {
+    if (channel->tx_broken) {
+        return -1;
+    }
+    uint8_t head[MESSAGE_HEAD_MAX_SIZE];
+    size_t head_size = message_encode_head(msg, head);
+    struct iovec single = { msg->payload, msg->payload_size };
+    const struct iovec* iov = msg->iov;
+    size_t iovcnt = msg->iovcnt;
+    if (!iov) {
+        iov = &single;
+        iovcnt = msg->header.length > 0 && msg->payload ? 1 : 0;
+    }
+    size_t total = head_size;
+    for (size_t i = 0; i < iovcnt; i++) {
+        total += iov[i].iov_len;
+    }
+    
+    uint64_t deadline_ms = get_monotonic_ms() + (uint64_t)(timeout_ms > 0 ? timeout_ms : 0);
+    int waited = 0;
+    int result = 0;
+    if (total <= channel->ring_size) {
+        // The reader never sees part of a frame that fits: on timeout nothing was written
+        result = wait_space(channel, total, deadline_ms, &waited);
+        if (result == 0) {
+            ring_copy(channel, head, head_size);
+            for (size_t i = 0; i < iovcnt; i++) {
+                ring_copy(channel, (const uint8_t*)iov[i].iov_base, iov[i].iov_len);
+            }
+        }
+    } else {
+        // The reader assembles a larger frame while it is written
+        result = ring_stream(channel, head, head_size, deadline_ms, &waited);
+        for (size_t i = 0; i < iovcnt && result == 0; i++) {
+            result = ring_stream(channel, (const uint8_t*)iov[i].iov_base, iov[i].iov_len, deadline_ms, &waited);
+        }
+        if (result < 0) {
+            logger_error("Shared-memory send of a %zu-byte frame cut short; channel unusable", total);
+            channel->tx_broken = 1;
+        }
+    }
+    
+    publish(channel);
+    if (waited) {
+        // The doorbell may also have announced incoming data: look again
+        shm_channel_wake(channel);
+    }
+    return result;
+}
+
+ssize_t shm_channel_write(ShmChannel* channel, const struct iovec* iov, int iovcnt) {
+    if (channel->tx_broken) {
+        return -1;
+    }
+    size_t space = tx_space(channel);
+    if (space == 0) {
+        // Ask the reader to ring once it releases space, then look once more
+        atomic_store_explicit(&channel->tx->writer_waiting, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        space = tx_space(channel);
+    }
+    if (space == (size_t)-1) {
+        return -1;
+    }
+    
+    size_t written = 0;
+    for (int i = 0; i < iovcnt && written < space; i++) {
+        size_t n = iov[i].iov_len;
+        if (n > space - written) {
+            n = space - written;
+        }
+        ring_copy(channel, (const uint8_t*)iov[i].iov_base, n);
+        written += n;
+    }
+    if (written > 0) {
+        publish(channel);
+    }
+    return (ssize_t)written;
+}
+
+/**
+ * @brief Bytes available in the receive ring
+ * @return Available bytes, (size_t)-1 if the peer corrupted the positions
+ */
+static size_t rx_available(const ShmChannel* channel) {
+    uint64_t head = atomic_load_explicit(&channel->rx->head, memory_order_acquire);
+    uint64_t available = head - channel->rx_tail;
+    if (available > channel->ring_size) {
+        return (size_t)-1;
+    }
+    return (size_t)available;
+}
+
+size_t shm_channel_backlog(const ShmChannel* channel) {
+    size_t available = rx_available(channel);
+    return available == (size_t)-1 ? 0 : available;
+}
+
+/**
+ * @brief Copy bytes out of the receive ring without consuming them
+ */
+static void ring_peek(const ShmChannel* channel, uint8_t* out, size_t len) {
+    size_t offset = (size_t)(channel->rx_tail & (channel->ring_size - 1));
+    size_t first = channel->ring_size - offset;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(out, channel->rx_data + offset, first);
+    memcpy(out + first, channel->rx_data, len - first);
+}
+
+int shm_channel_next(ShmChannel* channel, Message* msg) {
+    size_t available = rx_available(channel);
+    if (available == (size_t)-1) {
+        return -1;
+    }
+    size_t consumed = 0;
+    
+    if (!channel->have_header) {
+        if (available < sizeof(MessageHeader)) {
+            return 0;
+        }
+        uint8_t head[MESSAGE_HEAD_MAX_SIZE];
+        ring_peek(channel, head, sizeof(MessageHeader));
+        MessageHeader header;
+        memcpy(&header, head, sizeof(header));
+        message_header_deserialize(&header);
+        
+        size_t head_size = sizeof(MessageHeader) + message_extension_size(header.flags);
+        if (available < head_size) {
+            return 0;
+        }
+        if (header.length > SIZE_MAX - head_size) {
+            return -1;
+        }
+        ring_peek(channel, head, head_size);
+        
+        Message* current = &channel->current;
+        memset(current, 0, sizeof(Message));
+        current->header = header;
+        message_decode_extensions(current, head + sizeof(MessageHeader));
+        // Refuse before allocating: the lengths are the peer's word
+        if (channel->max_payload > 0 &&
+            (header.length > channel->max_payload ||
+             ((header.flags & MSG_FLAGS_COMPRESSED) && current->raw_length > channel->max_payload))) {
+            channel->oversized = header.length > channel->max_payload ? header.length : current->raw_length;
+            return -1;
+        }
+        if (header.length > 0) {
+            channel->wire = (uint8_t*)buffer_pool_alloc((size_t)header.length);
+            if (!channel->wire) {
+                return -1;
+            }
+        }
+        channel->received = 0;
+        channel->have_header = 1;
+        channel->rx_tail += head_size;
+        consumed += head_size;
+        available -= head_size;
+    }
+    
+    // Payload may exceed the ring: take what is there and come back for the rest
+    size_t length = (size_t)channel->current.header.length;
+    size_t n = length - channel->received;
+    if (n > available) {
+        n = available;
+    }
+    if (n > 0) {
+        ring_peek(channel, channel->wire + channel->received, n);
+        channel->received += n;
+        channel->rx_tail += n;
+        consumed += n;
+    }
+    if (consumed > 0) {
+        release(channel);
+    }
+    if (channel->received < length) {
+        return 0;
+    }
+    
+    *msg = channel->current;
+    channel->have_header = 0;
+    uint8_t* wire = channel->wire;
+    channel->wire = NULL;
+    if (msg->header.flags & MSG_FLAGS_COMPRESSED) {
+        int result = -1;
+        if ((channel->rejected = message_verify(msg, NULL, wire, 0)) == 0) {
+            result = message_decompress(msg, wire, channel->stats);
+        }
+        buffer_pool_free(wire);
+        if (result == 0 && (channel->rejected = message_verify(msg, NULL, msg->payload, channel->validate)) != 0) {
+            message_free(msg);
+            result = -1;
+        }
+        return result < 0 ? -1 : 1;
+    }
+    msg->payload = wire;
+    msg->payload_size = length;
+    if ((channel->rejected = message_verify(msg, NULL, wire, channel->validate)) != 0) {
+        message_free(msg);
+        return -1;
+    }
+    return 1;
+}
+
+void shm_channel_begin_read(ShmChannel* channel) {
+    clear_doorbell(channel->doorbell_fd);
+}
+
+int shm_channel_end_read(ShmChannel* channel) {
+    atomic_store_explicit(&channel->rx->reader_waiting, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    return rx_available(channel) != 0;
+}
+
+void shm_channel_wake(ShmChannel* channel) {
+    ring_doorbell(channel->doorbell_fd);
+}
+
+int shm_channel_wait(ShmChannel* channel, int timeout_ms) {
+    if (shm_channel_end_read(channel)) {
+        return 1;
+    }
+    return wait_doorbell(channel, timeout_ms);
+}
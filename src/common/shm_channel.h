@@ -0,0 +1,153 @@
+/**
+ * @file shm_channel.h
+ * @brief Shared-memory frame transport for same-host connections
+ *
+ * A channel is a pair of single-producer/single-consumer byte rings in one
+ * memfd mapping, one ring per direction, carrying exactly the frames a
+ * socket would. The server creates it for every connection accepted in
+ * SOCKET_MODE_SHM and passes the memfd and two eventfd doorbells to the
+ * client with SCM_RIGHTS; afterwards the unix socket only reports that the
+ * peer went away.
+ *
+ * A side rings the other's doorbell only after the other announced that it
+ * is about to sleep (reader: ring empty, writer: ring full), so a busy
+ * pipeline moves frames without any system call.
+ */
+
+#ifndef SHM_CHANNEL_H
+#define SHM_CHANNEL_H
+
+#include "protocol.h"
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define SHM_RING_DEFAULT_SIZE (1024 * 1024)    ///< Bytes per direction
+#define SHM_RING_MIN_SIZE 4096
+#define SHM_RING_MAX_SIZE (1024 * 1024 * 1024)
+
+typedef struct ShmChannel ShmChannel;
+
+/**
+ * @brief Create a channel and hand it to the client connected on sock (server side)
+ * @param sock Connected unix socket
+ * @param ring_size Bytes per direction (rounded up to a power of two)
+ * @return Channel on success, NULL on error
+ */
+ShmChannel* shm_channel_create(int sock, size_t ring_size);
+
+/**
+ * @brief Receive and map the channel offered by the server (client side)
+ * @param sock Connected unix socket (a receive timeout bounds the wait)
+ * @return Channel on success, NULL on error
+ */
+ShmChannel* shm_channel_attach(int sock);
+
+/**
+ * @brief Unmap the channel and close its doorbells (the socket is left open)
+ */
+void shm_channel_destroy(ShmChannel* channel);
+
+/**
+ * @brief Doorbell descriptor to watch for readability (data or space from the peer)
+ */
+int shm_channel_fd(const ShmChannel* channel);
+
+/**
+ * @brief Bytes per direction
+ */
+size_t shm_channel_ring_size(const ShmChannel* channel);
+
+/**
+ * @brief Bytes the peer wrote that were not consumed yet
+ */
+size_t shm_channel_backlog(const ShmChannel* channel);
+
+/**
+ * @brief Bytes we wrote that the peer has not consumed yet
+ *
+ * A send of up to ring size minus this many bytes completes without waiting.
+ */
+size_t shm_channel_unread(const ShmChannel* channel);
+
+/**
+ * @brief Decompression counters for received frames (NULL = not collected)
+ */
+void shm_channel_set_stats(ShmChannel* channel, CompressionStats* stats);
+
+/**
+ * @brief Checks beyond the checksum to run on received frames (INTEGRITY_UTF8 or 0)
+ */
+void shm_channel_set_validation(ShmChannel* channel, unsigned validate);
+
+/**
+ * @brief Largest payload to accept, before or after decompression (default MSG_DEFAULT_MAX_FRAME_SIZE, 0 = unlimited)
+ */
+void shm_channel_set_max_payload(ShmChannel* channel, uint64_t max_payload);
+
+/**
+ * @brief Announced length of the frame the last shm_channel_next refused as too large (0 = none)
+ */
+uint64_t shm_channel_oversized(const ShmChannel* channel);
+
+/**
+ * @brief INTEGRITY_* check the frame refused by the last shm_channel_next failed (0 = none)
+ */
+unsigned shm_channel_rejected(const ShmChannel* channel);
+
+/**
+ * @brief Write a frame, waiting for the reader while the ring is full
+ *
+ * A frame that fits in the ring is published whole: on timeout nothing was
+ * written and the channel stays usable. A larger frame is streamed as the
+ * reader makes room; if that is cut short, the channel refuses every
+ * further send.
+ * @param timeout_ms Longest wait for ring space in total (0 = do not wait)
+ * @return 0 on success, -1 on timeout, peer close or corrupted ring
+ */
+int shm_channel_send(ShmChannel* channel, const Message* msg, int timeout_ms);
+
+/**
+ * @brief Copy as much of a byte stream as fits into the ring, without waiting (event-loop use)
+ *
+ * Unlike shm_channel_send, a frame may be published in pieces: the caller
+ * keeps the rest and writes it next, like on a non-blocking socket. When
+ * the ring is full the peer rings our doorbell once it releases space.
+ * @return Bytes written (0 if the ring is full), -1 on a corrupted ring
+ */
+ssize_t shm_channel_write(ShmChannel* channel, const struct iovec* iov, int iovcnt);
+
+/**
+ * @brief Extract the next complete frame without blocking
+ *
+ * Frames larger than the ring are assembled across calls. A frame above
+ * the max payload is refused from its header, before anything is
+ * allocated. Checksummed frames are verified before they are handed out.
+ * @param msg Output message (must be freed with message_free)
+ * @return 1 if a frame was produced, 0 if more data is needed, -1 on protocol error
+ */
+int shm_channel_next(ShmChannel* channel, Message* msg);
+
+/**
+ * @brief Reset the doorbell after it fired (event-loop use)
+ */
+void shm_channel_begin_read(ShmChannel* channel);
+
+/**
+ * @brief Announce that the reader goes back to sleep (event-loop use)
+ * @return 1 if data arrived in the meantime and must be read first, 0 otherwise
+ */
+int shm_channel_end_read(ShmChannel* channel);
+
+/**
+ * @brief Ring our own doorbell so the event loop comes back to this channel
+ */
+void shm_channel_wake(ShmChannel* channel);
+
+/**
+ * @brief Block until data arrives (client use)
+ * @return 1 when woken, 0 on timeout, -1 on error or peer close
+ */
+int shm_channel_wait(ShmChannel* channel, int timeout_ms);
+
+#endif // SHM_CHANNEL_H
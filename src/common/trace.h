@@ -0,0 +1,82 @@
+/**
+ * @file trace.h
+ * @brief Static trace probes (USDT), compiled out unless built with TRACE=1
+ *
+ * With ENABLE_TRACE a probe is a single nop plus an ELF note in the
+ * .note.stapsdt format of systemtap's <sys/sdt.h>, so perf, bpftrace and
+ * bcc find the probes in the binary (provider "ipc") and can attach
+ * without recompiling:
+ *
+ *     bpftrace -e 'usdt:./run_server:ipc:handler_start { @t[arg0] = nsecs; }
+ *                  usdt:./run_server:ipc:handler_done /@t[arg0]/ {
+ *                      @us = hist((nsecs - @t[arg0]) / 1000); delete(@t[arg0]); }'
+ *
+ * A probe nobody is attached to costs the nop and keeping its arguments
+ * in registers. Every argument is passed as a 64-bit unsigned value.
+ * Without ENABLE_TRACE the macros expand to nothing and their arguments
+ * are not evaluated.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#ifdef ENABLE_TRACE
+
+#include <stdint.h>
+
+#if !defined(__GNUC__) || !(defined(__x86_64__) || defined(__aarch64__))
+#error "USDT probes need GCC or Clang on x86-64 or AArch64"
+#endif
+
+/*
+ * The note records the probe address, the address of a .stapsdt.base
+ * marker (tools use it to relocate the probe address in prelinked or
+ * position-independent binaries), an unused semaphore and the argument
+ * locations as the assembler operands print them ("8@%rdi", "8@-24(%rbp)",
+ * "8@$3" or "8@x1").
+ */
+#define TRACE_NOTE_(name, args)                                                         \
+    "990: nop\n"                                                                        \
+    ".pushsection .note.stapsdt,\"?\",\"note\"\n"                                       \
+    ".balign 4\n"                                                                       \
+    ".4byte 992f-991f, 994f-993f, 3\n"                                                  \
+    "991: .asciz \"stapsdt\"\n"                                                         \
+    "992: .balign 4\n"                                                                  \
+    "993: .8byte 990b\n"                                                                \
+    ".8byte _.stapsdt.base\n"                                                           \
+    ".8byte 0\n"                                                                        \
+    ".asciz \"ipc\"\n"                                                                  \
+    ".asciz \"" #name "\"\n"                                                            \
+    ".asciz \"" args "\"\n"                                                             \
+    "994: .balign 4\n"                                                                  \
+    ".popsection\n"                                                                     \
+    ".ifndef _.stapsdt.base\n"                                                          \
+    ".pushsection .stapsdt.base, \"aG\", \"progbits\", .stapsdt.base, comdat\n"         \
+    ".weak _.stapsdt.base\n"                                                            \
+    ".hidden _.stapsdt.base\n"                                                          \
+    "_.stapsdt.base: .space 1\n"                                                        \
+    ".size _.stapsdt.base, 1\n"                                                         \
+    ".popsection\n"                                                                     \
+    ".endif\n"
+
+#define TRACE_PROBE0(name) \
+    __asm__ __volatile__(TRACE_NOTE_(name, "") ::)
+#define TRACE_PROBE1(name, a) \
+    __asm__ __volatile__(TRACE_NOTE_(name, "8@%[a0]") :: [a0] "nor"((uint64_t)(a)))
+#define TRACE_PROBE2(name, a, b) \
+    __asm__ __volatile__(TRACE_NOTE_(name, "8@%[a0] 8@%[a1]") :: [a0] "nor"((uint64_t)(a)), \
+                         [a1] "nor"((uint64_t)(b)))
+#define TRACE_PROBE3(name, a, b, c) \
+    __asm__ __volatile__(TRACE_NOTE_(name, "8@%[a0] 8@%[a1] 8@%[a2]") :: [a0] "nor"((uint64_t)(a)), \
+                         [a1] "nor"((uint64_t)(b)), [a2] "nor"((uint64_t)(c)))
+
+#else
+
+#define TRACE_PROBE0(name) ((void)0)
+#define TRACE_PROBE1(name, a) ((void)0)
+#define TRACE_PROBE2(name, a, b) ((void)0)
+#define TRACE_PROBE3(name, a, b, c) ((void)0)
+
+#endif // ENABLE_TRACE
+
+#endif // TRACE_H
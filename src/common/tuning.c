@@ -0,0 +1,244 @@
+/**
+ * @file tuning.c
+ * @brief Socket and thread tuning profiles
+ */
+
+#define _GNU_SOURCE
+#include "tuning.h"
+#include "logger.h"
+#include "utils.h"
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define THROUGHPUT_BUFFER_SIZE (4 * 1024 * 1024)
+#define LATENCY_BUSY_POLL_US 50
+
+/**
+ * @brief Options a profile sets, before overrides
+ */
+static void profile_values(TuningProfile profile, TuningOptions* values) {
+    values->nodelay = 0;
+    values->quickack = 0;
+    values->sndbuf = 0;
+    values->rcvbuf = 0;
+    values->busy_poll_us = 0;
+    values->defer_accept_sec = 0;
+    if (profile == TUNING_PROFILE_LATENCY) {
+        values->nodelay = 1;
+        values->quickack = 1;
+        values->busy_poll_us = LATENCY_BUSY_POLL_US;
+    } else if (profile == TUNING_PROFILE_THROUGHPUT) {
+        values->sndbuf = THROUGHPUT_BUFFER_SIZE;
+        values->rcvbuf = THROUGHPUT_BUFFER_SIZE;
+    }
+}
+
+/**
+ * @brief Profile values with the overrides applied
+ */
+static void resolve(const TuningOptions* tuning, TuningOptions* out) {
+    profile_values(tuning->profile, out);
+    if (tuning->nodelay != TUNING_UNSET) out->nodelay = tuning->nodelay;
+    if (tuning->quickack != TUNING_UNSET) out->quickack = tuning->quickack;
+    if (tuning->sndbuf != TUNING_UNSET) out->sndbuf = tuning->sndbuf;
+    if (tuning->rcvbuf != TUNING_UNSET) out->rcvbuf = tuning->rcvbuf;
+    if (tuning->busy_poll_us != TUNING_UNSET) out->busy_poll_us = tuning->busy_poll_us;
+    if (tuning->defer_accept_sec != TUNING_UNSET) out->defer_accept_sec = tuning->defer_accept_sec;
+}
+
+/**
+ * @brief Set one option; a refusal is logged once per option, not fatal
+ */
+static void set_option(int fd, int level, int name, int value, const char* label, atomic_int* warned) {
+    if (setsockopt(fd, level, name, &value, sizeof(value)) < 0 && !atomic_exchange(warned, 1)) {
+        logger_warn("Could not set %s=%d: %s", label, value, get_error_string(errno));
+    }
+}
+
+static atomic_int warned_nodelay, warned_quickack, warned_sndbuf, warned_rcvbuf, warned_busy_poll, warned_defer;
+
+void tuning_init(TuningOptions* tuning) {
+    memset(tuning, 0, sizeof(TuningOptions));
+    tuning->profile = TUNING_PROFILE_DEFAULT;
+    tuning->nodelay = TUNING_UNSET;
+    tuning->quickack = TUNING_UNSET;
+    tuning->sndbuf = TUNING_UNSET;
+    tuning->rcvbuf = TUNING_UNSET;
+    tuning->busy_poll_us = TUNING_UNSET;
+    tuning->defer_accept_sec = TUNING_UNSET;
+    tuning->cpu_count = 0;
+}
+
+static int parse_profile(const char* name, TuningProfile* profile) {
+    if (strcmp(name, "default") == 0) {
+        *profile = TUNING_PROFILE_DEFAULT;
+    } else if (strcmp(name, "latency") == 0) {
+        *profile = TUNING_PROFILE_LATENCY;
+    } else if (strcmp(name, "throughput") == 0) {
+        *profile = TUNING_PROFILE_THROUGHPUT;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Parse a comma-separated CPU list ("2,3,6")
+ * @return 0 on success, -1 on a malformed list (nothing is changed)
+ */
+static int parse_cpus(TuningOptions* tuning, const char* list) {
+    int cpus[TUNING_MAX_CPUS];
+    size_t count = 0;
+    const char* p = list;
+    while (*p) {
+        char* end;
+        long cpu = strtol(p, &end, 10);
+        if (end == p || cpu < 0 || cpu >= CPU_SETSIZE || count >= TUNING_MAX_CPUS) {
+            return -1;
+        }
+        cpus[count++] = (int)cpu;
+        p = end;
+        if (*p == ',') {
+            p++;
+        } else if (*p) {
+            return -1;
+        }
+    }
+    memcpy(tuning->cpus, cpus, count * sizeof(int));
+    tuning->cpu_count = count;
+    return 0;
+}
+
+/**
+ * @brief Parse a non-negative integer option value
+ */
+static int parse_int(const char* value, int* out) {
+    char* end;
+    long parsed = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || parsed < 0 || parsed > INT_MAX) {
+        return -1;
+    }
+    *out = (int)parsed;
+    return 0;
+}
+
+int tuning_parse_option(TuningOptions* tuning, const char* key, const char* value) {
+    if (strcmp(key, "profile") == 0) {
+        parse_profile(value, &tuning->profile);
+    } else if (strcmp(key, "tcp_nodelay") == 0) {
+        parse_int(value, &tuning->nodelay);
+    } else if (strcmp(key, "tcp_quickack") == 0) {
+        parse_int(value, &tuning->quickack);
+    } else if (strcmp(key, "so_sndbuf") == 0) {
+        parse_int(value, &tuning->sndbuf);
+    } else if (strcmp(key, "so_rcvbuf") == 0) {
+        parse_int(value, &tuning->rcvbuf);
+    } else if (strcmp(key, "busy_poll_us") == 0) {
+        parse_int(value, &tuning->busy_poll_us);
+    } else if (strcmp(key, "defer_accept_sec") == 0) {
+        parse_int(value, &tuning->defer_accept_sec);
+    } else if (strcmp(key, "cpu_affinity") == 0) {
+        parse_cpus(tuning, value);
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+const char* tuning_profile_name(TuningProfile profile) {
+    switch (profile) {
+        case TUNING_PROFILE_LATENCY: return "latency";
+        case TUNING_PROFILE_THROUGHPUT: return "throughput";
+        default: return "default";
+    }
+}
+
+void tuning_apply_socket(int fd, const TuningOptions* tuning) {
+    TuningOptions values;
+    resolve(tuning, &values);
+    
+    // Only explicit values are written, so the default profile changes nothing
+    if (values.nodelay || tuning->nodelay != TUNING_UNSET) {
+        set_option(fd, IPPROTO_TCP, TCP_NODELAY, values.nodelay != 0, "TCP_NODELAY", &warned_nodelay);
+    }
+    if (values.sndbuf > 0) {
+        set_option(fd, SOL_SOCKET, SO_SNDBUF, values.sndbuf, "SO_SNDBUF", &warned_sndbuf);
+    }
+    if (values.rcvbuf > 0) {
+        set_option(fd, SOL_SOCKET, SO_RCVBUF, values.rcvbuf, "SO_RCVBUF", &warned_rcvbuf);
+    }
+#ifdef SO_BUSY_POLL
+    if (values.busy_poll_us > 0) {
+        set_option(fd, SOL_SOCKET, SO_BUSY_POLL, values.busy_poll_us, "SO_BUSY_POLL", &warned_busy_poll);
+    }
+#endif
+}
+
+void tuning_apply_listener(int fd, const TuningOptions* tuning) {
+    tuning_apply_socket(fd, tuning);
+    
+    TuningOptions values;
+    resolve(tuning, &values);
+    if (values.defer_accept_sec > 0) {
+        // Connections are only reported once the client has sent something
+        set_option(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, values.defer_accept_sec, "TCP_DEFER_ACCEPT",
+                   &warned_defer);
+    }
+}
+
+void tuning_apply_connected(int fd, const TuningOptions* tuning) {
+    TuningOptions values;
+    resolve(tuning, &values);
+    if (values.quickack) {
+        set_option(fd, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK", &warned_quickack);
+    }
+}
+
+static int get_option(int fd, int level, int name) {
+    int value = 0;
+    socklen_t length = sizeof(value);
+    if (getsockopt(fd, level, name, &value, &length) < 0) {
+        return -1;
+    }
+    return value;
+}
+
+size_t tuning_describe(int fd, const TuningOptions* tuning, char* buf, size_t cap) {
+    int busy_poll = 0;
+#ifdef SO_BUSY_POLL
+    busy_poll = get_option(fd, SOL_SOCKET, SO_BUSY_POLL);
+#endif
+    int written = snprintf(buf, cap, "profile=%s nodelay=%d quickack=%d sndbuf=%d rcvbuf=%d busy_poll_us=%d",
+                           tuning_profile_name(tuning->profile), get_option(fd, IPPROTO_TCP, TCP_NODELAY),
+                           get_option(fd, IPPROTO_TCP, TCP_QUICKACK), get_option(fd, SOL_SOCKET, SO_SNDBUF),
+                           get_option(fd, SOL_SOCKET, SO_RCVBUF), busy_poll);
+    if (written < 0) {
+        return 0;
+    }
+    return (size_t)written < cap ? (size_t)written : cap - 1;
+}
+
+int tuning_pin_thread(const TuningOptions* tuning, size_t index) {
+    if (tuning->cpu_count == 0) {
+        return -1;
+    }
+    int cpu = tuning->cpus[index % tuning->cpu_count];
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (result != 0) {
+        logger_warn("Could not pin thread to CPU %d: %s", cpu, get_error_string(result));
+        return -1;
+    }
+    return cpu;
+}
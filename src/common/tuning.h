@@ -0,0 +1,98 @@
+/**
+ * @file tuning.h
+ * @brief Socket and thread tuning profiles
+ *
+ * A profile picks a consistent set of TCP socket options: `latency`
+ * disables Nagle, acknowledges immediately and busy-polls the device
+ * queue; `throughput` keeps Nagle and enlarges the socket buffers. Any
+ * option can be overridden on its own. Options that the kernel refuses
+ * (busy polling above net.core.busy_read needs CAP_NET_ADMIN) are logged
+ * and skipped, never fatal; tuning_describe reads back what is in effect.
+ */
+
+#ifndef TUNING_H
+#define TUNING_H
+
+#include <stddef.h>
+
+#define TUNING_MAX_CPUS 64
+#define TUNING_UNSET -1             ///< Override not given: the profile decides
+
+/**
+ * @brief Named option sets
+ */
+typedef enum {
+    TUNING_PROFILE_DEFAULT,     ///< Kernel defaults
+    TUNING_PROFILE_LATENCY,     ///< TCP_NODELAY, TCP_QUICKACK, 50 us SO_BUSY_POLL
+    TUNING_PROFILE_THROUGHPUT   ///< Nagle kept, 4 MiB SO_SNDBUF and SO_RCVBUF
+} TuningProfile;
+
+/**
+ * @brief Profile plus explicit overrides (TUNING_UNSET = from the profile)
+ */
+typedef struct {
+    TuningProfile profile;
+    int nodelay;            ///< TCP_NODELAY
+    int quickack;           ///< TCP_QUICKACK once connected
+    int sndbuf;             ///< SO_SNDBUF in bytes (0 = kernel default)
+    int rcvbuf;             ///< SO_RCVBUF in bytes (0 = kernel default)
+    int busy_poll_us;       ///< SO_BUSY_POLL (0 = off)
+    int defer_accept_sec;   ///< TCP_DEFER_ACCEPT on listeners (0 = off)
+    int cpus[TUNING_MAX_CPUS];  ///< CPUs for the event-loop threads, used in turn
+    size_t cpu_count;       ///< 0 = no pinning
+} TuningOptions;
+
+/**
+ * @brief Default profile, no overrides, no pinning
+ */
+void tuning_init(TuningOptions* tuning);
+
+/**
+ * @brief Apply one configuration key
+ *
+ * Keys: profile (default, latency, throughput), tcp_nodelay, tcp_quickack,
+ * so_sndbuf, so_rcvbuf, busy_poll_us, defer_accept_sec and cpu_affinity
+ * (comma-separated CPU list). Malformed values are ignored.
+ * @return 1 if key is a tuning key, 0 if not
+ */
+int tuning_parse_option(TuningOptions* tuning, const char* key, const char* value);
+
+const char* tuning_profile_name(TuningProfile profile);
+
+/**
+ * @brief Apply the options to a TCP socket before connect or listen
+ *
+ * Buffer sizes must be set this early to take part in window scaling.
+ * Accepted sockets inherit everything set on their listener.
+ */
+void tuning_apply_socket(int fd, const TuningOptions* tuning);
+
+/**
+ * @brief Apply the options to a listening TCP socket (before listen)
+ */
+void tuning_apply_listener(int fd, const TuningOptions* tuning);
+
+/**
+ * @brief Apply the options that only work on an established connection
+ *
+ * That is TCP_QUICKACK, which is neither inherited nor sticky: the kernel
+ * may return to delayed ACKs later.
+ */
+void tuning_apply_connected(int fd, const TuningOptions* tuning);
+
+/**
+ * @brief Describe the options in effect on a socket, as read back from the kernel
+ *
+ * SO_SNDBUF and SO_RCVBUF read back doubled: the kernel adds room for its
+ * own bookkeeping.
+ * @return Length of the text written to buf
+ */
+size_t tuning_describe(int fd, const TuningOptions* tuning, char* buf, size_t cap);
+
+/**
+ * @brief Pin the calling thread to CPU cpus[index % cpu_count]
+ * @return The CPU, -1 if no pinning is configured or it failed
+ */
+int tuning_pin_thread(const TuningOptions* tuning, size_t index);
+
+#endif // TUNING_H
@@ -11,8 +11,20 @@
  */
 typedef enum {
     SOCKET_MODE_UNIX,   ///< AF_UNIX (Unix domain socket)
-    SOCKET_MODE_INET    ///< AF_INET (Internet socket)
+    SOCKET_MODE_INET,   ///< AF_INET (Internet socket)
+    SOCKET_MODE_SHM     ///< Shared-memory rings set up over an AF_UNIX socket
 } SocketMode;
 
+/**
+ * @brief Configuration name of a socket mode
+ */
+static inline const char* socket_mode_name(SocketMode mode) {
+    switch (mode) {
+        case SOCKET_MODE_UNIX: return "unix";
+        case SOCKET_MODE_SHM: return "shm";
+        default: return "inet";
+    }
+}
+
 #endif // TYPES_H
 
@@ -4,11 +4,13 @@
  */
 
 #define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
 #include "utils.h"
 #include <string.h>
 #include <errno.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <time.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <stdlib.h>
@@ -19,8 +21,22 @@ char* parse_address(const char* address, uint16_t* port) {
         return NULL;
     }
     
+    // "[v6]:port": the host is what is inside the brackets
+    if (addr_copy[0] == '[') {
+        char* close = strchr(addr_copy, ']');
+        if (close) {
+            *close = '\0';
+            if (close[1] == ':') {
+                *port = (uint16_t)atoi(close + 2);
+            }
+            memmove(addr_copy, addr_copy + 1, strlen(addr_copy + 1) + 1);
+        }
+        return addr_copy;
+    }
+    
+    // More than one colon: a bare IPv6 literal without port
     char* colon = strchr(addr_copy, ':');
-    if (colon) {
+    if (colon && !strchr(colon + 1, ':')) {
         *colon = '\0';
         char* port_str = colon + 1;
         *port = (uint16_t)atoi(port_str);
@@ -54,6 +70,47 @@ int set_socket_reuse(int fd) {
     return 0;
 }
 
+int set_socket_reuse_port(int fd) {
+#ifdef SO_REUSEPORT
+    int opt = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        return -1;
+    }
+    return 0;
+#else
+    (void)fd;
+    errno = ENOPROTOOPT;
+    return -1;
+#endif
+}
+
+uint64_t get_monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+void sleep_ms(unsigned ms) {
+    struct timespec ts;
+    ts.tv_sec = ms / 1000u;
+    ts.tv_nsec = (long)(ms % 1000u) * 1000000L;
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {
+        // ts now holds the time left
+    }
+}
+
+uint64_t get_monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t get_thread_cpu_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
 const char* get_error_string(int errnum) {
     return strerror(errnum);
 }
@@ -14,18 +14,22 @@
 #include <sys/un.h>
 
 /**
- * @brief Socket address union for AF_UNIX and AF_INET
+ * @brief Socket address union for AF_UNIX, AF_INET and AF_INET6
  */
 typedef union {
     struct sockaddr_un unix_addr;
     struct sockaddr_in inet_addr;
+    struct sockaddr_in6 inet6_addr;
     struct sockaddr generic;
 } SocketAddress;
 
 /**
- * @brief Parse IPv4 address and port
- * @param address String in format "host:port" or just "host"
- * @param port Port number (output parameter)
+ * @brief Split an address into host and port
+ *
+ * IPv6 literals with a port are written in brackets ("[::1]:8080"); a
+ * bare IPv6 literal ("::1") has no port.
+ * @param address String in format "host:port", "[ipv6]:port" or just "host"
+ * @param port Port number (output parameter, left alone when there is none)
  * @return Host address string (must be freed by caller)
  */
 char* parse_address(const char* address, uint16_t* port);
@@ -45,6 +49,33 @@ int set_socket_timeout(int fd, int timeout_sec);
  */
 int set_socket_reuse(int fd);
 
+/**
+ * @brief Enable SO_REUSEPORT (kernel load-balances accepts across sockets)
+ * @param fd Socket file descriptor
+ * @return 0 on success, -1 on error
+ */
+int set_socket_reuse_port(int fd);
+
+/**
+ * @brief Monotonic clock in milliseconds (for timeouts and deadlines)
+ */
+uint64_t get_monotonic_ms(void);
+
+/**
+ * @brief Monotonic clock in nanoseconds (system-wide, comparable across processes on one host)
+ */
+uint64_t get_monotonic_ns(void);
+
+/**
+ * @brief Sleep for ms milliseconds (resumed after signals)
+ */
+void sleep_ms(unsigned ms);
+
+/**
+ * @brief CPU time consumed by the calling thread, in nanoseconds
+ */
+uint64_t get_thread_cpu_ns(void);
+
 /**
  * @brief Get error string from errno
  */
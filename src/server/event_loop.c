@@ -0,0 +1,283 @@
+/**
+ * @file event_loop.c
+ * @brief Event-loop backends (epoll and poll)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include "event_loop.h"
+#include "../common/logger.h"
+#include <sys/epoll.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct EventLoop {
+    IoBackend backend;
+    int edge_triggered;
+    
+    // epoll backend
+    int epoll_fd;
+    struct epoll_event* epoll_events;
+    int epoll_capacity;
+    
+    // poll backend: dense pollfd array, fd -> slot map
+    struct pollfd* pollfds;
+    void** poll_data;
+    size_t poll_count;
+    size_t poll_capacity;
+    int* slot_of_fd;
+    size_t slot_map_size;
+};
+
+const char* io_backend_name(IoBackend backend) {
+    switch (backend) {
+        case IO_BACKEND_POLL: return "poll";
+        case IO_BACKEND_EPOLL: return "epoll";
+        case IO_BACKEND_URING: return "uring";
+        default: return "unknown";
+    }
+}
+
+static uint32_t to_epoll_events(const EventLoop* loop, uint32_t events) {
+    uint32_t ev = 0;
+    if (events & EVENT_READ) ev |= EPOLLIN | EPOLLRDHUP;
+    if (events & EVENT_WRITE) ev |= EPOLLOUT;
+    // EPOLLEXCLUSIVE only accepts EPOLLIN/EPOLLOUT/EPOLLET
+    if (events & EVENT_EXCLUSIVE) ev = (ev & ~EPOLLRDHUP) | EPOLLEXCLUSIVE;
+    if (loop->edge_triggered) ev |= EPOLLET;
+    return ev;
+}
+
+static short to_poll_events(uint32_t events) {
+    short ev = 0;
+    if (events & EVENT_READ) ev |= POLLIN;
+    if (events & EVENT_WRITE) ev |= POLLOUT;
+    return ev;
+}
+
+EventLoop* event_loop_create(IoBackend backend, int edge_triggered) {
+    // io_uring is completion-based and has no readiness loop
+    if (backend == IO_BACKEND_URING) {
+        errno = EINVAL;
+        return NULL;
+    }
+    
+    EventLoop* loop = calloc(1, sizeof(EventLoop));
+    if (!loop) {
+        return NULL;
+    }
+    loop->backend = backend;
+    loop->epoll_fd = -1;
+    
+    if (backend == IO_BACKEND_EPOLL) {
+        loop->edge_triggered = edge_triggered;
+        loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (loop->epoll_fd < 0) {
+            free(loop);
+            return NULL;
+        }
+    } else if (edge_triggered) {
+        logger_warn("Edge-triggered mode requires epoll; using level-triggered poll()");
+    }
+    
+    return loop;
+}
+
+void event_loop_destroy(EventLoop* loop) {
+    if (!loop) return;
+    
+    if (loop->epoll_fd >= 0) {
+        close(loop->epoll_fd);
+    }
+    free(loop->epoll_events);
+    free(loop->pollfds);
+    free(loop->poll_data);
+    free(loop->slot_of_fd);
+    free(loop);
+}
+
+static int poll_ensure_slot_map(EventLoop* loop, int fd) {
+    if ((size_t)fd < loop->slot_map_size) {
+        return 0;
+    }
+    size_t new_size = loop->slot_map_size == 0 ? 64 : loop->slot_map_size;
+    while (new_size <= (size_t)fd) {
+        new_size *= 2;
+    }
+    int* new_map = realloc(loop->slot_of_fd, new_size * sizeof(int));
+    if (!new_map) {
+        return -1;
+    }
+    for (size_t i = loop->slot_map_size; i < new_size; i++) {
+        new_map[i] = -1;
+    }
+    loop->slot_of_fd = new_map;
+    loop->slot_map_size = new_size;
+    return 0;
+}
+
+static int poll_add(EventLoop* loop, int fd, uint32_t events, void* data) {
+    if (poll_ensure_slot_map(loop, fd) < 0) {
+        return -1;
+    }
+    if (loop->slot_of_fd[fd] >= 0) {
+        errno = EEXIST;
+        return -1;
+    }
+    
+    if (loop->poll_count >= loop->poll_capacity) {
+        size_t new_capacity = loop->poll_capacity == 0 ? 16 : loop->poll_capacity * 2;
+        struct pollfd* new_pollfds = realloc(loop->pollfds, new_capacity * sizeof(struct pollfd));
+        if (!new_pollfds) {
+            return -1;
+        }
+        loop->pollfds = new_pollfds;
+        void** new_data = realloc(loop->poll_data, new_capacity * sizeof(void*));
+        if (!new_data) {
+            return -1;
+        }
+        loop->poll_data = new_data;
+        loop->poll_capacity = new_capacity;
+    }
+    
+    size_t slot = loop->poll_count++;
+    loop->pollfds[slot].fd = fd;
+    loop->pollfds[slot].events = to_poll_events(events);
+    loop->pollfds[slot].revents = 0;
+    loop->poll_data[slot] = data;
+    loop->slot_of_fd[fd] = (int)slot;
+    return 0;
+}
+
+static int poll_slot(const EventLoop* loop, int fd) {
+    if (fd < 0 || (size_t)fd >= loop->slot_map_size) {
+        return -1;
+    }
+    return loop->slot_of_fd[fd];
+}
+
+static int poll_modify(EventLoop* loop, int fd, uint32_t events, void* data) {
+    int slot = poll_slot(loop, fd);
+    if (slot < 0) {
+        errno = ENOENT;
+        return -1;
+    }
+    loop->pollfds[slot].events = to_poll_events(events);
+    loop->poll_data[slot] = data;
+    return 0;
+}
+
+static int poll_remove(EventLoop* loop, int fd) {
+    int slot = poll_slot(loop, fd);
+    if (slot < 0) {
+        errno = ENOENT;
+        return -1;
+    }
+    
+    // Move the last entry into the freed slot
+    size_t last = loop->poll_count - 1;
+    if ((size_t)slot != last) {
+        loop->pollfds[slot] = loop->pollfds[last];
+        loop->poll_data[slot] = loop->poll_data[last];
+        loop->slot_of_fd[loop->pollfds[slot].fd] = slot;
+    }
+    loop->slot_of_fd[fd] = -1;
+    loop->poll_count--;
+    return 0;
+}
+
+static int poll_wait(EventLoop* loop, LoopEvent* events, int max_events, int timeout_ms) {
+    int result = poll(loop->pollfds, loop->poll_count, timeout_ms);
+    if (result <= 0) {
+        return result;
+    }
+    
+    int n = 0;
+    for (size_t i = 0; i < loop->poll_count && n < max_events && result > 0; i++) {
+        short revents = loop->pollfds[i].revents;
+        if (!revents) continue;
+        result--;
+        
+        uint32_t ev = 0;
+        if (revents & POLLIN) ev |= EVENT_READ;
+        if (revents & POLLOUT) ev |= EVENT_WRITE;
+        if (revents & (POLLHUP | POLLERR | POLLNVAL)) ev |= EVENT_ERROR;
+        
+        events[n].events = ev;
+        events[n].data = loop->poll_data[i];
+        n++;
+    }
+    return n;
+}
+
+static int epoll_wait_events(EventLoop* loop, LoopEvent* events, int max_events, int timeout_ms) {
+    if (max_events > loop->epoll_capacity) {
+        struct epoll_event* new_events = realloc(loop->epoll_events, max_events * sizeof(struct epoll_event));
+        if (!new_events) {
+            return -1;
+        }
+        loop->epoll_events = new_events;
+        loop->epoll_capacity = max_events;
+    }
+    
+    int result = epoll_wait(loop->epoll_fd, loop->epoll_events, max_events, timeout_ms);
+    for (int i = 0; i < result; i++) {
+        uint32_t revents = loop->epoll_events[i].events;
+        uint32_t ev = 0;
+        if (revents & EPOLLIN) ev |= EVENT_READ;
+        if (revents & EPOLLOUT) ev |= EVENT_WRITE;
+        if (revents & (EPOLLHUP | EPOLLERR)) ev |= EVENT_ERROR;
+        // Peer shutdown: report as readable so buffered data is drained first
+        if (revents & EPOLLRDHUP) ev |= EVENT_READ;
+        
+        events[i].events = ev;
+        events[i].data = loop->epoll_events[i].data.ptr;
+    }
+    return result;
+}
+
+int event_loop_add(EventLoop* loop, int fd, uint32_t events, void* data) {
+    if (loop->backend == IO_BACKEND_EPOLL) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = to_epoll_events(loop, events);
+        ev.data.ptr = data;
+        return epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    }
+    return poll_add(loop, fd, events, data);
+}
+
+int event_loop_modify(EventLoop* loop, int fd, uint32_t events, void* data) {
+    if (loop->backend == IO_BACKEND_EPOLL) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = to_epoll_events(loop, events & ~EVENT_EXCLUSIVE);
+        ev.data.ptr = data;
+        return epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+    }
+    return poll_modify(loop, fd, events, data);
+}
+
+int event_loop_remove(EventLoop* loop, int fd) {
+    if (loop->backend == IO_BACKEND_EPOLL) {
+        return epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    }
+    return poll_remove(loop, fd);
+}
+
+int event_loop_wait(EventLoop* loop, LoopEvent* events, int max_events, int timeout_ms) {
+    if (max_events <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (loop->backend == IO_BACKEND_EPOLL) {
+        return epoll_wait_events(loop, events, max_events, timeout_ms);
+    }
+    return poll_wait(loop, events, max_events, timeout_ms);
+}
+
+int event_loop_is_edge_triggered(const EventLoop* loop) {
+    return loop ? loop->edge_triggered : 0;
+}
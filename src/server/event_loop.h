@@ -0,0 +1,98 @@
+/**
+ * @file event_loop.h
+ * @brief Pluggable event-loop backend
+ *
+ * Readiness notification for the server reactor. File descriptors are
+ * registered once and stay registered until removed, so a wakeup only
+ * costs as much as the number of ready descriptors (epoll) instead of
+ * the number of connections.
+ */
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdint.h>
+
+/**
+ * @brief I/O backend enumeration
+ */
+typedef enum {
+    IO_BACKEND_POLL,    ///< poll() fallback (portable, level-triggered only)
+    IO_BACKEND_EPOLL,   ///< epoll (Linux)
+    IO_BACKEND_URING    ///< io_uring completions (Linux 6.0+, driven by the server, not EventLoop)
+} IoBackend;
+
+/**
+ * @brief Event flags
+ */
+#define EVENT_READ  0x01u   ///< Descriptor is readable
+#define EVENT_WRITE 0x02u   ///< Descriptor is writable
+#define EVENT_ERROR 0x04u   ///< Hang-up or error condition
+#define EVENT_EXCLUSIVE 0x08u  ///< Wake only one loop for a shared fd (epoll only, add only)
+
+/**
+ * @brief Ready event returned by event_loop_wait
+ */
+typedef struct {
+    uint32_t events;    ///< EVENT_* flags
+    void* data;         ///< User data given at registration
+} LoopEvent;
+
+typedef struct EventLoop EventLoop;
+
+/**
+ * @brief Create event loop
+ * @param backend Backend to use
+ * @param edge_triggered Use edge-triggered notification (epoll only)
+ * @return Event loop on success, NULL on error
+ */
+EventLoop* event_loop_create(IoBackend backend, int edge_triggered);
+
+/**
+ * @brief Destroy event loop (registered descriptors are not closed)
+ */
+void event_loop_destroy(EventLoop* loop);
+
+/**
+ * @brief Register file descriptor
+ * @param loop Event loop
+ * @param fd File descriptor
+ * @param events EVENT_READ and/or EVENT_WRITE
+ * @param data User data returned with events for this descriptor
+ * @return 0 on success, -1 on error
+ */
+int event_loop_add(EventLoop* loop, int fd, uint32_t events, void* data);
+
+/**
+ * @brief Change interest set of a registered file descriptor
+ * @return 0 on success, -1 on error
+ */
+int event_loop_modify(EventLoop* loop, int fd, uint32_t events, void* data);
+
+/**
+ * @brief Unregister file descriptor (call before closing it)
+ * @return 0 on success, -1 on error
+ */
+int event_loop_remove(EventLoop* loop, int fd);
+
+/**
+ * @brief Wait for events
+ * @param loop Event loop
+ * @param events Output array
+ * @param max_events Capacity of output array
+ * @param timeout_ms Timeout in milliseconds (-1 blocks)
+ * @return Number of ready events, 0 on timeout, -1 on error (errno set)
+ */
+int event_loop_wait(EventLoop* loop, LoopEvent* events, int max_events, int timeout_ms);
+
+/**
+ * @brief Whether the loop delivers edge-triggered notifications
+ */
+int event_loop_is_edge_triggered(const EventLoop* loop);
+
+/**
+ * @brief Get backend name for logging
+ */
+const char* io_backend_name(IoBackend backend);
+
+#endif // EVENT_LOOP_H
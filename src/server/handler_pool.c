@@ -0,0 +1,335 @@
+/**
+ * @file handler_pool.c
+ * @brief Threads that run message handlers away from the I/O workers
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include "handler_pool.h"
+#include "../common/logger.h"
+#include "../common/utils.h"
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#define HANDLER_BURST 64    // Tasks taken from one worker's ring before looking at the next
+
+/**
+ * @brief Bounded single-producer, single-consumer ring of fixed-size items
+ *
+ * A side that is about to sleep and the other side that is about to decide
+ * whether to wake it each store their index, fence, then load the other
+ * index, so at least one of them sees the other's progress.
+ */
+typedef struct {
+    _Alignas(64) _Atomic size_t head;   // Next item to take (consumer)
+    _Alignas(64) _Atomic size_t tail;   // Next slot to fill (producer)
+    _Alignas(64) size_t mask;
+    size_t item_size;
+    uint8_t* items;
+} SpscRing;
+
+typedef struct {
+    HandlerPool* pool;
+    size_t index;
+    pthread_t thread;
+    int started;
+    int wake_fd;            // Written by workers when this thread's rings become non-empty
+} HandlerThread;
+
+struct HandlerPool {
+    HandlerRunFn run;
+    void* context;
+    size_t thread_count;
+    size_t producer_count;
+    HandlerThread* threads;
+    SpscRing* tasks;        // [producer * thread_count + thread]
+    SpscRing* completions;  // [producer * thread_count + thread]
+    int* producer_fds;      // Wakes each worker for its completions
+    atomic_int* task_full;  // [producer * thread_count + thread]: the worker waits for room in that ring
+    atomic_int stopping;
+};
+
+static int ring_init(SpscRing* ring, size_t capacity, size_t item_size) {
+    size_t slots = 1;
+    while (slots < capacity) {
+        slots <<= 1;
+    }
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    ring->mask = slots - 1;
+    ring->item_size = item_size;
+    ring->items = malloc(slots * item_size);
+    return ring->items ? 0 : -1;
+}
+
+/**
+ * @brief Append an item
+ * @return 1 if the consumer may be asleep and must be woken, 0 if not, -1 if the ring is full
+ */
+static int ring_push(SpscRing* ring, const void* item) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&ring->head, memory_order_acquire) > ring->mask) {
+        return -1;
+    }
+    memcpy(ring->items + (tail & ring->mask) * ring->item_size, item, ring->item_size);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    
+    atomic_thread_fence(memory_order_seq_cst);
+    return atomic_load_explicit(&ring->head, memory_order_relaxed) == tail ? 1 : 0;
+}
+
+/**
+ * @brief Take the oldest item
+ * @return 1 if an item was taken, 0 if the ring is empty
+ */
+static int ring_pop(SpscRing* ring, void* item) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (atomic_load_explicit(&ring->tail, memory_order_acquire) == head) {
+        // Pairs with the fence in ring_push before the caller goes to sleep
+        atomic_thread_fence(memory_order_seq_cst);
+        if (atomic_load_explicit(&ring->tail, memory_order_acquire) == head) {
+            return 0;
+        }
+    }
+    memcpy(item, ring->items + (head & ring->mask) * ring->item_size, ring->item_size);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return 1;
+}
+
+static void wake(int fd) {
+    uint64_t one = 1;
+    ssize_t written;
+    do {
+        written = write(fd, &one, sizeof(one));
+    } while (written < 0 && errno == EINTR);
+}
+
+static void report_completion(HandlerPool* pool, size_t producer, size_t thread, const HandlerTask* task) {
+    HandlerCompletion completion;
+    completion.connection_id = task->connection_id;
+    completion.msg = task->msg;     // Payload already released
+    
+    SpscRing* ring = &pool->completions[producer * pool->thread_count + thread];
+    int result;
+    while ((result = ring_push(ring, &completion)) < 0) {
+        // The worker drains completions from its event loop
+        if (atomic_load(&pool->stopping)) {
+            return;
+        }
+        sched_yield();
+    }
+    if (result > 0) {
+        wake(pool->producer_fds[producer]);
+    }
+}
+
+static void* handler_thread_main(void* arg) {
+    HandlerThread* thread = (HandlerThread*)arg;
+    HandlerPool* pool = thread->pool;
+    
+    // Signals are handled by the main thread
+    sigset_t set;
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+    
+    for (;;) {
+        int handled = 0;
+        for (size_t p = 0; p < pool->producer_count; p++) {
+            SpscRing* ring = &pool->tasks[p * pool->thread_count + thread->index];
+            HandlerTask task;
+            // Bounded bursts keep one busy worker from starving the others
+            for (int n = 0; n < HANDLER_BURST && ring_pop(ring, &task); n++) {
+                // Pairs with the fence in handler_pool_submit: a worker that found the ring full hears of the room
+                atomic_thread_fence(memory_order_seq_cst);
+                atomic_int* full = &pool->task_full[p * pool->thread_count + thread->index];
+                if (atomic_load_explicit(full, memory_order_relaxed) && atomic_exchange(full, 0)) {
+                    wake(pool->producer_fds[p]);
+                }
+                pool->run(pool->context, &task);
+                message_free(&task.msg);
+                if (task.notify) {
+                    report_completion(pool, p, thread->index, &task);
+                }
+                handled = 1;
+            }
+        }
+        if (handled) {
+            continue;
+        }
+        
+        // Every ring was seen empty after a fence: a worker that queues now wakes us
+        if (atomic_load(&pool->stopping)) {
+            break;
+        }
+        uint64_t value;
+        if (read(thread->wake_fd, &value, sizeof(value)) < 0 && errno != EINTR) {
+            logger_error("Handler thread %zu wait failed: %s", thread->index, get_error_string(errno));
+            break;
+        }
+    }
+    return NULL;
+}
+
+HandlerPool* handler_pool_create(size_t threads, size_t producers, size_t queue_size, HandlerRunFn run,
+                                 void* context) {
+    if (threads == 0 || producers == 0 || !run) {
+        return NULL;
+    }
+    
+    HandlerPool* pool = calloc(1, sizeof(HandlerPool));
+    if (!pool) {
+        return NULL;
+    }
+    pool->run = run;
+    pool->context = context;
+    atomic_init(&pool->stopping, 0);
+    
+    size_t rings = threads * producers;
+    pool->threads = calloc(threads, sizeof(HandlerThread));
+    pool->producer_fds = malloc(producers * sizeof(int));
+    pool->tasks = aligned_alloc(64, rings * sizeof(SpscRing));
+    pool->completions = aligned_alloc(64, rings * sizeof(SpscRing));
+    pool->task_full = malloc(rings * sizeof(atomic_int));
+    if (!pool->threads || !pool->producer_fds || !pool->tasks || !pool->completions || !pool->task_full) {
+        logger_error("Failed to allocate handler pool");
+        free(pool->threads);
+        free(pool->producer_fds);
+        free(pool->task_full);
+        free(pool->tasks);
+        free(pool->completions);
+        free(pool);
+        return NULL;
+    }
+    memset(pool->tasks, 0, rings * sizeof(SpscRing));
+    memset(pool->completions, 0, rings * sizeof(SpscRing));
+    for (size_t i = 0; i < rings; i++) {
+        atomic_init(&pool->task_full[i], 0);
+    }
+    for (size_t i = 0; i < producers; i++) {
+        pool->producer_fds[i] = -1;
+    }
+    for (size_t i = 0; i < threads; i++) {
+        pool->threads[i].wake_fd = -1;
+    }
+    // From here on handler_pool_destroy undoes whatever was set up
+    pool->thread_count = threads;
+    pool->producer_count = producers;
+    
+    for (size_t i = 0; i < rings; i++) {
+        if (ring_init(&pool->tasks[i], queue_size, sizeof(HandlerTask)) < 0 ||
+            ring_init(&pool->completions[i], queue_size, sizeof(HandlerCompletion)) < 0) {
+            logger_error("Failed to allocate handler queues");
+            handler_pool_destroy(pool);
+            return NULL;
+        }
+    }
+    for (size_t i = 0; i < producers; i++) {
+        pool->producer_fds[i] = eventfd(0, EFD_CLOEXEC);
+        if (pool->producer_fds[i] < 0) {
+            logger_error("Failed to create handler eventfd: %s", get_error_string(errno));
+            handler_pool_destroy(pool);
+            return NULL;
+        }
+    }
+    
+    for (size_t i = 0; i < threads; i++) {
+        HandlerThread* thread = &pool->threads[i];
+        thread->pool = pool;
+        thread->index = i;
+        thread->wake_fd = eventfd(0, EFD_CLOEXEC);
+        if (thread->wake_fd < 0) {
+            logger_error("Failed to create handler eventfd: %s", get_error_string(errno));
+            handler_pool_destroy(pool);
+            return NULL;
+        }
+        if (pthread_create(&thread->thread, NULL, handler_thread_main, thread) != 0) {
+            logger_error("Failed to start handler thread %zu", i);
+            handler_pool_destroy(pool);
+            return NULL;
+        }
+        thread->started = 1;
+    }
+    return pool;
+}
+
+void handler_pool_destroy(HandlerPool* pool) {
+    if (!pool) return;
+    
+    atomic_store(&pool->stopping, 1);
+    for (size_t i = 0; i < pool->thread_count; i++) {
+        HandlerThread* thread = &pool->threads[i];
+        if (thread->started) {
+            wake(thread->wake_fd);
+            pthread_join(thread->thread, NULL);
+        }
+        if (thread->wake_fd >= 0) {
+            close(thread->wake_fd);
+        }
+    }
+    
+    size_t rings = pool->thread_count * pool->producer_count;
+    for (size_t i = 0; i < rings; i++) {
+        // Threads that never started leave their tasks behind
+        HandlerTask task;
+        while (pool->tasks[i].items && ring_pop(&pool->tasks[i], &task)) {
+            message_free(&task.msg);
+        }
+        free(pool->tasks[i].items);
+        free(pool->completions[i].items);
+    }
+    for (size_t i = 0; i < pool->producer_count; i++) {
+        if (pool->producer_fds[i] >= 0) {
+            close(pool->producer_fds[i]);
+        }
+    }
+    free(pool->threads);
+    free(pool->producer_fds);
+    free(pool->task_full);
+    free(pool->tasks);
+    free(pool->completions);
+    free(pool);
+}
+
+int handler_pool_submit(HandlerPool* pool, size_t producer, HandlerTask* task) {
+    // Fibonacci hashing spreads the sequential slot numbers of connection IDs
+    size_t thread = (size_t)((task->connection_id * 11400714819323198485ull) >> 32) % pool->thread_count;
+    size_t index = producer * pool->thread_count + thread;
+    int result = ring_push(&pool->tasks[index], task);
+    if (result < 0) {
+        // Ask for a wake-up, then look again in case the thread made room meanwhile
+        atomic_store(&pool->task_full[index], 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        result = ring_push(&pool->tasks[index], task);
+        if (result < 0) {
+            return -1;
+        }
+    }
+    if (result > 0) {
+        wake(pool->threads[thread].wake_fd);
+    }
+    return 0;
+}
+
+int handler_pool_next_completion(HandlerPool* pool, size_t producer, HandlerCompletion* out) {
+    SpscRing* rings = &pool->completions[producer * pool->thread_count];
+    for (size_t i = 0; i < pool->thread_count; i++) {
+        if (ring_pop(&rings[i], out)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int handler_pool_wake_fd(const HandlerPool* pool, size_t producer) {
+    return pool->producer_fds[producer];
+}
+
+size_t handler_pool_threads(const HandlerPool* pool) {
+    return pool->thread_count;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file handler_pool.h
+ * @brief Threads that run message handlers away from the I/O workers
+ *
+ * Each I/O worker hands frames to the handler threads over lock-free
+ * single-producer, single-consumer rings, one per (worker, handler thread)
+ * pair. A connection always maps to the same handler thread, so its
+ * messages are handled in the order they arrived. Handled frames that the
+ * worker asked to hear about flow back over a second set of rings, and the
+ * worker is woken through an eventfd that it watches in its event loop.
+ */
+
+#ifndef HANDLER_POOL_H
+#define HANDLER_POOL_H
+
+#include "../common/protocol.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Frame queued for a handler thread
+ */
+typedef struct {
+    uint64_t connection_id;
+    Message msg;            ///< Owns its payload; released after the handler ran
+    uint64_t stream_offset; ///< MSG_TYPE_CHUNK: stream bytes before this chunk
+    int notify;             ///< Report back to the producing worker once handled
+} HandlerTask;
+
+/**
+ * @brief Handled frame reported back to its worker
+ */
+typedef struct {
+    uint64_t connection_id;
+    Message msg;            ///< Header and extensions of the frame, without payload
+} HandlerCompletion;
+
+/**
+ * @brief Runs one task on a handler thread
+ *
+ * The pool releases the payload afterwards; the function may take it with
+ * message_take_payload.
+ */
+typedef void (*HandlerRunFn)(void* context, HandlerTask* task);
+
+typedef struct HandlerPool HandlerPool;
+
+/**
+ * @brief Start the handler threads
+ * @param threads Number of handler threads (at least 1)
+ * @param producers Number of I/O workers that submit tasks
+ * @param queue_size Slots of each ring (rounded up to a power of two)
+ * @param run Function called for every task
+ * @param context First argument of run
+ * @return The pool, NULL on error
+ */
+HandlerPool* handler_pool_create(size_t threads, size_t producers, size_t queue_size, HandlerRunFn run,
+                                 void* context);
+
+/**
+ * @brief Stop the threads once every queued task has run, and release the pool
+ *
+ * Completions nobody collected are dropped.
+ */
+void handler_pool_destroy(HandlerPool* pool);
+
+/**
+ * @brief Queue a task on the thread that owns its connection
+ *
+ * On success the task's message belongs to the pool. When the ring is
+ * full, the worker's wake fd (handler_pool_wake_fd) fires once the handler
+ * thread has taken a task from it.
+ * @param producer Index of the calling worker
+ * @return 0 on success, -1 if that thread's ring is full (the task is untouched)
+ */
+int handler_pool_submit(HandlerPool* pool, size_t producer, HandlerTask* task);
+
+/**
+ * @brief Take the next completion for a worker, without blocking
+ * @return 1 if a completion was produced, 0 if there is none
+ */
+int handler_pool_next_completion(HandlerPool* pool, size_t producer, HandlerCompletion* out);
+
+/**
+ * @brief Eventfd that becomes readable when completions arrive for a worker, or a full ring has room
+ *
+ * Read it (to reset it) before draining with handler_pool_next_completion.
+ */
+int handler_pool_wake_fd(const HandlerPool* pool, size_t producer);
+
+/**
+ * @brief Number of handler threads
+ */
+size_t handler_pool_threads(const HandlerPool* pool);
+
+#endif // HANDLER_POOL_H
@@ -0,0 +1,338 @@
+/**
+ * @file handoff.c
+ * @brief Listening-socket handoff over a unix control socket
+ */
+
+#define _GNU_SOURCE
+#include "handoff.h"
+#include "../common/error.h"
+#include "../common/logger.h"
+#include "../common/utils.h"
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define HANDOFF_MAGIC 0x49504348u      // "IPCH"
+#define HANDOFF_VERSION 1
+#define HANDOFF_IDENTITY_MAX (64 * 1024)
+#define HANDOFF_CONFIRM 'R'
+
+/**
+ * @brief First record of an exchange (big-endian fields)
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t mode;
+    uint32_t count;
+    uint32_t identity_len;
+} HandoffHeader;
+
+static int fill_address(struct sockaddr_un* addr, const char* path) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        logger_error("Handoff path too long: %s", path);
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+/**
+ * @brief Check that the peer runs as this process's user
+ */
+static int check_peer(int fd, pid_t* pid) {
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0) {
+        logger_error("Failed to identify handoff peer: %s", get_error_string(errno));
+        return -1;
+    }
+    if (cred.uid != geteuid()) {
+        logger_error("Refusing handoff with pid %d of uid %u", (int)cred.pid, (unsigned)cred.uid);
+        return -1;
+    }
+    if (pid) {
+        *pid = cred.pid;
+    }
+    return 0;
+}
+
+static int send_record(int fd, const void* data, size_t len, const int* fds, size_t fd_count) {
+    struct iovec iov = { (void*)data, len };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int) * HANDOFF_FDS_PER_MESSAGE)];
+    } control;
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    if (fd_count > 0) {
+        memset(&control, 0, sizeof(control));
+        mh.msg_control = control.buf;
+        mh.msg_controllen = CMSG_SPACE(sizeof(int) * fd_count);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&mh);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fd_count);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * fd_count);
+    }
+    
+    ssize_t sent;
+    do {
+        sent = sendmsg(fd, &mh, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    if (sent != (ssize_t)len) {
+        logger_error("Failed to send handoff record: %s", sent < 0 ? get_error_string(errno) : "short write");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Receive one record, appending the descriptors it carries to fds
+ * @return Record length, -1 on error
+ */
+static ssize_t receive_record(int fd, void* data, size_t cap, int* fds, size_t* fd_count, size_t fd_cap) {
+    struct iovec iov = { data, cap };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int) * HANDOFF_FDS_PER_MESSAGE)];
+    } control;
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = control.buf;
+    mh.msg_controllen = sizeof(control.buf);
+    
+    ssize_t received;
+    do {
+        received = recvmsg(fd, &mh, MSG_CMSG_CLOEXEC);
+    } while (received < 0 && errno == EINTR);
+    if (received <= 0) {
+        logger_error("Handoff peer went away: %s", received < 0 ? get_error_string(errno) : "connection closed");
+        return -1;
+    }
+    
+    // Take every descriptor first, so none leaks when the record is refused
+    int truncated = (mh.msg_flags & (MSG_CTRUNC | MSG_TRUNC)) != 0;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&mh); cmsg; cmsg = CMSG_NXTHDR(&mh, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        const unsigned char* cursor = CMSG_DATA(cmsg);
+        for (size_t i = 0; i < count; i++) {
+            int received_fd;
+            memcpy(&received_fd, cursor + i * sizeof(int), sizeof(int));
+            if (fds && *fd_count < fd_cap) {
+                fds[(*fd_count)++] = received_fd;
+            } else {
+                close(received_fd);
+                truncated = 1;
+            }
+        }
+    }
+    if (truncated) {
+        logger_error("Handoff record truncated");
+        return -1;
+    }
+    return received;
+}
+
+int handoff_listen(const char* path) {
+    struct sockaddr_un addr;
+    char dir[sizeof(addr.sun_path)];
+    char staged[sizeof(addr.sun_path)];
+    if (strlen(path) + sizeof(".XXXXXX/s") > sizeof(staged)) {
+        logger_error("Handoff path too long: %s", path);
+        return -1;
+    }
+    
+    // Bind inside a fresh 0700 directory, so nobody else can connect before
+    // the socket is 0600, then move it into place (this also replaces a stale
+    // socket; a server still at path would have handed its sockets over)
+    snprintf(dir, sizeof(dir), "%s.XXXXXX", path);
+    if (!mkdtemp(dir)) {
+        logger_error("Failed to create a private directory for %s: %s", path, get_error_string(errno));
+        return -1;
+    }
+    memcpy(staged, dir, strlen(dir));
+    memcpy(staged + strlen(dir), "/s", sizeof("/s"));
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        logger_error("Failed to create handoff socket: %s", get_error_string(errno));
+        rmdir(dir);
+        return -1;
+    }
+    if (fill_address(&addr, staged) < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        chmod(staged, 0600) < 0 || listen(fd, 4) < 0 || rename(staged, path) < 0) {
+        logger_error("Failed to listen for handoffs at %s: %s", path, get_error_string(errno));
+        close(fd);
+        unlink(staged);
+        rmdir(dir);
+        return -1;
+    }
+    rmdir(dir);
+    return fd;
+}
+
+int handoff_accept(int listen_fd, int timeout_ms, pid_t* pid) {
+    struct pollfd pfd = { listen_fd, POLLIN, 0 };
+    int ready = poll(&pfd, 1, timeout_ms);
+    if (ready <= 0) {
+        return ready < 0 && errno != EINTR ? -1 : 0;
+    }
+    
+    int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    if (fd < 0) {
+        return errno == EAGAIN || errno == EINTR || errno == ECONNABORTED ? 0 : -1;
+    }
+    // Nothing is sent before the peer is known to run as this user
+    if (check_peer(fd, pid) < 0) {
+        close(fd);
+        return 0;
+    }
+    set_socket_timeout(fd, HANDOFF_TIMEOUT_SEC);
+    return fd;
+}
+
+int handoff_send(int fd, const HandoffState* state) {
+    HandoffHeader header;
+    header.magic = htonl(HANDOFF_MAGIC);
+    header.version = htons(HANDOFF_VERSION);
+    header.mode = htons((uint16_t)state->mode);
+    header.count = htonl((uint32_t)state->count);
+    header.identity_len = htonl((uint32_t)state->identity_len);
+    if (send_record(fd, &header, sizeof(header), NULL, 0) < 0) {
+        return -1;
+    }
+    
+    for (size_t sent = 0; sent < state->count; sent += HANDOFF_FDS_PER_MESSAGE) {
+        size_t count = state->count - sent;
+        if (count > HANDOFF_FDS_PER_MESSAGE) {
+            count = HANDOFF_FDS_PER_MESSAGE;
+        }
+        uint32_t length = htonl((uint32_t)count);
+        if (send_record(fd, &length, sizeof(length), state->fds + sent, count) < 0) {
+            return -1;
+        }
+    }
+    
+    if (state->identity_len > 0 && send_record(fd, state->identity, state->identity_len, NULL, 0) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+int handoff_wait_confirm(int fd) {
+    char confirm = 0;
+    ssize_t received;
+    do {
+        received = recv(fd, &confirm, sizeof(confirm), 0);
+    } while (received < 0 && errno == EINTR);
+    return received == 1 && confirm == HANDOFF_CONFIRM ? 0 : -1;
+}
+
+int handoff_receive(const char* path, HandoffState* state, int* fd_out, pid_t* pid) {
+    memset(state, 0, sizeof(*state));
+    struct sockaddr_un addr;
+    if (fill_address(&addr, path) < 0) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        logger_error("Failed to create handoff socket: %s", get_error_string(errno));
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        int error = errno;
+        close(fd);
+        if (error == ENOENT || error == ECONNREFUSED) {
+            return 0;
+        }
+        logger_error("Failed to reach the server at %s: %s", path, get_error_string(error));
+        return -1;
+    }
+    if (check_peer(fd, pid) < 0) {
+        close(fd);
+        return -1;
+    }
+    set_socket_timeout(fd, HANDOFF_TIMEOUT_SEC);
+    
+    HandoffHeader header;
+    if (receive_record(fd, &header, sizeof(header), NULL, NULL, 0) != (ssize_t)sizeof(header) ||
+        ntohl(header.magic) != HANDOFF_MAGIC || ntohs(header.version) != HANDOFF_VERSION) {
+        logger_error("Server at %s sent an invalid handoff", path);
+        goto fail;
+    }
+    size_t count = ntohl(header.count);
+    size_t identity_len = ntohl(header.identity_len);
+    if (count == 0 || count > HANDOFF_MAX_LISTENERS || identity_len > HANDOFF_IDENTITY_MAX) {
+        logger_error("Server at %s offered %zu listeners and a %zu-byte identity", path, count, identity_len);
+        goto fail;
+    }
+    state->mode = ntohs(header.mode);
+    
+    while (state->count < count) {
+        uint32_t length;
+        size_t before = state->count;
+        if (receive_record(fd, &length, sizeof(length), state->fds, &state->count, count) !=
+                (ssize_t)sizeof(length) || state->count - before != ntohl(length)) {
+            logger_error("Server at %s sent an invalid listener record", path);
+            goto fail;
+        }
+    }
+    
+    if (identity_len > 0) {
+        state->identity = malloc(identity_len);
+        if (!state->identity) {
+            logger_error("Failed to allocate %zu-byte TLS identity", identity_len);
+            goto fail;
+        }
+        state->identity_len = identity_len;
+        if (receive_record(fd, state->identity, identity_len, NULL, NULL, 0) != (ssize_t)identity_len) {
+            logger_error("Server at %s sent an invalid TLS identity", path);
+            goto fail;
+        }
+    }
+    
+    *fd_out = fd;
+    return 1;
+
+fail:
+    handoff_state_free(state);
+    close(fd);
+    return -1;
+}
+
+int handoff_confirm(int fd) {
+    char confirm = HANDOFF_CONFIRM;
+    int result = send_record(fd, &confirm, sizeof(confirm), NULL, 0);
+    close(fd);
+    return result;
+}
+
+void handoff_state_free(HandoffState* state) {
+    for (size_t i = 0; i < state->count; i++) {
+        if (state->fds[i] >= 0) {
+            close(state->fds[i]);
+        }
+    }
+    state->count = 0;
+    if (state->identity) {
+        explicit_bzero(state->identity, state->identity_len);
+        free(state->identity);
+        state->identity = NULL;
+    }
+    state->identity_len = 0;
+}
@@ -0,0 +1,86 @@
+/**
+ * @file handoff.h
+ * @brief Passing listening sockets from a running server to its replacement
+ *
+ * A server with a handoff path waits for a successor on a unix control
+ * socket at that path. A new process started with the same path connects,
+ * receives every listening socket with SCM_RIGHTS (the same kernel
+ * sockets, accept queues included) plus the TLS identity, and confirms
+ * once it watches them. Until then both processes accept, so no
+ * connection attempt is refused or lost during the cutover. The control
+ * socket is only reachable by the owner, and each side checks that the
+ * peer runs as the same user.
+ *
+ * Messages are SOCK_SEQPACKET records: a header, the descriptors in groups
+ * of HANDOFF_FDS_PER_MESSAGE, the identity if any; then one confirmation
+ * byte from the successor.
+ */
+
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define HANDOFF_MAX_LISTENERS 256
+#define HANDOFF_FDS_PER_MESSAGE 64      ///< Below the kernel's SCM_MAX_FD of 253
+#define HANDOFF_TIMEOUT_SEC 10          ///< Longest wait for any message of the exchange
+
+/**
+ * @brief What a server hands over
+ */
+typedef struct {
+    uint32_t mode;              ///< SocketMode of the listeners
+    int fds[HANDOFF_MAX_LISTENERS];
+    size_t count;
+    uint8_t* identity;          ///< TLS identity (tls_export_identity), NULL without TLS
+    size_t identity_len;
+} HandoffState;
+
+/**
+ * @brief Create the control socket (mode 0600), replacing a stale one at path
+ * @return Listening descriptor, -1 on error
+ */
+int handoff_listen(const char* path);
+
+/**
+ * @brief Accept a successor on the control socket, waiting up to timeout_ms
+ * @param pid Set to the successor's process ID
+ * @return Connected descriptor, 0 on timeout or after refusing a peer of another user, -1 on error
+ */
+int handoff_accept(int listen_fd, int timeout_ms, pid_t* pid);
+
+/**
+ * @brief Send the listeners and identity to a connected successor
+ * @return 0 on success, -1 on error
+ */
+int handoff_send(int fd, const HandoffState* state);
+
+/**
+ * @brief Wait for the successor to confirm it accepts on the listeners
+ * @return 0 once confirmed, -1 if it failed or went away
+ */
+int handoff_wait_confirm(int fd);
+
+/**
+ * @brief Take over the listeners of the server waiting at path
+ * @param state Filled on success; release with handoff_state_free
+ * @param fd Set to the connection to confirm on with handoff_confirm
+ * @param pid Set to the predecessor's process ID
+ * @return 1 if the listeners were received, 0 if no server waits at path, -1 on error
+ */
+int handoff_receive(const char* path, HandoffState* state, int* fd, pid_t* pid);
+
+/**
+ * @brief Tell the predecessor it may stop accepting, and close the connection
+ * @return 0 on success, -1 if the predecessor went away
+ */
+int handoff_confirm(int fd);
+
+/**
+ * @brief Close descriptors still in state and wipe the identity
+ */
+void handoff_state_free(HandoffState* state);
+
+#endif // HANDOFF_H
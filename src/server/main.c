@@ -10,6 +10,7 @@
 #include "../common/logger.h"
 #include "../common/types.h"
 #include "../common/protocol.h"
+#include "../common/buffer_pool.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -22,6 +23,7 @@
 
 static Server g_server;
 static int g_running = 1;
+static char g_broadcast_topic[MSG_TOPIC_MAX + 1];   // Republish received text here ("" = off)
 
 static void signal_handler(int sig) {
     (void)sig;
@@ -30,7 +32,9 @@ static void signal_handler(int sig) {
     logger_info("Received signal, shutting down...");
 }
 
-static int parse_config(const char* filename, SocketMode* mode, char** address, int* enable_tls) {
+static int parse_config(const char* filename, SocketMode* mode, char** address, int* enable_tls,
+                        ServerOptions* options, int* batch_dispatch, int* log_async,
+                        LoggerAsyncOptions* log_options) {
     FILE* f = fopen(filename, "r");
     if (!f) {
         fprintf(stderr, "Failed to open %s\n", filename);
@@ -41,6 +45,10 @@ static int parse_config(const char* filename, SocketMode* mode, char** address,
     *mode = SOCKET_MODE_INET;
     *address = NULL;
     *enable_tls = 0;
+    server_options_init(options);
+    *batch_dispatch = 0;
+    *log_async = 0;
+    logger_async_options_init(log_options);
     
     while (fgets(line, sizeof(line), f)) {
         // Remove newline
@@ -65,19 +73,125 @@ static int parse_config(const char* filename, SocketMode* mode, char** address,
                 *mode = SOCKET_MODE_UNIX;
             } else if (strcmp(value, "inet") == 0) {
                 *mode = SOCKET_MODE_INET;
+            } else if (strcmp(value, "shm") == 0) {
+                *mode = SOCKET_MODE_SHM;
             }
         } else if (strcmp(key, "address") == 0) {
             *address = strdup(value);
         } else if (strcmp(key, "tls") == 0) {
             *enable_tls = (atoi(value) != 0);
+        } else if (strcmp(key, "io_backend") == 0) {
+            if (strcmp(value, "epoll") == 0) {
+                options->io_backend = IO_BACKEND_EPOLL;
+            } else if (strcmp(value, "poll") == 0) {
+                options->io_backend = IO_BACKEND_POLL;
+            } else if (strcmp(value, "uring") == 0) {
+                options->io_backend = IO_BACKEND_URING;
+            }
+        } else if (strcmp(key, "epoll_mode") == 0) {
+            if (strcmp(value, "edge") == 0) {
+                options->edge_triggered = 1;
+            } else if (strcmp(value, "level") == 0) {
+                options->edge_triggered = 0;
+            }
+        } else if (strcmp(key, "workers") == 0) {
+            int workers = atoi(value);
+            options->workers = workers > 0 ? (size_t)workers : 0;
+        } else if (strcmp(key, "ack_batch") == 0) {
+            options->ack_batch = (atoi(value) != 0);
+        } else if (strcmp(key, "ack_batch_max") == 0) {
+            int max = atoi(value);
+            options->ack_batch_max = max > 0 ? (size_t)max : 1;
+        } else if (strcmp(key, "tls_cert") == 0) {
+            snprintf(options->tls_cert_file, sizeof(options->tls_cert_file), "%s", value);
+        } else if (strcmp(key, "tls_key") == 0) {
+            snprintf(options->tls_key_file, sizeof(options->tls_key_file), "%s", value);
+        } else if (strcmp(key, "tls_ticket_key") == 0) {
+            snprintf(options->tls_ticket_key_file, sizeof(options->tls_ticket_key_file), "%s", value);
+        } else if (strcmp(key, "shm_ring_size") == 0) {
+            long size = atol(value);
+            options->shm_ring_size = size > 0 ? (size_t)size : SHM_RING_DEFAULT_SIZE;
+        } else if (strcmp(key, "compression") == 0) {
+            options->compression = (atoi(value) != 0);
+        } else if (strcmp(key, "checksums") == 0) {
+            options->checksums = (atoi(value) != 0);
+        } else if (strcmp(key, "validate_utf8") == 0) {
+            options->validate_utf8 = (atoi(value) != 0);
+        } else if (strcmp(key, "ktls") == 0) {
+            options->ktls = (atoi(value) != 0);
+        } else if (strcmp(key, "tls_handshake_timeout_ms") == 0) {
+            int timeout = atoi(value);
+            options->handshake_timeout_ms = timeout > 0 ? timeout : 1;
+        } else if (strcmp(key, "max_frame_size") == 0) {
+            long long size = atoll(value);
+            options->max_frame_size = size > 0 ? (uint64_t)size : 0;
+        } else if (strcmp(key, "send_queue_high") == 0) {
+            long bytes = atol(value);
+            options->send_queue_high = bytes > 0 ? (size_t)bytes : 0;
+        } else if (strcmp(key, "send_queue_low") == 0) {
+            long bytes = atol(value);
+            options->send_queue_low = bytes > 0 ? (size_t)bytes : 0;
+        } else if (strcmp(key, "handler_threads") == 0) {
+            int threads = atoi(value);
+            options->handler_threads = threads > 0 ? (size_t)threads : 0;
+        } else if (strcmp(key, "handler_ack") == 0) {
+            if (strcmp(value, "complete") == 0) {
+                options->handler_ack = HANDLER_ACK_COMPLETE;
+            } else if (strcmp(value, "receive") == 0) {
+                options->handler_ack = HANDLER_ACK_RECEIVE;
+            }
+        } else if (strcmp(key, "stats") == 0) {
+            options->stats_requests = (atoi(value) != 0);
+        } else if (strcmp(key, "publish") == 0) {
+            options->publish_requests = (atoi(value) != 0);
+        } else if (strcmp(key, "subscriber_queue_max") == 0) {
+            long bytes = atol(value);
+            options->subscriber_queue_max = bytes > 0 ? (size_t)bytes : 0;
+        } else if (strcmp(key, "subscriber_drop") == 0) {
+            if (strcmp(value, "frames") == 0) {
+                options->subscriber_drop = SUBSCRIBER_DROP_FRAMES;
+            } else if (strcmp(value, "connection") == 0) {
+                options->subscriber_drop = SUBSCRIBER_DROP_CONNECTION;
+            }
+        } else if (strcmp(key, "broadcast_text") == 0) {
+            snprintf(g_broadcast_topic, sizeof(g_broadcast_topic), "%s", value);
+        } else if (strcmp(key, "handoff_path") == 0) {
+            snprintf(options->handoff_path, sizeof(options->handoff_path), "%s", value);
+        } else if (strcmp(key, "handoff_drain_ms") == 0) {
+            int drain = atoi(value);
+            options->handoff_drain_ms = drain >= 0 ? drain : 0;
+        } else if (strcmp(key, "batch_dispatch") == 0) {
+            *batch_dispatch = (atoi(value) != 0);
+        } else if (strcmp(key, "log_async") == 0) {
+            *log_async = (atoi(value) != 0);
+        } else if (strcmp(key, "log_ring_lines") == 0) {
+            long lines = atol(value);
+            log_options->ring_lines = lines > 0 ? (size_t)lines : LOGGER_ASYNC_DEFAULT_LINES;
+        } else if (strcmp(key, "log_flush_ms") == 0) {
+            int interval = atoi(value);
+            log_options->flush_interval_ms = interval > 0 ? interval : 1;
+        } else if (strcmp(key, "log_flush_level") == 0) {
+            if (strcmp(value, "info") == 0) {
+                log_options->flush_level = LOG_LEVEL_INFO;
+            } else if (strcmp(value, "warn") == 0) {
+                log_options->flush_level = LOG_LEVEL_WARN;
+            } else if (strcmp(value, "error") == 0) {
+                log_options->flush_level = LOG_LEVEL_ERROR;
+            }
+        } else {
+            tuning_parse_option(&options->tuning, key, value);
         }
     }
     
     fclose(f);
     
+    if (options->send_queue_low > options->send_queue_high) {
+        options->send_queue_low = options->send_queue_high;
+    }
+    
     // Set default address if not provided
     if (!*address) {
-        if (*mode == SOCKET_MODE_UNIX) {
+        if (*mode != SOCKET_MODE_INET) {
             *address = strdup("/tmp/server.sock");
         } else {
             *address = strdup("localhost:8080");
@@ -87,20 +201,25 @@ static int parse_config(const char* filename, SocketMode* mode, char** address,
     return 0;
 }
 
-static void message_handler(int client_id, const Message* msg) {
-    (void)client_id;
+static void message_handler(uint64_t connection_id, Message* msg) {
+    (void)connection_id;
     if (msg->header.type == MSG_TYPE_TEXT && msg->payload) {
-        char* text = malloc(msg->payload_size + 1);
-        if (text) {
-            memcpy(text, msg->payload, msg->payload_size);
-            text[msg->payload_size] = '\0';
-            logger_info("Received text message: %s", text);
-            free(text);
+        // Payload is not NUL-terminated; print it with an explicit length
+        logger_info("Received text message: %.*s", (int)msg->payload_size, (const char*)msg->payload);
+        if (g_broadcast_topic[0] != '\0') {
+            server_broadcast(&g_server, g_broadcast_topic, strlen(g_broadcast_topic), msg->payload,
+                             msg->payload_size);
         }
     }
 }
 
-static void write_metrics(FILE* f, const Server* server) {
+static void message_batch_handler(uint64_t connection_id, Message* msgs, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        message_handler(connection_id, &msgs[i]);
+    }
+}
+
+static void write_metrics(FILE* f, const Server* server, int log_async) {
     size_t total_clients, total_messages;
     double uptime, throughput_mb_s, avg_latency_ms, min_latency_ms, max_latency_ms;
     
@@ -108,7 +227,7 @@ static void write_metrics(FILE* f, const Server* server) {
                       &throughput_mb_s, &avg_latency_ms, &min_latency_ms, &max_latency_ms);
     
     fprintf(f, "\n=== SERVER METRICS ===\n");
-    fprintf(f, "Mode: %s\n", server->mode == SOCKET_MODE_UNIX ? "unix" : "inet");
+    fprintf(f, "Mode: %s\n", socket_mode_name(server->mode));
     fprintf(f, "Address: %s\n", server->address);
     if (server->mode == SOCKET_MODE_INET) {
         fprintf(f, "TLS Enabled: %s\n", server->enable_tls ? "Yes" : "No");
@@ -121,6 +240,68 @@ static void write_metrics(FILE* f, const Server* server) {
     fprintf(f, "Message Rate: %.2f msg/s\n", message_rate);
     fprintf(f, "Average Latency: %.2f ms\n", avg_latency_ms);
     fprintf(f, "Throughput: %.4f MB/s\n", throughput_mb_s);
+    
+    ServerMetrics merged;
+    server_merge_metrics(server, &merged);
+    const Histogram* latency = &merged.latency;
+    fprintf(f, "End-to-End Latency: %llu samples, p50 %.1f us, p90 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n",
+            (unsigned long long)latency->total, (double)histogram_percentile(latency, 50.0) / 1e3,
+            (double)histogram_percentile(latency, 90.0) / 1e3, (double)histogram_percentile(latency, 99.0) / 1e3,
+            (double)histogram_percentile(latency, 99.9) / 1e3, (double)latency->max / 1e3);
+    fprintf(f, "ACK Frames Sent: %zu\n", merged.ack_frames_sent);
+    fprintf(f, "Streams Completed: %zu (%zu connections closed for oversized frames)\n",
+            merged.streams_completed, merged.frames_rejected);
+    if (merged.frames_corrupt > 0) {
+        fprintf(f, "Corrupt Frames: %zu connections closed for a bad checksum or invalid UTF-8\n",
+                merged.frames_corrupt);
+    }
+    fprintf(f, "Send Queues: peak %zu bytes, %zu read pauses for slow consumers\n",
+            merged.send_queue_peak, merged.read_pauses);
+    if (server->options.handler_threads > 0) {
+        fprintf(f, "Handler Threads: %zu, %zu read pauses for a full handler queue\n", server->options.handler_threads,
+                merged.handler_stalls);
+    }
+    if (merged.broadcasts > 0 || merged.subscribers_dropped > 0) {
+        fprintf(f, "Broadcasts: %zu worker fan-outs, %zu subscriber deliveries, %zu skipped for lagging subscribers, "
+                "%zu subscribers disconnected\n", merged.broadcasts, merged.broadcast_deliveries,
+                merged.broadcast_drops, merged.subscribers_dropped);
+    }
+    if (merged.dispatch_batches > 0) {
+        fprintf(f, "Dispatch Batches: %zu (%.1f messages per batch)\n", merged.dispatch_batches,
+                (double)merged.total_messages / (double)merged.dispatch_batches);
+    }
+    const CompressionStats* inflate = &merged.decompression;
+    fprintf(f, "Compressed Frames: %zu, %llu -> %llu bytes (%.1f%% of original), %.3f ms CPU decompressing\n",
+            inflate->frames, (unsigned long long)inflate->wire_bytes, (unsigned long long)inflate->raw_bytes,
+            compression_stats_ratio(inflate), (double)inflate->cpu_ns / 1e6);
+    if (server->enable_tls) {
+        fprintf(f, "TLS Handshakes: %zu completed (%zu resumed), %zu failed (%zu timed out), %zu in progress\n",
+                merged.handshakes_completed, merged.handshakes_resumed, merged.handshakes_failed,
+                merged.handshake_timeouts, merged.handshakes_in_progress);
+        if (server->options.ktls) {
+            fprintf(f, "kTLS Connections: %zu tx, %zu rx\n", merged.ktls_send, merged.ktls_recv);
+        }
+    }
+    
+    BufferPoolStats pool;
+    buffer_pool_get_stats(&pool);
+    size_t pool_allocs = 0, pool_hits = 0;
+    for (size_t i = 0; i < BUFFER_POOL_CLASS_COUNT; i++) {
+        pool_allocs += pool.allocs[i];
+        pool_hits += pool.hits[i];
+    }
+    double hit_rate = pool_allocs > 0 ? 100.0 * (double)pool_hits / (double)pool_allocs : 0.0;
+    fprintf(f, "Buffer Pool: %zu allocs, %.2f%% hit rate, %zu oversize, %zu released, %zu bytes cached, %zu thread pools\n",
+            pool_allocs, hit_rate, pool.oversize_allocs, pool.releases, pool.cached_bytes, pool.thread_pools);
+    for (size_t i = 0; i < BUFFER_POOL_CLASS_COUNT; i++) {
+        if (pool.allocs[i] > 0 || pool.cached[i] > 0) {
+            fprintf(f, "  Class %zu B: %zu allocs, %zu hits, %zu cached\n",
+                    pool.class_size[i], pool.allocs[i], pool.hits[i], pool.cached[i]);
+        }
+    }
+    if (log_async) {
+        fprintf(f, "Log Lines Dropped: %zu\n", logger_dropped_lines());
+    }
     fflush(f);
 }
 
@@ -136,25 +317,36 @@ int main(int argc, char* argv[]) {
     SocketMode mode;
     char* address = NULL;
     int enable_tls = 0;
+    ServerOptions options;
+    int batch_dispatch;
+    int log_async;
+    LoggerAsyncOptions log_options;
     
-    if (parse_config(INPUT_FILE, &mode, &address, &enable_tls) < 0) {
+    if (parse_config(INPUT_FILE, &mode, &address, &enable_tls, &options, &batch_dispatch, &log_async,
+                     &log_options) < 0) {
         return 1;
     }
     
-    // Initialize logger with output file
-    if (logger_init(OUTPUT_FILE) < 0) {
+    // Initialize logger with output file; a restarted server appends to its predecessor's log
+    int logger_result = options.handoff_path[0] ? logger_init_append(OUTPUT_FILE) : logger_init(OUTPUT_FILE);
+    if (logger_result < 0) {
         fprintf(stderr, "Failed to initialize logger\n");
         free(address);
         return 1;
     }
     
-    if (mode == SOCKET_MODE_UNIX && enable_tls) {
-        logger_warn("TLS requested for UNIX mode; disabling TLS because it is not required.");
+    if (log_async && logger_start_async(&log_options) < 0) {
+        logger_warn("Failed to start the background log writer; logging synchronously");
+        log_async = 0;
+    }
+    
+    if (mode != SOCKET_MODE_INET && enable_tls) {
+        logger_warn("TLS requested for %s mode; disabling TLS because it is not required.", socket_mode_name(mode));
         enable_tls = 0;
     }
     
-    if (mode == SOCKET_MODE_UNIX) {
-        logger_info("Server configuration: mode=unix, path=%s, tls=%s",
+    if (mode != SOCKET_MODE_INET) {
+        logger_info("Server configuration: mode=%s, path=%s, tls=%s", socket_mode_name(mode),
                     address ? address : "(null)",
                     enable_tls ? "enabled" : "disabled");
     } else {
@@ -172,6 +364,10 @@ int main(int argc, char* argv[]) {
     }
     
     free(address);
+    server_set_options(&g_server, &options);
+    if (batch_dispatch) {
+        server_set_batch_handler(&g_server, message_batch_handler);
+    }
     
     // Start server
     logger_info("Starting server...");
@@ -181,16 +377,21 @@ int main(int argc, char* argv[]) {
         logger_cleanup();
         return 1;
     }
+    if (server_handed_off(&g_server)) {
+        logger_info("Handed over to the successor");
+    }
     
-    // Write metrics to output file
+    // Write metrics to output file, after any log lines still queued
+    logger_flush();
     FILE* output = fopen(OUTPUT_FILE, "a");
     if (output) {
-        write_metrics(output, &g_server);
+        write_metrics(output, &g_server, log_async);
         fclose(output);
     }
     
     // Cleanup
     server_cleanup(&g_server);
+    buffer_pool_cleanup();
     logger_cleanup();
     
     return 0;
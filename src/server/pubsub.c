@@ -0,0 +1,172 @@
+/**
+ * @file pubsub.c
+ * @brief Topic subscriptions and broadcast frames shared by every subscriber
+ */
+
+#include "pubsub.h"
+#include <stdlib.h>
+#include <string.h>
+
+SharedFrame* shared_frame_create(Message* msg) {
+    const char* topic;
+    size_t topic_len;
+    const uint8_t* data;
+    size_t data_len;
+    if (message_parse_publish(msg, &topic, &topic_len, &data, &data_len) < 0) {
+        return NULL;
+    }
+    
+    SharedFrame* frame = (SharedFrame*)malloc(sizeof(SharedFrame));
+    if (!frame) {
+        return NULL;
+    }
+    memcpy(frame->topic, topic, topic_len);
+    frame->topic_len = topic_len;
+    
+    size_t expected = msg->payload_size;
+    size_t size = 0;
+    uint8_t* payload = message_take_payload(msg, &size);
+    if (size != expected) {
+        free(frame);
+        return NULL;
+    }
+    memset(&frame->msg, 0, sizeof(Message));
+    frame->msg.header.type = MSG_TYPE_PUBLISH;
+    frame->msg.header.length = size;
+    frame->msg.header.flags = MSG_FLAGS_NONE;
+    frame->msg.payload = payload;
+    frame->msg.payload_size = size;
+    frame->head_size = message_encode_head(&frame->msg, frame->head);
+    atomic_init(&frame->refs, 1);
+    return frame;
+}
+
+void shared_frame_retain(SharedFrame* frame) {
+    atomic_fetch_add_explicit(&frame->refs, 1, memory_order_relaxed);
+}
+
+void shared_frame_release(SharedFrame* frame) {
+    if (!frame) return;
+    // The last owner must see every write made through the other references
+    if (atomic_fetch_sub_explicit(&frame->refs, 1, memory_order_acq_rel) == 1) {
+        message_payload_free(frame->msg.payload);
+        free(frame);
+    }
+}
+
+/**
+ * @brief FNV-1a
+ */
+static uint32_t topic_hash(const char* name, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void topic_table_init(TopicTable* table) {
+    memset(table, 0, sizeof(TopicTable));
+}
+
+void topic_table_free(TopicTable* table) {
+    for (size_t i = 0; i < table->count; i++) {
+        free(table->topics[i].subscribers);
+    }
+    free(table->topics);
+    topic_table_init(table);
+}
+
+Topic* topic_table_find(TopicTable* table, const char* name, size_t name_len) {
+    uint32_t hash = topic_hash(name, name_len);
+    for (size_t i = 0; i < table->count; i++) {
+        Topic* topic = &table->topics[i];
+        if (topic->hash == hash && topic->name_len == name_len && memcmp(topic->name, name, name_len) == 0) {
+            return topic;
+        }
+    }
+    return NULL;
+}
+
+int topic_table_subscribe(TopicTable* table, const char* name, size_t name_len, uint64_t id) {
+    Topic* topic = topic_table_find(table, name, name_len);
+    if (!topic) {
+        if (table->count == table->capacity) {
+            size_t capacity = table->capacity ? table->capacity * 2 : 8;
+            Topic* topics = (Topic*)realloc(table->topics, capacity * sizeof(Topic));
+            if (!topics) {
+                return -1;
+            }
+            table->topics = topics;
+            table->capacity = capacity;
+        }
+        topic = &table->topics[table->count++];
+        memset(topic, 0, sizeof(Topic));
+        memcpy(topic->name, name, name_len);
+        topic->name_len = name_len;
+        topic->hash = topic_hash(name, name_len);
+    }
+    
+    for (size_t i = 0; i < topic->count; i++) {
+        if (topic->subscribers[i] == id) {
+            return 0;
+        }
+    }
+    if (topic->count == topic->capacity) {
+        size_t capacity = topic->capacity ? topic->capacity * 2 : 4;
+        uint64_t* subscribers = (uint64_t*)realloc(topic->subscribers, capacity * sizeof(uint64_t));
+        if (!subscribers) {
+            if (topic->count == 0) {
+                topic_table_remove_at(table, topic, 0);
+            }
+            return -1;
+        }
+        topic->subscribers = subscribers;
+        topic->capacity = capacity;
+    }
+    topic->subscribers[topic->count++] = id;
+    return 1;
+}
+
+void topic_table_remove_at(TopicTable* table, Topic* topic, size_t index) {
+    if (index < topic->count) {
+        topic->subscribers[index] = topic->subscribers[--topic->count];
+    }
+    if (topic->count == 0) {
+        free(topic->subscribers);
+        *topic = table->topics[--table->count];
+    }
+}
+
+int topic_table_unsubscribe(TopicTable* table, const char* name, size_t name_len, uint64_t id) {
+    Topic* topic = topic_table_find(table, name, name_len);
+    if (!topic) {
+        return 0;
+    }
+    for (size_t i = 0; i < topic->count; i++) {
+        if (topic->subscribers[i] == id) {
+            topic_table_remove_at(table, topic, i);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void topic_table_remove_connection(TopicTable* table, uint64_t id) {
+    // Removing a topic moves the last one into its place: look at index i again
+    size_t i = 0;
+    while (i < table->count) {
+        Topic* topic = &table->topics[i];
+        size_t before = table->count;
+        for (size_t j = 0; j < topic->count; j++) {
+            if (topic->subscribers[j] == id) {
+                topic_table_remove_at(table, topic, j);
+                break;
+            }
+        }
+        if (table->count == before) {
+            i++;
+        }
+    }
+}
@@ -0,0 +1,107 @@
+/**
+ * @file pubsub.h
+ * @brief Topic subscriptions and broadcast frames shared by every subscriber
+ *
+ * A broadcast is encoded once into a SharedFrame. Every subscriber's send
+ * queue references the same bytes, and the last reference releases them;
+ * TLS connections encrypt straight from the shared plaintext as they write
+ * it. Each worker keeps a TopicTable of its own connections and is the
+ * only thread that touches it.
+ */
+
+#ifndef PUBSUB_H
+#define PUBSUB_H
+
+#include "../common/protocol.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+/**
+ * @brief Encoded MSG_TYPE_PUBLISH frame with a reference count
+ */
+typedef struct {
+    atomic_uint refs;
+    char topic[MSG_TOPIC_MAX];
+    size_t topic_len;
+    Message msg;            ///< Owns the payload (topic and data)
+    uint8_t head[MESSAGE_HEAD_MAX_SIZE];
+    size_t head_size;
+} SharedFrame;
+
+/**
+ * @brief Encode a publication, taking over its payload
+ *
+ * Extensions of the incoming frame (sequence number, send time, checksum)
+ * are dropped: they belonged to the publisher's connection. Borrowed
+ * payloads are copied.
+ * @param msg Well-formed MSG_TYPE_PUBLISH message; its payload is gone afterwards
+ * @return Frame holding one reference, NULL on a malformed message or allocation failure
+ */
+SharedFrame* shared_frame_create(Message* msg);
+
+void shared_frame_retain(SharedFrame* frame);
+
+/**
+ * @brief Drop a reference, freeing the frame with the last one (any thread)
+ */
+void shared_frame_release(SharedFrame* frame);
+
+/**
+ * @brief Bytes the frame occupies on the wire
+ */
+static inline size_t shared_frame_size(const SharedFrame* frame) {
+    return frame->head_size + frame->msg.payload_size;
+}
+
+/**
+ * @brief Subscribers of one topic
+ */
+typedef struct {
+    char name[MSG_TOPIC_MAX];
+    size_t name_len;
+    uint32_t hash;
+    uint64_t* subscribers;  ///< Connection IDs
+    size_t count;
+    size_t capacity;
+} Topic;
+
+/**
+ * @brief Topics with at least one subscriber
+ */
+typedef struct {
+    Topic* topics;
+    size_t count;
+    size_t capacity;
+} TopicTable;
+
+void topic_table_init(TopicTable* table);
+
+void topic_table_free(TopicTable* table);
+
+/**
+ * @return The topic, NULL if nobody subscribed to it. Valid until the table changes.
+ */
+Topic* topic_table_find(TopicTable* table, const char* name, size_t name_len);
+
+/**
+ * @return 1 if the connection was added, 0 if it already was subscribed, -1 on allocation failure
+ */
+int topic_table_subscribe(TopicTable* table, const char* name, size_t name_len, uint64_t id);
+
+/**
+ * @return 1 if the connection was removed, 0 if it was not subscribed
+ */
+int topic_table_unsubscribe(TopicTable* table, const char* name, size_t name_len, uint64_t id);
+
+/**
+ * @brief Remove a connection from every topic (on disconnect)
+ */
+void topic_table_remove_connection(TopicTable* table, uint64_t id);
+
+/**
+ * @brief Remove the subscriber at index from a topic, dropping the topic once empty
+ */
+void topic_table_remove_at(TopicTable* table, Topic* topic, size_t index);
+
+#endif // PUBSUB_H
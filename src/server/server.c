@@ -9,190 +9,2004 @@
 #include "../common/logger.h"
 #include "../common/utils.h"
 #include "../common/net_common.h"
+#include "../common/buffer_pool.h"
+#include "../common/trace.h"
 #include <signal.h>
-#include <poll.h>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <sys/time.h>
 #include <math.h>
 #include <sys/un.h>
+#include <sys/eventfd.h>
 
-static void add_client(Server* server, int fd, void* ssl) {
-    if (server->client_count >= server->client_capacity) {
-        size_t new_capacity = server->client_capacity == 0 ? 8 : server->client_capacity * 2;
-        ClientConnection* new_clients = realloc(server->clients, new_capacity * sizeof(ClientConnection));
-        if (!new_clients) {
+#define MAX_EVENTS 256
+#define MAX_WORKERS 256
+#define HANDSHAKE_SWEEP_INTERVAL_MS 250
+
+// io_uring backend
+#define URING_ENTRIES 256
+#define URING_BUFFER_COUNT 256      // Provided receive buffers per worker (power of two)
+#define URING_BUFFER_SIZE 4096
+
+// Operation kind in the low bits of user_data (pointers are at least 8-byte aligned)
+#define URING_OP_ACCEPT 0u
+#define URING_OP_RECV 1u
+#define URING_OP_SEND 2u
+#define URING_OP_CANCEL 3u
+#define URING_OP_WAKE 4u        // Read on the handler pool eventfd
+#define URING_OP_BROADCAST 5u   // Read on the worker's broadcast eventfd
+#define URING_OP_MASK 7u
+
+// Shared-memory clients register their doorbell with this bit set in the event data
+#define SHM_DOORBELL_TAG 1u
+#define SHM_MAX_FRAMES_PER_WAKE 256     // Then yield to other connections
+
+// Handler pool: event data of the completion eventfd, and ring slots per (worker, thread) pair
+#define HANDLER_WAKE_DATA ((void*)(uintptr_t)2u)
+#define BROADCAST_WAKE_DATA ((void*)(uintptr_t)4u)
+#define HANDLER_QUEUE_SIZE 1024
+
+// MSG_TYPE_STATS replies
+#define STATS_MAX_CONNECTIONS 256       // Connections listed individually
+#define STATS_TEXT_MAX (64 * 1024)
+
+/**
+ * @brief Frame waiting in a connection's send queue
+ *
+ * The readiness backends write it when the socket accepts more; the
+ * io_uring backend submits header and payload as linked sends.
+ * Publications reference the payload of their SharedFrame instead of
+ * owning a copy.
+ */
+typedef struct OutboundFrame {
+    struct OutboundFrame* next;
+    ClientConnection* client;
+    uint8_t head[MESSAGE_HEAD_MAX_SIZE];
+    size_t head_size;
+    uint8_t* payload;       // Owned, released with message_payload_free, unless shared
+    size_t payload_size;
+    SharedFrame* shared;    // Publication holding the payload (one reference per frame)
+    size_t sent;            // Bytes confirmed written
+    unsigned pending;       // io_uring: completions outstanding for the submitted chain
+    int failed;
+} OutboundFrame;
+
+static inline uint64_t uring_tag(const void* ptr, unsigned op) {
+    return (uint64_t)(uintptr_t)ptr | op;
+}
+
+static inline void* uring_untag(uint64_t user_data) {
+    return (void*)(uintptr_t)(user_data & ~(uint64_t)URING_OP_MASK);
+}
+
+/**
+ * @brief Add to a counter that only the calling thread writes
+ */
+static inline void counter_add(_Atomic uint64_t* counter, uint64_t value) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value,
+                          memory_order_relaxed);
+}
+
+static inline void counter_set(_Atomic uint64_t* counter, uint64_t value) {
+    atomic_store_explicit(counter, value, memory_order_relaxed);
+}
+
+static void traffic_init(TrafficCounters* traffic) {
+    atomic_init(&traffic->messages_in, 0);
+    atomic_init(&traffic->bytes_in, 0);
+    atomic_init(&traffic->frames_out, 0);
+    atomic_init(&traffic->bytes_out, 0);
+    atomic_init(&traffic->rx_queued, 0);
+    atomic_init(&traffic->tx_queued, 0);
+    atomic_init(&traffic->broadcasts_out, 0);
+    atomic_init(&traffic->broadcasts_dropped, 0);
+    atomic_init(&traffic->broadcast_lag, 0);
+}
+
+static void traffic_read(const TrafficCounters* traffic, TrafficSnapshot* out) {
+    out->messages_in = atomic_load_explicit(&traffic->messages_in, memory_order_relaxed);
+    out->bytes_in = atomic_load_explicit(&traffic->bytes_in, memory_order_relaxed);
+    out->frames_out = atomic_load_explicit(&traffic->frames_out, memory_order_relaxed);
+    out->bytes_out = atomic_load_explicit(&traffic->bytes_out, memory_order_relaxed);
+    out->rx_queued = atomic_load_explicit(&traffic->rx_queued, memory_order_relaxed);
+    out->tx_queued = atomic_load_explicit(&traffic->tx_queued, memory_order_relaxed);
+    out->broadcasts_out = atomic_load_explicit(&traffic->broadcasts_out, memory_order_relaxed);
+    out->broadcasts_dropped = atomic_load_explicit(&traffic->broadcasts_dropped, memory_order_relaxed);
+    out->broadcast_lag = atomic_load_explicit(&traffic->broadcast_lag, memory_order_relaxed);
+}
+
+static void traffic_sum(TrafficSnapshot* dst, const TrafficSnapshot* src) {
+    dst->messages_in += src->messages_in;
+    dst->bytes_in += src->bytes_in;
+    dst->frames_out += src->frames_out;
+    dst->bytes_out += src->bytes_out;
+    dst->rx_queued += src->rx_queued;
+    dst->tx_queued += src->tx_queued;
+    dst->broadcasts_out += src->broadcasts_out;
+    dst->broadcasts_dropped += src->broadcasts_dropped;
+    dst->broadcast_lag += src->broadcast_lag;
+}
+
+/**
+ * @brief Find a live connection in the slab
+ * @return The connection, NULL if the ID is stale or unknown
+ */
+static ClientConnection* lookup_client(const ServerWorker* worker, uint64_t id) {
+    size_t slot = connection_id_slot(id);
+    if (slot >= worker->slot_count) {
+        return NULL;
+    }
+    const ClientSlot* entry = &worker->slots[slot];
+    if (!entry->client || entry->generation != connection_id_generation(id)) {
+        return NULL;
+    }
+    return entry->client;
+}
+
+static ClientConnection* add_client(ServerWorker* worker, int fd, void* ssl) {
+    // Grow the slab only when no released slot is left
+    if (worker->free_slot == CLIENT_SLOT_NONE && worker->slot_count >= worker->slot_capacity) {
+        if (worker->slot_capacity >= CONNECTION_ID_MAX_SLOTS) {
+            logger_error("Client table full (%zu connections)", worker->client_count);
+            return NULL;
+        }
+        size_t new_capacity = worker->slot_capacity == 0 ? 8 : worker->slot_capacity * 2;
+        pthread_mutex_lock(&worker->table_lock);
+        ClientSlot* new_slots = realloc(worker->slots, new_capacity * sizeof(ClientSlot));
+        if (new_slots) {
+            worker->slots = new_slots;
+            worker->slot_capacity = new_capacity;
+        }
+        pthread_mutex_unlock(&worker->table_lock);
+        if (!new_slots) {
             logger_error("Failed to allocate memory for clients");
+            return NULL;
+        }
+    }
+    
+    ClientConnection* client = malloc(sizeof(ClientConnection));
+    if (!client) {
+        logger_error("Failed to allocate memory for client");
+        return NULL;
+    }
+    client->fd = fd;
+    client->ssl = ssl;
+    client->is_ssl = (ssl != NULL);
+    client->id = 0;
+    client->state = ssl ? CLIENT_STATE_HANDSHAKE : CLIENT_STATE_ACTIVE;
+    client->handshake_deadline_ms = get_monotonic_ms() + (uint64_t)worker->server->options.handshake_timeout_ms;
+    client->interest = EVENT_READ;
+    frame_reader_init(&client->reader);
+    client->reader.stats = &worker->metrics.decompression;
+    client->reader.max_payload = worker->server->options.max_frame_size;
+    client->reader.validate = worker->server->options.validate_utf8 ? INTEGRITY_UTF8 : 0;
+    client->shm = NULL;
+    client->features = MSG_FEATURE_NONE;
+    client->connected_ms = get_monotonic_ms();
+    client->stream_offset = 0;
+    traffic_init(&client->traffic);
+    client->pending_ack_sequence = 0;
+    client->pending_ack_timestamp = 0;
+    client->pending_acks = 0;
+    client->send_queue = NULL;
+    client->send_queue_tail = NULL;
+    client->send_queued = 0;
+    client->broadcasts_queued = 0;
+    client->subscriptions = 0;
+    client->read_paused = 0;
+    client->handler_stalled = 0;
+    client->next_stalled = NULL;
+    client->uring_ops = 0;
+    client->recv_armed = 0;
+    client->closing = 0;
+    client->next_closing = NULL;
+    
+    // Register once; the descriptor stays in the loop until remove_client
+    if (worker->event_loop && event_loop_add(worker->event_loop, fd, EVENT_READ, client) < 0) {
+        logger_error("Failed to register client (fd=%d): %s", fd, get_error_string(errno));
+        free(client);
+        return NULL;
+    }
+    
+    // Reuse the most recently released slot: its memory is still warm
+    pthread_mutex_lock(&worker->table_lock);
+    uint32_t slot = worker->free_slot;
+    if (slot != CLIENT_SLOT_NONE) {
+        worker->free_slot = worker->slots[slot].next_free;
+    } else {
+        slot = (uint32_t)worker->slot_count++;
+        worker->slots[slot].generation = 1;
+    }
+    ClientSlot* entry = &worker->slots[slot];
+    entry->client = client;
+    entry->next_free = CLIENT_SLOT_NONE;
+    client->id = ((uint64_t)entry->generation << 32) |
+                 ((uint64_t)worker->id << CONNECTION_ID_SLOT_BITS) | slot;
+    worker->client_count++;
+    worker->metrics.total_clients++;
+    pthread_mutex_unlock(&worker->table_lock);
+    if (client->state == CLIENT_STATE_HANDSHAKE) {
+        worker->metrics.handshakes_in_progress++;
+        TRACE_PROBE1(handshake_start, client->id);
+    }
+    return client;
+}
+
+/**
+ * @brief Release a send and its payload (or its reference to the shared publication)
+ */
+static void free_outbound(OutboundFrame* send) {
+    if (send->shared) {
+        shared_frame_release(send->shared);
+    } else {
+        message_payload_free(send->payload);
+    }
+    buffer_pool_free(send);
+}
+
+static void close_client(ClientConnection* client) {
+    if (client->is_ssl && client->ssl) {
+        close_tls_connection(client->ssl);
+    }
+    close(client->fd);
+    frame_reader_free(&client->reader);
+    shm_channel_destroy(client->shm);
+    if (client->handler_stalled) {
+        message_free(&client->stalled_task.msg);
+    }
+    while (client->send_queue) {
+        OutboundFrame* send = client->send_queue;
+        client->send_queue = send->next;
+        free_outbound(send);
+    }
+    free(client);
+}
+
+/**
+ * @brief Take a client out of the worker's table without closing it
+ * @return 0 on success, -1 if the client is not in the table
+ */
+static int detach_client(ServerWorker* worker, ClientConnection* client) {
+    if (lookup_client(worker, client->id) != client) {
+        return -1;
+    }
+    
+    logger_info("Client disconnected (fd=%d)", client->fd);
+    if (client->subscriptions > 0) {
+        topic_table_remove_connection(&worker->topics, client->id);
+        client->subscriptions = 0;
+    }
+    if (client->state == CLIENT_STATE_HANDSHAKE) {
+        worker->metrics.handshakes_in_progress--;
+        worker->metrics.handshakes_failed++;
+    }
+    if (client->handler_stalled) {
+        ClientConnection** link = &worker->stalled_clients;
+        while (*link && *link != client) {
+            link = &(*link)->next_stalled;
+        }
+        if (*link) {
+            *link = client->next_stalled;
+        }
+    }
+    
+    if (worker->event_loop) {
+        event_loop_remove(worker->event_loop, client->fd);
+        if (client->shm) {
+            event_loop_remove(worker->event_loop, shm_channel_fd(client->shm));
+        }
+    }
+    
+    // Release the slot under a new generation so the old ID never resolves
+    // again; the connection's totals move to the worker at the same time
+    pthread_mutex_lock(&worker->table_lock);
+    size_t slot = connection_id_slot(client->id);
+    ClientSlot* entry = &worker->slots[slot];
+    entry->client = NULL;
+    entry->generation = entry->generation + 1 != 0 ? entry->generation + 1 : 1;
+    entry->next_free = worker->free_slot;
+    worker->free_slot = (uint32_t)slot;
+    worker->client_count--;
+    TrafficSnapshot traffic;
+    traffic_read(&client->traffic, &traffic);
+    counter_add(&worker->closed_traffic.messages_in, traffic.messages_in);
+    counter_add(&worker->closed_traffic.bytes_in, traffic.bytes_in);
+    counter_add(&worker->closed_traffic.frames_out, traffic.frames_out);
+    counter_add(&worker->closed_traffic.bytes_out, traffic.bytes_out);
+    counter_add(&worker->closed_traffic.broadcasts_out, traffic.broadcasts_out);
+    counter_add(&worker->closed_traffic.broadcasts_dropped, traffic.broadcasts_dropped);
+    pthread_mutex_unlock(&worker->table_lock);
+    return 0;
+}
+
+/**
+ * @brief Remove a client now but free it after the current batch of events
+ */
+static void remove_client_deferred(ServerWorker* worker, ClientConnection* client) {
+    if (client->closing || detach_client(worker, client) < 0) {
+        return;
+    }
+    client->closing = 1;
+    client->next_closing = worker->closing_clients;
+    worker->closing_clients = client;
+}
+
+static void remove_client(ServerWorker* worker, ClientConnection* client) {
+    if (client->shm) {
+        // Socket and doorbell may both be in the current batch of events: free after it
+        remove_client_deferred(worker, client);
+        return;
+    }
+    if (detach_client(worker, client) < 0) {
+        return;
+    }
+    close_client(client);
+}
+
+/**
+ * @brief Free connections removed while handling the last batch of events
+ */
+static void release_closed_clients(ServerWorker* worker) {
+    while (worker->closing_clients) {
+        ClientConnection* client = worker->closing_clients;
+        worker->closing_clients = client->next_closing;
+        close_client(client);
+    }
+}
+
+/**
+ * @brief Move a freshly accepted connection onto a shared-memory channel
+ * @return 0 on success, -1 on error (the caller removes the client)
+ */
+static int attach_shm_channel(ServerWorker* worker, ClientConnection* client) {
+    client->shm = shm_channel_create(client->fd, worker->server->options.shm_ring_size);
+    if (!client->shm) {
+        return -1;
+    }
+    shm_channel_set_stats(client->shm, &worker->metrics.decompression);
+    shm_channel_set_validation(client->shm, worker->server->options.validate_utf8 ? INTEGRITY_UTF8 : 0);
+    shm_channel_set_max_payload(client->shm, worker->server->options.max_frame_size);
+    
+    void* tagged = (void*)((uintptr_t)client | SHM_DOORBELL_TAG);
+    if (event_loop_add(worker->event_loop, shm_channel_fd(client->shm), EVENT_READ, tagged) < 0) {
+        logger_error("Failed to register doorbell (fd=%d): %s", client->fd, get_error_string(errno));
+        return -1;
+    }
+    
+    // Nothing was announced yet: ask for the first wake-up, unless the client already wrote
+    if (shm_channel_end_read(client->shm)) {
+        shm_channel_wake(client->shm);
+    }
+    logger_info("Shared-memory channel ready (fd=%d, %zu KiB per direction)", client->fd,
+                shm_channel_ring_size(client->shm) / 1024);
+    return 0;
+}
+
+static int advance_handshake(ServerWorker* worker, ClientConnection* client);
+static int set_interest(ServerWorker* worker, ClientConnection* client, uint32_t interest);
+static int dispatch_frames(ServerWorker* worker, ClientConnection* client);
+static void flush_pending_ack(ServerWorker* worker, ClientConnection* client);
+
+static void accept_new_connection(ServerWorker* worker) {
+    Server* server = worker->server;
+    
+    // Drain the accept queue (required for edge-triggered notification)
+    for (;;) {
+        int client_fd = accept(worker->listen_fd, NULL, NULL);
+        if (client_fd < 0) {
+            if (errno == EINTR) continue;
+            // EAGAIN also means another worker took it from a shared queue
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                logger_error("Accept error: %s", get_error_string(errno));
+            }
+            return;
+        }
+        
+        // Client sockets are non-blocking: reads and handshakes never stall the loop
+        int flags = fcntl(client_fd, F_GETFL, 0);
+        fcntl(client_fd, F_SETFL, flags | O_NONBLOCK);
+        if (server->mode == SOCKET_MODE_INET) {
+            tuning_apply_connected(client_fd, &server->options.tuning);
+        }
+        
+        void* ssl = NULL;
+        if (server->enable_tls) {
+            ssl = create_tls_connection(client_fd, server->ssl_ctx);
+            if (!ssl) {
+                logger_error("Failed to create TLS state (fd=%d)", client_fd);
+                close(client_fd);
+                continue;
+            }
+        }
+        
+        ClientConnection* client = add_client(worker, client_fd, ssl);
+        if (!client) {
+            if (ssl) {
+                close_tls_connection(ssl);
+            }
+            close(client_fd);
+            continue;
+        }
+        logger_info("New client connected (fd=%d, worker=%zu, id=%llx)", client_fd, worker->id,
+                    (unsigned long long)client->id);
+        TRACE_PROBE3(accept, worker->id, client_fd, client->id);
+        
+        if (server->mode == SOCKET_MODE_SHM && attach_shm_channel(worker, client) < 0) {
+            remove_client(worker, client);
+            continue;
+        }
+        
+        // The ClientHello usually arrives right behind the connection
+        if (client->state == CLIENT_STATE_HANDSHAKE) {
+            advance_handshake(worker, client);
+        }
+    }
+}
+
+/**
+ * @brief Close a connection on the io_uring backend
+ *
+ * The connection leaves the client table at once; shutdown() completes its
+ * armed receive and any send in flight, and the memory is released by
+ * uring_release_client once the last completion has been handled.
+ */
+static void uring_close_client(ServerWorker* worker, ClientConnection* client) {
+    if (client->closing) {
+        return;
+    }
+    detach_client(worker, client);
+    client->closing = 1;
+    shutdown(client->fd, SHUT_RDWR);
+    client->next_closing = worker->closing_clients;
+    worker->closing_clients = client;
+}
+
+/**
+ * @brief Free a closing connection once no operation references it
+ * @note Call last in a completion handler; the client may be freed
+ */
+static void uring_release_client(ServerWorker* worker, ClientConnection* client) {
+    if (!client->closing || client->uring_ops > 0) {
+        return;
+    }
+    ClientConnection** link = &worker->closing_clients;
+    while (*link && *link != client) {
+        link = &(*link)->next_closing;
+    }
+    if (*link) {
+        *link = client->next_closing;
+    }
+    close_client(client);
+}
+
+/**
+ * @brief Submit the unsent part of a frame as linked header and payload sends
+ */
+static void uring_submit_send(ServerWorker* worker, OutboundFrame* send) {
+    ClientConnection* client = send->client;
+    uint64_t tag = uring_tag(send, URING_OP_SEND);
+    send->pending = 0;
+    send->failed = 0;
+    
+    if (send->sent < send->head_size) {
+        int link = send->payload_size > 0;
+        if (uring_send(worker->uring, client->fd, send->head + send->sent,
+                       send->head_size - send->sent, link, tag) < 0) {
+            send->failed = 1;
+        } else {
+            send->pending++;
+        }
+    }
+    if (!send->failed && send->payload_size > 0) {
+        size_t offset = send->sent > send->head_size ? send->sent - send->head_size : 0;
+        if (uring_send(worker->uring, client->fd, send->payload + offset,
+                       send->payload_size - offset, 0, tag) < 0) {
+            send->failed = 1;
+        } else {
+            send->pending++;
+        }
+    }
+    client->uring_ops += send->pending;
+    
+    if (send->pending == 0) {
+        logger_error("io_uring submission queue full, dropping client (fd=%d)", client->fd);
+        uring_close_client(worker, client);
+    }
+}
+
+/**
+ * @brief Arm the multishot receive of an io_uring client
+ */
+static int uring_arm_recv(ServerWorker* worker, ClientConnection* client) {
+    if (uring_recv_multishot(worker->uring, client->fd, uring_tag(client, URING_OP_RECV)) < 0) {
+        logger_error("Failed to arm receive for client (fd=%d)", client->fd);
+        return -1;
+    }
+    client->uring_ops++;
+    client->recv_armed = 1;
+    return 0;
+}
+
+/**
+ * @brief Drop a client whose send failed (it may still be on the call stack)
+ */
+static void fail_client(ServerWorker* worker, ClientConnection* client) {
+    if (worker->uring) {
+        uring_close_client(worker, client);
+    } else {
+        remove_client_deferred(worker, client);
+    }
+}
+
+/**
+ * @brief Account for written bytes of the frame at the head of the send queue
+ */
+static void send_queue_advance(ClientConnection* client, size_t bytes) {
+    client->send_queued -= bytes;
+    counter_set(&client->traffic.tx_queued, client->send_queued);
+}
+
+/**
+ * @brief Release the fully written frame at the head of the send queue
+ */
+static void send_queue_pop(ClientConnection* client) {
+    OutboundFrame* send = client->send_queue;
+    client->send_queue = send->next;
+    if (!client->send_queue) {
+        client->send_queue_tail = NULL;
+    }
+    if (send->shared) {
+        client->broadcasts_queued--;
+        counter_set(&client->traffic.broadcast_lag, client->broadcasts_queued);
+    }
+    free_outbound(send);
+}
+
+/**
+ * @brief Write queued frames until the socket would block (readiness backends)
+ *
+ * Write interest is registered exactly while frames are left.
+ * @return 0 on success, -1 on a write error
+ */
+static int flush_send_queue(ServerWorker* worker, ClientConnection* client) {
+    while (client->send_queue) {
+        OutboundFrame* send = client->send_queue;
+        struct iovec iov[2];
+        int iovcnt = 0;
+        if (send->sent < send->head_size) {
+            iov[iovcnt].iov_base = send->head + send->sent;
+            iov[iovcnt].iov_len = send->head_size - send->sent;
+            iovcnt++;
+        }
+        size_t offset = send->sent > send->head_size ? send->sent - send->head_size : 0;
+        if (offset < send->payload_size) {
+            iov[iovcnt].iov_base = send->payload + offset;
+            iov[iovcnt].iov_len = send->payload_size - offset;
+            iovcnt++;
+        }
+        
+        ssize_t written = client->shm ? shm_channel_write(client->shm, iov, iovcnt) :
+                          send_nonblocking(client->fd, client->ssl, client->is_ssl, iov, iovcnt);
+        if (written < 0) {
+            logger_error("Send to client (fd=%d) failed: %s", client->fd, get_error_string(errno));
+            return -1;
+        }
+        if (written == 0) {
+            break;
+        }
+        send->sent += (size_t)written;
+        send_queue_advance(client, (size_t)written);
+        if (send->sent == send->head_size + send->payload_size) {
+            send_queue_pop(client);
+        }
+    }
+    if (client->shm) {
+        // The doorbell reports released ring space; the socket is only watched for hang-up
+        return 0;
+    }
+    
+    uint32_t interest = (client->read_paused ? 0 : EVENT_READ) | (client->send_queue ? EVENT_WRITE : 0);
+    return set_interest(worker, client, interest);
+}
+
+/**
+ * @brief Stop reading from a client until maybe_resume_reading lets it go on
+ */
+static void pause_reading(ServerWorker* worker, ClientConnection* client) {
+    client->read_paused = 1;
+    if (client->shm) {
+        // handle_shm_doorbell leaves the ring unread while paused
+        return;
+    }
+    if (!worker->uring) {
+        if (set_interest(worker, client, client->send_queue ? EVENT_WRITE : 0) < 0) {
+            remove_client_deferred(worker, client);
+        }
+        return;
+    }
+    // Received data already in the completion queue is buffered, not dispatched
+    if (client->recv_armed &&
+        uring_cancel(worker->uring, uring_tag(client, URING_OP_RECV), uring_tag(client, URING_OP_CANCEL)) == 0) {
+        client->uring_ops++;
+    }
+}
+
+/**
+ * @brief Resume a paused client once its send queue has drained to the low watermark
+ *
+ * A client whose handler task is stalled stays paused until it is queued.
+ */
+static void maybe_resume_reading(ServerWorker* worker, ClientConnection* client) {
+    if (!client->read_paused || client->closing || client->handler_stalled ||
+        client->send_queued > worker->server->options.send_queue_low) {
+        return;
+    }
+    client->read_paused = 0;
+    logger_info("Client (fd=%d) caught up: resuming reads", client->fd);
+    
+    if (client->shm) {
+        // Frames that arrived meanwhile wait in the ring
+        shm_channel_wake(client->shm);
+        return;
+    }
+    if (worker->uring) {
+        if (!client->recv_armed && uring_arm_recv(worker, client) < 0) {
+            uring_close_client(worker, client);
+            return;
+        }
+    } else if (set_interest(worker, client, EVENT_READ | (client->send_queue ? EVENT_WRITE : 0)) < 0) {
+        remove_client_deferred(worker, client);
+        return;
+    }
+    
+    // Frames that arrived before the pause are still in the read buffer
+    if (dispatch_frames(worker, client) < 0) {
+        fail_client(worker, client);
+        return;
+    }
+    flush_pending_ack(worker, client);
+}
+
+/**
+ * @brief Append a send to the client's queue and start writing it
+ *
+ * Frames go out one at a time to keep their order. A client whose
+ * queue grows past the high watermark is no longer read from.
+ */
+static void enqueue_send(ServerWorker* worker, ClientConnection* client, OutboundFrame* send) {
+    if (client->send_queue_tail) {
+        client->send_queue_tail->next = send;
+    } else {
+        client->send_queue = send;
+    }
+    client->send_queue_tail = send;
+    client->send_queued += send->head_size + send->payload_size;
+    counter_set(&client->traffic.tx_queued, client->send_queued);
+    
+    if (client->send_queue == send) {
+        if (worker->uring) {
+            uring_submit_send(worker, send);
+        } else if (flush_send_queue(worker, client) < 0) {
+            remove_client_deferred(worker, client);
+            return;
+        }
+    }
+    if (client->send_queued > worker->metrics.send_queue_peak) {
+        worker->metrics.send_queue_peak = client->send_queued;
+    }
+    
+    size_t high = worker->server->options.send_queue_high;
+    if (high > 0 && client->send_queued > high && !client->read_paused && !client->closing) {
+        worker->metrics.read_pauses++;
+        logger_warn("Client (fd=%d) is not reading: pausing reads with %zu bytes queued", client->fd,
+                    client->send_queued);
+        pause_reading(worker, client);
+    }
+}
+
+/**
+ * @brief Queue a frame for the client, taking over its payload
+ */
+static void queue_frame(ServerWorker* worker, ClientConnection* client, Message* msg) {
+    if (client->closing) {
+        message_free(msg);
+        return;
+    }
+    
+    OutboundFrame* send = buffer_pool_alloc(sizeof(OutboundFrame));
+    if (!send) {
+        logger_error("Failed to allocate send for client (fd=%d)", client->fd);
+        message_free(msg);
+        fail_client(worker, client);
+        return;
+    }
+    memset(send, 0, sizeof(OutboundFrame));
+    send->client = client;
+    send->head_size = message_encode_head(msg, send->head);
+    size_t expected = msg->payload_size;
+    send->payload = message_take_payload(msg, &send->payload_size);
+    message_free(msg);
+    if (send->payload_size != expected) {
+        logger_error("Failed to allocate payload for client (fd=%d)", client->fd);
+        buffer_pool_free(send);
+        fail_client(worker, client);
+        return;
+    }
+    enqueue_send(worker, client, send);
+}
+
+/**
+ * @brief Send a frame to a client and free it
+ */
+static void send_to_client(ServerWorker* worker, ClientConnection* client, Message* msg) {
+    counter_add(&client->traffic.frames_out, 1);
+    counter_add(&client->traffic.bytes_out, message_total_size(msg));
+    if (client->shm && !client->closing && !client->send_queue &&
+        shm_channel_unread(client->shm) + message_total_size(msg) <= shm_channel_ring_size(client->shm)) {
+        // Fits the ring: written whole without waiting, no queue entry needed
+        if (shm_channel_send(client->shm, msg, 0) < 0) {
+            // Like a failed socket write: the client would miss this reply
+            logger_error("Shared-memory send to client (fd=%d) failed", client->fd);
+            fail_client(worker, client);
+        }
+        message_free(msg);
+        return;
+    }
+    queue_frame(worker, client, msg);
+}
+
+static void send_ack(ServerWorker* worker, ClientConnection* client, Message* ack) {
+    TRACE_PROBE2(ack_send, client->id, (ack->header.flags & MSG_FLAGS_SEQUENCED) ? ack->sequence : 0);
+    send_to_client(worker, client, ack);
+    worker->metrics.ack_frames_sent++;
+}
+
+/**
+ * @brief Send the cumulative ACK covering every message dispatched so far
+ */
+static void flush_pending_ack(ServerWorker* worker, ClientConnection* client) {
+    if (client->pending_acks == 0) {
+        return;
+    }
+    Message ack = message_create_ack_batch(client->pending_ack_sequence);
+    if (client->pending_ack_timestamp != 0) {
+        message_set_timestamp(&ack, client->pending_ack_timestamp);
+    }
+    send_ack(worker, client, &ack);
+    client->pending_acks = 0;
+}
+
+static void handle_hello(ServerWorker* worker, ClientConnection* client, const Message* msg) {
+    uint32_t requested = 0;
+    if (message_parse_hello(msg, &requested) < 0) {
+        logger_warn("Malformed HELLO from client (fd=%d)", client->fd);
+    }
+    
+    uint32_t supported = MSG_FEATURE_NONE;
+    if (worker->server->options.ack_batch) {
+        supported |= MSG_FEATURE_ACK_BATCH;
+    }
+    if (worker->server->options.compression) {
+        supported |= MSG_FEATURE_COMPRESSION;
+    }
+    if (worker->server->options.checksums) {
+        supported |= MSG_FEATURE_CHECKSUM;
+    }
+    supported |= MSG_FEATURE_TIMESTAMPS | MSG_FEATURE_SEQUENCE;
+    client->features = requested & supported;
+    logger_info("Client (fd=%d) negotiated features=0x%x", client->fd, client->features);
+    
+    Message reply = message_create_hello(client->features);
+    send_to_client(worker, client, &reply);
+}
+
+/**
+ * @brief Answer MSG_TYPE_STATS with a snapshot of every worker
+ */
+static void handle_stats_request(ServerWorker* worker, ClientConnection* client) {
+    if (!worker->server->options.stats_requests) {
+        static const char disabled[] = "stats requests are disabled";
+        Message error = message_create_error(disabled, sizeof(disabled) - 1);
+        send_to_client(worker, client, &error);
+        return;
+    }
+    
+    char* text = malloc(STATS_TEXT_MAX);
+    if (!text) {
+        logger_error("Failed to allocate stats reply");
+        return;
+    }
+    size_t length = server_format_stats(worker->server, text, STATS_TEXT_MAX);
+    Message reply = message_create_stats(text, length);
+    free(text);
+    send_to_client(worker, client, &reply);
+}
+
+/**
+ * @brief Call the handler for one message (worker or handler thread)
+ * @param stream_offset MSG_TYPE_CHUNK: stream bytes delivered before this chunk
+ */
+static void run_handler(const Server* server, uint64_t connection_id, Message* msg, uint64_t stream_offset) {
+    TRACE_PROBE2(handler_start, connection_id, msg->header.type);
+    if (msg->header.type == MSG_TYPE_CHUNK && server->stream_handler) {
+        StreamChunk chunk;
+        chunk.offset = stream_offset;
+        chunk.data = msg->payload;
+        chunk.length = msg->payload_size;
+        chunk.final = (msg->header.flags & MSG_FLAGS_FINAL) != 0;
+        server->stream_handler(connection_id, &chunk);
+    } else if (server->batch_handler) {
+        server->batch_handler(connection_id, msg, 1);
+    } else if (server->handler) {
+        server->handler(connection_id, msg);
+    }
+    TRACE_PROBE2(handler_done, connection_id, msg->header.type);
+}
+
+static void run_handler_task(void* context, HandlerTask* task) {
+    run_handler((const Server*)context, task->connection_id, &task->msg, task->stream_offset);
+}
+
+/**
+ * @brief Account for one chunk of the client's current stream
+ */
+static void advance_stream(ServerWorker* worker, ClientConnection* client, const Message* msg) {
+    client->stream_offset += msg->payload_size;
+    if (msg->header.flags & MSG_FLAGS_FINAL) {
+        logger_info("Stream of %llu bytes from client id=%llx complete",
+                    (unsigned long long)client->stream_offset, (unsigned long long)client->id);
+        client->stream_offset = 0;
+        worker->metrics.streams_completed++;
+    }
+}
+
+/**
+ * @brief ACK a handled message, batched when the client negotiated it
+ */
+static void acknowledge(ServerWorker* worker, ClientConnection* client, const Message* msg) {
+    if (!message_needs_ack(&msg->header)) {
+        return;
+    }
+    uint64_t timestamp = (msg->header.flags & MSG_FLAGS_TIMESTAMPED) ? msg->timestamp_ns : 0;
+    
+    // Batched: remember the sequence, one ACK_BATCH covers the whole read
+    if ((client->features & MSG_FEATURE_ACK_BATCH) && (msg->header.flags & MSG_FLAGS_SEQUENCED)) {
+        client->pending_ack_sequence = msg->sequence;
+        client->pending_ack_timestamp = timestamp;
+        client->pending_acks++;
+        if (client->pending_acks >= worker->server->options.ack_batch_max) {
+            flush_pending_ack(worker, client);
+        }
+        return;
+    }
+    
+    // Echo ACK (carrying the sequence number, if any); earlier batched ACKs go first
+    flush_pending_ack(worker, client);
+    Message ack = message_create_ack();
+    if (msg->header.flags & MSG_FLAGS_SEQUENCED) {
+        message_set_sequence(&ack, msg->sequence);
+    }
+    if (timestamp != 0) {
+        message_set_timestamp(&ack, timestamp);
+    }
+    send_ack(worker, client, &ack);
+}
+
+/**
+ * @brief Queue the tasks that found their handler ring full, and resume those connections
+ */
+static void submit_stalled_tasks(ServerWorker* worker) {
+    HandlerPool* pool = worker->server->handler_pool;
+    ClientConnection* stalled = worker->stalled_clients;
+    worker->stalled_clients = NULL;
+    
+    while (stalled) {
+        ClientConnection* client = stalled;
+        stalled = client->next_stalled;
+        if (client->closing) {
+            // close_client releases the task
+            continue;
+        }
+        if (handler_pool_submit(pool, worker->id, &client->stalled_task) < 0) {
+            client->next_stalled = worker->stalled_clients;
+            worker->stalled_clients = client;
+            continue;
+        }
+        client->handler_stalled = 0;
+        // Dispatches the frames buffered meanwhile, which may stall it again
+        maybe_resume_reading(worker, client);
+    }
+}
+
+/**
+ * @brief Send the ACKs of messages whose handler thread has finished with them
+ */
+static void handle_handler_completions(ServerWorker* worker) {
+    HandlerPool* pool = worker->server->handler_pool;
+    HandlerCompletion completion;
+    ClientConnection* batch = NULL;     // Client whose cumulative ACK may still be open
+    
+    while (handler_pool_next_completion(pool, worker->id, &completion)) {
+        // Connections closed meanwhile no longer resolve
+        ClientConnection* client = lookup_client(worker, completion.connection_id);
+        if (batch && batch != client && !batch->closing) {
+            flush_pending_ack(worker, batch);
+        }
+        batch = client;
+        if (client && !client->closing) {
+            acknowledge(worker, client, &completion.msg);
+        }
+    }
+    if (batch && !batch->closing) {
+        flush_pending_ack(worker, batch);
+    }
+    submit_stalled_tasks(worker);
+}
+
+/**
+ * @brief Queue a message for the handler thread that owns its connection
+ *
+ * The payload moves to the handler thread. While that thread's queue is
+ * full the connection keeps the task and is not read from; the pool wakes
+ * the worker once the thread has made room.
+ */
+static void offload_message(ServerWorker* worker, ClientConnection* client, Message* msg, uint64_t stream_offset,
+                            int notify) {
+    HandlerPool* pool = worker->server->handler_pool;
+    HandlerTask task;
+    task.connection_id = client->id;
+    task.msg = *msg;
+    task.stream_offset = stream_offset;
+    task.notify = notify;
+    msg->payload = NULL;
+    msg->payload_size = 0;
+    
+    if (handler_pool_submit(pool, worker->id, &task) == 0) {
+        return;
+    }
+    worker->metrics.handler_stalls++;
+    client->stalled_task = task;
+    client->handler_stalled = 1;
+    client->next_stalled = worker->stalled_clients;
+    worker->stalled_clients = client;
+    if (!client->read_paused) {
+        pause_reading(worker, client);
+    }
+}
+
+/**
+ * @brief Arrival time of the frames being dispatched, read once per read
+ */
+static uint64_t batch_now(ServerWorker* worker) {
+    if (worker->batch.now_ns == 0) {
+        worker->batch.now_ns = get_monotonic_ns();
+    }
+    return worker->batch.now_ns;
+}
+
+/**
+ * @brief Count frames that arrived together
+ *
+ * The gap since the previous read is one interval; the other frames of
+ * the read arrived with it and add intervals of zero.
+ */
+static void record_arrivals(ServerWorker* worker, ClientConnection* client, size_t count, size_t bytes) {
+    ServerMetrics* metrics = &worker->metrics;
+    double now = (double)batch_now(worker) / 1e9;
+    if (metrics->last_message_time > 0.0) {
+        double interval_ms = (now - metrics->last_message_time) * 1000.0;
+        metrics->total_interval_ms += interval_ms;
+        if (metrics->interval_count == 0 || interval_ms < metrics->min_interval_ms) {
+            metrics->min_interval_ms = interval_ms;
+        }
+        if (metrics->interval_count == 0 || interval_ms > metrics->max_interval_ms) {
+            metrics->max_interval_ms = interval_ms;
+        }
+        metrics->interval_count++;
+    }
+    if (count > 1) {
+        metrics->min_interval_ms = 0.0;
+        metrics->interval_count += count - 1;
+    }
+    metrics->last_message_time = now;
+    metrics->total_messages += count;
+    metrics->total_bytes += bytes;
+    counter_add(&client->traffic.messages_in, count);
+    counter_add(&client->traffic.bytes_in, bytes);
+}
+
+/**
+ * @brief Hand the collected frames to the MessageBatchHandler and acknowledge them
+ */
+static void flush_batch(ServerWorker* worker, ClientConnection* client) {
+    DispatchBatch* batch = &worker->batch;
+    if (batch->count == 0) {
+        return;
+    }
+    record_arrivals(worker, client, batch->count, batch->bytes);
+    worker->metrics.dispatch_batches++;
+    TRACE_PROBE2(batch_start, client->id, batch->count);
+    worker->server->batch_handler(client->id, batch->msgs, batch->count);
+    TRACE_PROBE2(batch_done, client->id, batch->count);
+    for (size_t i = 0; i < batch->count; i++) {
+        if (!client->closing) {
+            acknowledge(worker, client, &batch->msgs[i]);
+        }
+        message_free(&batch->msgs[i]);
+    }
+    batch->count = 0;
+    batch->bytes = 0;
+}
+
+/**
+ * @brief Frames the server answers itself instead of passing them to the handler
+ */
+static int handled_by_server(uint32_t type) {
+    return type == MSG_TYPE_HELLO || type == MSG_TYPE_STATS || type == MSG_TYPE_SUBSCRIBE ||
+           type == MSG_TYPE_UNSUBSCRIBE || type == MSG_TYPE_PUBLISH;
+}
+
+static void send_error(ServerWorker* worker, ClientConnection* client, const char* text) {
+    Message error = message_create_error(text, strlen(text));
+    send_to_client(worker, client, &error);
+}
+
+/**
+ * @brief Skip a publication for a lagging subscriber, or drop the subscriber
+ */
+static void drop_publication(ServerWorker* worker, ClientConnection* client) {
+    if (worker->server->options.subscriber_drop == SUBSCRIBER_DROP_CONNECTION) {
+        logger_warn("Subscriber (fd=%d) is %zu bytes behind: disconnecting", client->fd,
+                    client->send_queued + (client->shm ? shm_channel_unread(client->shm) : 0));
+        worker->metrics.subscribers_dropped++;
+        fail_client(worker, client);
+        return;
+    }
+    worker->metrics.broadcast_drops++;
+    counter_add(&client->traffic.broadcasts_dropped, 1);
+}
+
+/**
+ * @brief Queue a publication for one subscriber, sharing its payload
+ */
+static void send_publication(ServerWorker* worker, ClientConnection* client, SharedFrame* frame) {
+    size_t size = shared_frame_size(frame);
+    int lagging;
+    if (client->shm) {
+        // The ring is the queue: never wait for a subscriber to make room, nor overtake queued replies
+        lagging = client->send_queue ||
+                  shm_channel_unread(client->shm) + size > shm_channel_ring_size(client->shm);
+    } else {
+        size_t limit = worker->server->options.subscriber_queue_max;
+        if (limit == 0) {
+            limit = worker->server->options.send_queue_high;
+        }
+        lagging = limit > 0 && client->send_queued + size > limit;
+    }
+    if (lagging) {
+        drop_publication(worker, client);
+        return;
+    }
+    
+    counter_add(&client->traffic.frames_out, 1);
+    counter_add(&client->traffic.bytes_out, size);
+    counter_add(&client->traffic.broadcasts_out, 1);
+    worker->metrics.broadcast_deliveries++;
+    if (client->shm) {
+        Message view = frame->msg;
+        view.borrowed = 1;
+        if (shm_channel_send(client->shm, &view, 0) < 0) {
+            logger_error("Shared-memory send to client (fd=%d) failed", client->fd);
+            fail_client(worker, client);
+        }
+        return;
+    }
+    
+    OutboundFrame* send = buffer_pool_alloc(sizeof(OutboundFrame));
+    if (!send) {
+        logger_error("Failed to allocate send for client (fd=%d)", client->fd);
+        fail_client(worker, client);
+        return;
+    }
+    memset(send, 0, sizeof(OutboundFrame));
+    send->client = client;
+    memcpy(send->head, frame->head, frame->head_size);
+    send->head_size = frame->head_size;
+    send->payload = frame->msg.payload;
+    send->payload_size = frame->msg.payload_size;
+    send->shared = frame;
+    shared_frame_retain(frame);
+    client->broadcasts_queued++;
+    counter_set(&client->traffic.broadcast_lag, client->broadcasts_queued);
+    enqueue_send(worker, client, send);
+}
+
+/**
+ * @brief Queue a publication for every subscriber of its topic on this worker
+ */
+static void deliver_publication(ServerWorker* worker, SharedFrame* frame) {
+    Topic* topic = topic_table_find(&worker->topics, frame->topic, frame->topic_len);
+    if (!topic) {
+        return;
+    }
+    worker->metrics.broadcasts++;
+    
+    // Subscribers dropped on the way leave the table: walk a copy of the IDs
+    size_t count = topic->count;
+    uint64_t* ids = buffer_pool_alloc(count * sizeof(uint64_t));
+    if (!ids) {
+        logger_error("Failed to allocate %zu subscribers", count);
+        return;
+    }
+    memcpy(ids, topic->subscribers, count * sizeof(uint64_t));
+    for (size_t i = 0; i < count; i++) {
+        ClientConnection* client = lookup_client(worker, ids[i]);
+        if (client && !client->closing) {
+            send_publication(worker, client, frame);
+        }
+    }
+    buffer_pool_free(ids);
+}
+
+/**
+ * @brief Hand a publication to the inboxes of every worker but skip
+ * @return 0 on success, -1 if an inbox could not take it
+ */
+static int post_publication(Server* server, SharedFrame* frame, const ServerWorker* skip) {
+    int result = 0;
+    for (size_t w = 0; w < server->worker_count; w++) {
+        ServerWorker* worker = &server->workers[w];
+        if (worker == skip) {
+            continue;
+        }
+        pthread_mutex_lock(&worker->inbox_lock);
+        if (worker->inbox_count == worker->inbox_capacity) {
+            size_t capacity = worker->inbox_capacity ? worker->inbox_capacity * 2 : 64;
+            SharedFrame** inbox = realloc(worker->inbox, capacity * sizeof(SharedFrame*));
+            if (!inbox) {
+                pthread_mutex_unlock(&worker->inbox_lock);
+                logger_error("Failed to queue publication for worker %zu", worker->id);
+                result = -1;
+                continue;
+            }
+            worker->inbox = inbox;
+            worker->inbox_capacity = capacity;
+        }
+        shared_frame_retain(frame);
+        worker->inbox[worker->inbox_count++] = frame;
+        int wake = worker->inbox_count == 1;
+        pthread_mutex_unlock(&worker->inbox_lock);
+        
+        // One wake-up per batch: the worker empties the whole inbox
+        uint64_t one = 1;
+        if (wake && write(worker->broadcast_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            logger_error("Failed to wake worker %zu: %s", worker->id, get_error_string(errno));
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Deliver the publications other threads queued for this worker
+ */
+static void drain_inbox(ServerWorker* worker) {
+    pthread_mutex_lock(&worker->inbox_lock);
+    SharedFrame** frames = worker->inbox;
+    size_t count = worker->inbox_count;
+    worker->inbox = NULL;
+    worker->inbox_count = 0;
+    worker->inbox_capacity = 0;
+    pthread_mutex_unlock(&worker->inbox_lock);
+    
+    for (size_t i = 0; i < count; i++) {
+        deliver_publication(worker, frames[i]);
+        shared_frame_release(frames[i]);
+    }
+    free(frames);
+}
+
+/**
+ * @brief Apply a SUBSCRIBE or UNSUBSCRIBE request
+ */
+static void handle_subscription(ServerWorker* worker, ClientConnection* client, const Message* msg) {
+    const char* topic = (const char*)msg->payload;
+    size_t length = msg->payload_size;
+    if (length == 0 || length > MSG_TOPIC_MAX) {
+        send_error(worker, client, "topic names are 1 to 255 bytes");
+        return;
+    }
+    
+    if (msg->header.type == MSG_TYPE_SUBSCRIBE) {
+        int added = topic_table_subscribe(&worker->topics, topic, length, client->id);
+        if (added < 0) {
+            logger_error("Failed to allocate subscription for client (fd=%d)", client->fd);
+            send_error(worker, client, "subscription failed");
             return;
         }
-        server->clients = new_clients;
-        server->client_capacity = new_capacity;
+        if (added) {
+            client->subscriptions++;
+            logger_info("Client id=%llx subscribed to %.*s", (unsigned long long)client->id, (int)length, topic);
+        }
+    } else if (topic_table_unsubscribe(&worker->topics, topic, length, client->id)) {
+        client->subscriptions--;
+        logger_info("Client id=%llx unsubscribed from %.*s", (unsigned long long)client->id, (int)length, topic);
+    }
+    acknowledge(worker, client, msg);
+}
+
+/**
+ * @brief Relay a client's publication to the subscribers of its topic
+ *
+ * This worker's subscribers get it right away, the other workers' through
+ * their inboxes.
+ */
+static void handle_publish(ServerWorker* worker, ClientConnection* client, Message* msg) {
+    if (!worker->server->options.publish_requests) {
+        send_error(worker, client, "publish requests are disabled");
+        return;
     }
+    const char* topic;
+    size_t topic_len;
+    const uint8_t* data;
+    size_t data_len;
+    if (message_parse_publish(msg, &topic, &topic_len, &data, &data_len) < 0) {
+        send_error(worker, client, "malformed publication");
+        return;
+    }
+    record_arrivals(worker, client, 1, msg->payload_size);
     
-    server->clients[server->client_count].fd = fd;
-    server->clients[server->client_count].ssl = ssl;
-    server->clients[server->client_count].is_ssl = (ssl != NULL);
-    server->client_count++;
-    server->total_clients++;
+    // The frame takes the payload over; the header stays for the ACK
+    SharedFrame* frame = shared_frame_create(msg);
+    if (!frame) {
+        logger_error("Failed to allocate publication from client (fd=%d)", client->fd);
+        send_error(worker, client, "publication failed");
+        return;
+    }
+    post_publication(worker->server, frame, worker);
+    deliver_publication(worker, frame);
+    shared_frame_release(frame);
+    acknowledge(worker, client, msg);
+}
+
+/**
+ * @brief Whether a frame joins the batch instead of being dispatched on its own
+ */
+static int batched(const Server* server, const Message* msg) {
+    if (!server->batch_handler || server->handler_pool || handled_by_server(msg->header.type)) {
+        return 0;
+    }
+    return msg->header.type != MSG_TYPE_CHUNK || !server->stream_handler;
 }
 
-static void remove_client(Server* server, size_t index) {
-    if (index >= server->client_count) {
+static void dispatch_message(ServerWorker* worker, ClientConnection* client, Message* msg) {
+    ServerMetrics* metrics = &worker->metrics;
+    Server* server = worker->server;
+    int batch = batched(server, msg);
+    TRACE_PROBE3(frame_received, client->id, msg->header.type, msg->payload_size);
+    
+    // Replies and unbatched frames must not overtake the ACKs of earlier frames
+    if (!batch) {
+        flush_batch(worker, client);
+    }
+    if (msg->header.type == MSG_TYPE_HELLO) {
+        handle_hello(worker, client, msg);
+        return;
+    }
+    if (msg->header.type == MSG_TYPE_STATS) {
+        handle_stats_request(worker, client);
+        return;
+    }
+    if (msg->header.type == MSG_TYPE_SUBSCRIBE || msg->header.type == MSG_TYPE_UNSUBSCRIBE) {
+        handle_subscription(worker, client, msg);
+        return;
+    }
+    if (msg->header.type == MSG_TYPE_PUBLISH) {
+        handle_publish(worker, client, msg);
         return;
     }
     
-    ClientConnection* client = &server->clients[index];
-    logger_info("Client disconnected (fd=%d)", client->fd);
+    // True latency: the client stamped the frame with the shared monotonic clock
+    uint64_t timestamp = (msg->header.flags & MSG_FLAGS_TIMESTAMPED) ? msg->timestamp_ns : 0;
+    if (timestamp != 0) {
+        uint64_t now_ns = batch_now(worker);
+        histogram_record(&metrics->latency, now_ns > timestamp ? now_ns - timestamp : 0);
+    }
     
-    if (client->is_ssl && client->ssl) {
-        close_tls_connection(client->ssl);
+    uint64_t stream_offset = client->stream_offset;
+    if (msg->header.type == MSG_TYPE_CHUNK) {
+        advance_stream(worker, client, msg);
     }
-    close(client->fd);
     
-    // Move remaining clients
-    for (size_t i = index; i < server->client_count - 1; i++) {
-        server->clients[i] = server->clients[i + 1];
+    if (batch) {
+        // The batch takes the message over; it is handled and freed in flush_batch
+        DispatchBatch* pending = &worker->batch;
+        pending->msgs[pending->count++] = *msg;
+        pending->bytes += msg->payload_size;
+        msg->payload = NULL;
+        msg->payload_size = 0;
+        if (pending->count == SERVER_BATCH_MAX) {
+            flush_batch(worker, client);
+        }
+        return;
+    }
+    
+    record_arrivals(worker, client, 1, msg->payload_size);
+    if (!server->handler_pool) {
+        run_handler(server, client->id, msg, stream_offset);
+        acknowledge(worker, client, msg);
+        return;
+    }
+    
+    // Handler threads: ACK now, or once the handler thread reports back
+    int ack_now = server->options.handler_ack == HANDLER_ACK_RECEIVE;
+    if (ack_now) {
+        acknowledge(worker, client, msg);
+    }
+    offload_message(worker, client, msg, stream_offset, !ack_now && message_needs_ack(&msg->header));
+}
+
+/**
+ * @brief Tell the client why its frame was refused; the caller closes the connection
+ *
+ * Closing rather than skipping the frame keeps a later cumulative ACK
+ * from covering its sequence number.
+ * @param failed INTEGRITY_* check the frame failed
+ */
+static void reject_corrupt_frame(ServerWorker* worker, ClientConnection* client, unsigned failed) {
+    static const char bad_checksum[] = "payload checksum mismatch";
+    static const char bad_text[] = "text payload is not valid UTF-8";
+    const char* reason = failed == INTEGRITY_CRC32C ? bad_checksum : bad_text;
+    size_t length = failed == INTEGRITY_CRC32C ? sizeof(bad_checksum) - 1 : sizeof(bad_text) - 1;
+    logger_error("Refusing frame from client (fd=%d): %s", client->fd, reason);
+    worker->metrics.frames_corrupt++;
+    Message error = message_create_error(reason, length);
+    send_to_client(worker, client, &error);
+}
+
+/**
+ * @brief Tell the client its frame is above max_frame_size; the caller closes the connection
+ * @param length Announced payload length, before or after decompression
+ */
+static void reject_oversized_frame(ServerWorker* worker, ClientConnection* client, uint64_t length) {
+    logger_error("Frame of %llu bytes from client (fd=%d) exceeds max_frame_size %llu",
+                 (unsigned long long)length, client->fd,
+                 (unsigned long long)worker->server->options.max_frame_size);
+    worker->metrics.frames_rejected++;
+    static const char too_large[] = "frame exceeds max_frame_size; stream large payloads as chunks";
+    Message error = message_create_error(too_large, sizeof(too_large) - 1);
+    send_to_client(worker, client, &error);
+}
+
+/**
+ * @brief Dispatch every complete frame in the client's read buffer
+ *
+ * Batched frames only borrow their payloads, which stay in place until
+ * the next read.
+ * @return 0 on success, -1 on protocol error
+ */
+static int dispatch_frames(ServerWorker* worker, ClientConnection* client) {
+    Server* server = worker->server;
+    int (*next)(FrameReader*, Message*) =
+        server->batch_handler && !server->handler_pool ? frame_reader_next_view : frame_reader_next;
+    Message msg;
+    int result = 0;
+    worker->batch.now_ns = 0;
+    // A paused client's frames stay buffered until its send queue drains
+    while (!client->closing && !client->read_paused && (result = next(&client->reader, &msg)) > 0) {
+        dispatch_message(worker, client, &msg);
+        message_free(&msg);
+    }
+    flush_batch(worker, client);
+    if (result < 0 && client->reader.oversized > 0) {
+        reject_oversized_frame(worker, client, client->reader.oversized);
+        return -1;
+    }
+    if (result < 0 && client->reader.rejected) {
+        reject_corrupt_frame(worker, client, client->reader.rejected);
+        return -1;
+    }
+    if (result < 0) {
+        logger_error("Protocol error from client (fd=%d)", client->fd);
+        return -1;
+    }
+    counter_set(&client->traffic.rx_queued, client->reader.end - client->reader.start);
+    return 0;
+}
+
+/**
+ * @brief Read available bytes and dispatch every complete frame
+ * @return 0 if the client is still connected, -1 if it was removed
+ */
+static int handle_client_readable(ServerWorker* worker, ClientConnection* client) {
+    int edge_triggered = event_loop_is_edge_triggered(worker->event_loop);
+    
+    for (;;) {
+        ssize_t received = frame_reader_read(&client->reader, client->fd, client->ssl, client->is_ssl);
+        if (received < 0) {
+            remove_client(worker, client);
+            return -1;
+        }
+        
+        if (dispatch_frames(worker, client) < 0) {
+            remove_client(worker, client);
+            return -1;
+        }
+        if (client->closing) {
+            return -1;
+        }
+        
+        // Level-triggered: the loop reports the socket again if more is pending.
+        // Edge-triggered: keep reading until the socket would block.
+        // Paused: the socket is read again once the send queue drains.
+        if (received == 0 || !edge_triggered || client->read_paused || !worker->server->running) {
+            flush_pending_ack(worker, client);
+            return 0;
+        }
+    }
+}
+
+/**
+ * @brief Register the events a connection currently waits for
+ */
+static int set_interest(ServerWorker* worker, ClientConnection* client, uint32_t interest) {
+    if (client->interest == interest) {
+        return 0;
+    }
+    if (event_loop_modify(worker->event_loop, client->fd, interest, client) < 0) {
+        logger_error("Failed to update events (fd=%d): %s", client->fd, get_error_string(errno));
+        return -1;
     }
-    server->client_count--;
+    client->interest = interest;
+    return 0;
 }
 
-static void accept_new_connection(Server* server) {
-    int client_fd = accept(server->server_fd, NULL, NULL);
-    if (client_fd < 0) {
-        if (errno != EAGAIN && errno != EWOULDBLOCK) {
-            logger_error("Accept error: %s", get_error_string(errno));
+/**
+ * @brief Drive the TLS handshake; promote the connection once it completes
+ * @return 0 if the client is still connected, -1 if it was removed
+ */
+static int advance_handshake(ServerWorker* worker, ClientConnection* client) {
+    int want_write = 0;
+    int result = continue_tls_handshake(client->ssl, &want_write);
+    if (result < 0) {
+        TRACE_PROBE2(handshake_done, client->id, 0);
+        remove_client(worker, client);
+        return -1;
+    }
+    
+    if (result == 0) {
+        uint32_t interest = EVENT_READ | (want_write ? EVENT_WRITE : 0);
+        if (set_interest(worker, client, interest) < 0) {
+            remove_client(worker, client);
+            return -1;
         }
+        return 0;
+    }
+    
+    client->state = CLIENT_STATE_ACTIVE;
+    worker->metrics.handshakes_in_progress--;
+    worker->metrics.handshakes_completed++;
+    int resumed = tls_session_reused(client->ssl);
+    if (resumed) {
+        worker->metrics.handshakes_resumed++;
+    }
+    int ktls_send = tls_ktls_send(client->ssl);
+    int ktls_recv = tls_ktls_recv(client->ssl);
+    worker->metrics.ktls_send += (size_t)ktls_send;
+    worker->metrics.ktls_recv += (size_t)ktls_recv;
+    logger_info("TLS handshake complete (fd=%d, %s, ktls tx=%s rx=%s)", client->fd,
+                resumed ? "resumed" : "full", ktls_send ? "on" : "off", ktls_recv ? "on" : "off");
+    TRACE_PROBE2(handshake_done, client->id, 1);
+    if (set_interest(worker, client, EVENT_READ) < 0) {
+        remove_client(worker, client);
+        return -1;
+    }
+    
+    // Records sent right behind the handshake may already sit in the SSL buffer
+    return handle_client_readable(worker, client);
+}
+
+/**
+ * @brief Drop connections whose TLS handshake ran past its deadline
+ */
+static void expire_handshakes(ServerWorker* worker) {
+    if (worker->metrics.handshakes_in_progress == 0) {
+        return;
+    }
+    uint64_t now = get_monotonic_ms();
+    if (now < worker->next_handshake_sweep_ms) {
         return;
     }
+    worker->next_handshake_sweep_ms = now + HANDSHAKE_SWEEP_INTERVAL_MS;
     
-    void* ssl = NULL;
-    if (server->enable_tls) {
-        ssl = accept_tls_connection(client_fd, server->ssl_ctx);
-        if (!ssl) {
-            close(client_fd);
+    // Removal only frees a slot, so the walk can continue past it
+    for (size_t i = 0; i < worker->slot_count; i++) {
+        ClientConnection* client = worker->slots[i].client;
+        if (client && client->state == CLIENT_STATE_HANDSHAKE && now >= client->handshake_deadline_ms) {
+            logger_warn("TLS handshake timed out (fd=%d)", client->fd);
+            worker->metrics.handshake_timeouts++;
+            remove_client(worker, client);
+        }
+    }
+}
+
+/**
+ * @brief Dispatch frames from a shared-memory channel until it runs dry
+ */
+static void handle_shm_doorbell(ServerWorker* worker, ClientConnection* client) {
+    ShmChannel* channel = client->shm;
+    shm_channel_begin_read(channel);
+    
+    // The doorbell also rings when the client released ring space for queued replies
+    if (client->send_queue) {
+        if (flush_send_queue(worker, client) < 0) {
+            fail_client(worker, client);
             return;
         }
+        maybe_resume_reading(worker, client);
     }
     
-    add_client(server, client_fd, ssl);
-    logger_info("New client connected (fd=%d)", client_fd);
+    size_t frames = 0;
+    do {
+        if (client->read_paused) {
+            // Leave the client's frames in the ring until it reads its replies
+            return;
+        }
+        Message msg;
+        int result = 0;
+        worker->batch.now_ns = 0;
+        while (!client->closing && !client->read_paused && (result = shm_channel_next(channel, &msg)) > 0) {
+            dispatch_message(worker, client, &msg);
+            message_free(&msg);
+            if (++frames >= SHM_MAX_FRAMES_PER_WAKE) {
+                break;
+            }
+        }
+        flush_batch(worker, client);
+        if (client->closing) {
+            return;
+        }
+        if (result < 0 && shm_channel_oversized(channel) > 0) {
+            reject_oversized_frame(worker, client, shm_channel_oversized(channel));
+            remove_client(worker, client);
+            return;
+        }
+        if (result < 0 && shm_channel_rejected(channel)) {
+            reject_corrupt_frame(worker, client, shm_channel_rejected(channel));
+            remove_client(worker, client);
+            return;
+        }
+        if (result < 0) {
+            logger_error("Protocol error from client (fd=%d)", client->fd);
+            remove_client(worker, client);
+            return;
+        }
+        counter_set(&client->traffic.rx_queued, shm_channel_backlog(channel));
+        flush_pending_ack(worker, client);
+        
+        if (frames >= SHM_MAX_FRAMES_PER_WAKE) {
+            // Busy producer: come back after the other ready connections
+            shm_channel_wake(channel);
+            return;
+        }
+    } while (worker->server->running && shm_channel_end_read(channel));
+}
+
+/**
+ * @brief The socket of a shared-memory client only becomes readable on hang-up
+ */
+static void handle_shm_socket(ServerWorker* worker, ClientConnection* client) {
+    char byte;
+    ssize_t received = recv(client->fd, &byte, sizeof(byte), MSG_DONTWAIT);
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return;
+    }
+    if (received > 0) {
+        logger_error("Unexpected socket data from shared-memory client (fd=%d)", client->fd);
+    }
+    remove_client(worker, client);
 }
 
-static void handle_client_message(Server* server, size_t client_index, MessageHandler handler) {
-    ClientConnection* client = &server->clients[client_index];
+static void handle_client_event(ServerWorker* worker, ClientConnection* client, uint32_t events) {
+    if (client->closing) {
+        return;
+    }
+    if (client->shm) {
+        handle_shm_socket(worker, client);
+        return;
+    }
     
-    Message msg;
-    if (receive_message(client->fd, client->ssl, client->is_ssl, &msg) < 0) {
-        remove_client(server, client_index);
+    if (client->state == CLIENT_STATE_HANDSHAKE) {
+        if (events & (EVENT_READ | EVENT_WRITE | EVENT_ERROR)) {
+            // Errors surface from the handshake itself
+            advance_handshake(worker, client);
+        }
         return;
     }
     
-    // Record metrics
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    double now = tv.tv_sec + tv.tv_usec / 1000000.0;
-    if (server->last_message_time > 0.0) {
-        double interval_ms = (now - server->last_message_time) * 1000.0;
-        server->total_interval_ms += interval_ms;
-        if (server->interval_count == 0 || interval_ms < server->min_interval_ms) {
-            server->min_interval_ms = interval_ms;
+    if ((events & EVENT_WRITE) && client->send_queue) {
+        if (flush_send_queue(worker, client) < 0) {
+            remove_client(worker, client);
+            return;
+        }
+        maybe_resume_reading(worker, client);
+        if (client->closing) {
+            return;
+        }
+    }
+    
+    if ((events & EVENT_READ) && !client->read_paused) {
+        handle_client_readable(worker, client);
+    } else if (events & EVENT_ERROR) {
+        remove_client(worker, client);
+    }
+}
+
+/**
+ * @brief Reset the broadcast eventfd and deliver the queued publications (readiness backends)
+ */
+static void handle_broadcast_wake(ServerWorker* worker) {
+    uint64_t value;
+    if (read(worker->broadcast_fd, &value, sizeof(value)) < 0 && errno != EAGAIN && errno != EINTR) {
+        logger_error("Broadcast wake-up read failed: %s", get_error_string(errno));
+    }
+    drain_inbox(worker);
+}
+
+/**
+ * @brief Reset the handler pool eventfd and collect its completions (readiness backends)
+ */
+static void handle_handler_wake(ServerWorker* worker) {
+    uint64_t value;
+    if (read(handler_pool_wake_fd(worker->server->handler_pool, worker->id), &value, sizeof(value)) < 0 &&
+        errno != EINTR) {
+        logger_error("Handler wake-up read failed: %s", get_error_string(errno));
+    }
+    handle_handler_completions(worker);
+}
+
+/**
+ * @brief Stop taking connections from the listener (the successor accepts them now)
+ */
+static void stop_accepting(ServerWorker* worker) {
+    worker->accepting = 0;
+    if (worker->uring) {
+        // The accept ends with -ECANCELED and is not armed again
+        if (uring_cancel(worker->uring, URING_OP_ACCEPT, URING_OP_CANCEL) < 0) {
+            logger_error("Failed to cancel accept on worker %zu", worker->id);
+        }
+    } else if (event_loop_remove(worker->event_loop, worker->listen_fd) < 0) {
+        logger_error("Failed to stop accepting on worker %zu: %s", worker->id, get_error_string(errno));
+    }
+}
+
+/**
+ * @brief After a handoff: whether the worker still has connections to finish
+ */
+static int keep_draining(ServerWorker* worker) {
+    if (worker->accepting) {
+        stop_accepting(worker);
+    }
+    if (worker->accept_armed) {
+        // Connections the kernel accepted for us are still in the completion queue
+        return 1;
+    }
+    if (worker->client_count == 0) {
+        logger_info("Worker %zu drained", worker->id);
+        TRACE_PROBE2(drain_done, worker->id, 0);
+        return 0;
+    }
+    if (get_monotonic_ms() >= worker->server->drain_deadline_ms) {
+        logger_warn("Worker %zu: drain deadline passed, closing %zu connections", worker->id, worker->client_count);
+        TRACE_PROBE2(drain_done, worker->id, worker->client_count);
+        return 0;
+    }
+    return 1;
+}
+
+static void run_event_loop(ServerWorker* worker) {
+    LoopEvent events[MAX_EVENTS];
+    
+    while (worker->server->running) {
+        // Wake up often enough to enforce handshake deadlines
+        int timeout_ms = worker->metrics.handshakes_in_progress > 0 ? HANDSHAKE_SWEEP_INTERVAL_MS : 1000;
+        int ready = event_loop_wait(worker->event_loop, events, MAX_EVENTS, timeout_ms);
+        
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            logger_error("Poll error: %s", get_error_string(errno));
+            break;
+        }
+        
+        for (int i = 0; i < ready; i++) {
+            uintptr_t data = (uintptr_t)events[i].data;
+            if (data == 0) {
+                // Server socket: new connections
+                accept_new_connection(worker);
+            } else if (data == (uintptr_t)HANDLER_WAKE_DATA) {
+                handle_handler_wake(worker);
+            } else if (data == (uintptr_t)BROADCAST_WAKE_DATA) {
+                handle_broadcast_wake(worker);
+            } else if (data & SHM_DOORBELL_TAG) {
+                ClientConnection* client = (ClientConnection*)(data & ~(uintptr_t)SHM_DOORBELL_TAG);
+                if (!client->closing) {
+                    handle_shm_doorbell(worker, client);
+                }
+            } else {
+                handle_client_event(worker, (ClientConnection*)events[i].data, events[i].events);
+            }
+        }
+        
+        release_closed_clients(worker);
+        expire_handshakes(worker);
+        if (atomic_load(&worker->server->draining) && !keep_draining(worker)) {
+            break;
+        }
+    }
+}
+
+static void handle_accept_completion(ServerWorker* worker, const UringCompletion* cqe) {
+    if (cqe->res >= 0) {
+        int client_fd = cqe->res;
+        if (worker->server->mode == SOCKET_MODE_INET) {
+            tuning_apply_connected(client_fd, &worker->server->options.tuning);
+        }
+        ClientConnection* client = add_client(worker, client_fd, NULL);
+        if (!client) {
+            close(client_fd);
+        } else if (uring_arm_recv(worker, client) < 0) {
+            remove_client(worker, client);
+        } else {
+            logger_info("New client connected (fd=%d, worker=%zu, id=%llx)", client_fd, worker->id,
+                    (unsigned long long)client->id);
+            TRACE_PROBE3(accept, worker->id, client_fd, client->id);
+        }
+    } else if (cqe->res != -EAGAIN && cqe->res != -EINTR && cqe->res != -ECANCELED) {
+        logger_error("Accept error: %s", get_error_string(-cqe->res));
+    }
+    
+    // The kernel ends a multishot accept on errors; arm a new one
+    if (!uring_completion_more(cqe)) {
+        worker->accept_armed = 0;
+        if (worker->server->running && worker->accepting) {
+            if (uring_accept_multishot(worker->uring, worker->listen_fd, URING_OP_ACCEPT) < 0) {
+                logger_error("Failed to re-arm accept on worker %zu", worker->id);
+            } else {
+                worker->accept_armed = 1;
+            }
+        }
+    }
+}
+
+static void handle_recv_completion(ServerWorker* worker, ClientConnection* client, const UringCompletion* cqe) {
+    int more = uring_completion_more(cqe);
+    if (!more) {
+        client->uring_ops--;
+        client->recv_armed = 0;
+    }
+    
+    uint16_t bid;
+    const uint8_t* data = uring_completion_buffer(worker->uring, cqe, &bid);
+    if (data && cqe->res > 0 && !client->closing) {
+        int fed = frame_reader_feed(&client->reader, data, (size_t)cqe->res);
+        // Frames are cut out of the reader's buffer, so the kernel buffer can go back at once
+        uring_recycle_buffer(worker->uring, bid);
+        if (fed < 0 || dispatch_frames(worker, client) < 0) {
+            uring_close_client(worker, client);
+        } else {
+            flush_pending_ack(worker, client);
         }
-        if (server->interval_count == 0 || interval_ms > server->max_interval_ms) {
-            server->max_interval_ms = interval_ms;
+    } else if (data) {
+        uring_recycle_buffer(worker->uring, bid);
+    }
+    
+    if (!client->closing) {
+        // 0 is an orderly close; ENOBUFS only means every buffer was in use,
+        // ECANCELED that reading was paused
+        if (cqe->res == 0 || (cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -ECANCELED)) {
+            uring_close_client(worker, client);
+        } else if (!more && !client->read_paused && uring_arm_recv(worker, client) < 0) {
+            uring_close_client(worker, client);
         }
-        server->interval_count++;
     }
-    server->last_message_time = now;
-    server->total_messages++;
-    server->total_bytes += msg.payload_size;
+    uring_release_client(worker, client);
+}
+
+static void handle_send_completion(ServerWorker* worker, OutboundFrame* send, const UringCompletion* cqe) {
+    ClientConnection* client = send->client;
+    client->uring_ops--;
+    send->pending--;
+    if (cqe->res > 0) {
+        send->sent += (size_t)cqe->res;
+        send_queue_advance(client, (size_t)cqe->res);
+    } else if (cqe->res != -ECANCELED) {
+        // ECANCELED: the payload was linked to a header send that failed
+        send->failed = 1;
+    }
     
-    // Calculate latency if we have timing info (simplified - would need to track send time)
-    // For now, we'll use a simple approximation
+    if (send->pending > 0) {
+        return;
+    }
     
-    if (handler) {
-        handler(client->fd, &msg);
+    if (!client->closing) {
+        if (send->failed) {
+            if (cqe->res < 0) {
+                logger_error("Send to client (fd=%d) failed: %s", client->fd, get_error_string(-cqe->res));
+            }
+            uring_close_client(worker, client);
+        } else if (send->sent < send->head_size + send->payload_size) {
+            // Interrupted part way: send the rest
+            uring_submit_send(worker, send);
+        } else {
+            send_queue_pop(client);
+            if (client->send_queue) {
+                uring_submit_send(worker, client->send_queue);
+            }
+            maybe_resume_reading(worker, client);
+        }
+    }
+    // Closing: queued sends are released with the connection
+    uring_release_client(worker, client);
+}
+
+/**
+ * @brief Get woken when handler threads finish messages of this worker
+ */
+static int watch_handler_completions(ServerWorker* worker) {
+    int fd = handler_pool_wake_fd(worker->server->handler_pool, worker->id);
+    int result;
+    if (worker->uring) {
+        // The read completes, and is submitted again, once per wake-up
+        result = uring_read(worker->uring, fd, &worker->handler_wake_value, sizeof(worker->handler_wake_value),
+                            URING_OP_WAKE);
+    } else {
+        result = event_loop_add(worker->event_loop, fd, EVENT_READ, HANDLER_WAKE_DATA);
+    }
+    if (result < 0) {
+        logger_error("Failed to watch handler completions on worker %zu", worker->id);
+    }
+    return result;
+}
+
+/**
+ * @brief Get woken when another thread queues publications for this worker
+ */
+static int watch_broadcasts(ServerWorker* worker) {
+    int result;
+    if (worker->uring) {
+        result = uring_read(worker->uring, worker->broadcast_fd, &worker->broadcast_wake_value,
+                            sizeof(worker->broadcast_wake_value), URING_OP_BROADCAST);
+    } else {
+        result = event_loop_add(worker->event_loop, worker->broadcast_fd, EVENT_READ, BROADCAST_WAKE_DATA);
     }
-    
-    // Echo ACK for non-ACK messages
-    if (msg.header.type != MSG_TYPE_ACK) {
-        Message ack = message_create_ack();
-        send_message(client->fd, client->ssl, client->is_ssl, &ack);
-        message_free(&ack);
+    if (result < 0) {
+        logger_error("Failed to watch broadcasts on worker %zu", worker->id);
     }
-    
-    message_free(&msg);
+    return result;
 }
 
-static void run_event_loop(Server* server, MessageHandler handler) {
-    struct pollfd* pollfds = NULL;
-    size_t pollfd_count = 0;
-    size_t pollfd_capacity = 0;
+static void run_uring_loop(ServerWorker* worker) {
+    UringCompletion completions[MAX_EVENTS];
     
-    while (server->running) {
-        // Reallocate pollfds if needed
-        size_t needed = 1 + server->client_count; // server + clients
-        if (needed > pollfd_capacity) {
-            size_t new_capacity = needed + 8;
-            struct pollfd* new_pollfds = realloc(pollfds, new_capacity * sizeof(struct pollfd));
-            if (!new_pollfds) {
-                logger_error("Failed to allocate memory for pollfds");
-                break;
-            }
-            pollfds = new_pollfds;
-            pollfd_capacity = new_capacity;
-        }
-        
-        pollfd_count = 0;
-        
-        // Add server socket
-        pollfds[pollfd_count].fd = server->server_fd;
-        pollfds[pollfd_count].events = POLLIN;
-        pollfd_count++;
-        
-        // Add client sockets
-        for (size_t i = 0; i < server->client_count; i++) {
-            pollfds[pollfd_count].fd = server->clients[i].fd;
-            pollfds[pollfd_count].events = POLLIN;
-            pollfd_count++;
-        }
-        
-        int poll_result = poll(pollfds, pollfd_count, 1000);
-        
-        if (poll_result < 0) {
-            if (errno == EINTR) continue;
-            logger_error("Poll error: %s", get_error_string(errno));
+    while (worker->server->running) {
+        // Submits everything queued while handling the previous batch
+        if (uring_wait(worker->uring, 1000) < 0) {
+            logger_error("io_uring wait error: %s", get_error_string(errno));
             break;
         }
         
-        if (poll_result == 0) continue;  // Timeout
-        
-        // Check server socket for new connections
-        if (pollfds[0].revents & POLLIN) {
-            accept_new_connection(server);
-        }
-        
-        // Check client sockets
-        for (size_t i = 1; i < pollfd_count; i++) {
-            size_t client_index = i - 1;
-            if (client_index >= server->client_count) continue;
-            
-            if (pollfds[i].revents & POLLIN) {
-                handle_client_message(server, client_index, handler);
-            }
-            if (pollfds[i].revents & (POLLHUP | POLLERR)) {
-                remove_client(server, client_index);
-                // Adjust indices after removal
-                i--;
-                pollfd_count--;
+        int count = uring_reap(worker->uring, completions, MAX_EVENTS);
+        for (int i = 0; i < count; i++) {
+            const UringCompletion* cqe = &completions[i];
+            void* target = uring_untag(cqe->user_data);
+            switch (cqe->user_data & URING_OP_MASK) {
+                case URING_OP_ACCEPT:
+                    handle_accept_completion(worker, cqe);
+                    break;
+                case URING_OP_RECV:
+                    handle_recv_completion(worker, (ClientConnection*)target, cqe);
+                    break;
+                case URING_OP_SEND:
+                    handle_send_completion(worker, (OutboundFrame*)target, cqe);
+                    break;
+                case URING_OP_CANCEL:
+                    // Cancelling the accept leaves no connection behind
+                    if (target) {
+                        ((ClientConnection*)target)->uring_ops--;
+                        uring_release_client(worker, (ClientConnection*)target);
+                    }
+                    break;
+                case URING_OP_WAKE:
+                    handle_handler_completions(worker);
+                    if (worker->server->running && watch_handler_completions(worker) < 0) {
+                        return;
+                    }
+                    break;
+                case URING_OP_BROADCAST:
+                    drain_inbox(worker);
+                    if (worker->server->running && watch_broadcasts(worker) < 0) {
+                        return;
+                    }
+                    break;
             }
         }
+        if (atomic_load(&worker->server->draining) && !keep_draining(worker)) {
+            break;
+        }
+    }
+}
+
+static void run_worker(ServerWorker* worker) {
+    int cpu = tuning_pin_thread(&worker->server->options.tuning, worker->id);
+    if (cpu >= 0) {
+        logger_info("Worker %zu pinned to CPU %d", worker->id, cpu);
+    }
+    
+    if (worker->uring) {
+        run_uring_loop(worker);
+    } else {
+        run_event_loop(worker);
     }
+}
+
+static void* worker_thread_main(void* arg) {
+    ServerWorker* worker = (ServerWorker*)arg;
     
-    free(pollfds);
+    // Signals are handled by the main thread
+    sigset_t set;
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+    
+    run_worker(worker);
+    return NULL;
+}
+
+void server_options_init(ServerOptions* options) {
+    memset(options, 0, sizeof(ServerOptions));
+    options->io_backend = IO_BACKEND_EPOLL;
+    options->edge_triggered = 0;
+    options->workers = 1;
+    options->ack_batch = 1;
+    options->ack_batch_max = 64;
+    options->handshake_timeout_ms = 10000;
+    options->compression = 1;
+    options->checksums = 1;
+    options->validate_utf8 = 0;
+    options->shm_ring_size = SHM_RING_DEFAULT_SIZE;
+    options->stats_requests = 1;
+    options->max_frame_size = MSG_DEFAULT_MAX_FRAME_SIZE;
+    options->send_queue_high = 1024 * 1024;
+    options->send_queue_low = 256 * 1024;
+    options->handler_threads = 0;
+    options->handler_ack = HANDLER_ACK_COMPLETE;
+    tuning_init(&options->tuning);
+    options->publish_requests = 1;
+    options->subscriber_queue_max = 0;
+    options->subscriber_drop = SUBSCRIBER_DROP_FRAMES;
+    options->handoff_path[0] = '\0';
+    options->handoff_drain_ms = 30000;
+}
+
+void server_set_options(Server* server, const ServerOptions* options) {
+    if (server && options) {
+        server->options = *options;
+    }
+}
+
+void server_set_stream_handler(Server* server, StreamHandler handler) {
+    if (server) {
+        server->stream_handler = handler;
+    }
+}
+
+void server_set_batch_handler(Server* server, MessageBatchHandler handler) {
+    if (server) {
+        server->batch_handler = handler;
+    }
 }
 
 int server_init(Server* server, SocketMode mode, const char* address, int enable_tls) {
@@ -204,33 +2018,19 @@ int server_init(Server* server, SocketMode mode, const char* address, int enable
     }
     server->enable_tls = enable_tls;
     server->server_fd = -1;
+    server->handoff_fd = -1;
+    server->predecessor_fd = -1;
     server->running = 0;
-    server->clients = NULL;
-    server->client_count = 0;
-    server->client_capacity = 0;
-    server->total_clients = 0;
-    server->total_messages = 0;
-    server->total_bytes = 0;
-    server->last_message_time = 0.0;
-    server->total_interval_ms = 0.0;
-    server->min_interval_ms = 0.0;
-    server->max_interval_ms = 0.0;
-    server->interval_count = 0;
+    server->workers = NULL;
+    server->worker_count = 0;
+    server_options_init(&server->options);
     
     struct timeval tv;
     gettimeofday(&tv, NULL);
     server->start_time = tv.tv_sec + tv.tv_usec / 1000000.0;
     
-    // Initialize TLS if enabled
-    if (enable_tls) {
-        server->ssl_ctx = init_tls_server();
-        if (!server->ssl_ctx) {
-            free(server->address);
-            return -1;
-        }
-    } else {
-        server->ssl_ctx = NULL;
-    }
+    // The TLS context is created by server_start, once the certificate options are known
+    server->ssl_ctx = NULL;
     
     return 0;
 }
@@ -239,21 +2039,76 @@ void server_cleanup(Server* server) {
     if (!server) return;
     
     server->running = 0;
+    if (server->handoff_thread_started) {
+        pthread_join(server->handoff_thread, NULL);
+        server->handoff_thread_started = 0;
+    }
+    if (server->handoff_fd >= 0) {
+        close(server->handoff_fd);
+        unlink(server->options.handoff_path);
+    }
+    handoff_state_free(&server->inherited);
+    if (server->predecessor_fd >= 0) {
+        close(server->predecessor_fd);
+    }
+    
+    // Workers first: they queue messages for the handler threads, which
+    // then finish what is queued
+    for (size_t w = 0; w < server->worker_count; w++) {
+        ServerWorker* worker = &server->workers[w];
+        if (worker->thread_started) {
+            pthread_join(worker->thread, NULL);
+            worker->thread_started = 0;
+        }
+    }
+    handler_pool_destroy(server->handler_pool);
     
-    // Close all client connections
-    for (size_t i = 0; i < server->client_count; i++) {
-        ClientConnection* client = &server->clients[i];
-        if (client->is_ssl && client->ssl) {
-            close_tls_connection(client->ssl);
+    for (size_t w = 0; w < server->worker_count; w++) {
+        ServerWorker* worker = &server->workers[w];
+        
+        // The ring goes first: nothing may complete into freed connections
+        if (worker->uring) {
+            uring_destroy(worker->uring);
+        }
+        
+        // Close all client connections
+        for (size_t i = 0; i < worker->slot_count; i++) {
+            if (worker->slots[i].client) {
+                close_client(worker->slots[i].client);
+            }
+        }
+        free(worker->slots);
+        while (worker->closing_clients) {
+            ClientConnection* client = worker->closing_clients;
+            worker->closing_clients = client->next_closing;
+            close_client(client);
+        }
+        
+        if (worker->event_loop) {
+            event_loop_destroy(worker->event_loop);
+        }
+        if (worker->owns_listen_fd && worker->listen_fd >= 0 && worker->listen_fd != server->server_fd) {
+            close(worker->listen_fd);
+        }
+        if (worker->server) {
+            pthread_mutex_destroy(&worker->table_lock);
+            for (size_t i = 0; i < worker->inbox_count; i++) {
+                shared_frame_release(worker->inbox[i]);
+            }
+            free(worker->inbox);
+            pthread_mutex_destroy(&worker->inbox_lock);
+            topic_table_free(&worker->topics);
+            if (worker->broadcast_fd >= 0) {
+                close(worker->broadcast_fd);
+            }
         }
-        close(client->fd);
     }
-    free(server->clients);
+    free(server->workers);
     
-    // Close server socket
+    // Close server socket; after a handoff the path belongs to the successor
     if (server->server_fd >= 0) {
         close(server->server_fd);
-        if (server->mode == SOCKET_MODE_UNIX) {
+        if (server->mode != SOCKET_MODE_INET && !server->handed_off) {
             unlink(server->address);
         }
     }
@@ -267,49 +2122,395 @@ void server_cleanup(Server* server) {
     memset(server, 0, sizeof(Server));
 }
 
-static void setup_socket(Server* server) {
-    if (server->mode == SOCKET_MODE_UNIX) {
+/**
+ * @brief Create a listening socket
+ * @param reuse_port Bind with SO_REUSEPORT so every worker gets its own queue
+ */
+static int setup_socket(Server* server, int reuse_port) {
+    int fd;
+    if (server->mode != SOCKET_MODE_INET) {
         logger_info("Initializing UNIX socket at %s", server->address);
-        server->server_fd = setup_unix_socket(server->address);
+        fd = setup_unix_socket(server->address);
     } else {
         uint16_t port = 8080;
         char* host = parse_address(server->address, &port);
         if (!host) {
             logger_error("Failed to parse address");
-            return;
+            return -1;
         }
-        logger_info("Initializing INET socket host=%s port=%u", host, port);
-        server->server_fd = setup_inet_socket(host, port);
+        logger_info("Initializing INET socket host=%s port=%u%s", host, port,
+                    reuse_port ? " (SO_REUSEPORT)" : "");
+        fd = setup_inet_socket(host, port, reuse_port);
         free(host);
+        if (fd >= 0) {
+            // Accepted sockets inherit the listener's options
+            tuning_apply_listener(fd, &server->options.tuning);
+        }
     }
     
-    if (server->server_fd < 0) {
-        return;
+    if (fd < 0) {
+        return -1;
+    }
+    
+    if (listen(fd, SOMAXCONN) < 0) {
+        logger_error("Failed to listen: %s", get_error_string(errno));
+        close(fd);
+        return -1;
     }
     
     // Set non-blocking
-    int flags = fcntl(server->server_fd, F_GETFL, 0);
-    fcntl(server->server_fd, F_SETFL, flags | O_NONBLOCK);
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    return fd;
+}
+
+/**
+ * @brief Watch the eventfds other threads use to hand the worker work
+ */
+static int watch_wakeups(ServerWorker* worker) {
+    if (worker->server->handler_pool && watch_handler_completions(worker) < 0) {
+        return -1;
+    }
+    return watch_broadcasts(worker);
+}
+
+static int init_worker(Server* server, ServerWorker* worker, size_t id) {
+    memset(worker, 0, sizeof(ServerWorker));
+    pthread_mutex_init(&worker->table_lock, NULL);
+    traffic_init(&worker->closed_traffic);
+    worker->free_slot = CLIENT_SLOT_NONE;
+    worker->server = server;
+    worker->id = id;
+    worker->listen_fd = -1;
+    pthread_mutex_init(&worker->inbox_lock, NULL);
+    topic_table_init(&worker->topics);
+    worker->broadcast_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (worker->broadcast_fd < 0) {
+        logger_error("Failed to create broadcast eventfd: %s", get_error_string(errno));
+        return -1;
+    }
+    
+    int reuse_port = server->worker_count > 1;
+    if (id < server->inherited.count) {
+        // Hot restart: the previous server's socket, with the connections queued on it
+        worker->listen_fd = server->inherited.fds[id];
+        server->inherited.fds[id] = -1;
+        worker->owns_listen_fd = 1;
+        if (id == 0) {
+            server->server_fd = worker->listen_fd;
+        }
+    } else if (server->inherited.count > 0 && !server->inherited_reuse_port) {
+        // Without SO_REUSEPORT on the inherited sockets no new one can join them
+        worker->listen_fd = server->workers[id % server->inherited.count].listen_fd;
+    } else if (id == 0 || server->mode == SOCKET_MODE_INET) {
+        worker->listen_fd = setup_socket(server, reuse_port);
+        if (worker->listen_fd < 0) {
+            return -1;
+        }
+        worker->owns_listen_fd = 1;
+        if (id == 0) {
+            server->server_fd = worker->listen_fd;
+            if (server->mode == SOCKET_MODE_INET) {
+                char tuning[256];
+                tuning_describe(worker->listen_fd, &server->options.tuning, tuning, sizeof(tuning));
+                logger_info("Socket tuning: %s", tuning);
+            }
+        }
+    } else {
+        // UNIX sockets have no SO_REUSEPORT balancing: share one accept queue
+        worker->listen_fd = server->server_fd;
+    }
+    
+    if (server->options.io_backend == IO_BACKEND_URING) {
+        worker->uring = uring_create(URING_ENTRIES, URING_BUFFER_COUNT, URING_BUFFER_SIZE);
+        if (worker->uring) {
+            if (uring_accept_multishot(worker->uring, worker->listen_fd, URING_OP_ACCEPT) < 0) {
+                logger_error("Failed to arm accept on worker %zu", id);
+                return -1;
+            }
+            worker->accepting = 1;
+            worker->accept_armed = 1;
+            return watch_wakeups(worker);
+        }
+        if (id > 0) {
+            logger_error("Failed to create io_uring: %s", get_error_string(errno));
+            return -1;
+        }
+        logger_warn("io_uring unavailable (%s); using epoll", get_error_string(errno));
+        server->options.io_backend = IO_BACKEND_EPOLL;
+    }
+    
+    worker->event_loop = event_loop_create(server->options.io_backend, server->options.edge_triggered);
+    if (!worker->event_loop) {
+        logger_error("Failed to create %s event loop: %s",
+                     io_backend_name(server->options.io_backend), get_error_string(errno));
+        return -1;
+    }
+    
+    // A shared queue wakes only one worker per connection
+    uint32_t listen_events = EVENT_READ;
+    if (server->listeners_shared) {
+        listen_events |= EVENT_EXCLUSIVE;
+    }
+    if (event_loop_add(worker->event_loop, worker->listen_fd, listen_events, NULL) < 0) {
+        logger_error("Failed to register server socket: %s", get_error_string(errno));
+        return -1;
+    }
+    worker->accepting = 1;
+    return watch_wakeups(worker);
+}
+
+/**
+ * @brief Take over the listeners of the server waiting at the handoff path, if one does
+ * @return 0 on success or if none waits, -1 on error
+ */
+static int take_over_listeners(Server* server) {
+    const char* path = server->options.handoff_path;
+    pid_t pid = 0;
+    int result = handoff_receive(path, &server->inherited, &server->predecessor_fd, &pid);
+    if (result <= 0) {
+        return result;
+    }
+    if (server->inherited.mode != (uint32_t)server->mode ||
+        (server->mode != SOCKET_MODE_INET && server->inherited.count != 1)) {
+        logger_error("Server at %s (pid %d) serves %s sockets, not %s", path, (int)pid,
+                     socket_mode_name((SocketMode)server->inherited.mode), socket_mode_name(server->mode));
+        handoff_state_free(&server->inherited);
+        close(server->predecessor_fd);
+        server->predecessor_fd = -1;
+        return -1;
+    }
+    
+    int reuse_port = 0;
+    socklen_t len = sizeof(reuse_port);
+    if (getsockopt(server->inherited.fds[0], SOL_SOCKET, SO_REUSEPORT, &reuse_port, &len) == 0) {
+        server->inherited_reuse_port = reuse_port;
+    }
+    logger_info("Taking over %zu listeners from pid %d at %s", server->inherited.count, (int)pid, path);
+    TRACE_PROBE2(handoff_received, pid, server->inherited.count);
+    return 0;
+}
+
+/**
+ * @brief Everything is watched: let the previous server stop accepting
+ */
+static void confirm_takeover(Server* server) {
+    handoff_state_free(&server->inherited);
+    if (handoff_confirm(server->predecessor_fd) < 0) {
+        logger_warn("Previous server went away before the takeover was confirmed");
+    }
+    server->predecessor_fd = -1;
+}
+
+/**
+ * @brief Pass the listeners to a connected successor
+ * @return 0 once it took over, -1 if it failed (this server keeps accepting)
+ */
+static int hand_off(Server* server, int fd, pid_t pid) {
+    const char* path = server->options.handoff_path;
+    
+    // The successor waits at the path for its own successor once it has the sockets
+    close(server->handoff_fd);
+    server->handoff_fd = -1;
+    unlink(path);
+    
+    HandoffState state;
+    memset(&state, 0, sizeof(state));
+    state.mode = (uint32_t)server->mode;
+    for (size_t w = 0; w < server->worker_count; w++) {
+        if (server->workers[w].owns_listen_fd) {
+            state.fds[state.count++] = server->workers[w].listen_fd;
+        }
+    }
+    if (server->ssl_ctx) {
+        state.identity = tls_export_identity(server->ssl_ctx, &state.identity_len);
+    }
+    TRACE_PROBE2(handoff_send, pid, state.count);
+    int result = handoff_send(fd, &state);
+    tls_identity_free(state.identity, state.identity_len);
+    if (result == 0) {
+        result = handoff_wait_confirm(fd);
+    }
+    close(fd);
+    if (result < 0) {
+        logger_warn("Handoff to pid %d failed; still accepting", (int)pid);
+        server->handoff_fd = handoff_listen(path);
+        return -1;
+    }
+    
+    size_t open = server_get_client_count(server);
+    server->handed_off = 1;
+    server->drain_deadline_ms = get_monotonic_ms() + (uint64_t)server->options.handoff_drain_ms;
+    atomic_store(&server->draining, 1);
+    logger_info("Pid %d took over %zu listeners; draining %zu connections (up to %d ms)", (int)pid,
+                state.count, open, server->options.handoff_drain_ms);
+    TRACE_PROBE1(drain_start, open);
+    
+    // Wake every worker so it stops accepting now, not at its next timeout
+    for (size_t w = 0; w < server->worker_count; w++) {
+        uint64_t one = 1;
+        if (write(server->workers[w].broadcast_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            logger_error("Failed to wake worker %zu: %s", w, get_error_string(errno));
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Wait for successors on the handoff socket until one takes over
+ */
+static void* handoff_thread_main(void* arg) {
+    Server* server = (Server*)arg;
+    
+    // Signals are handled by the main thread
+    sigset_t set;
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+    
+    while (server->running && server->handoff_fd >= 0) {
+        pid_t pid = 0;
+        int fd = handoff_accept(server->handoff_fd, 1000, &pid);
+        if (fd < 0) {
+            logger_error("Handoff socket failed: %s", get_error_string(errno));
+            break;
+        }
+        if (fd > 0 && hand_off(server, fd, pid) == 0) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+static int start_handoff_listener(Server* server) {
+    server->handoff_fd = handoff_listen(server->options.handoff_path);
+    if (server->handoff_fd < 0) {
+        return -1;
+    }
+    if (pthread_create(&server->handoff_thread, NULL, handoff_thread_main, server) != 0) {
+        logger_error("Failed to start the handoff thread");
+        return -1;
+    }
+    server->handoff_thread_started = 1;
+    logger_info("Hot restart: a server started with handoff_path=%s takes over", server->options.handoff_path);
+    return 0;
 }
 
 int server_start(Server* server, MessageHandler handler) {
-    setup_socket(server);
-    if (server->server_fd < 0) {
+    size_t worker_count = server->options.workers;
+    if (worker_count == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        worker_count = cpus > 0 ? (size_t)cpus : 1;
+    }
+    if (worker_count > MAX_WORKERS) {
+        worker_count = MAX_WORKERS;
+    }
+    
+    if (server->options.handoff_path[0] && take_over_listeners(server) < 0) {
         return -1;
     }
+    if (server->inherited.count > worker_count) {
+        // A listener nobody accepts from would strand the connections queued on it
+        logger_info("Running %zu workers, one per inherited listener", server->inherited.count);
+        worker_count = server->inherited.count;
+    }
     
-    if (listen(server->server_fd, SOMAXCONN) < 0) {
-        logger_error("Failed to listen: %s", get_error_string(errno));
+    if (server->enable_tls && !server->ssl_ctx) {
+        server->ssl_ctx = init_tls_server(server->options.tls_cert_file, server->options.tls_key_file,
+                                          server->options.tls_ticket_key_file, server->inherited.identity,
+                                          server->inherited.identity_len);
+        if (!server->ssl_ctx) {
+            return -1;
+        }
+        if (server->options.ktls) {
+            tls_enable_ktls(server->ssl_ctx);
+        }
+    }
+    
+    if (server->options.io_backend == IO_BACKEND_URING && server->enable_tls) {
+        logger_warn("io_uring backend serves plaintext sockets only; using epoll for TLS");
+        server->options.io_backend = IO_BACKEND_EPOLL;
+    }
+    if (server->options.io_backend == IO_BACKEND_URING && server->mode == SOCKET_MODE_SHM) {
+        logger_warn("io_uring backend does not watch shared-memory doorbells; using epoll");
+        server->options.io_backend = IO_BACKEND_EPOLL;
+    }
+    
+    server->workers = calloc(worker_count, sizeof(ServerWorker));
+    if (!server->workers) {
+        logger_error("Failed to allocate memory for workers");
         return -1;
     }
+    server->worker_count = worker_count;
+    server->listeners_shared = (server->mode != SOCKET_MODE_INET && worker_count > 1) ||
+                               (server->inherited.count > 0 && !server->inherited_reuse_port &&
+                                worker_count > server->inherited.count);
+    server->handler = handler;
+    
+    if (server->options.handler_threads > 0) {
+        server->handler_pool = handler_pool_create(server->options.handler_threads, worker_count,
+                                                   HANDLER_QUEUE_SIZE, run_handler_task, server);
+        if (!server->handler_pool) {
+            return -1;
+        }
+        logger_info("Handler threads: %zu (ACK %s)", server->options.handler_threads,
+                    server->options.handler_ack == HANDLER_ACK_RECEIVE ? "on receive" : "after the handler");
+    }
+    
+    for (size_t i = 0; i < worker_count; i++) {
+        if (init_worker(server, &server->workers[i], i) < 0) {
+            return -1;
+        }
+    }
+    if (server->predecessor_fd >= 0) {
+        confirm_takeover(server);
+    }
+    
+    if (server->options.io_backend == IO_BACKEND_URING) {
+        logger_info("Event loop backend: uring (multishot accept/recv, provided buffers), workers=%zu",
+                    worker_count);
+    } else {
+        logger_info("Event loop backend: %s (%s-triggered), workers=%zu",
+                    io_backend_name(server->options.io_backend),
+                    event_loop_is_edge_triggered(server->workers[0].event_loop) ? "edge" : "level",
+                    worker_count);
+    }
+    if (server->options.checksums || server->options.validate_utf8) {
+        logger_info("Payload checks: %s (checksums %s, UTF-8 validation %s)", integrity_backend(),
+                    server->options.checksums ? "offered" : "off", server->options.validate_utf8 ? "on" : "off");
+    }
     
     server->running = 1;
-    if (server->mode == SOCKET_MODE_UNIX) {
+    if (server->mode == SOCKET_MODE_SHM) {
+        logger_info("Server listening (SHM) at path=%s", server->address);
+    } else if (server->mode == SOCKET_MODE_UNIX) {
         logger_info("Server listening (UNIX) at path=%s", server->address);
     } else {
         logger_info("Server listening (INET) at address=%s", server->address);
     }
-    run_event_loop(server, handler);
+    if (server->options.handoff_path[0] && start_handoff_listener(server) < 0) {
+        server->running = 0;
+        return -1;
+    }
+    
+    // Worker 0 runs on the calling thread
+    for (size_t i = 1; i < worker_count; i++) {
+        ServerWorker* worker = &server->workers[i];
+        if (pthread_create(&worker->thread, NULL, worker_thread_main, worker) != 0) {
+            logger_error("Failed to start worker %zu", i);
+            server->running = 0;
+            break;
+        }
+        worker->thread_started = 1;
+    }
+    run_worker(&server->workers[0]);
+    
+    for (size_t i = 1; i < worker_count; i++) {
+        ServerWorker* worker = &server->workers[i];
+        if (worker->thread_started) {
+            pthread_join(worker->thread, NULL);
+            worker->thread_started = 0;
+        }
+    }
     
     return 0;
 }
@@ -320,8 +2521,217 @@ void server_stop(Server* server) {
     }
 }
 
+int server_handed_off(const Server* server) {
+    return server ? server->handed_off : 0;
+}
+
+int server_broadcast(Server* server, const char* topic, size_t topic_len, const void* data, size_t len) {
+    if (!server || !server->running || !topic || topic_len == 0 || topic_len > MSG_TOPIC_MAX) {
+        return -1;
+    }
+    Message msg = message_create_publish(topic, topic_len, data, len);
+    if (msg.payload_size != msg.header.length) {
+        logger_error("Failed to allocate publication of %zu bytes", len);
+        return -1;
+    }
+    SharedFrame* frame = shared_frame_create(&msg);
+    message_free(&msg);
+    if (!frame) {
+        logger_error("Failed to allocate publication of %zu bytes", len);
+        return -1;
+    }
+    int result = post_publication(server, frame, NULL);
+    shared_frame_release(frame);
+    return result;
+}
+
 size_t server_get_client_count(const Server* server) {
-    return server ? server->client_count : 0;
+    if (!server) return 0;
+    
+    size_t count = 0;
+    for (size_t i = 0; i < server->worker_count; i++) {
+        ServerWorker* worker = &server->workers[i];
+        pthread_mutex_lock(&worker->table_lock);
+        count += worker->client_count;
+        pthread_mutex_unlock(&worker->table_lock);
+    }
+    return count;
+}
+
+static void fill_connection_snapshot(const ServerWorker* worker, const ClientConnection* client,
+                                     uint64_t now_ms, ConnectionSnapshot* snapshot) {
+    snapshot->id = client->id;
+    snapshot->fd = client->fd;
+    snapshot->worker = worker->id;
+    snapshot->age_sec = (double)(now_ms - client->connected_ms) / 1000.0;
+    traffic_read(&client->traffic, &snapshot->traffic);
+}
+
+size_t server_snapshot(const Server* server, ServerSnapshot* totals,
+                       ConnectionSnapshot* connections, size_t max_connections) {
+    memset(totals, 0, sizeof(ServerSnapshot));
+    if (!server) return 0;
+    
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    totals->uptime_sec = tv.tv_sec + tv.tv_usec / 1000000.0 - server->start_time;
+    totals->workers = server->worker_count;
+    uint64_t now_ms = get_monotonic_ms();
+    
+    size_t listed = 0;
+    for (size_t w = 0; w < server->worker_count; w++) {
+        ServerWorker* worker = &server->workers[w];
+        pthread_mutex_lock(&worker->table_lock);
+        
+        TrafficSnapshot traffic;
+        traffic_read(&worker->closed_traffic, &traffic);
+        traffic_sum(&totals->traffic, &traffic);
+        totals->total_clients += worker->metrics.total_clients;
+        totals->active_clients += worker->client_count;
+        
+        for (size_t i = 0; i < worker->slot_count; i++) {
+            const ClientConnection* client = worker->slots[i].client;
+            if (!client) {
+                continue;
+            }
+            traffic_read(&client->traffic, &traffic);
+            traffic_sum(&totals->traffic, &traffic);
+            if (connections && listed < max_connections) {
+                fill_connection_snapshot(worker, client, now_ms, &connections[listed++]);
+            }
+        }
+        pthread_mutex_unlock(&worker->table_lock);
+    }
+    return totals->active_clients;
+}
+
+int server_connection_info(const Server* server, uint64_t id, ConnectionSnapshot* out) {
+    size_t w = connection_id_worker(id);
+    if (!server || w >= server->worker_count) {
+        return -1;
+    }
+    
+    ServerWorker* worker = &server->workers[w];
+    pthread_mutex_lock(&worker->table_lock);
+    const ClientConnection* client = lookup_client(worker, id);
+    if (client) {
+        fill_connection_snapshot(worker, client, get_monotonic_ms(), out);
+    }
+    pthread_mutex_unlock(&worker->table_lock);
+    return client ? 0 : -1;
+}
+
+/**
+ * @brief Append to a stats buffer
+ * @return 0 if it fit, -1 if the text was cut off
+ */
+static int stats_append(char* buf, size_t cap, size_t* length, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(buf + *length, cap - *length, format, args);
+    va_end(args);
+    if (written < 0 || (size_t)written >= cap - *length) {
+        buf[*length] = '\0';
+        return -1;
+    }
+    *length += (size_t)written;
+    return 0;
+}
+
+size_t server_format_stats(const Server* server, char* buf, size_t cap) {
+    if (cap == 0) return 0;
+    buf[0] = '\0';
+    
+    ConnectionSnapshot* connections = malloc(STATS_MAX_CONNECTIONS * sizeof(ConnectionSnapshot));
+    ServerSnapshot totals;
+    size_t active = server_snapshot(server, &totals, connections, connections ? STATS_MAX_CONNECTIONS : 0);
+    size_t listed = connections ? (active < STATS_MAX_CONNECTIONS ? active : STATS_MAX_CONNECTIONS) : 0;
+    
+    const TrafficSnapshot* t = &totals.traffic;
+    double rate = totals.uptime_sec > 0.0 ? (double)t->messages_in / totals.uptime_sec : 0.0;
+    size_t length = 0;
+    int result = stats_append(buf, cap, &length,
+                              "uptime=%.2fs workers=%zu clients=%zu accepted=%zu messages=%llu bytes_in=%llu "
+                              "frames_out=%llu bytes_out=%llu rx_queued=%llu tx_queued=%llu msg_rate=%.1f/s\n",
+                              totals.uptime_sec, totals.workers, totals.active_clients, totals.total_clients,
+                              (unsigned long long)t->messages_in, (unsigned long long)t->bytes_in,
+                              (unsigned long long)t->frames_out, (unsigned long long)t->bytes_out,
+                              (unsigned long long)t->rx_queued, (unsigned long long)t->tx_queued, rate);
+    
+    for (size_t i = 0; result == 0 && i < listed; i++) {
+        const ConnectionSnapshot* c = &connections[i];
+        result = stats_append(buf, cap, &length,
+                              "client id=%llx fd=%d worker=%zu age=%.2fs messages=%llu bytes_in=%llu "
+                              "frames_out=%llu bytes_out=%llu rx_queued=%llu tx_queued=%llu",
+                              (unsigned long long)c->id, c->fd, c->worker, c->age_sec, (unsigned long long)c->traffic.messages_in,
+                              (unsigned long long)c->traffic.bytes_in, (unsigned long long)c->traffic.frames_out,
+                              (unsigned long long)c->traffic.bytes_out, (unsigned long long)c->traffic.rx_queued,
+                              (unsigned long long)c->traffic.tx_queued);
+        if (result == 0 && (c->traffic.broadcasts_out > 0 || c->traffic.broadcasts_dropped > 0)) {
+            // Subscribers: how far behind the publications they are
+            result = stats_append(buf, cap, &length, " pub_out=%llu pub_dropped=%llu pub_lag=%llu",
+                                  (unsigned long long)c->traffic.broadcasts_out,
+                                  (unsigned long long)c->traffic.broadcasts_dropped,
+                                  (unsigned long long)c->traffic.broadcast_lag);
+        }
+        if (result == 0) {
+            result = stats_append(buf, cap, &length, "\n");
+        }
+    }
+    if (result == 0 && active > listed) {
+        stats_append(buf, cap, &length, "(%zu more connections)\n", active - listed);
+    }
+    
+    free(connections);
+    return length;
+}
+
+void server_merge_metrics(const Server* server, ServerMetrics* merged) {
+    memset(merged, 0, sizeof(ServerMetrics));
+    if (!server) return;
+    
+    for (size_t i = 0; i < server->worker_count; i++) {
+        const ServerMetrics* m = &server->workers[i].metrics;
+        merged->total_clients += m->total_clients;
+        merged->total_messages += m->total_messages;
+        merged->total_bytes += m->total_bytes;
+        merged->total_interval_ms += m->total_interval_ms;
+        if (m->interval_count > 0) {
+            if (merged->interval_count == 0 || m->min_interval_ms < merged->min_interval_ms) {
+                merged->min_interval_ms = m->min_interval_ms;
+            }
+            if (merged->interval_count == 0 || m->max_interval_ms > merged->max_interval_ms) {
+                merged->max_interval_ms = m->max_interval_ms;
+            }
+        }
+        merged->interval_count += m->interval_count;
+        if (m->last_message_time > merged->last_message_time) {
+            merged->last_message_time = m->last_message_time;
+        }
+        merged->ack_frames_sent += m->ack_frames_sent;
+        merged->streams_completed += m->streams_completed;
+        merged->frames_rejected += m->frames_rejected;
+        merged->frames_corrupt += m->frames_corrupt;
+        merged->read_pauses += m->read_pauses;
+        merged->handler_stalls += m->handler_stalls;
+        merged->dispatch_batches += m->dispatch_batches;
+        merged->broadcasts += m->broadcasts;
+        merged->broadcast_deliveries += m->broadcast_deliveries;
+        merged->broadcast_drops += m->broadcast_drops;
+        merged->subscribers_dropped += m->subscribers_dropped;
+        if (m->send_queue_peak > merged->send_queue_peak) {
+            merged->send_queue_peak = m->send_queue_peak;
+        }
+        merged->handshakes_in_progress += m->handshakes_in_progress;
+        merged->handshakes_completed += m->handshakes_completed;
+        merged->handshakes_resumed += m->handshakes_resumed;
+        merged->ktls_send += m->ktls_send;
+        merged->ktls_recv += m->ktls_recv;
+        compression_stats_add(&merged->decompression, &m->decompression);
+        histogram_merge(&merged->latency, &m->latency);
+        merged->handshakes_failed += m->handshakes_failed;
+        merged->handshake_timeouts += m->handshake_timeouts;
+    }
 }
 
 void server_get_metrics(const Server* server,
@@ -334,18 +2744,21 @@ void server_get_metrics(const Server* server,
                        double* max_latency_ms) {
     if (!server) return;
     
+    ServerMetrics merged;
+    server_merge_metrics(server, &merged);
+    
     struct timeval tv;
     gettimeofday(&tv, NULL);
     double current_time = tv.tv_sec + tv.tv_usec / 1000000.0;
     
-    if (total_clients) *total_clients = server->total_clients;
-    if (total_messages) *total_messages = server->total_messages;
+    if (total_clients) *total_clients = merged.total_clients;
+    if (total_messages) *total_messages = merged.total_messages;
     if (uptime) *uptime = current_time - server->start_time;
     
     // Calculate throughput (MB/s)
     if (throughput_mbps) {
         if (uptime && *uptime > 0.0) {
-            double megabytes = server->total_bytes / (1024.0 * 1024.0);
+            double megabytes = merged.total_bytes / (1024.0 * 1024.0);
             *throughput_mbps = megabytes / *uptime;
         } else {
             *throughput_mbps = 0.0;
@@ -354,17 +2767,16 @@ void server_get_metrics(const Server* server,
     
     // Message interval statistics (ms)
     if (avg_latency_ms) {
-        if (server->interval_count > 0) {
-            *avg_latency_ms = server->total_interval_ms / server->interval_count;
+        if (merged.interval_count > 0) {
+            *avg_latency_ms = merged.total_interval_ms / merged.interval_count;
         } else {
             *avg_latency_ms = 0.0;
         }
     }
     if (min_latency_ms) {
-        *min_latency_ms = (server->interval_count > 0) ? server->min_interval_ms : 0.0;
+        *min_latency_ms = (merged.interval_count > 0) ? merged.min_interval_ms : 0.0;
     }
     if (max_latency_ms) {
-        *max_latency_ms = (server->interval_count > 0) ? server->max_interval_ms : 0.0;
+        *max_latency_ms = (merged.interval_count > 0) ? merged.max_interval_ms : 0.0;
     }
 }
-
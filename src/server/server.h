@@ -2,8 +2,10 @@
  * @file server.h
  * @brief Server implementation
  * 
- * Server with multi-client support using poll() for I/O multiplexing.
- * Supports both AF_UNIX and AF_INET sockets with optional TLS.
+ * Server with multi-client support using epoll (or poll() as fallback)
+ * for I/O multiplexing, or io_uring completions for plaintext sockets.
+ * Supports both AF_UNIX and AF_INET sockets with optional TLS, and
+ * shared-memory rings for clients on the same host.
  */
 
 #ifndef SERVER_H
@@ -11,60 +13,401 @@
 
 #include "../common/protocol.h"
 #include "../common/types.h"
+#include "../common/frame_reader.h"
+#include "../common/shm_channel.h"
+#include "../common/histogram.h"
+#include "../common/tuning.h"
+#include "event_loop.h"
+#include "uring.h"
+#include "handler_pool.h"
+#include "pubsub.h"
+#include "handoff.h"
 #include <stddef.h>
 #include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+struct OutboundFrame;
 
 /**
- * @brief Client connection structure
+ * @brief Connection lifecycle
+ */
+typedef enum {
+    CLIENT_STATE_HANDSHAKE,     ///< TLS handshake in progress, no messages yet
+    CLIENT_STATE_ACTIVE         ///< Reading and dispatching messages
+} ClientState;
+
+/**
+ * @brief Traffic counters of a connection, readable from any thread
+ *
+ * Only the owning worker writes them, with a relaxed load and store (no
+ * locked instruction on the hot path); readers use relaxed loads and may
+ * see a message counted before its bytes.
+ */
+typedef struct {
+    _Atomic uint64_t messages_in;   ///< Frames dispatched
+    _Atomic uint64_t bytes_in;      ///< Payload bytes dispatched (after decompression)
+    _Atomic uint64_t frames_out;    ///< Frames sent (ACKs, replies)
+    _Atomic uint64_t bytes_out;     ///< Bytes sent, headers included
+    _Atomic uint64_t rx_queued;     ///< Bytes received but not yet dispatched (gauge)
+    _Atomic uint64_t tx_queued;     ///< Bytes queued for sending but not yet written (gauge)
+    _Atomic uint64_t broadcasts_out;     ///< Publications queued for this subscriber
+    _Atomic uint64_t broadcasts_dropped; ///< Publications skipped because the subscriber lagged
+    _Atomic uint64_t broadcast_lag;      ///< Publications queued but not yet written (gauge)
+} TrafficCounters;
+
+/**
+ * @brief Plain copy of TrafficCounters
  */
 typedef struct {
+    uint64_t messages_in;
+    uint64_t bytes_in;
+    uint64_t frames_out;
+    uint64_t bytes_out;
+    uint64_t rx_queued;
+    uint64_t tx_queued;
+    uint64_t broadcasts_out;
+    uint64_t broadcasts_dropped;
+    uint64_t broadcast_lag;
+} TrafficSnapshot;
+
+/**
+ * @brief Connection ID layout: generation (32 bits), worker (8 bits), slot (24 bits)
+ *
+ * The generation of a slot changes every time it is released, so an ID
+ * stays unique long after its descriptor number was reused.
+ */
+#define CONNECTION_ID_SLOT_BITS 24
+#define CONNECTION_ID_WORKER_BITS 8
+#define CONNECTION_ID_MAX_SLOTS ((size_t)1 << CONNECTION_ID_SLOT_BITS)
+
+static inline size_t connection_id_slot(uint64_t id) {
+    return (size_t)(id & (CONNECTION_ID_MAX_SLOTS - 1));
+}
+
+static inline size_t connection_id_worker(uint64_t id) {
+    return (size_t)((id >> CONNECTION_ID_SLOT_BITS) & ((1u << CONNECTION_ID_WORKER_BITS) - 1));
+}
+
+static inline uint32_t connection_id_generation(uint64_t id) {
+    return (uint32_t)(id >> 32);
+}
+
+/**
+ * @brief Client connection structure
+ */
+typedef struct ClientConnection {
     int fd;
     void* ssl;  // SSL* pointer
     int is_ssl;
+    uint64_t id;   // Connection ID; its slot locates the connection in worker->slots
+    ClientState state;
+    uint64_t handshake_deadline_ms;  // Monotonic deadline while in CLIENT_STATE_HANDSHAKE
+    uint32_t interest;   // EVENT_* flags currently registered
+    FrameReader reader;  // Read buffer and framing state
+    ShmChannel* shm;     // Shared-memory transport (SOCKET_MODE_SHM), NULL for sockets
+    uint32_t features;   // MSG_FEATURE_* negotiated with HELLO
+    uint64_t connected_ms;      // Monotonic accept time
+    uint64_t stream_offset;     // Bytes of the current stream (MSG_TYPE_CHUNK) dispatched so far
+    TrafficCounters traffic;    // Read by stats snapshots on other threads
+    
+    // Cumulative ACK not yet sent (MSG_FEATURE_ACK_BATCH)
+    uint64_t pending_ack_sequence;
+    uint64_t pending_ack_timestamp;  // Send time of that message (0 = not timestamped)
+    size_t pending_acks;
+    
+    // Outbound frames not yet written, oldest first (socket transports)
+    struct OutboundFrame* send_queue;
+    struct OutboundFrame* send_queue_tail;
+    size_t send_queued;     // Unwritten bytes in send_queue
+    size_t broadcasts_queued;   // Frames of send_queue that are shared publications
+    size_t subscriptions;   // Topics of the worker's TopicTable this connection is in
+    int read_paused;        // Not reading until send_queued falls to the low watermark and no task is stalled
+    
+    // Handler threads: a task whose ring was full, submitted again once it has room
+    HandlerTask stalled_task;
+    int handler_stalled;
+    struct ClientConnection* next_stalled;
+    
+    // io_uring backend: the connection is freed once no operation references it
+    unsigned uring_ops;                 // Submitted operations not yet completed
+    int recv_armed;                     // A multishot receive is outstanding
+    int closing;                        // Removed from the client table, waiting to be freed
+    struct ClientConnection* next_closing;
 } ClientConnection;
 
+#define SERVER_PATH_MAX 256
+
 /**
- * @brief Server structure
+ * @brief When messages run by handler threads are acknowledged
+ */
+typedef enum {
+    HANDLER_ACK_COMPLETE,   ///< Once the handler has returned
+    HANDLER_ACK_RECEIVE     ///< As soon as the frame is queued for its handler thread
+} HandlerAckMode;
+
+/**
+ * @brief What happens to a subscriber that cannot keep up with its publications
+ */
+typedef enum {
+    SUBSCRIBER_DROP_FRAMES,     ///< Skip publications while its queue is over the limit
+    SUBSCRIBER_DROP_CONNECTION  ///< Disconnect it
+} SubscriberDropPolicy;
+
+/**
+ * @brief Tunable server options (see server_options_init for defaults)
+ */
+typedef struct {
+    IoBackend io_backend;   ///< Event-loop backend
+    int edge_triggered;     ///< Edge-triggered notification (epoll only)
+    size_t workers;         ///< Event-loop threads (0 = one per online CPU)
+    int ack_batch;          ///< Offer MSG_FEATURE_ACK_BATCH to clients that ask
+    size_t ack_batch_max;   ///< Send a cumulative ACK after this many messages at the latest
+    int handshake_timeout_ms; ///< Drop clients whose TLS handshake takes longer
+    char tls_cert_file[SERVER_PATH_MAX];        ///< PEM certificate chain ("" = ephemeral self-signed)
+    char tls_key_file[SERVER_PATH_MAX];         ///< PEM private key for tls_cert_file
+    char tls_ticket_key_file[SERVER_PATH_MAX];  ///< Session ticket keys shared across restarts ("" = random)
+    int ktls;               ///< Offload the TLS record layer to the kernel when supported
+    int compression;        ///< Accept MSG_FLAGS_COMPRESSED payloads from clients that ask
+    int checksums;          ///< Offer MSG_FEATURE_CHECKSUM (checksummed frames are always verified)
+    int validate_utf8;      ///< Refuse MSG_TYPE_TEXT payloads that are not well-formed UTF-8
+    size_t shm_ring_size;   ///< Bytes per direction of each shared-memory channel
+    int stats_requests;     ///< Answer MSG_TYPE_STATS with a live snapshot
+    uint64_t max_frame_size; ///< Largest payload accepted on a socket, compressed or not (0 = unlimited)
+    size_t send_queue_high; ///< Stop reading from a client with more unwritten bytes than this (0 = never)
+    size_t send_queue_low;  ///< Resume reading once its unwritten bytes fall to this
+    size_t handler_threads; ///< Threads running the handlers (0 = on the workers themselves)
+    HandlerAckMode handler_ack; ///< ACK timing for messages run by handler threads
+    TuningOptions tuning;   ///< TCP socket options and worker CPU affinity
+    int publish_requests;   ///< Relay MSG_TYPE_PUBLISH from clients to the topic's subscribers
+    size_t subscriber_queue_max; ///< Unwritten bytes past which a publication counts as lagging (0 = send_queue_high)
+    SubscriberDropPolicy subscriber_drop; ///< Fate of lagging subscribers
+    char handoff_path[SERVER_PATH_MAX]; ///< Control socket for hot restarts ("" = off)
+    int handoff_drain_ms;   ///< After a handoff, longest wait for open connections to finish
+} ServerOptions;
+
+/**
+ * @brief Per-worker metrics (owned by one thread, merged on report)
  */
 typedef struct {
-    SocketMode mode;
-    char* address;
-    int enable_tls;
-    int server_fd;
-    int running;
-    void* ssl_ctx;  // SSL_CTX* pointer
-    
-    ClientConnection* clients;
-    size_t client_count;
-    size_t client_capacity;
-    
-    // Metrics
     size_t total_clients;
     size_t total_messages;
-    double start_time;
     size_t total_bytes;
-    double last_message_time;
+    double last_message_time;   ///< Monotonic clock, seconds
     double total_interval_ms;
     double min_interval_ms;
     double max_interval_ms;
     size_t interval_count;
-} Server;
+    size_t ack_frames_sent;     ///< ACK and ACK_BATCH frames written
+    size_t streams_completed;   ///< Streams whose final chunk was dispatched
+    size_t frames_rejected;     ///< Connections closed for a frame above max_frame_size
+    size_t frames_corrupt;      ///< Connections closed for a checksum mismatch or invalid text
+    size_t read_pauses;         ///< Times reading stopped because a client's send queue was full
+    size_t send_queue_peak;     ///< Largest send queue of any connection, in bytes
+    size_t handler_stalls;      ///< Times a handler thread's queue was full and a connection stopped being read
+    size_t dispatch_batches;    ///< MessageBatchHandler calls
+    size_t broadcasts;          ///< Publications fanned out to this worker's subscribers
+    size_t broadcast_deliveries; ///< Subscriber queues a publication was added to
+    size_t broadcast_drops;     ///< Publications skipped for lagging subscribers
+    size_t subscribers_dropped; ///< Subscribers disconnected for lagging
+    size_t handshakes_in_progress;
+    size_t handshakes_completed;
+    size_t handshakes_resumed;  ///< Completed handshakes that resumed a session
+    size_t handshakes_failed;   ///< Includes timeouts
+    size_t handshake_timeouts;
+    size_t ktls_send;           ///< Connections whose outgoing records are encrypted by the kernel
+    size_t ktls_recv;           ///< Connections whose incoming records are decrypted by the kernel
+    CompressionStats decompression; ///< Compressed payloads received
+    Histogram latency;          ///< Client send to dispatch, in ns (MSG_FLAGS_TIMESTAMPED frames)
+} ServerMetrics;
 
 /**
  * @brief Message handler callback type
+ *
+ * With more than one worker, or with handler threads, the handler is
+ * called concurrently from several threads and must be thread-safe;
+ * messages of one connection are still handled one at a time, in order. The message is freed when
+ * the handler returns; to keep the payload without copying it, take it
+ * with message_take_payload. connection_id is the connection's stable ID
+ * (see server_connection_info), never the reusable descriptor number.
+ */
+typedef void (*MessageHandler)(uint64_t connection_id, Message* msg);
+
+#define SERVER_BATCH_MAX 64     ///< Most frames given to one MessageBatchHandler call
+
+/**
+ * @brief Batch message handler callback type
+ *
+ * Used instead of the MessageHandler: receives the complete frames taken
+ * from one read of a connection together, in order, at most
+ * SERVER_BATCH_MAX at a time. The payloads are views into the
+ * connection's read buffer, valid only during the call; message_take_payload
+ * copies one that must be kept. The threading rules are those of
+ * MessageHandler. With handler threads, frames are copied off the read
+ * buffer and each call carries a single message.
  */
-typedef void (*MessageHandler)(int client_id, const Message* msg);
+typedef void (*MessageBatchHandler)(uint64_t connection_id, Message* msgs, size_t count);
+
+/**
+ * @brief One piece of a streamed payload (MSG_TYPE_CHUNK)
+ */
+typedef struct {
+    uint64_t offset;        ///< Stream bytes delivered before this chunk
+    const uint8_t* data;    ///< Chunk payload, valid only during the call
+    size_t length;
+    int final;              ///< Last chunk: offset + length is the size of the stream
+} StreamChunk;
+
+/**
+ * @brief Stream handler callback type
+ *
+ * Called for every chunk of a stream in order, from the worker that owns
+ * the connection or its handler thread, with the same threading rules as
+ * MessageHandler. Only
+ * the chunk being delivered is held in memory, however large the stream.
+ */
+typedef void (*StreamHandler)(uint64_t connection_id, const StreamChunk* chunk);
+
+struct Server;
+
+#define CLIENT_SLOT_NONE UINT32_MAX
+
+/**
+ * @brief Frames of the read a worker is dispatching
+ */
+typedef struct {
+    Message msgs[SERVER_BATCH_MAX]; ///< Waiting for the MessageBatchHandler
+    size_t count;
+    size_t bytes;           ///< Payload bytes of msgs
+    uint64_t now_ns;        ///< Arrival time of the whole read (0 = clock not read yet)
+} DispatchBatch;
+
+/**
+ * @brief Entry of a worker's client slab
+ */
+typedef struct {
+    ClientConnection* client;   ///< NULL while the slot is free
+    uint32_t generation;        ///< Generation of the current or next connection ID
+    uint32_t next_free;         ///< Free-list link (CLIENT_SLOT_NONE ends the list)
+} ClientSlot;
+
+/**
+ * @brief Event-loop thread with its own listener, client table and metrics
+ */
+typedef struct {
+    struct Server* server;
+    size_t id;
+    int listen_fd;          // Own SO_REUSEPORT socket (inet) or shared socket (unix)
+    int owns_listen_fd;
+    int accepting;          // listen_fd is watched (cleared once a successor took over)
+    int accept_armed;       // io_uring: an accept may still complete, even after its cancel
+    EventLoop* event_loop;  // Readiness backends (poll, epoll)
+    UringRing* uring;       // Completion backend (uring)
+    uint64_t handler_wake_value;    // io_uring: target of the read on the handler_pool eventfd
+    pthread_t thread;
+    int thread_started;
+    
+    // Client slab: adding, removing and looking up a connection is O(1) and
+    // connections never move. The table changes only under table_lock, so
+    // snapshots from other threads may walk it; the owning worker reads it
+    // without locking
+    pthread_mutex_t table_lock;
+    ClientSlot* slots;
+    size_t slot_count;      // Slots ever used (free ones included)
+    size_t slot_capacity;
+    uint32_t free_slot;     // Most recently released slot (CLIENT_SLOT_NONE if none)
+    size_t client_count;
+    TrafficCounters closed_traffic;     // Totals of connections already removed (under table_lock)
+    ClientConnection* closing_clients;  // Closed connections still referenced by in-flight operations or events
+    ClientConnection* stalled_clients;  // Connections paused on a full handler ring (handler_stalled)
+    uint64_t next_handshake_sweep_ms;   // Next check for expired TLS handshakes
+    DispatchBatch batch;
+    
+    // Publish/subscribe: the topic table is the worker's own; any thread
+    // appends publications to the inbox and wakes the worker through broadcast_fd
+    TopicTable topics;
+    pthread_mutex_t inbox_lock;
+    SharedFrame** inbox;
+    size_t inbox_count;
+    size_t inbox_capacity;
+    int broadcast_fd;       // eventfd
+    uint64_t broadcast_wake_value;  // io_uring: target of the read on broadcast_fd
+    
+    ServerMetrics metrics;
+} ServerWorker;
+
+/**
+ * @brief Server structure
+ */
+typedef struct Server {
+    SocketMode mode;
+    char* address;
+    int enable_tls;
+    int server_fd;  // First listening socket
+    atomic_int running;
+    void* ssl_ctx;  // SSL_CTX* pointer
+    ServerOptions options;
+    StreamHandler stream_handler;   // Receives MSG_TYPE_CHUNK frames (NULL = MessageHandler does)
+    MessageHandler handler;
+    MessageBatchHandler batch_handler;  // Replaces handler when set
+    HandlerPool* handler_pool;      // Runs the handlers when options.handler_threads > 0
+    
+    ServerWorker* workers;
+    size_t worker_count;
+    int listeners_shared;   // Several workers accept from one socket
+    
+    // Hot restart (options.handoff_path): a successor connecting to
+    // handoff_fd gets the listeners, then this server stops accepting and
+    // drains until its connections are gone or the deadline passes
+    int handoff_fd;             // Control socket (-1 = not waiting for a successor)
+    pthread_t handoff_thread;
+    int handoff_thread_started;
+    HandoffState inherited;     // Listeners taken over from the previous server, until workers own them
+    int inherited_reuse_port;
+    int predecessor_fd;         // Connection to the previous server, until the takeover is confirmed
+    atomic_int draining;
+    uint64_t drain_deadline_ms;
+    int handed_off;             // The listeners belong to the successor now
+    
+    double start_time;
+} Server;
 
 /**
  * @brief Initialize server
  * @param server Server structure to initialize
- * @param mode Socket mode (UNIX or INET)
- * @param address Address (socket path for UNIX, host:port for INET)
+ * @param mode Socket mode (UNIX, INET or SHM)
+ * @param address Address (socket path for UNIX and SHM, host:port for INET)
  * @param enable_tls Enable TLS/SSL encryption
  * @return 0 on success, -1 on error
  */
 int server_init(Server* server, SocketMode mode, const char* address, int enable_tls);
 
+/**
+ * @brief Fill options with defaults (epoll, level-triggered, one worker, ACK batching offered)
+ */
+void server_options_init(ServerOptions* options);
+
+/**
+ * @brief Apply options (call after server_init, before server_start)
+ */
+void server_set_options(Server* server, const ServerOptions* options);
+
+/**
+ * @brief Receive streams chunk by chunk (call before server_start)
+ *
+ * Without a stream handler, chunks reach the MessageHandler as
+ * MSG_TYPE_CHUNK messages.
+ */
+void server_set_stream_handler(Server* server, StreamHandler handler);
+
+/**
+ * @brief Receive the frames of each read as one batch (call before server_start)
+ *
+ * The MessageHandler passed to server_start is then not called and may be
+ * NULL.
+ */
+void server_set_batch_handler(Server* server, MessageBatchHandler handler);
+
 /**
  * @brief Cleanup server resources
  */
@@ -72,6 +415,11 @@ void server_cleanup(Server* server);
 
 /**
  * @brief Start the server
+ *
+ * With options.handoff_path, the listeners of a server already waiting at
+ * that path are taken over instead of binding new ones, and the server
+ * then waits there for its own successor. Returns once stopped, or once a
+ * successor took over and the open connections drained.
  * @param server Server instance
  * @param handler Message handler callback (can be NULL)
  * @return 0 on success, -1 on error
@@ -84,12 +432,88 @@ int server_start(Server* server, MessageHandler handler);
 void server_stop(Server* server);
 
 /**
- * @brief Get number of connected clients
+ * @brief Whether a successor took over the listeners (server_start returned after draining)
+ */
+int server_handed_off(const Server* server);
+
+/**
+ * @brief Send data to every subscriber of a topic (any thread, while the server runs)
+ *
+ * The frame is encoded once and the same buffer is queued for every
+ * subscriber; each worker fans it out to its own connections on its next
+ * loop iteration. A subscriber whose unwritten bytes exceed
+ * subscriber_queue_max misses the publication or is disconnected,
+ * depending on subscriber_drop. Publications of one thread reach each
+ * subscriber in the order they were made.
+ * @param topic Topic name, 1 to MSG_TOPIC_MAX bytes
+ * @return 0 if the publication was handed to the workers, -1 on error
+ */
+int server_broadcast(Server* server, const char* topic, size_t topic_len, const void* data, size_t len);
+
+/**
+ * @brief Get number of connected clients (summed over workers)
  */
 size_t server_get_client_count(const Server* server);
 
 /**
- * @brief Get server metrics
+ * @brief Live view of one connection
+ */
+typedef struct {
+    uint64_t id;
+    int fd;
+    size_t worker;
+    double age_sec;
+    TrafficSnapshot traffic;
+} ConnectionSnapshot;
+
+/**
+ * @brief Live totals over all workers
+ */
+typedef struct {
+    double uptime_sec;
+    size_t workers;
+    size_t active_clients;
+    size_t total_clients;       ///< Accepted since start
+    TrafficSnapshot traffic;    ///< Active and closed connections
+} ServerSnapshot;
+
+/**
+ * @brief Take a consistent-enough snapshot while the server runs (any thread)
+ *
+ * Each worker's table is locked only while its connections are copied;
+ * counters are read without stopping the workers.
+ * @param totals Output totals
+ * @param connections Output array for per-connection views (may be NULL)
+ * @param max_connections Capacity of connections
+ * @return Number of active connections (may exceed max_connections)
+ */
+size_t server_snapshot(const Server* server, ServerSnapshot* totals,
+                       ConnectionSnapshot* connections, size_t max_connections);
+
+/**
+ * @brief Look up a live connection by the ID handed to the MessageHandler (any thread)
+ * @param server Server instance
+ * @param id Connection ID
+ * @param out Output view of the connection
+ * @return 0 if the connection is still open, -1 otherwise
+ */
+int server_connection_info(const Server* server, uint64_t id, ConnectionSnapshot* out);
+
+/**
+ * @brief Format a snapshot as text: a totals line, then one line per connection
+ * @return Length written (excluding NUL), truncated to fit cap
+ */
+size_t server_format_stats(const Server* server, char* buf, size_t cap);
+
+/**
+ * @brief Merge per-worker metrics into one block
+ * @param server Server instance
+ * @param merged Output metrics
+ */
+void server_merge_metrics(const Server* server, ServerMetrics* merged);
+
+/**
+ * @brief Get server metrics (merged over workers)
  */
 void server_get_metrics(const Server* server, 
                        size_t* total_clients,
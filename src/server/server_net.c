@@ -14,13 +14,22 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <errno.h>
 #include <string.h>
+#include <stdlib.h>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 #include <openssl/x509.h>
 #include <openssl/rsa.h>
 #include <openssl/evp.h>
 #include <openssl/pem.h>
+#include <openssl/ec.h>
+#include <stdio.h>
+
+#define TLS_TICKET_KEY_SIZE 80          // Key name, HMAC secret and AES key
+#define TLS_SESSION_CACHE_SIZE 20480
+#define TLS_SESSION_LIFETIME_SEC 7200
+#define TLS_IDENTITY_MAX (32 * 1024)    // Encoded certificate or key
 
 int setup_unix_socket(const char* socket_path) {
     int fd = socket(AF_UNIX, SOCK_STREAM, 0);
@@ -51,34 +60,46 @@ int setup_unix_socket(const char* socket_path) {
     return fd;
 }
 
-int setup_inet_socket(const char* host, uint16_t port) {
-    int fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (fd < 0) {
-        logger_error("Failed to create INET socket: %s", get_error_string(errno));
-        return -1;
-    }
-    
-    struct sockaddr_in addr;
+int setup_inet_socket(const char* host, uint16_t port, int reuse_port) {
+    SocketAddress addr;
+    socklen_t addr_len;
     memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(port);
     
-    if (!host || strlen(host) == 0 || strcmp(host, "localhost") == 0 || strcmp(host, "127.0.0.1") == 0) {
-        addr.sin_addr.s_addr = INADDR_ANY;
+    if (host && inet_pton(AF_INET6, host, &addr.inet6_addr.sin6_addr) == 1) {
+        // IPv6 literal ("::" listens on every address of both families)
+        addr.inet6_addr.sin6_family = AF_INET6;
+        addr.inet6_addr.sin6_port = htons(port);
+        addr_len = sizeof(addr.inet6_addr);
     } else {
-        if (inet_aton(host, &addr.sin_addr) == 0) {
-            close(fd);
+        addr.inet_addr.sin_family = AF_INET;
+        addr.inet_addr.sin_port = htons(port);
+        addr_len = sizeof(addr.inet_addr);
+        if (!host || strlen(host) == 0 || strcmp(host, "localhost") == 0 || strcmp(host, "127.0.0.1") == 0) {
+            addr.inet_addr.sin_addr.s_addr = INADDR_ANY;
+        } else if (inet_pton(AF_INET, host, &addr.inet_addr.sin_addr) != 1) {
             logger_error("Invalid IP address: %s", host);
             return -1;
         }
     }
     
+    int fd = socket(addr.generic.sa_family, SOCK_STREAM, 0);
+    if (fd < 0) {
+        logger_error("Failed to create INET socket: %s", get_error_string(errno));
+        return -1;
+    }
+    
     if (set_socket_reuse(fd) < 0) {
         close(fd);
         return -1;
     }
     
-    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+    if (reuse_port && set_socket_reuse_port(fd) < 0) {
+        close(fd);
+        logger_error("Failed to enable SO_REUSEPORT: %s", get_error_string(errno));
+        return -1;
+    }
+    
+    if (bind(fd, &addr.generic, addr_len) < 0) {
         close(fd);
         logger_error("Failed to bind INET socket: %s", get_error_string(errno));
         return -1;
@@ -87,53 +108,59 @@ int setup_inet_socket(const char* host, uint16_t port) {
     return fd;
 }
 
-void* init_tls_server(void) {
-    SSL_library_init();
-    SSL_load_error_strings();
-    OpenSSL_add_all_algorithms();
-    
-    const SSL_METHOD* method = TLS_server_method();
-    SSL_CTX* ctx = SSL_CTX_new(method);
-    
-    if (!ctx) {
-        logger_error("Failed to create SSL context");
-        return NULL;
+/**
+ * @brief Load certificate chain and private key from PEM files
+ */
+static int load_certificate(SSL_CTX* ctx, const char* cert_file, const char* key_file) {
+    if (SSL_CTX_use_certificate_chain_file(ctx, cert_file) != 1) {
+        logger_error("Failed to load TLS certificate from %s", cert_file);
+        return -1;
     }
-    
-    // Generate self-signed certificate for demo (modern EVP API)
+    if (SSL_CTX_use_PrivateKey_file(ctx, key_file, SSL_FILETYPE_PEM) != 1) {
+        logger_error("Failed to load TLS private key from %s", key_file);
+        return -1;
+    }
+    if (SSL_CTX_check_private_key(ctx) != 1) {
+        logger_error("TLS private key %s does not match certificate %s", key_file, cert_file);
+        return -1;
+    }
+    logger_info("Loaded TLS certificate %s", cert_file);
+    return 0;
+}
+
+/**
+ * @brief Generate an ephemeral self-signed ECDSA P-256 certificate (demo fallback)
+ */
+static int generate_certificate(SSL_CTX* ctx) {
+    // P-256 keygen takes microseconds and its signatures are far cheaper than RSA-2048
     EVP_PKEY* pkey = NULL;
-    EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL);
+    EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
     if (!pctx) {
-        SSL_CTX_free(ctx);
         logger_error("Failed to create EVP_PKEY_CTX");
-        return NULL;
+        return -1;
     }
     if (EVP_PKEY_keygen_init(pctx) <= 0) {
         EVP_PKEY_CTX_free(pctx);
-        SSL_CTX_free(ctx);
         logger_error("EVP_PKEY_keygen_init failed");
-        return NULL;
+        return -1;
     }
-    if (EVP_PKEY_CTX_set_rsa_keygen_bits(pctx, 2048) <= 0) {
+    if (EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx, NID_X9_62_prime256v1) <= 0) {
         EVP_PKEY_CTX_free(pctx);
-        SSL_CTX_free(ctx);
-        logger_error("EVP_PKEY_CTX_set_rsa_keygen_bits failed");
-        return NULL;
+        logger_error("EVP_PKEY_CTX_set_ec_paramgen_curve_nid failed");
+        return -1;
     }
     if (EVP_PKEY_keygen(pctx, &pkey) <= 0) {
         EVP_PKEY_CTX_free(pctx);
-        SSL_CTX_free(ctx);
         logger_error("EVP_PKEY_keygen failed");
-        return NULL;
+        return -1;
     }
     EVP_PKEY_CTX_free(pctx);
     
     X509* x509 = X509_new();
     if (!x509) {
         EVP_PKEY_free(pkey);
-        SSL_CTX_free(ctx);
         logger_error("Failed to allocate X509");
-        return NULL;
+        return -1;
     }
     X509_set_version(x509, 2);
     ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
@@ -148,47 +175,249 @@ void* init_tls_server(void) {
     if (!X509_sign(x509, pkey, EVP_sha256())) {
         X509_free(x509);
         EVP_PKEY_free(pkey);
-        SSL_CTX_free(ctx);
         logger_error("X509_sign failed");
-        return NULL;
+        return -1;
     }
     
     if (SSL_CTX_use_certificate(ctx, x509) != 1) {
         X509_free(x509);
         EVP_PKEY_free(pkey);
-        SSL_CTX_free(ctx);
         logger_error("SSL_CTX_use_certificate failed");
-        return NULL;
+        return -1;
     }
     if (SSL_CTX_use_PrivateKey(ctx, pkey) != 1) {
         X509_free(x509);
         EVP_PKEY_free(pkey);
-        SSL_CTX_free(ctx);
         logger_error("SSL_CTX_use_PrivateKey failed");
-        return NULL;
+        return -1;
     }
     
     X509_free(x509);
     EVP_PKEY_free(pkey);
+    logger_warn("No TLS certificate configured; using an ephemeral self-signed ECDSA P-256 certificate");
+    return 0;
+}
+
+static void put_u32(uint8_t* p, uint32_t value) {
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/**
+ * @brief Split an identity from tls_export_identity into its parts
+ * @return 0 on success, -1 if it is malformed
+ */
+static int parse_identity(const uint8_t* identity, size_t len, const uint8_t** cert, size_t* cert_len,
+                          const uint8_t** key, size_t* key_len, const uint8_t** tickets) {
+    if (len < 4) return -1;
+    *cert_len = get_u32(identity);
+    if (*cert_len > len - 4 || len - 4 - *cert_len < 4) return -1;
+    *cert = identity + 4;
+    *key_len = get_u32(*cert + *cert_len);
+    *key = *cert + *cert_len + 4;
+    if (len < 8 + *cert_len + TLS_TICKET_KEY_SIZE || *key_len != len - 8 - *cert_len - TLS_TICKET_KEY_SIZE) {
+        return -1;
+    }
+    *tickets = *key + *key_len;
+    return 0;
+}
+
+/**
+ * @brief Use the certificate and private key of an inherited identity
+ */
+static int use_identity(SSL_CTX* ctx, const uint8_t* cert_der, size_t cert_len, const uint8_t* key_der,
+                        size_t key_len) {
+    const unsigned char* cursor = cert_der;
+    X509* x509 = d2i_X509(NULL, &cursor, (long)cert_len);
+    cursor = key_der;
+    EVP_PKEY* pkey = d2i_AutoPrivateKey(NULL, &cursor, (long)key_len);
+    int result = -1;
+    if (!x509 || !pkey) {
+        logger_error("Failed to decode the inherited TLS certificate");
+    } else if (SSL_CTX_use_certificate(ctx, x509) != 1 || SSL_CTX_use_PrivateKey(ctx, pkey) != 1) {
+        logger_error("Failed to use the inherited TLS certificate");
+    } else {
+        logger_info("Using the TLS certificate inherited from the previous server");
+        result = 0;
+    }
+    X509_free(x509);
+    EVP_PKEY_free(pkey);
+    return result;
+}
+
+/**
+ * @brief Load session ticket keys so tickets stay valid across restarts
+ * 
+ * The file holds TLS_TICKET_KEY_SIZE bytes: 16 bytes key name, 32 bytes
+ * HMAC secret, 32 bytes AES key (e.g. `head -c 80 /dev/urandom`).
+ */
+static int load_ticket_keys(SSL_CTX* ctx, const char* ticket_key_file) {
+    unsigned char keys[TLS_TICKET_KEY_SIZE];
+    FILE* f = fopen(ticket_key_file, "rb");
+    if (!f) {
+        logger_error("Failed to open TLS ticket key file %s: %s", ticket_key_file, get_error_string(errno));
+        return -1;
+    }
+    size_t read = fread(keys, 1, sizeof(keys), f);
+    fclose(f);
+    if (read != sizeof(keys)) {
+        logger_error("TLS ticket key file %s must contain %d bytes", ticket_key_file, TLS_TICKET_KEY_SIZE);
+        return -1;
+    }
+    
+    long result = SSL_CTX_set_tlsext_ticket_keys(ctx, keys, sizeof(keys));
+    OPENSSL_cleanse(keys, sizeof(keys));
+    if (result != 1) {
+        logger_error("Failed to set TLS ticket keys");
+        return -1;
+    }
+    return 0;
+}
+
+void* init_tls_server(const char* cert_file, const char* key_file, const char* ticket_key_file,
+                      const uint8_t* identity, size_t identity_len) {
+    const uint8_t* inherited_cert = NULL;
+    const uint8_t* inherited_key = NULL;
+    const uint8_t* inherited_tickets = NULL;
+    size_t inherited_cert_len = 0;
+    size_t inherited_key_len = 0;
+    if (identity && parse_identity(identity, identity_len, &inherited_cert, &inherited_cert_len,
+                                   &inherited_key, &inherited_key_len, &inherited_tickets) < 0) {
+        logger_warn("Ignoring malformed inherited TLS identity");
+        inherited_cert = NULL;
+        inherited_tickets = NULL;
+    }
+    
+    SSL_library_init();
+    SSL_load_error_strings();
+    OpenSSL_add_all_algorithms();
+    
+    const SSL_METHOD* method = TLS_server_method();
+    SSL_CTX* ctx = SSL_CTX_new(method);
+    
+    if (!ctx) {
+        logger_error("Failed to create SSL context");
+        return NULL;
+    }
+    
+    int loaded;
+    if (cert_file && cert_file[0] && key_file && key_file[0]) {
+        loaded = load_certificate(ctx, cert_file, key_file);
+    } else if (inherited_cert) {
+        loaded = use_identity(ctx, inherited_cert, inherited_cert_len, inherited_key, inherited_key_len);
+    } else {
+        loaded = generate_certificate(ctx);
+    }
+    if (loaded < 0) {
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+    
+    // Resumption: stateful cache for TLS 1.2 session IDs, tickets for both versions
+    static const unsigned char session_id_context[] = "ipc-server";
+    SSL_CTX_set_session_id_context(ctx, session_id_context, sizeof(session_id_context) - 1);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(ctx, TLS_SESSION_CACHE_SIZE);
+    SSL_CTX_set_timeout(ctx, TLS_SESSION_LIFETIME_SEC);
+    SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+    if (ticket_key_file && ticket_key_file[0]) {
+        if (load_ticket_keys(ctx, ticket_key_file) < 0) {
+            SSL_CTX_free(ctx);
+            return NULL;
+        }
+    } else if (inherited_tickets &&
+               SSL_CTX_set_tlsext_ticket_keys(ctx, (void*)inherited_tickets, TLS_TICKET_KEY_SIZE) != 1) {
+        logger_warn("Failed to take over TLS ticket keys; earlier sessions will not resume");
+    }
     
     return ctx;
 }
 
-void* accept_tls_connection(int fd, void* ssl_ctx) {
+uint8_t* tls_export_identity(void* ssl_ctx, size_t* len) {
     SSL_CTX* ctx = (SSL_CTX*)ssl_ctx;
-    SSL* ssl = SSL_new(ctx);
-    if (!ssl) {
+    X509* x509 = SSL_CTX_get0_certificate(ctx);
+    EVP_PKEY* pkey = SSL_CTX_get0_privatekey(ctx);
+    int cert_len = x509 ? i2d_X509(x509, NULL) : -1;
+    int key_len = pkey ? i2d_PrivateKey(pkey, NULL) : -1;
+    if (cert_len <= 0 || key_len <= 0 || cert_len > TLS_IDENTITY_MAX || key_len > TLS_IDENTITY_MAX) {
+        logger_error("Failed to encode the TLS certificate");
         return NULL;
     }
     
-    SSL_set_fd(ssl, fd);
-    
-    if (SSL_accept(ssl) <= 0) {
-        ERR_print_errors_fp(stderr);
-        SSL_free(ssl);
+    size_t total = 8 + (size_t)cert_len + (size_t)key_len + TLS_TICKET_KEY_SIZE;
+    uint8_t* identity = malloc(total);
+    if (!identity) {
+        logger_error("Failed to allocate %zu-byte TLS identity", total);
+        return NULL;
+    }
+    unsigned char* cursor = identity + 4;
+    put_u32(identity, (uint32_t)cert_len);
+    i2d_X509(x509, &cursor);
+    put_u32(cursor, (uint32_t)key_len);
+    cursor += 4;
+    i2d_PrivateKey(pkey, &cursor);
+    if (SSL_CTX_get_tlsext_ticket_keys(ctx, cursor, TLS_TICKET_KEY_SIZE) != 1) {
+        logger_error("Failed to read TLS ticket keys");
+        tls_identity_free(identity, total);
+        return NULL;
+    }
+    *len = total;
+    return identity;
+}
+
+void tls_identity_free(uint8_t* identity, size_t len) {
+    if (identity) {
+        OPENSSL_cleanse(identity, len);
+        free(identity);
+    }
+}
+
+void* create_tls_connection(int fd, void* ssl_ctx) {
+    SSL* ssl = SSL_new((SSL_CTX*)ssl_ctx);
+    if (!ssl) {
         return NULL;
     }
     
+    SSL_set_fd(ssl, fd);
+    SSL_set_accept_state(ssl);
+    // send_nonblocking rebuilds a gathered record in a fresh buffer when it retries
+    SSL_set_mode(ssl, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
     return ssl;
 }
 
+int continue_tls_handshake(void* ssl, int* want_write) {
+    *want_write = 0;
+    
+    int result = SSL_do_handshake((SSL*)ssl);
+    if (result == 1) {
+        return 1;
+    }
+    
+    int err = SSL_get_error((SSL*)ssl, result);
+    if (err == SSL_ERROR_WANT_READ) {
+        return 0;
+    }
+    if (err == SSL_ERROR_WANT_WRITE) {
+        *want_write = 1;
+        return 0;
+    }
+    
+    unsigned long code = ERR_get_error();
+    if (code != 0) {
+        char buf[256];
+        ERR_error_string_n(code, buf, sizeof(buf));
+        logger_warn("TLS handshake failed: %s", buf);
+    } else if (err == SSL_ERROR_SYSCALL && errno != 0) {
+        logger_warn("TLS handshake failed: %s", get_error_string(errno));
+    } else {
+        logger_warn("TLS handshake failed: connection closed by peer");
+    }
+    ERR_clear_error();
+    return -1;
+}
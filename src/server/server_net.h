@@ -8,6 +8,7 @@
 #ifndef SERVER_NET_H
 #define SERVER_NET_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 /**
@@ -19,25 +20,60 @@ int setup_unix_socket(const char* socket_path);
 
 /**
  * @brief Setup Internet socket
- * @param host Host address
+ * @param host IPv4 or IPv6 literal ("localhost", "127.0.0.1" and "" listen on every IPv4 address)
  * @param port Port number
+ * @param reuse_port Enable SO_REUSEPORT (one listener per worker)
  * @return Socket file descriptor on success, -1 on error
  */
-int setup_inet_socket(const char* host, uint16_t port);
+int setup_inet_socket(const char* host, uint16_t port, int reuse_port);
 
 /**
  * @brief Initialize TLS server context
+ * 
+ * Session resumption is enabled (session cache and tickets). Without a
+ * certificate an ephemeral self-signed ECDSA P-256 certificate is used.
+ * @param cert_file PEM certificate chain (NULL or "" to generate one)
+ * @param key_file PEM private key matching cert_file
+ * @param ticket_key_file 80-byte ticket key file (NULL or "" for random per-process keys)
+ * @param identity Identity of the previous server (tls_export_identity, NULL if none). Its
+ *                 certificate replaces the generated one and its ticket keys the random
+ *                 ones; configured files take precedence.
  * @return SSL_CTX pointer on success, NULL on error
  */
-void* init_tls_server(void);
+void* init_tls_server(const char* cert_file, const char* key_file, const char* ticket_key_file,
+                      const uint8_t* identity, size_t identity_len);
+
+/**
+ * @brief Encode the leaf certificate, private key and session ticket keys of a context
+ *
+ * Handed to a replacement server so it keeps the certificate and resumes
+ * the sessions this one issued.
+ * @return Buffer to release with tls_identity_free, NULL on error
+ */
+uint8_t* tls_export_identity(void* ssl_ctx, size_t* len);
 
 /**
- * @brief Accept TLS connection
- * @param fd Socket file descriptor
+ * @brief Wipe and free an identity from tls_export_identity
+ */
+void tls_identity_free(uint8_t* identity, size_t len);
+
+/**
+ * @brief Create server-side TLS state for an accepted socket
+ * 
+ * The handshake is not started; drive it with continue_tls_handshake.
+ * @param fd Non-blocking socket file descriptor
  * @param ssl_ctx SSL context
  * @return SSL pointer on success, NULL on error
  */
-void* accept_tls_connection(int fd, void* ssl_ctx);
+void* create_tls_connection(int fd, void* ssl_ctx);
+
+/**
+ * @brief Advance a TLS handshake as far as possible without blocking
+ * @param ssl SSL pointer from create_tls_connection
+ * @param want_write Set to 1 if the handshake waits for the socket to become writable
+ * @return 1 when the handshake is complete, 0 if it needs more I/O, -1 on failure
+ */
+int continue_tls_handshake(void* ssl, int* want_write);
 
 #endif // SERVER_NET_H
 
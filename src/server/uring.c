@@ -0,0 +1,404 @@
+/**
+ * @file uring.c
+ * @brief io_uring ring setup, submission and completion handling
+ */
+
+#define _GNU_SOURCE
+#include "uring.h"
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define URING_BUFFER_GROUP 0
+#define URING_CQ_FACTOR 4   // Completion queue entries per submission entry
+
+struct UringRing {
+    int fd;
+    
+    // Submission queue
+    void* sq_ptr;
+    size_t sq_size;
+    unsigned* sq_khead;
+    unsigned* sq_ktail;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned sq_tail;           ///< Local tail, published on submit
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+    
+    // Completion queue
+    void* cq_ptr;
+    size_t cq_size;
+    unsigned* cq_khead;
+    unsigned* cq_ktail;
+    unsigned cq_mask;
+    struct io_uring_cqe* cqes;
+    
+    // Provided receive buffers
+    struct io_uring_buf_ring* buf_ring;
+    size_t buf_ring_size;
+    uint8_t* buffers;
+    unsigned buf_count;
+    size_t buf_size;
+    uint16_t buf_tail;
+};
+
+static int sys_uring_setup(unsigned entries, struct io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                           const void* arg, size_t arg_size) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_size);
+}
+
+static int sys_uring_register(int fd, unsigned opcode, const void* arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void add_buffer(UringRing* ring, uint16_t bid) {
+    struct io_uring_buf* buf = &ring->buf_ring->bufs[ring->buf_tail & (ring->buf_count - 1)];
+    buf->addr = (uint64_t)(uintptr_t)(ring->buffers + (size_t)bid * ring->buf_size);
+    buf->len = (uint32_t)ring->buf_size;
+    buf->bid = bid;
+    ring->buf_tail++;
+}
+
+static void publish_buffers(UringRing* ring) {
+    __atomic_store_n(&ring->buf_ring->tail, ring->buf_tail, __ATOMIC_RELEASE);
+}
+
+static int setup_buffers(UringRing* ring, unsigned count, size_t size) {
+    ring->buf_count = count;
+    ring->buf_size = size;
+    ring->buf_ring_size = count * sizeof(struct io_uring_buf);
+    ring->buf_ring = mmap(NULL, ring->buf_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring->buf_ring == MAP_FAILED) {
+        ring->buf_ring = NULL;
+        return -1;
+    }
+    
+    ring->buffers = malloc((size_t)count * size);
+    if (!ring->buffers) {
+        return -1;
+    }
+    
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring->buf_ring;
+    reg.ring_entries = count;
+    reg.bgid = URING_BUFFER_GROUP;
+    if (sys_uring_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        return -1;
+    }
+    
+    for (unsigned i = 0; i < count; i++) {
+        add_buffer(ring, (uint16_t)i);
+    }
+    publish_buffers(ring);
+    return 0;
+}
+
+static int map_rings(UringRing* ring, const struct io_uring_params* p) {
+    ring->sq_size = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+    ring->cq_size = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+    int single_mmap = (p->features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap && ring->cq_size > ring->sq_size) {
+        ring->sq_size = ring->cq_size;
+    }
+    
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        ring->sq_ptr = NULL;
+        return -1;
+    }
+    
+    if (single_mmap) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            ring->cq_ptr = NULL;
+            return -1;
+        }
+    }
+    
+    ring->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        return -1;
+    }
+    
+    uint8_t* sq = (uint8_t*)ring->sq_ptr;
+    ring->sq_khead = (unsigned*)(sq + p->sq_off.head);
+    ring->sq_ktail = (unsigned*)(sq + p->sq_off.tail);
+    ring->sq_mask = *(unsigned*)(sq + p->sq_off.ring_mask);
+    ring->sq_entries = p->sq_entries;
+    ring->sq_tail = *ring->sq_ktail;
+    
+    // Identity mapping: SQE slot i is always described by array entry i
+    unsigned* array = (unsigned*)(sq + p->sq_off.array);
+    for (unsigned i = 0; i < p->sq_entries; i++) {
+        array[i] = i;
+    }
+    
+    uint8_t* cq = (uint8_t*)ring->cq_ptr;
+    ring->cq_khead = (unsigned*)(cq + p->cq_off.head);
+    ring->cq_ktail = (unsigned*)(cq + p->cq_off.tail);
+    ring->cq_mask = *(unsigned*)(cq + p->cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + p->cq_off.cqes);
+    return 0;
+}
+
+UringRing* uring_create(unsigned entries, unsigned buffer_count, size_t buffer_size) {
+    if (buffer_count == 0 || (buffer_count & (buffer_count - 1)) != 0 || buffer_count > 32768) {
+        errno = EINVAL;
+        return NULL;
+    }
+    
+    UringRing* ring = calloc(1, sizeof(UringRing));
+    if (!ring) {
+        return NULL;
+    }
+    
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN;
+    params.cq_entries = entries * URING_CQ_FACTOR;
+    ring->fd = sys_uring_setup(entries, &params);
+    if (ring->fd < 0 && errno == EINVAL) {
+        // Kernels before 5.19 have no COOP_TASKRUN
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = entries * URING_CQ_FACTOR;
+        ring->fd = sys_uring_setup(entries, &params);
+    }
+    if (ring->fd < 0) {
+        free(ring);
+        return NULL;
+    }
+    
+    // Timed waits need EXT_ARG; NODROP keeps completions when the CQ overflows
+    int saved_errno = ENOSYS;
+    if ((params.features & IORING_FEAT_EXT_ARG) && (params.features & IORING_FEAT_NODROP)) {
+        if (map_rings(ring, &params) == 0 && setup_buffers(ring, buffer_count, buffer_size) == 0) {
+            return ring;
+        }
+        saved_errno = errno;
+    }
+    
+    uring_destroy(ring);
+    errno = saved_errno;
+    return NULL;
+}
+
+void uring_destroy(UringRing* ring) {
+    if (!ring) return;
+    
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+    if (ring->sqes) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ptr && ring->cq_ptr != ring->sq_ptr) {
+        munmap(ring->cq_ptr, ring->cq_size);
+    }
+    if (ring->sq_ptr) {
+        munmap(ring->sq_ptr, ring->sq_size);
+    }
+    if (ring->buf_ring) {
+        munmap(ring->buf_ring, ring->buf_ring_size);
+    }
+    free(ring->buffers);
+    free(ring);
+}
+
+/**
+ * @brief Publish queued SQEs and enter the kernel
+ */
+static int enter(UringRing* ring, unsigned min_complete, int timeout_ms) {
+    __atomic_store_n(ring->sq_ktail, ring->sq_tail, __ATOMIC_RELEASE);
+    unsigned to_submit = ring->sq_tail - __atomic_load_n(ring->sq_khead, __ATOMIC_ACQUIRE);
+    
+    unsigned flags = 0;
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    const void* argp = NULL;
+    size_t arg_size = 0;
+    
+    if (min_complete > 0) {
+        flags |= IORING_ENTER_GETEVENTS;
+        if (timeout_ms >= 0) {
+            ts.tv_sec = timeout_ms / 1000;
+            ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000LL;
+            memset(&arg, 0, sizeof(arg));
+            arg.ts = (uint64_t)(uintptr_t)&ts;
+            flags |= IORING_ENTER_EXT_ARG;
+            argp = &arg;
+            arg_size = sizeof(arg);
+        }
+    } else if (to_submit == 0) {
+        return 0;
+    }
+    
+    int result = sys_uring_enter(ring->fd, to_submit, min_complete, flags, argp, arg_size);
+    if (result < 0 && (errno == ETIME || errno == EINTR || errno == EBUSY)) {
+        return 0;
+    }
+    return result < 0 ? -1 : 0;
+}
+
+/**
+ * @brief Ensure at least count free SQE slots, submitting if the queue is full
+ */
+static int reserve(UringRing* ring, unsigned count) {
+    unsigned head = __atomic_load_n(ring->sq_khead, __ATOMIC_ACQUIRE);
+    if (ring->sq_entries - (ring->sq_tail - head) >= count) {
+        return 0;
+    }
+    if (enter(ring, 0, 0) < 0) {
+        return -1;
+    }
+    head = __atomic_load_n(ring->sq_khead, __ATOMIC_ACQUIRE);
+    return ring->sq_entries - (ring->sq_tail - head) >= count ? 0 : -1;
+}
+
+static struct io_uring_sqe* get_sqe(UringRing* ring) {
+    if (reserve(ring, 1) < 0) {
+        return NULL;
+    }
+    struct io_uring_sqe* sqe = &ring->sqes[ring->sq_tail & ring->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_tail++;
+    return sqe;
+}
+
+int uring_accept_multishot(UringRing* ring, int fd, uint64_t user_data) {
+    struct io_uring_sqe* sqe = get_sqe(ring);
+    if (!sqe) {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = user_data;
+    return 0;
+}
+
+int uring_recv_multishot(UringRing* ring, int fd, uint64_t user_data) {
+    struct io_uring_sqe* sqe = get_sqe(ring);
+    if (!sqe) {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = user_data;
+    return 0;
+}
+
+int uring_send(UringRing* ring, int fd, const void* buf, size_t len, int link, uint64_t user_data) {
+    // A linked SQE must be followed by its successor, so reserve both slots
+    if (reserve(ring, link ? 2 : 1) < 0) {
+        return -1;
+    }
+    struct io_uring_sqe* sqe = get_sqe(ring);
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = (uint32_t)len;
+    // WAITALL: a short write fails the request and breaks the link instead of
+    // letting the next part of the frame go out after a partial one
+    sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+    sqe->flags = link ? IOSQE_IO_LINK : 0;
+    sqe->user_data = user_data;
+    return 0;
+}
+
+int uring_read(UringRing* ring, int fd, void* buf, size_t len, uint64_t user_data) {
+    struct io_uring_sqe* sqe = get_sqe(ring);
+    if (!sqe) {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = (uint32_t)len;
+    sqe->off = (uint64_t)-1;    // Current position: required for non-seekable files
+    sqe->user_data = user_data;
+    return 0;
+}
+
+int uring_cancel(UringRing* ring, uint64_t target, uint64_t user_data) {
+    struct io_uring_sqe* sqe = get_sqe(ring);
+    if (!sqe) {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = user_data;
+    return 0;
+}
+
+int uring_wait(UringRing* ring, int timeout_ms) {
+    // Completions already pending: only submit
+    unsigned head = *ring->cq_khead;
+    if (__atomic_load_n(ring->cq_ktail, __ATOMIC_ACQUIRE) != head) {
+        return enter(ring, 0, 0);
+    }
+    return enter(ring, 1, timeout_ms);
+}
+
+int uring_reap(UringRing* ring, UringCompletion* out, int max) {
+    unsigned head = *ring->cq_khead;
+    unsigned tail = __atomic_load_n(ring->cq_ktail, __ATOMIC_ACQUIRE);
+    int count = 0;
+    
+    while (head != tail && count < max) {
+        const struct io_uring_cqe* cqe = &ring->cqes[head & ring->cq_mask];
+        out[count].user_data = cqe->user_data;
+        out[count].res = cqe->res;
+        out[count].flags = cqe->flags;
+        count++;
+        head++;
+    }
+    
+    __atomic_store_n(ring->cq_khead, head, __ATOMIC_RELEASE);
+    return count;
+}
+
+const uint8_t* uring_completion_buffer(UringRing* ring, const UringCompletion* cqe, uint16_t* bid) {
+    if (!(cqe->flags & IORING_CQE_F_BUFFER)) {
+        return NULL;
+    }
+    uint16_t id = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+    if (id >= ring->buf_count) {
+        return NULL;
+    }
+    *bid = id;
+    return ring->buffers + (size_t)id * ring->buf_size;
+}
+
+void uring_recycle_buffer(UringRing* ring, uint16_t bid) {
+    add_buffer(ring, bid);
+    publish_buffers(ring);
+}
+
+int uring_completion_more(const UringCompletion* cqe) {
+    return (cqe->flags & IORING_CQE_F_MORE) != 0;
+}
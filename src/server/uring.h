@@ -0,0 +1,105 @@
+/**
+ * @file uring.h
+ * @brief Minimal io_uring wrapper for the completion-based server backend
+ *
+ * Talks to the kernel through the raw io_uring syscalls. Receives use a
+ * provided buffer ring, so a multishot recv hands out filled buffers
+ * without an SQE per read; accepts are multishot as well. Submissions are
+ * batched and flushed by uring_wait, so steady-state traffic costs one
+ * io_uring_enter per loop iteration. Requires Linux 6.0 or newer.
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Completion copied out of the CQ ring
+ */
+typedef struct {
+    uint64_t user_data; ///< Value given at submission
+    int32_t res;        ///< Result (bytes, fd) or -errno
+    uint32_t flags;     ///< IORING_CQE_F_* flags
+} UringCompletion;
+
+typedef struct UringRing UringRing;
+
+/**
+ * @brief Create a ring with a provided receive buffer ring
+ * @param entries Submission queue size
+ * @param buffer_count Number of receive buffers (power of two)
+ * @param buffer_size Size of each receive buffer
+ * @return Ring on success, NULL on error (errno set)
+ */
+UringRing* uring_create(unsigned entries, unsigned buffer_count, size_t buffer_size);
+
+/**
+ * @brief Destroy ring (cancels everything in flight, descriptors are not closed)
+ */
+void uring_destroy(UringRing* ring);
+
+/**
+ * @brief Queue a multishot accept
+ * @return 0 on success, -1 if the submission queue is full
+ */
+int uring_accept_multishot(UringRing* ring, int fd, uint64_t user_data);
+
+/**
+ * @brief Queue a multishot receive into provided buffers
+ * @return 0 on success, -1 if the submission queue is full
+ */
+int uring_recv_multishot(UringRing* ring, int fd, uint64_t user_data);
+
+/**
+ * @brief Queue a send of the whole buffer
+ * @param link Link the next queued operation to this one (it only starts once this completes)
+ * @return 0 on success, -1 if the submission queue is full
+ */
+int uring_send(UringRing* ring, int fd, const void* buf, size_t len, int link, uint64_t user_data);
+
+/**
+ * @brief Queue a read into buf (eventfds and other non-socket descriptors)
+ * @return 0 on success, -1 if the submission queue is full
+ */
+int uring_read(UringRing* ring, int fd, void* buf, size_t len, uint64_t user_data);
+
+/**
+ * @brief Queue cancellation of the operation submitted with user_data target
+ * @param user_data Tag of the cancellation's own completion
+ * @return 0 on success, -1 if the submission queue is full
+ */
+int uring_cancel(UringRing* ring, uint64_t target, uint64_t user_data);
+
+/**
+ * @brief Submit queued operations and wait for at least one completion
+ * @param timeout_ms Timeout in milliseconds (-1 blocks)
+ * @return 0 on success or timeout, -1 on error (errno set)
+ */
+int uring_wait(UringRing* ring, int timeout_ms);
+
+/**
+ * @brief Take completions out of the CQ ring
+ * @return Number of completions stored in out
+ */
+int uring_reap(UringRing* ring, UringCompletion* out, int max);
+
+/**
+ * @brief Receive buffer selected for a completion
+ * @param bid Output buffer id (pass to uring_recycle_buffer)
+ * @return Buffer data, NULL if the completion carries no buffer
+ */
+const uint8_t* uring_completion_buffer(UringRing* ring, const UringCompletion* cqe, uint16_t* bid);
+
+/**
+ * @brief Give a receive buffer back to the kernel
+ */
+void uring_recycle_buffer(UringRing* ring, uint16_t bid);
+
+/**
+ * @brief Whether a multishot operation stays armed after this completion
+ */
+int uring_completion_more(const UringCompletion* cqe);
+
+#endif // URING_H